@@ -0,0 +1,57 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace ipc {
+/** One slot of a bulk channel, see server::create_bulk_channel().
+ *
+ * |data| points straight into shared memory. The writer gets the slot's
+ * capacity as |size| and fills it in place, the reader gets what was filled.
+ */
+struct bulk_buffer {
+	uint32_t slot = 0;
+	uint64_t sequence = 0;
+	char *data = nullptr;
+	size_t size = 0;
+};
+
+// Server end of a bulk channel, used from one thread at a time.
+class bulk_writer {
+public:
+	virtual ~bulk_writer(){};
+
+	// Whether a client has the channel open, buffers are only handed out while one does.
+	virtual bool has_reader() = 0;
+	// Next slot to fill. False while the reader still holds every slot or there is no reader, the caller drops or retries.
+	virtual bool acquire(ipc::bulk_buffer &buffer) = 0;
+	// Hand the acquired |buffer| with |size| bytes filled to the reader. Only its slot index and sequence travel through the connection.
+	virtual bool publish(const ipc::bulk_buffer &buffer, size_t size) = 0;
+};
+
+// Client end of a bulk channel, see client::open_bulk_channel().
+class bulk_reader {
+public:
+	virtual ~bulk_reader(){};
+
+	// Let the writer reuse a buffer that was handed to the reader, in the order they were handed over. From one thread at a time.
+	virtual bool release(const ipc::bulk_buffer &buffer) = 0;
+};
+}
@@ -0,0 +1,73 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "ipc-client.hpp"
+
+namespace ipc {
+/** Callbacks of a client's calls in flight, by uid.
+ *
+ * The client's uids count up from one, and a uid is only handed out once its
+ * slot, the uid modulo the capacity, is free. Registering a call and looking
+ * up its reply each come down to a few atomic operations on that slot,
+ * without a lock or an allocation. If every slot tried is taken the call goes
+ * into a locked map instead, so there is no limit on calls in flight.
+ */
+class call_table {
+public:
+	typedef std::pair<call_return_t, void *> entry;
+
+	static constexpr size_t capacity = 1024;
+
+	call_table();
+
+	// Register a call and return its uid. Calls without a callback only get a uid.
+	uint64_t insert(call_return_t fn, void *data);
+	// Remove a call, and hand out its callback if it was still registered.
+	bool take(uint64_t uid, entry &callback);
+	bool cancel(uint64_t uid);
+	// Remove every call, for failing them all once the connection is gone.
+	std::vector<entry> drain();
+
+private:
+	// A key of 0 marks a free slot, claimed while its owner fills it in.
+	static constexpr uint64_t free_key = 0, claimed_key = UINT64_MAX;
+	// Uids tried before falling back to the map.
+	static constexpr size_t probe_limit = 16;
+
+	struct slot {
+		std::atomic<uint64_t> key = free_key;
+		std::atomic<call_return_t> fn = nullptr;
+		std::atomic<void *> data = nullptr;
+	};
+
+	std::atomic<uint64_t> m_next_uid = 1;
+	std::array<slot, capacity> m_slots;
+
+	std::mutex m_overflow_mtx;
+	std::atomic<size_t> m_overflow_size = 0;
+	std::map<uint64_t, entry> m_overflow;
+};
+}
@@ -22,6 +22,7 @@
 #include "ipc-value.hpp"
 #include <map>
 #include <memory>
+#include <string_view>
 
 namespace ipc {
 class collection {
@@ -31,10 +32,11 @@ public:
 
 	std::string get_name();
 	bool register_function(std::shared_ptr<function> func);
-	std::shared_ptr<function> get_function(const std::string &name);
+	std::shared_ptr<function> get_function(std::string_view name);
+	const std::map<std::string, std::shared_ptr<function>, std::less<>> &get_functions();
 
 private:
 	std::string m_name;
-	std::map<std::string, std::shared_ptr<function>> m_functions;
+	std::map<std::string, std::shared_ptr<function>, std::less<>> m_functions;
 };
 }
\ No newline at end of file
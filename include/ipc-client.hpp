@@ -17,11 +17,20 @@
 ******************************************************************************/
 
 #pragma once
+#include <atomic>
+#include <chrono>
 #include <functional>
+#include <map>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <memory>
 #include "ipc.hpp"
+#include "ipc-bulk.hpp"
 #include "ipc-socket.hpp"
+#ifdef IPC_COROUTINES
+#include <coroutine>
+#endif
 
 typedef void (*call_return_t)(void *data, const std::vector<ipc::value> &rval, std::chrono::high_resolution_clock::duration obs_call_duration);
 extern call_return_t g_fn;
@@ -31,9 +40,77 @@ extern int64_t g_cbid;
 typedef void (*call_on_freeze_t)(const std::string &app_state_path, const std::string &call_name, int total_time, int obs_time);
 
 namespace ipc {
+/** Reply of a call made through ipc::client::call_async().
+ *
+ * Copies share the same reply. A failed call completes with a single Null
+ * value holding the error message, like the replies call() hands over.
+ */
+class call_future {
+	struct state;
+	std::shared_ptr<state> m_state;
+
+	friend class client;
+
+public:
+	call_future() {}
+
+	// False for a default constructed future.
+	bool valid() const;
+	bool ready() const;
+	void wait() const;
+	bool wait_for(std::chrono::nanoseconds timeout) const;
+
+	// Wait for the reply and move its values out, later calls return nothing.
+	std::vector<ipc::value> get();
+	// Time the server spent in the function, valid once ready.
+	std::chrono::high_resolution_clock::duration duration() const;
+
+#ifdef IPC_COROUTINES
+	// co_await resumes the coroutine with the reply's values, on the thread that read the
+	// reply or through the client's completion executor. A blocking call from there stalls the client.
+	bool await_ready() const;
+	bool await_suspend(std::coroutine_handle<> caller);
+	std::vector<ipc::value> await_resume();
+#endif
+};
+
+// One call of a batch, see client::call_batch(). Without |fn| the call goes out one way, see client::call_one_way().
+struct call_spec {
+	std::string class_name;
+	std::string function_name;
+	std::vector<ipc::value> arguments;
+	call_return_t fn = nullptr;
+	void *data = nullptr;
+};
+
+// Latest values the server keeps under a key, see client::open_live_value().
+class live_value {
+public:
+	virtual ~live_value(){};
+
+	// Copy the latest values into |values| without involving the server. False if none were stored yet.
+	virtual bool read(std::vector<ipc::value> &values) = 0;
+	// Number of times the values were stored, zero before the first time.
+	virtual uint64_t version() = 0;
+};
+
 class client {
 public:
 	using call_on_disconnect_t = std::function<void()>;
+	using async_return_t = std::function<void(const std::vector<ipc::value> &rval, std::chrono::high_resolution_clock::duration obs_call_duration)>;
+	// Runs the task it is given, on whatever thread it likes.
+	using completion_executor_t = std::function<void(std::function<void()> task)>;
+	using event_handler_t = std::function<void(const std::vector<ipc::value> &values)>;
+	// Gets the reader too, buffers may arrive before open_bulk_channel() returned it.
+	using bulk_handler_t = std::function<void(ipc::bulk_reader &reader, const ipc::bulk_buffer &buffer)>;
+
+	enum class transport {
+		// The platform's socket or named pipe.
+		Default,
+		// Calls and replies travel through rings in shared memory, the socket is
+		// only used to set them up. Falls back to Default where unavailable.
+		SharedMemory,
+	};
 
 	client(){};
 	virtual ~client(){};
@@ -41,8 +118,11 @@ public:
 	// |disconnectionCallback| is called when the server disconnection is detected.
 	// If the callback is not set or you use the other constructor,
 	// the client will just call |exit(1)| when the server disconnects.
+	// On macOS there is no background detection, the first call that fails
+	// because the server is gone runs |disconnectionCallback| and nothing exits.
 	static std::shared_ptr<client> create(const std::string &socketPath, call_on_disconnect_t disconnectionCallback);
 	static std::shared_ptr<client> create(std::string socketPath);
+	static std::shared_ptr<client> create(const std::string &socketPath, call_on_disconnect_t disconnectionCallback, transport kind);
 
 	// Stop all internal threads and the background disconnection detection.
 	// Call this if you do not plan to use the object anymore
@@ -55,11 +135,89 @@ public:
 
 	virtual std::vector<ipc::value> call_synchronous_helper(const std::string &cname, const std::string &fname, const std::vector<ipc::value> &args) = 0;
 
+	/** Make all of |calls| at once, each callback gets its own entry's reply.
+	 *
+	 * Where the server speaks v2 the calls travel in a single frame and their
+	 * replies come back in a single frame, so a burst of small calls pays for
+	 * framing and wakeups once. Otherwise they go out one by one. Returns false
+	 * if the batch could not be sent, no callback is called then; calls sent
+	 * one by one before the failure still complete.
+	 */
+	virtual bool call_batch(std::vector<call_spec> calls);
+
+	/** Make a call nobody waits for, returns once the frame is on its way.
+	 *
+	 * Where the server speaks v2 it sends no reply at all, not even an error,
+	 * and the call takes no entry in the table of calls in flight. Otherwise
+	 * the reply is dropped when it arrives.
+	 */
+	virtual bool call_one_way(const std::string &cname, const std::string &fname, std::vector<ipc::value> args);
+
+	// Pass |message| to the server's message handler, in order with calls made before and after. One way like call_one_way().
+	bool send_message(const std::vector<char> &message);
+
+	/** Have |handler| called with the values of every event |event| of class |cname| the server publishes.
+	 *
+	 * Events arrive on the thread that reads replies, in the order they were
+	 * published, so a slow handler holds up replies. Subscribing again replaces
+	 * the handler. Blocks until the server confirmed, so it must not be called
+	 * from a handler or callback. Returns false if the server refused, can't
+	 * send events or doesn't answer in time, nothing is subscribed then.
+	 */
+	bool subscribe(const std::string &cname, const std::string &event, event_handler_t handler);
+	// Stop receiving an event, events already on their way are dropped.
+	bool unsubscribe(const std::string &cname, const std::string &event);
+
+	/** Open the live value the server keeps under |key|, see server::create_live_value().
+	 *
+	 * Reading it is a copy out of shared memory. With |on_change| the server
+	 * announces changes made after this returned, one at a time: the next one
+	 * is only sent once |on_change| was handed the latest values, so changes
+	 * that came in between are skipped rather than queued. |on_change| runs
+	 * like an event handler and replaces the one of a live value opened under
+	 * the same key before. Blocks like subscribe(). Null if the server or the
+	 * platform has no such live value, or the server doesn't answer in time.
+	 */
+	virtual std::shared_ptr<ipc::live_value> open_live_value(const std::string &key, event_handler_t on_change = nullptr);
+
+	/** Become the reader of the bulk channel the server keeps under |key|, see server::create_bulk_channel().
+	 *
+	 * |handler| is handed every buffer published from then on, in order and
+	 * like an event. A buffer stays valid and untouched until it is passed to
+	 * bulk_reader::release(), which may happen later and on another thread,
+	 * and the server can't reuse its slot before. Dropping the reader stops
+	 * delivery without releasing anything. Blocks like subscribe(). Null if
+	 * the server or the platform has no such channel, or the server doesn't
+	 * answer in time.
+	 */
+	virtual std::shared_ptr<ipc::bulk_reader> open_bulk_channel(const std::string &key, bulk_handler_t handler);
+
+	// call() without the function pointer and void * plumbing. Replies that never arrive leave the future waiting, as they leave call() callbacks uncalled.
+	call_future call_async(const std::string &cname, const std::string &fname, std::vector<ipc::value> args);
+	// Returns false if the call could not be sent, |callback| is not called then.
+	bool call_async(const std::string &cname, const std::string &fname, std::vector<ipc::value> args, async_return_t callback);
+
+	// Deliver call_async() callbacks through |executor| instead of on the thread that reads replies, which
+	// a slow callback holds up. Futures only use it to resume coroutines awaiting them. Set it before making calls.
+	void set_completion_executor(completion_executor_t executor);
+
 	void set_freeze_callback(call_on_freeze_t cb, std::string app_state);
 
+	// Binary arguments of at least |bytes| are passed as shared memory, see ipc::shared_binary.
+	// Zero, the default, copies everything into the frame. Ignored by transports that can't pass descriptors.
+	void set_shared_binary_threshold(size_t bytes);
+
 protected:
 	std::string m_app_state_path;
 	call_on_freeze_t m_freeze_cb = nullptr;
+	size_t m_shared_binary_threshold = 0;
+	completion_executor_t m_completion_executor;
 	std::atomic_bool m_shutting_down = false;
+
+	std::mutex m_events_mtx;
+	std::map<std::string, std::map<std::string, event_handler_t, std::less<>>, std::less<>> m_events;
+
+	// Call the handler subscribed to an event the server published, if there still is one.
+	void dispatch_event(std::string_view cname, std::string_view event, const std::vector<ipc::value> &values);
 };
 }
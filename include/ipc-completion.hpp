@@ -0,0 +1,72 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace ipc {
+/** Wait slot for the reply to one synchronous call.
+ *
+ * Slots are taken from a process-wide pool and handed back once the reply
+ * is in, so a synchronous call creates no kernel object and allocates
+ * nothing after the first few. On Linux a slot is a single futex word that
+ * only enters the kernel when the caller actually has to sleep, elsewhere it
+ * is a mutex and a condition variable.
+ */
+class completion {
+public:
+	// A slot taken from the pool, returned to it when this goes away.
+	class lease {
+		completion *m_slot;
+
+	public:
+		lease();
+		~lease();
+		lease(const lease &) = delete;
+		lease &operator=(const lease &) = delete;
+
+		completion *operator->() const { return m_slot; }
+		completion &operator*() const { return *m_slot; }
+	};
+
+	// Mark the call as done and wake its caller, from any thread.
+	void signal();
+	// Wait until signal() was called, false if |timeout| passed first.
+	bool wait_for(std::chrono::nanoseconds timeout);
+	void wait();
+
+private:
+	completion() {}
+
+#ifdef __linux__
+	// 0 while pending, 1 while pending with the caller asleep, 2 once done.
+	std::atomic<uint32_t> m_state = 0;
+#else
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+	bool m_done = false;
+#endif
+
+	static completion *acquire();
+	static void release(completion *slot);
+};
+}
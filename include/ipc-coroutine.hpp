@@ -0,0 +1,217 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+
+#pragma once
+#ifndef IPC_COROUTINES
+#error "ipc-coroutine.hpp needs the library built with lib-streamlabs-ipc_COROUTINES"
+#endif
+
+#include "ipc.hpp"
+#include "ipc-function.hpp"
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace ipc {
+template<typename T = void> class task;
+
+struct task_promise_base {
+	// Who to resume once the task is done, nobody until it is awaited.
+	std::coroutine_handle<> continuation = std::noop_coroutine();
+	std::exception_ptr error;
+
+	struct final_awaiter {
+		bool await_ready() noexcept { return false; }
+		template<typename Promise> std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+		{
+			return handle.promise().continuation;
+		}
+		void await_resume() noexcept {}
+	};
+
+	std::suspend_always initial_suspend() noexcept { return {}; }
+	final_awaiter final_suspend() noexcept { return {}; }
+	void unhandled_exception() { error = std::current_exception(); }
+};
+
+template<typename T> struct task_promise : task_promise_base {
+	std::optional<T> value;
+
+	task<T> get_return_object();
+	void return_value(T p_value) { value.emplace(std::move(p_value)); }
+	T result()
+	{
+		if (error) {
+			std::rethrow_exception(error);
+		}
+		return std::move(*value);
+	}
+};
+
+template<> struct task_promise<void> : task_promise_base {
+	task<void> get_return_object();
+	void return_void() {}
+	void result()
+	{
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+};
+
+/** Lazily started coroutine, runs once it is awaited and hands back its result or exception.
+ *
+ * Awaiting a task resumes it on the awaiting thread and continues the awaiter
+ * straight from the task's end, so chains of tasks neither grow the stack nor
+ * involve a scheduler. Calls are awaited through ipc::call_future:
+ *
+ *	ipc::task<uint64_t> count(std::shared_ptr<ipc::client> client, uint64_t from)
+ *	{
+ *		std::vector<ipc::value> args = {ipc::value(from)};
+ *		std::vector<ipc::value> rval = co_await client->call_async("Cls", "Count", std::move(args));
+ *		co_return rval[0].value_union.ui64;
+ *	}
+ *
+ * Arguments are built before the co_await, GCC 12 rejects an initializer list inside it.
+ */
+template<typename T> class task {
+public:
+	typedef task_promise<T> promise_type;
+
+	explicit task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+	task(task &&other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+	task &operator=(task &&other) noexcept
+	{
+		std::swap(m_handle, other.m_handle);
+		return *this;
+	}
+	task(const task &) = delete;
+	task &operator=(const task &) = delete;
+	~task()
+	{
+		if (m_handle) {
+			m_handle.destroy();
+		}
+	}
+
+	auto operator co_await() && noexcept
+	{
+		struct awaiter {
+			std::coroutine_handle<promise_type> handle;
+
+			bool await_ready() noexcept { return false; }
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+			{
+				handle.promise().continuation = caller;
+				return handle;
+			}
+			T await_resume() { return handle.promise().result(); }
+		};
+		return awaiter{m_handle};
+	}
+
+private:
+	std::coroutine_handle<promise_type> m_handle;
+};
+
+template<typename T> inline task<T> task_promise<T>::get_return_object()
+{
+	return task<T>(std::coroutine_handle<task_promise<T>>::from_promise(*this));
+}
+
+inline task<void> task_promise<void>::get_return_object()
+{
+	return task<void>(std::coroutine_handle<task_promise<void>>::from_promise(*this));
+}
+
+// Coroutine frame that nobody waits for, it frees itself when it ends.
+struct detached_task {
+	struct promise_type {
+		detached_task get_return_object() noexcept { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() noexcept {}
+		void unhandled_exception() noexcept { std::terminate(); }
+	};
+};
+
+inline detached_task run_detached(ipc::task<void> work)
+{
+	try {
+		co_await std::move(work);
+	} catch (std::exception &e) {
+		ipc::log("Spawned task failed with error %s.", e.what());
+	}
+}
+
+/** Start |work| right away on this thread and let it run to its end on its own.
+ *
+ * It runs until its first suspension before this returns. Exceptions that
+ * escape it are logged.
+ */
+inline void spawn(ipc::task<void> work)
+{
+	run_detached(std::move(work));
+}
+
+// Handler of a coroutine function. Arguments stay valid until the task is done, across every co_await in it.
+typedef ipc::task<std::vector<ipc::value>> (*coroutine_call_handler_t)(void *data, const int64_t id, ipc::span<const ipc::value_view> args);
+
+/** Function whose handler is a coroutine, on top of an async_call_handler_t.
+ *
+ * The task starts on the thread the server hands the call to and the reply
+ * goes out once it is done, so a handler can co_await calls to other servers
+ * without holding up a thread. An exception thrown by it fails the call.
+ */
+class coroutine_function : public ipc::function {
+public:
+	coroutine_function(const std::string &name, const std::vector<ipc::type> &params, coroutine_call_handler_t ptr, void *data)
+		: function(name, params, &coroutine_function::start, this), m_handler(ptr), m_data(data)
+	{
+	}
+
+private:
+	coroutine_call_handler_t m_handler;
+	void *m_data;
+
+	static void start(void *data, const int64_t id, ipc::span<const ipc::value_view> args, ipc::call_completion_t done)
+	{
+		coroutine_function *self = static_cast<coroutine_function *>(data);
+		ipc::spawn(finish(self->m_handler(self->m_data, id, args), std::move(done)));
+	}
+
+	static ipc::task<void> finish(ipc::task<std::vector<ipc::value>> work, ipc::call_completion_t done)
+	{
+		std::vector<ipc::value> rval;
+		std::string error;
+		try {
+			rval = co_await std::move(work);
+		} catch (std::exception &e) {
+			error = e.what();
+		}
+		done(rval, error);
+	}
+};
+
+inline std::shared_ptr<ipc::function> make_coroutine_function(const std::string &name, coroutine_call_handler_t ptr, void *data = nullptr)
+{
+	return std::make_shared<ipc::coroutine_function>(name, std::vector<ipc::type>(), ptr, data);
+}
+}
@@ -0,0 +1,56 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ipc {
+/** Fixed pool of threads that server calls can be handed to.
+ *
+ * Tasks posted to the pool run on whichever worker is free, pinned tasks all
+ * run on one extra thread in the order they were posted. Destroying the
+ * executor runs what is still queued and joins every thread.
+ */
+class executor {
+	struct queue {
+		std::mutex mtx;
+		std::condition_variable cv;
+		// Pending from |head| on. The storage is kept once drained, so posting doesn't allocate.
+		std::vector<std::function<void()>> tasks;
+		size_t head = 0;
+		bool stop = false;
+	};
+
+	queue m_pool, m_pinned;
+	std::vector<std::thread> m_workers;
+	std::thread m_pinned_worker;
+
+	static void worker(queue &tasks);
+
+public:
+	executor(size_t threads);
+	~executor();
+
+	void post(std::function<void()> task);
+	void post_pinned(std::function<void()> task);
+};
+}
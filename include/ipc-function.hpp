@@ -19,10 +19,33 @@
 #pragma once
 #include "ipc.hpp"
 #include "ipc-value.hpp"
+#include <array>
+#include <functional>
 #include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 
 namespace ipc {
 typedef void (*call_handler_t)(void *data, const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval);
+// Arguments borrow from the received frame and are only valid during the call, see ipc::value_view.
+typedef void (*view_call_handler_t)(void *data, const int64_t id, ipc::span<const ipc::value_view> args, std::vector<ipc::value> &rval);
+// Finishes an asynchronous call, exactly once and from any thread. A non-empty |error| fails the call.
+typedef std::function<void(std::vector<ipc::value> &rval, const std::string &error)> call_completion_t;
+// Returns as soon as the work is started. Arguments stay valid until |done| has been called.
+typedef void (*async_call_handler_t)(void *data, const int64_t id, ipc::span<const ipc::value_view> args, ipc::call_completion_t done);
+
+/** Where the server runs calls to a function.
+ */
+enum class execution {
+	// In order with the client's other serial calls, one at a time. The default, a slow handler holds up only its own client.
+	serial,
+	// On any thread of the server's executor, alongside everything else. The reply goes out whenever the call is done.
+	concurrent,
+	// On the executor's pinned thread, in arrival order across all clients, for handlers that need one particular thread.
+	pinned,
+};
 
 class function {
 public:
@@ -34,6 +57,14 @@ public:
 	function(const std::string &name, call_handler_t ptr);
 	function(const std::string &name, void *data);
 	function(const std::string &name);
+	function(const std::string &name, const std::vector<ipc::type> &params, view_call_handler_t ptr, void *data);
+	function(const std::string &name, view_call_handler_t ptr, void *data);
+	function(const std::string &name, view_call_handler_t ptr);
+	function(const std::string &name, const std::vector<ipc::type> &params, async_call_handler_t ptr, void *data);
+	function(const std::string &name, async_call_handler_t ptr, void *data);
+	// Keep a null handler unambiguous now that there are two handler types.
+	function(const std::string &name, const std::vector<ipc::type> &params, std::nullptr_t, void *data);
+	function(const std::string &name, std::nullptr_t, void *data);
 	virtual ~function();
 
 	/** Get the unique name for this function used to identify it.
@@ -47,15 +78,205 @@ public:
 
 	std::string get_name();
 
+	void set_execution(ipc::execution policy);
+	ipc::execution get_execution();
+
 	/** Call this function
 		*
 		*/
 	void call(const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval);
 
+	/** Call this function with borrowed arguments
+		*
+		* Handlers registered with the owning signature get a copy of the arguments.
+		*/
+	void call(const int64_t id, ipc::span<const ipc::value_view> args, std::vector<ipc::value> &rval);
+
+	// Whether the handler finishes calls later through a completion, see async_call_handler_t.
+	bool is_asynchronous();
+
+	/** Call this function and get the result through |done|
+		*
+		* Synchronous handlers run right away and complete before this returns.
+		*/
+	void call_async(const int64_t id, ipc::span<const ipc::value_view> args, ipc::call_completion_t done);
+
 private:
 	std::string m_name, m_nameUnique;
 	std::vector<ipc::type> m_params;
 
 	std::pair<call_handler_t, void *> m_callHandler;
+	view_call_handler_t m_viewHandler = nullptr;
+	async_call_handler_t m_asyncHandler = nullptr;
+	ipc::execution m_execution = ipc::execution::serial;
 };
-}
\ No newline at end of file
+
+/** Conversion between a native type and the wire, one specialization per type a typed function may take or return.
+ *
+ * std::string_view and ipc::span<const char> borrow from the received frame
+ * like ipc::value_view does, std::string and std::vector<char> copy.
+ */
+template<typename T> struct marshal;
+
+// Every union member starts at its beginning, so a scalar is read from there.
+template<typename T, ipc::type Tag> struct marshal_scalar {
+	static constexpr ipc::type type = Tag;
+	static T from(const ipc::value_view &view)
+	{
+		T p_value;
+		memcpy(&p_value, &view.value_union, sizeof(T));
+		return p_value;
+	}
+	static ipc::value to(T p_value) { return ipc::value(p_value); }
+};
+
+template<> struct marshal<float> : marshal_scalar<float, ipc::type::Float> {};
+template<> struct marshal<double> : marshal_scalar<double, ipc::type::Double> {};
+template<> struct marshal<int32_t> : marshal_scalar<int32_t, ipc::type::Int32> {};
+template<> struct marshal<int64_t> : marshal_scalar<int64_t, ipc::type::Int64> {};
+template<> struct marshal<uint32_t> : marshal_scalar<uint32_t, ipc::type::UInt32> {};
+template<> struct marshal<uint64_t> : marshal_scalar<uint64_t, ipc::type::UInt64> {};
+
+template<> struct marshal<std::string_view> {
+	static constexpr ipc::type type = ipc::type::String;
+	static std::string_view from(const ipc::value_view &view) { return view.value_str; }
+	static ipc::value to(std::string_view p_value)
+	{
+		ipc::value value;
+		value.type = ipc::type::String;
+		value.value_str.assign(p_value.data(), p_value.size());
+		return value;
+	}
+};
+
+template<> struct marshal<std::string> {
+	static constexpr ipc::type type = ipc::type::String;
+	static std::string from(const ipc::value_view &view) { return std::string(view.value_str); }
+	static ipc::value to(const std::string &p_value) { return ipc::value(p_value); }
+};
+
+template<> struct marshal<ipc::span<const char>> {
+	static constexpr ipc::type type = ipc::type::Binary;
+	static ipc::span<const char> from(const ipc::value_view &view) { return view.value_bin; }
+	static ipc::value to(ipc::span<const char> p_value)
+	{
+		ipc::value value;
+		value.type = ipc::type::Binary;
+		value.value_str.assign(p_value.data(), p_value.size());
+		return value;
+	}
+};
+
+template<> struct marshal<std::vector<char>> {
+	static constexpr ipc::type type = ipc::type::Binary;
+	static std::vector<char> from(const ipc::value_view &view) { return std::vector<char>(view.value_bin.begin(), view.value_bin.end()); }
+	static ipc::value to(const std::vector<char> &p_value) { return ipc::value(p_value); }
+};
+
+template<typename Signature> struct function_traits;
+
+template<typename R, typename... Args> struct function_traits<R (*)(Args...)> {
+	typedef void owner;
+	typedef R result;
+	typedef std::tuple<std::decay_t<Args>...> arguments;
+};
+
+template<typename R, typename C, typename... Args> struct function_traits<R (C::*)(Args...)> : function_traits<R (*)(Args...)> {
+	typedef C owner;
+};
+
+template<typename R, typename C, typename... Args> struct function_traits<R (C::*)(Args...) const> : function_traits<R (*)(Args...)> {
+	typedef const C owner;
+};
+
+/** Glue behind ipc::make_function, turns a native function into a view_call_handler_t.
+ *
+ * Parameter types are known at compile time, so arguments are checked and
+ * converted straight from the borrowed views and the result is appended to
+ * the reply without building an intermediate argument vector. Results can
+ * be void, any type with a marshal specialization, a std::tuple of those for
+ * several values, or a std::vector<ipc::value> that is passed through.
+ */
+template<auto Fn> class typed_function {
+	typedef function_traits<decltype(Fn)> traits;
+	typedef typename traits::arguments arguments;
+	static constexpr size_t arity = std::tuple_size<arguments>::value;
+
+	template<size_t... I> static constexpr std::array<ipc::type, arity> make_types(std::index_sequence<I...>)
+	{
+		return {{marshal<std::tuple_element_t<I, arguments>>::type...}};
+	}
+
+	template<typename T> static void append(std::vector<ipc::value> &rval, T &&result)
+	{
+		typedef std::decay_t<T> type;
+		if constexpr (std::is_same<type, std::vector<ipc::value>>::value) {
+			for (auto &value : result) {
+				rval.push_back(std::move(value));
+			}
+		} else {
+			rval.push_back(marshal<type>::to(result));
+		}
+	}
+
+	template<typename... T> static void append(std::vector<ipc::value> &rval, std::tuple<T...> &&result)
+	{
+		std::apply([&rval](auto &&... element) { (append(rval, std::move(element)), ...); }, std::move(result));
+	}
+
+	template<size_t... I> static decltype(auto) invoke(void *data, ipc::span<const ipc::value_view> args, std::index_sequence<I...>)
+	{
+		if constexpr (std::is_void<typename traits::owner>::value) {
+			return Fn(marshal<std::tuple_element_t<I, arguments>>::from(args[I])...);
+		} else {
+			return (static_cast<typename traits::owner *>(data)->*Fn)(marshal<std::tuple_element_t<I, arguments>>::from(args[I])...);
+		}
+	}
+
+public:
+	static constexpr std::array<ipc::type, arity> types = make_types(std::make_index_sequence<arity>());
+
+	static void call(void *data, const int64_t, ipc::span<const ipc::value_view> args, std::vector<ipc::value> &rval)
+	{
+		if (args.size() != arity) {
+			throw std::invalid_argument("Expected " + std::to_string(arity) + " arguments, got " + std::to_string(args.size()) + ".");
+		}
+		for (size_t idx = 0; idx < arity; idx++) {
+			if (args[idx].type != types[idx]) {
+				throw std::invalid_argument("Argument " + std::to_string(idx) + " has the wrong type.");
+			}
+		}
+
+		if constexpr (std::is_void<typename traits::result>::value) {
+			invoke(data, args, std::make_index_sequence<arity>());
+		} else {
+			append(rval, invoke(data, args, std::make_index_sequence<arity>()));
+		}
+	}
+};
+
+/** Register a native function with a signature derived at compile time.
+ *
+ * ipc::make_function<&bar>("bar") for free functions and static members,
+ * ipc::make_function<&Foo::bar>("bar", &foo) for members of |instance|. The
+ * unique name goes through ipc::base::make_unique_id, so it matches what the
+ * same function declared by hand would get. A call with the wrong number or
+ * types of arguments fails with an error reply.
+ */
+template<auto Fn> std::shared_ptr<ipc::function> make_function(const std::string &name)
+{
+	static_assert(std::is_void<typename function_traits<decltype(Fn)>::owner>::value, "member functions need an instance");
+	const auto &types = typed_function<Fn>::types;
+	return std::make_shared<ipc::function>(name, std::vector<ipc::type>(types.begin(), types.end()), &typed_function<Fn>::call, nullptr);
+}
+
+template<auto Fn, typename Class> std::shared_ptr<ipc::function> make_function(const std::string &name, Class *instance)
+{
+	typedef typename function_traits<decltype(Fn)>::owner owner;
+	static_assert(!std::is_void<owner>::value, "only member functions take an instance");
+	static_assert(std::is_base_of<std::remove_const_t<owner>, Class>::value, "instance is not of the function's class");
+	const auto &types = typed_function<Fn>::types;
+	return std::make_shared<ipc::function>(name, std::vector<ipc::type>(types.begin(), types.end()), &typed_function<Fn>::call,
+					       const_cast<void *>(static_cast<const void *>(static_cast<owner *>(instance))));
+}
+}
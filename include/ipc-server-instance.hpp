@@ -28,5 +28,8 @@ public:
 	static std::shared_ptr<ipc::server_instance> create(server *owner, std::shared_ptr<ipc::socket> socket, int call_timeout);
 	server_instance(){};
 	virtual ~server_instance(){};
+
+	// Write a v2 frame holding an event, false where the connection can't take it.
+	virtual bool send_event(const ipc::frame_builder &) { return false; }
 };
 }
\ No newline at end of file
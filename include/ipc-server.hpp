@@ -18,17 +18,22 @@
 
 #pragma once
 #include "ipc.hpp"
+#include "ipc-bulk.hpp"
 #include "ipc-class.hpp"
+#include "ipc-executor.hpp"
 #include "ipc-server-instance.hpp"
 #include "ipc-socket.hpp"
+#include "semaphore.hpp"
 
 #include <chrono>
+#include <condition_variable>
 #include <functional>
 #include <list>
 #include <map>
 #include <mutex>
 #include <queue>
 #include <string>
+#include <string_view>
 #include <thread>
 
 namespace ipc {
@@ -39,12 +44,32 @@ typedef void (*server_disconnect_handler_t)(void *, int64_t);
 typedef void (*server_message_handler_t)(void *, int64_t, const std::vector<char> &);
 typedef void (*server_pre_callback_t)(std::string, std::string, const std::vector<ipc::value> &, void *);
 typedef void (*server_post_callback_t)(std::string, std::string, const std::vector<ipc::value> &, void *);
+typedef std::function<void(bool success, std::vector<ipc::value> &rval, const std::string &errormsg,
+			   std::chrono::high_resolution_clock::duration call_duration)>
+	server_call_done_t;
 
 class server {
 	bool m_isInitialized = false;
 
+public:
+	// Entry of the method table, a method's ID is its index plus one.
+	struct method {
+		std::string class_name;
+		std::string function_name;
+		std::shared_ptr<ipc::function> function;
+		size_t hash;
+	};
+
+private:
 	// Functions
-	std::map<std::string, std::shared_ptr<ipc::collection>> m_classes;
+	std::map<std::string, std::shared_ptr<ipc::collection>, std::less<>> m_classes;
+	std::vector<method> m_methods;
+	std::vector<uint32_t> m_method_slots;
+
+	// Calls to functions that aren't serial. Null from the moment finalize() starts draining it.
+	size_t m_executorThreads = 0;
+	std::mutex m_executor_mtx;
+	std::unique_ptr<ipc::executor> m_executor;
 
 	// Socket
 	std::mutex m_sockets_mtx;
@@ -52,9 +77,12 @@ class server {
 	std::list<std::shared_ptr<ipc::socket>> m_sockets;
 #elif __APPLE__
 	std::list<std::shared_ptr<ipc::socket>> m_sockets;
+#elif __linux__
+	std::list<std::shared_ptr<ipc::socket>> m_sockets;
 #endif
 	std::string m_socketPath = "";
 	int m_callTimeout = 0;
+	size_t m_sharedBinaryThreshold = 0;
 
 	// Client management.
 	std::mutex m_clients_mtx;
@@ -62,8 +90,24 @@ class server {
 	std::map<std::shared_ptr<ipc::socket>, std::shared_ptr<server_instance>> m_clients;
 #elif __APPLE__
 	std::map<std::shared_ptr<ipc::socket>, std::shared_ptr<server_instance>> m_clients;
+#elif __linux__
+	std::map<std::shared_ptr<ipc::socket>, std::shared_ptr<server_instance>> m_clients;
 #endif
 
+	// Clients subscribed to events, by class and event name.
+	std::mutex m_events_mtx;
+	std::map<std::string, std::map<std::string, std::vector<std::weak_ptr<server_instance>>, std::less<>>, std::less<>> m_subscribers;
+
+	// Live values by key, see set_live_value().
+	struct live_value;
+	std::mutex m_live_mtx;
+	std::map<std::string, std::shared_ptr<live_value>, std::less<>> m_live_values;
+
+	// Bulk channels by key, see create_bulk_channel().
+	struct bulk_channel;
+	std::mutex m_bulk_mtx;
+	std::map<std::string, std::shared_ptr<bulk_channel>, std::less<>> m_bulk_channels;
+
 	// Event Handlers
 	std::pair<server_connect_handler_t, void *> m_handlerConnect;
 	std::pair<server_disconnect_handler_t, void *> m_handlerDisconnect;
@@ -75,9 +119,31 @@ class server {
 	struct {
 		std::thread worker;
 		bool stop = false;
+		std::condition_variable cv;
+#ifdef __linux__
+		std::mutex dead_mtx;
+		std::vector<std::shared_ptr<ipc::socket>> dead;
+#else
+		// Guards |woken|, so a wakeup can't slip in between the watcher checking it and waiting.
+		std::mutex wake_mtx;
+		bool woken = false;
+		// Waited for next to the pending accepts.
+		std::unique_ptr<os::semaphore> wake;
+#endif
 	} m_watcher;
 
 	void watcher();
+#ifndef __linux__
+	// Make the watcher look at its sockets again. Any thread.
+	void wake_watcher();
+#endif
+	void build_method_table();
+	static size_t method_hash(std::string_view cname, std::string_view fname);
+	ipc::function *find_function(std::string_view cname, std::string_view fname, std::string &errormsg);
+	bool call_function(int64_t cid, std::string_view cname, std::string_view fname, ipc::function &fnc, ipc::span<const ipc::value_view> args,
+			   std::vector<ipc::value> &rval, std::string &errormsg, std::chrono::high_resolution_clock::duration &call_duration);
+	// Hand what client::send_message() sent to the message handler.
+	bool deliver_message(int64_t cid, const char *data, size_t size, std::string &errormsg);
 
 #ifdef WIN32
 	void spawn_client(std::shared_ptr<ipc::socket> socket);
@@ -85,6 +151,9 @@ class server {
 #elif __APPLE__
 	void spawn_client(std::shared_ptr<ipc::socket> socket);
 	void kill_client(std::shared_ptr<ipc::socket> socket);
+#elif __linux__
+	void spawn_client(std::shared_ptr<ipc::socket> socket);
+	void kill_client(std::shared_ptr<ipc::socket> socket);
 #endif
 
 public:
@@ -101,9 +170,18 @@ public: // Status
 	void finalize();
 	void set_call_timeout(int callTimeout);
 
+	// Binary return values of at least |bytes| are passed as shared memory, see ipc::shared_binary.
+	// Zero, the default, copies everything into the frame. Ignored by transports that can't pass descriptors.
+	void set_shared_binary_threshold(size_t bytes);
+	size_t get_shared_binary_threshold();
+
+	// Threads that concurrent functions are run on, takes effect at initialize(). Zero, the default, uses one per core but at least two.
+	void set_executor_threads(size_t threads);
+
 public: // Events
 	void set_connect_handler(server_connect_handler_t handler, void *data);
 	void set_disconnect_handler(server_disconnect_handler_t handler, void *data);
+	// Receives what clients send with client::send_message(), in order with their calls.
 	void set_message_handler(server_message_handler_t handler, void *data);
 	void set_pre_callback(server_pre_callback_t handler, void *data);
 	void set_post_callback(server_post_callback_t handler, void *data);
@@ -111,9 +189,83 @@ public: // Events
 public: // Functionality
 	bool register_collection(std::shared_ptr<ipc::collection> cls);
 
+	// Table handed to clients at connect, fixed by initialize(). Later registrations are only reachable by name.
+	const std::vector<method> &get_methods();
+	// ID of a method in the table, 0 if it isn't in there.
+	uint32_t find_method(std::string_view cname, std::string_view fname);
+
+	// Function a call resolves to, by ID if there is one and by name otherwise. Null with |errormsg| set if there is none.
+	ipc::function *resolve_function(uint32_t method_id, std::string_view cname, std::string_view fname, std::string &errormsg);
+	// Run |task| on the executor according to |policy|, which must not be serial. False and |task| is dropped once the server is shutting down.
+	bool post(ipc::execution policy, std::function<void()> task);
+
+	/** Send event |event| of class |cname| to every client that subscribed to it.
+	 *
+	 * The values are encoded once and inline, shared binaries included. Events
+	 * published from one thread reach a client in order. Never waits for a
+	 * client: one that can't take the event right away gets it queued and sent
+	 * from the executor, and one that falls too far behind is disconnected.
+	 * Returns the number of clients it was sent to.
+	 */
+	size_t publish(const std::string &cname, const std::string &event, std::vector<ipc::value> values);
+
+	/** Keep the latest values stored under |key| in shared memory, see client::open_live_value().
+	 *
+	 * Meant for state that changes faster than clients care to hear about it,
+	 * like meters and statistics: clients read the latest values whenever they
+	 * like without a call, and those that asked to be told about changes get
+	 * one notification at a time however often the values change. |capacity|
+	 * bounds the encoded values, which take a few bytes more than their
+	 * contents. False if the key exists or the platform has no live values.
+	 */
+	bool create_live_value(const std::string &key, size_t capacity);
+	// Replace the values of |key|, false if it doesn't exist or they don't fit. Shared binaries are copied in.
+	bool set_live_value(const std::string &key, std::vector<ipc::value> values);
+	// Clients that opened it keep reading the last values.
+	void remove_live_value(const std::string &key);
+
+	/** Create a channel for large buffers like video frames or audio blocks, see ipc::bulk_writer.
+	 *
+	 * The channel is a pool of |slot_count| page aligned slots of |slot_size|
+	 * bytes in shared memory, read by one client at a time. Buffers are filled
+	 * and read in place, only their slot index and sequence number are sent
+	 * to the client. A client opening the channel takes over whatever the one
+	 * before still held. Null if the key exists or the platform has no bulk
+	 * channels.
+	 */
+	std::shared_ptr<ipc::bulk_writer> create_bulk_channel(const std::string &key, size_t slot_count, size_t slot_size);
+	// The writer stays usable but can't be opened anymore.
+	void remove_bulk_channel(const std::string &key);
+
 public: // Client -> Server
 	bool client_call_function(int64_t cid, const std::string &cname, const std::string &fname, std::vector<ipc::value> &args, std::vector<ipc::value> &rval,
 				  std::string &errormsg, std::chrono::high_resolution_clock::duration &call_duration);
+	bool client_call_function(int64_t cid, std::string_view cname, std::string_view fname, ipc::span<const ipc::value_view> args,
+				  std::vector<ipc::value> &rval, std::string &errormsg, std::chrono::high_resolution_clock::duration &call_duration);
+	bool client_call_function(int64_t cid, uint32_t method_id, ipc::span<const ipc::value_view> args, std::vector<ipc::value> &rval,
+				  std::string &errormsg, std::chrono::high_resolution_clock::duration &call_duration);
+
+	/** Call a function that may finish later, see ipc::async_call_handler_t.
+	 *
+	 * |done| runs exactly once, on whichever thread completes the call, and
+	 * |args| have to stay valid until it did. Calls still running keep the
+	 * server in use, they have to be done before finalize().
+	 */
+	void client_call_function_async(int64_t cid, uint32_t method_id, std::string_view cname, std::string_view fname,
+					ipc::span<const ipc::value_view> args, ipc::server_call_done_t done);
+
+	// Add or drop |instance| from the subscribers of an event, see publish().
+	void client_subscribe(std::shared_ptr<server_instance> instance, std::string_view cname, std::string_view event, bool subscribe);
+
+	// Give |instance| a reader slot of live value |key|, |rval| receives what ipc::live_open answers with. Opening it again returns the same slot.
+	bool client_open_live_value(std::shared_ptr<server_instance> instance, std::string_view key, std::vector<ipc::value> &rval,
+				    std::string &errormsg);
+	// Make |instance| the reader of bulk channel |key|, |rval| receives what ipc::bulk_open answers with.
+	bool client_open_bulk_channel(std::shared_ptr<server_instance> instance, std::string_view key, std::vector<ipc::value> &rval,
+				      std::string &errormsg);
+
+	// Hand a connection that went away to the watcher, which reaps it without having to look at every other client. Any thread.
+	void client_disconnected(std::shared_ptr<ipc::socket> socket);
 
 	friend class server_instance;
 };
@@ -17,14 +17,20 @@
 ******************************************************************************/
 
 #pragma once
+#include <cstring>
 #include <inttypes.h>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
 typedef float float_t;
 typedef double double_t;
 
 namespace ipc {
+class frame_builder;
+
 enum class type : uint32_t {
 	Null,
 	Float,
@@ -37,8 +43,124 @@ enum class type : uint32_t {
 	Binary,
 };
 
+/** Encoding of the message in a frame.
+ *
+ * Stored in the low half of the ipc_size_t prefix, which v1 peers always
+ * leave zero, so every frame says how to decode it. A client only sends v2
+ * once the server acknowledged the handshake call, and servers answer in the
+ * revision of the request.
+ */
+enum class protocol : uint32_t {
+	// Fixed width tags, lengths and integers behind a size_t message length.
+	v1 = 0,
+	// Single byte tags, varint integers and lengths, and a method ID in place of the names.
+	v2 = 2,
+};
+
+/** Read-only Binary contents living in memory that can be handed to another process.
+ *
+ * Transports that can pass descriptors send these out of band instead of
+ * copying them into the frame, the receiver maps the same memory.
+ */
+class shared_binary {
+public:
+	virtual ~shared_binary(){};
+
+	virtual const char *data() const = 0;
+	virtual size_t size() const = 0;
+	virtual int get_handle() const = 0;
+};
+typedef std::vector<std::shared_ptr<ipc::shared_binary>> shared_binary_list;
+
+/** Contents of a String or Binary value.
+ *
+ * Up to inline_capacity bytes live in the object itself, longer contents in
+ * a heap block, and Binary contents that were passed out of band stay in
+ * their shared mapping. Reads like a std::string so code using value_str
+ * keeps compiling. Contents are followed by a terminator unless shared.
+ */
+class value_bytes {
+	// Last byte of m_storage: the length while inline, otherwise one of these.
+	static constexpr uint8_t heap_tag = 0x40;
+	static constexpr uint8_t shared_tag = 0x80;
+
+	// Inline: contents and terminator. Heap and shared: a pointer, then a uint32_t size.
+	alignas(void *) char m_storage[16] = {};
+
+	uint8_t tag() const { return uint8_t(m_storage[sizeof(m_storage) - 1]); }
+	void *pointer() const
+	{
+		void *ptr;
+		memcpy(&ptr, m_storage, sizeof(ptr));
+		return ptr;
+	}
+	void set_external(void *ptr, size_t size, uint8_t tag);
+	void copy_from(const value_bytes &other);
+	void release();
+
+public:
+	static constexpr size_t inline_capacity = sizeof(m_storage) - 2;
+
+	value_bytes() {}
+	value_bytes(const char *data, size_t size);
+	value_bytes(const std::string &p_value) : value_bytes(p_value.data(), p_value.size()) {}
+	value_bytes(const value_bytes &other) { copy_from(other); }
+	value_bytes(value_bytes &&other) noexcept
+	{
+		memcpy(m_storage, other.m_storage, sizeof(m_storage));
+		other.m_storage[0] = other.m_storage[sizeof(m_storage) - 1] = 0;
+	}
+	~value_bytes()
+	{
+		if (tag() > inline_capacity) {
+			release();
+		}
+	}
+
+	value_bytes &operator=(const value_bytes &other);
+	value_bytes &operator=(value_bytes &&other) noexcept;
+	value_bytes &operator=(const std::string &p_value);
+	value_bytes &operator=(const char *p_value);
+
+	void assign(const char *data, size_t size);
+	void assign(std::shared_ptr<ipc::shared_binary> shared);
+	void clear();
+
+	size_t size() const
+	{
+		if (tag() <= inline_capacity) {
+			return tag();
+		}
+		uint32_t size;
+		memcpy(&size, m_storage + sizeof(void *), sizeof(size));
+		return size;
+	}
+	size_t length() const { return size(); }
+	bool empty() const { return size() == 0; }
+	const char *data() const
+	{
+		if (tag() <= inline_capacity) {
+			return m_storage;
+		} else if (tag() == heap_tag) {
+			return static_cast<const char *>(pointer());
+		}
+		return (*static_cast<std::shared_ptr<ipc::shared_binary> *>(pointer()))->data();
+	}
+	const char *c_str() const { return data(); }
+	const char *begin() const { return data(); }
+	const char *end() const { return data() + size(); }
+
+	// Set when the contents are a Binary that was passed out of band.
+	std::shared_ptr<ipc::shared_binary> get_shared() const;
+
+	operator std::string() const { return std::string(data(), size()); }
+	operator std::string_view() const { return std::string_view(data(), size()); }
+	bool operator==(std::string_view other) const { return std::string_view(*this) == other; }
+	bool operator!=(std::string_view other) const { return std::string_view(*this) != other; }
+};
+
 struct value {
-	type type;
+	ipc::type type;
 	union {
 		float fp32;
 		double fp64;
@@ -47,8 +169,8 @@ struct value {
 		uint32_t ui32;
 		uint64_t ui64;
 	} value_union;
-	std::string value_str;
-	std::vector<char> value_bin;
+	// String contents. Binary contents share the storage and are read through binary_data().
+	ipc::value_bytes value_str;
 
 	value();
 	value(float);
@@ -59,9 +181,73 @@ struct value {
 	value(uint64_t);
 	value(const std::string &p_value);
 	value(const std::vector<char> &p_value);
+	value(std::shared_ptr<ipc::shared_binary> p_value);
 
+	// Binary contents, whether they arrived inline or out of band. These replace
+	// the former std::vector<char> value_bin and value_shared members, so code
+	// that read those has to move to binary_data()/binary_size() and
+	// get_shared_binary(), and build values through the constructors.
+	const char *binary_data() const;
+	size_t binary_size() const;
+	// Set for Binary values that are passed out of band.
+	std::shared_ptr<ipc::shared_binary> get_shared_binary() const;
+
+	// Values with a shared binary are only referenced by index into |attachments|.
 	size_t size();
-	size_t serialize(std::vector<char> &buf, size_t offset);
-	size_t deserialize(const std::vector<char> &buf, size_t offset);
+	size_t serialize(std::vector<char> &buf, size_t offset, ipc::shared_binary_list *attachments = nullptr);
+	void serialize(ipc::frame_builder &builder, ipc::shared_binary_list *attachments = nullptr, ipc::protocol version = ipc::protocol::v1);
+	size_t deserialize(const std::vector<char> &buf, size_t offset, const ipc::shared_binary_list *attachments = nullptr,
+			   ipc::protocol version = ipc::protocol::v1);
+
+private:
+	// Write exactly size() bytes to |buf|.
+	size_t write(char *buf, ipc::shared_binary_list *attachments);
+	void write_v2(ipc::frame_builder &builder, ipc::shared_binary_list *attachments);
+};
+
+// Non-owning view of contiguous elements, a stand-in for C++20's std::span.
+template<typename T> class span {
+	T *m_data = nullptr;
+	size_t m_size = 0;
+
+public:
+	span() {}
+	span(T *data, size_t size) : m_data(data), m_size(size) {}
+	span(std::vector<typename std::remove_const<T>::type> &data) : m_data(data.data()), m_size(data.size()) {}
+	span(const std::vector<typename std::remove_const<T>::type> &data) : m_data(data.data()), m_size(data.size()) {}
+
+	T *data() const { return m_data; }
+	size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+	T *begin() const { return m_data; }
+	T *end() const { return m_data + m_size; }
+	T &operator[](size_t idx) const { return m_data[idx]; }
+};
+
+/** Borrowed counterpart of ipc::value.
+ *
+ * Strings and binaries point into the buffer the view was decoded from, or
+ * into the ipc::value it was made from, and are only valid as long as that
+ * is. Nothing is allocated to decode one.
+ */
+struct value_view {
+	ipc::type type = ipc::type::Null;
+	decltype(ipc::value::value_union) value_union = {};
+	std::string_view value_str;
+	ipc::span<const char> value_bin;
+	// Set for Binary values that were passed out of band, value_bin then points into its mapping.
+	std::shared_ptr<ipc::shared_binary> value_shared;
+
+	value_view() {}
+	value_view(const ipc::value &p_value);
+
+	// Owning copy, for code that has to keep the value beyond the call.
+	ipc::value to_value() const;
+
+	size_t deserialize(const char *buf, size_t length, size_t offset, const ipc::shared_binary_list *attachments = nullptr,
+			   ipc::protocol version = ipc::protocol::v1);
+
+private:
+	size_t deserialize_v2(const char *buf, size_t length, size_t offset, const ipc::shared_binary_list *attachments);
 };
 }
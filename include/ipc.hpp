@@ -18,7 +18,9 @@
 
 #pragma once
 #include "ipc-value.hpp"
+#include <cstring>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 #include <functional>
@@ -61,6 +63,46 @@ public:
 	static std::string getDescription(DWORD key);
 };
 
+// The handshake is an ordinary v1 call with the highest revision the client speaks as UInt32
+// argument. Servers without v2 answer it with an unknown class error.
+static const char protocol_handshake_class[] = "ipc:protocol";
+static const char protocol_handshake_function[] = "hello";
+
+// Messages for server::set_message_handler() travel as a one-way call with the bytes as single Binary argument.
+static const char message_class[] = "ipc:message";
+static const char message_function[] = "post";
+
+// Clients (un)subscribe to events with a call taking the class and the event name as Strings.
+static const char event_class[] = "ipc:events";
+static const char event_subscribe[] = "subscribe";
+static const char event_unsubscribe[] = "unsubscribe";
+
+// Clients open a live value with a call taking its key as String, answered with the name of its shared memory
+// and the client's reader slot. Changes are announced as events of this class named like the key.
+static const char live_class[] = "ipc:live";
+static const char live_open[] = "open";
+
+// Clients open a bulk channel with a call taking its key as String, answered with the name of its shared memory. Published
+// buffers are announced as events of this class named like the key, carrying the slot as UInt32 and the sequence as UInt64.
+static const char bulk_class[] = "ipc:bulk";
+static const char bulk_open[] = "open";
+
+// Classes named like this are handled by the library itself and never registered.
+inline bool is_reserved_class(std::string_view name)
+{
+	return name.substr(0, 4) == "ipc:";
+}
+
+inline ipc::protocol read_protocol(const char *frame)
+{
+	ipc_size_real_t version;
+	memcpy(&version, frame, sizeof(version));
+	return ipc::protocol(version);
+}
+
+// Read a LEB128 varint at |offset|, returning the number of bytes used. Throws on truncated or overlong input.
+size_t read_varint(const char *buf, size_t length, size_t offset, uint64_t &value);
+
 inline void make_sendable(std::vector<char> &in)
 {
 	reinterpret_cast<ipc_size_real_t &>(in[sizeof(ipc_size_real_t)]) = ipc_size_real_t(in.size() - sizeof(ipc_size_t));
@@ -71,6 +113,131 @@ inline ipc_size_t read_size(std::vector<char> const &in)
 	return reinterpret_cast<const ipc_size_real_t &>(in[sizeof(ipc_size_real_t)]);
 }
 
+// A piece of a frame that is written out without being copied together first.
+struct frame_segment {
+	const char *data;
+	size_t length;
+};
+
+/** Growable frame buffer that messages are serialized into in a single pass.
+ *
+ * Lengths are reserved when a frame or message starts and patched once its
+ * contents are written, so nothing has to be measured up front. The buffer
+ * only grows and is meant to be reused for every frame a connection sends.
+ *
+ * Large binary values can be left in their own storage instead, see
+ * set_reference_threshold(). Such a frame is written with gather().
+ */
+class frame_builder {
+	struct reference {
+		size_t offset;
+		const char *data;
+		size_t length;
+	};
+
+	std::vector<char> m_buffer;
+	size_t m_length = 0;
+	std::vector<reference> m_references;
+	size_t m_referenced = 0;
+	size_t m_reference_threshold = 0;
+
+	void grow(size_t required);
+
+public:
+	frame_builder();
+
+	// Start a new frame behind its ipc_size_t prefix, keeping the allocation.
+	void reset();
+
+	// Append |length| bytes and return where they start. Valid until the next append.
+	inline char *append(size_t length)
+	{
+		if (m_length + length > m_buffer.size()) {
+			grow(m_length + length);
+		}
+		char *out = m_buffer.data() + m_length;
+		m_length += length;
+		return out;
+	}
+
+	template<typename T> inline void append_value(T value) { memcpy(append(sizeof(T)), &value, sizeof(T)); }
+	template<typename T> inline void patch_value(size_t offset, T value) { memcpy(m_buffer.data() + offset, &value, sizeof(T)); }
+
+	inline void append_varint(uint64_t value)
+	{
+		size_t length = 1;
+		for (uint64_t rest = value >> 7; rest != 0; rest >>= 7) {
+			length++;
+		}
+		char *out = append(length);
+		for (; value >= 0x80; value >>= 7) {
+			*out++ = char(uint8_t(value) | 0x80);
+		}
+		*out = char(value);
+	}
+
+	/** Append |length| bytes of a binary value.
+	 *
+	 * From the reference threshold on they are not copied, only their place in
+	 * the frame is recorded, and they have to stay where they are until the
+	 * frame has been written.
+	 */
+	void append_binary(const char *data, size_t length);
+
+	// Reference binary values of at least |bytes|, 0 copies everything. Kept across reset().
+	void set_reference_threshold(size_t bytes);
+
+	// Fill in the ipc_size_t prefix, the counterpart of make_sendable().
+	void finish(ipc::protocol version = ipc::protocol::v1);
+
+	// The bytes in the buffer, which are the whole frame unless something is referenced.
+	const char *data() const;
+	size_t size() const;
+
+	// The whole frame in order, buffered and referenced pieces, replacing what |segments| held.
+	void gather(std::vector<ipc::frame_segment> &segments) const;
+	size_t frame_size() const;
+};
+
+/** Receive buffer a connection reads ahead into and takes whole frames out of.
+ *
+ * The transport asks for room behind the buffered bytes with prepare(), fills
+ * in whatever is available and commit()s it, then next() yields every complete
+ * frame in place. Once the prefix of a frame is in, the buffer makes room for
+ * all of it, so the rest of a large frame is received straight to where it
+ * belongs and never moves again.
+ */
+class frame_reader {
+	std::vector<char> m_buffer;
+	size_t m_begin = 0, m_end = 0;
+	size_t m_last = 0;
+	uint64_t m_position = 0;
+
+public:
+	// Size of the frame at the front including its prefix, 0 until the prefix is in.
+	size_t expected() const;
+	size_t buffered() const;
+
+	// Room for at least |length| more bytes behind the buffered ones, valid until the next prepare() or detach().
+	char *prepare(size_t length);
+	void commit(size_t length);
+
+	// Take the complete frame at the front. |frame| stays valid until the next prepare() or detach().
+	bool next(const char *&frame, size_t &length);
+
+	// Stream offset of the frame next() will return, which counts every byte ever committed.
+	uint64_t position() const;
+	uint64_t received() const;
+
+	/** Hand the storage of the frame just taken to |buffer|, at offset 0.
+	 *
+	 * Only possible while it was the sole frame in the buffer, so the caller
+	 * can keep a large frame without a copy. The reader goes on with the
+	 * storage |buffer| had.
+	 */
+	bool detach(std::vector<char> &buffer);
+};
+
 void log(const char *fmt, ...);
 void register_log_callback(ipc::log_callback_t callback, void *data);
 
@@ -83,25 +250,57 @@ public:
 
 namespace message {
 struct function_call {
-	ipc::value uid = ipc::value(0ull);
+	ipc::value uid = ipc::value(uint64_t(0));
 	ipc::value class_name = ipc::value("");
 	ipc::value function_name = ipc::value("");
+	// v2 only: when not zero it identifies the function and the names are left out.
+	uint32_t method_id = 0;
+	// v2 only: the server sends no reply.
+	bool one_way = false;
 	std::vector<ipc::value> arguments;
 
 	size_t size();
-	size_t serialize(std::vector<char> &buf, size_t offset);
-	size_t deserialize(std::vector<char> &buf, size_t offset);
+	size_t serialize(std::vector<char> &buf, size_t offset, ipc::shared_binary_list *attachments = nullptr);
+	void serialize(ipc::frame_builder &builder, ipc::shared_binary_list *attachments = nullptr, ipc::protocol version = ipc::protocol::v1);
+	size_t deserialize(std::vector<char> &buf, size_t offset, const ipc::shared_binary_list *attachments = nullptr);
+};
+
+// Borrowed counterpart of function_call, see ipc::value_view. Reusing one keeps the argument storage.
+struct function_call_view {
+	ipc::value_view uid;
+	ipc::value_view class_name;
+	ipc::value_view function_name;
+	uint32_t method_id = 0;
+	bool one_way = false;
+	std::vector<ipc::value_view> arguments;
+
+	size_t deserialize(const char *buf, size_t length, const ipc::shared_binary_list *attachments = nullptr, ipc::protocol version = ipc::protocol::v1);
 };
 
 struct function_reply {
-	ipc::value uid = ipc::value(0ull);
+	ipc::value uid = ipc::value(uint64_t(0));
 	ipc::value obs_call_duration_ms = ipc::value(std::uint32_t(0u));
 	std::vector<ipc::value> values;
 	ipc::value error = ipc::value("");
 
 	size_t size();
-	size_t serialize(std::vector<char> &buf, size_t offset);
-	size_t deserialize(std::vector<char> &buf, size_t offset);
+	size_t serialize(std::vector<char> &buf, size_t offset, ipc::shared_binary_list *attachments = nullptr);
+	void serialize(ipc::frame_builder &builder, ipc::shared_binary_list *attachments = nullptr, ipc::protocol version = ipc::protocol::v1);
+	size_t deserialize(std::vector<char> &buf, size_t offset, const ipc::shared_binary_list *attachments = nullptr,
+			   ipc::protocol version = ipc::protocol::v1);
+};
+
+// Published by the server to the clients that subscribed to it. v2 only, it shares the frames replies travel in.
+struct event {
+	ipc::value class_name = ipc::value("");
+	ipc::value event_name = ipc::value("");
+	std::vector<ipc::value> values;
+
+	void serialize(ipc::frame_builder &builder, ipc::shared_binary_list *attachments = nullptr);
+	size_t deserialize(std::vector<char> &buf, size_t offset, const ipc::shared_binary_list *attachments = nullptr);
+
+	// Whether the message at |offset| of a v2 frame is an event rather than a function_reply.
+	static bool is_event(const char *buf, size_t length, size_t offset);
 };
 }
 }
\ No newline at end of file
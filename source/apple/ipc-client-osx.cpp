@@ -1,13 +1,13 @@
 #include "ipc-client-osx.hpp"
+#include "../include/ipc-completion.hpp"
 
 call_return_t g_fn = NULL;
 void *g_data = NULL;
 int64_t g_cbid = NULL;
 
-std::shared_ptr<ipc::client> ipc::client::create(const std::string &socketPath, call_on_disconnect_t)
+std::shared_ptr<ipc::client> ipc::client::create(const std::string &socketPath, call_on_disconnect_t disconnectionCallback)
 {
-	// There is not a worker thread on macOS, so we do not care about the disconnection callback.
-	return std::make_unique<ipc::client_osx>(socketPath);
+	return std::make_unique<ipc::client_osx>(socketPath, disconnectionCallback);
 }
 
 std::shared_ptr<ipc::client> ipc::client::create(std::string socketPath)
@@ -15,7 +15,13 @@ std::shared_ptr<ipc::client> ipc::client::create(std::string socketPath)
 	return std::make_unique<ipc::client_osx>(socketPath);
 }
 
-ipc::client_osx::client_osx(std::string socketPath)
+std::shared_ptr<ipc::client> ipc::client::create(const std::string &socketPath, call_on_disconnect_t disconnectionCallback, transport)
+{
+	// Only the named pipe transport exists on macOS.
+	return std::make_unique<ipc::client_osx>(socketPath, disconnectionCallback);
+}
+
+ipc::client_osx::client_osx(std::string socketPath, call_on_disconnect_t disconnectionCallback) : m_disconnectionCallback(disconnectionCallback)
 {
 	m_socket = os::apple::socket_osx::create(os::open_only, socketPath);
 
@@ -44,8 +50,6 @@ void ipc::client_osx::stop()
 
 bool ipc::client_osx::call(const std::string &cname, const std::string &fname, std::vector<ipc::value> args, call_return_t fn, void *data, int64_t &cbid)
 {
-	static std::mutex mtx;
-	static uint64_t timestamp = 0;
 	os::error ec = os::error::Error;
 
 	std::shared_ptr<os::async_op> write_op;
@@ -55,10 +59,11 @@ bool ipc::client_osx::call(const std::string &cname, const std::string &fname, s
 	if (!m_socket)
 		return false;
 
-	{
-		std::unique_lock<std::mutex> ulock(mtx);
-		timestamp++;
-		fnc_call_msg.uid = ipc::value(timestamp);
+	// Replies are matched back to their callback by uid, the callback is dropped again if the call doesn't go out.
+	fnc_call_msg.uid = ipc::value(m_calls.insert(fn, data));
+	// The shared default would be written by every thread calling at the same time, only a caller's own is set.
+	if (fn != nullptr && &cbid != &g_cbid) {
+		cbid = int64_t(fnc_call_msg.uid.value_union.ui64);
 	}
 
 	// Set
@@ -72,15 +77,10 @@ bool ipc::client_osx::call(const std::string &cname, const std::string &fname, s
 		fnc_call_msg.serialize(buf, sizeof(ipc_size_t));
 	} catch (std::exception &e) {
 		ipc::log("(write) %8llu: Failed to serialize, error %s.", fnc_call_msg.uid.value_union.ui64, e.what());
+		m_calls.cancel(fnc_call_msg.uid.value_union.ui64);
 		throw e;
 	}
 
-	if (fn != nullptr) {
-		std::unique_lock<std::mutex> ulock(m_lock);
-		m_cb.insert(std::make_pair(fnc_call_msg.uid.value_union.ui64, std::make_pair(fn, data)));
-		cbid = fnc_call_msg.uid.value_union.ui64;
-	}
-
 	ipc::make_sendable(buf);
 
 	sem_wait(m_writer_sem);
@@ -90,20 +90,39 @@ bool ipc::client_osx::call(const std::string &cname, const std::string &fname, s
 			std::this_thread::sleep_for(std::chrono::milliseconds(2));
 	}
 
+	if (ec == os::error::Disconnected) {
+		handle_disconnect(fnc_call_msg.uid.value_union.ui64);
+		return false;
+	}
+
 	// Reply from "Shutdown" is unreliable
 	if (m_shutting_down)
 		return true;
 
 	buffer.resize(sizeof(ipc_size_t));
 	ec = (os::error)m_socket->read(buffer.data(), buffer.size(), true, REPLY);
+	if (ec == os::error::Disconnected) {
+		handle_disconnect(fnc_call_msg.uid.value_union.ui64);
+		return false;
+	}
 	read_callback_init(ec, buffer.size());
 	return true;
 }
 
+void ipc::client_osx::handle_disconnect(uint64_t uid)
+{
+	// There is no worker thread on macOS, the call that finds the server gone reports it.
+	m_calls.cancel(uid);
+	sem_post(m_writer_sem);
+	if (m_disconnectionCallback && !m_disconnected.exchange(true)) {
+		m_disconnectionCallback();
+	}
+}
+
 std::vector<ipc::value> ipc::client_osx::call_synchronous_helper(const std::string &cname, const std::string &fname, const std::vector<ipc::value> &args)
 {
 	struct CallData {
-		sem_t *sem;
+		ipc::completion::lease done;
 		bool called = false;
 		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
 
@@ -117,28 +136,17 @@ std::vector<ipc::value> ipc::client_osx::call_synchronous_helper(const std::stri
 		std::copy(rval.begin(), rval.end(), std::back_inserter(cd.values));
 		cd.obs_call_duration = obs_call_duration;
 		cd.called = true;
-		sem_post(cd.sem);
+		cd.done->signal();
 	};
 
-	const auto uniqueId = cname.size() + fname.size() + rand();
-	std::string sem_name = "sem-cb" + std::to_string(uniqueId);
-	std::string path = "/tmp/" + sem_name;
-	sem_unlink(path.c_str());
-	remove(path.c_str());
-	cd.sem = sem_open(path.c_str(), O_CREAT | O_EXCL, 0644, 0);
-	if (cd.sem == SEM_FAILED) {
-		return {};
-	}
-
+	// A pooled slot instead of a named semaphore per call, which took several syscalls
+	// and a file system object, under a rand() name that could collide.
 	int64_t cbid = 0;
 	bool success = call(cname, fname, std::move(args), cb, &cd, cbid);
 	if (!success) {
 		return {};
 	}
-	sem_wait(cd.sem);
-	sem_close(cd.sem);
-	sem_unlink(path.c_str());
-	remove(path.c_str());
+	cd.done->wait();
 
 	if (!cd.called) {
 		cancel(cbid);
@@ -156,7 +164,7 @@ void ipc::client_osx::read_callback_init(os::error ec, size_t size)
 		ipc_size_t n_size = read_size(buffer);
 		if (n_size != 0) {
 			buffer.resize(n_size);
-			ec2 = (os::error)m_socket->read(buffer.data(), buffer.size(), false, REPLY);
+			ec2 = (os::error)m_socket->read(buffer.data(), buffer.size(), true, REPLY);
 			read_callback_msg(ec, buffer.size());
 		}
 	}
@@ -174,14 +182,11 @@ void ipc::client_osx::read_callback_msg(os::error ec, size_t size)
 		throw e;
 	}
 
-	// Find the callback function.
-	std::unique_lock<std::mutex> ulock(m_lock);
-	auto cb2 = m_cb.find(fnc_reply_msg.uid.value_union.ui64);
-	if (cb2 == m_cb.end()) {
+	// Find the callback function. Nothing is locked while it runs, so it may take its time or make another call.
+	if (!m_calls.take(fnc_reply_msg.uid.value_union.ui64, cb)) {
 		sem_post(m_writer_sem);
 		return;
 	}
-	cb = cb2->second;
 	// Decode return values or errors.
 	if (fnc_reply_msg.error.value_str.size() > 0) {
 		fnc_reply_msg.values.resize(1);
@@ -191,15 +196,16 @@ void ipc::client_osx::read_callback_msg(os::error ec, size_t size)
 
 	// Call Callback
 	cb.first(cb.second, fnc_reply_msg.values, std::chrono::milliseconds(fnc_reply_msg.obs_call_duration_ms.value_union.ui32));
-
-	// Remove cb entry
-	m_cb.erase(fnc_reply_msg.uid.value_union.ui64);
 }
 
 bool ipc::client_osx::cancel(int64_t const &id)
 {
-	std::unique_lock<std::mutex> ulock(m_lock);
-	return m_cb.erase(id) != 0;
+	return m_calls.cancel(uint64_t(id));
 }
 
-void ipc::client::set_freeze_callback(call_on_freeze_t cb, std::string app_state) {}
\ No newline at end of file
+void ipc::client::set_freeze_callback(call_on_freeze_t cb, std::string app_state) {}
+
+void ipc::client::set_shared_binary_threshold(size_t bytes)
+{
+	m_shared_binary_threshold = bytes;
+}
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "../include/ipc-client.hpp"
+#include "../include/ipc-call-table.hpp"
 #include "../include/error.hpp"
 #include "ipc-socket-osx.hpp"
 #include "async_request.hpp"
@@ -13,7 +14,7 @@
 namespace ipc {
 class client_osx : public ipc::client {
 public:
-	client_osx(std::string socketPath);
+	client_osx(std::string socketPath, call_on_disconnect_t disconnectionCallback = nullptr);
 	~client_osx();
 
 public:
@@ -27,16 +28,18 @@ public:
 
 private:
 	std::atomic_bool m_stop = true;
+	call_on_disconnect_t m_disconnectionCallback;
+	std::atomic_bool m_disconnected = false;
 	std::unique_ptr<os::apple::socket_osx> m_socket;
 	std::string writer_sem_name = "semaphore-client-writer";
 	sem_t *m_writer_sem;
-	std::mutex m_lock;
-	std::map<int64_t, std::pair<call_return_t, void *>> m_cb;
+	ipc::call_table m_calls;
 
 	std::vector<char> buffer;
 
 	void read_callback_init(os::error ec, size_t size);
 	void read_callback_msg(os::error ec, size_t size);
 	bool cancel(int64_t const &id);
+	void handle_disconnect(uint64_t uid);
 };
 }
\ No newline at end of file
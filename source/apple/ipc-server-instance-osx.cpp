@@ -66,6 +66,11 @@ void ipc::server_instance_osx::worker_req()
 		os::error ec = (os::error)m_socket->read(m_rbuf.data(), m_rbuf.size(), true, REQUEST);
 		read_callback_init(ec, m_rbuf.size());
 	}
+
+	// Unless the server is the one tearing this down, have it reaped now.
+	if (!m_stopWorkers) {
+		m_parent->client_disconnected(m_socket);
+	}
 }
 
 void ipc::server_instance_osx::worker_rep()
@@ -122,7 +127,7 @@ void ipc::server_instance_osx::read_callback_init(os::error ec, size_t size)
 		ipc_size_t n_size = read_size(m_rbuf);
 		if (n_size > 1) {
 			m_rbuf.resize(n_size);
-			ec2 = (os::error)m_socket->read(m_rbuf.data(), m_rbuf.size(), false, REQUEST);
+			ec2 = (os::error)m_socket->read(m_rbuf.data(), m_rbuf.size(), true, REQUEST);
 			read_callback_msg(ec, m_rbuf.size());
 		} else {
 			sem_post(m_writer_sem);
@@ -1,6 +1,8 @@
 #include "ipc-socket-osx.hpp"
 
 #include <errno.h>
+#include <stdexcept>
+#include <string.h>
 
 std::unique_ptr<os::apple::socket_osx> os::apple::socket_osx::create(os::create_only_t, const std::string &name)
 {
@@ -17,17 +19,13 @@ os::apple::socket_osx::socket_osx(os::create_only_t, const std::string name)
 	this->name_req = name + "-req";
 	this->name_rep = name + "-rep";
 
-	remove(name_req.c_str());
-	if (mkfifo(name_req.c_str(), S_IRUSR | S_IWUSR) < 0)
-		throw std::exception((const std::exception &)"Could not create request pipe");
+	if (os::posix::fifo::make(name_req) < 0)
+		throw std::runtime_error(std::string("Could not create request pipe, error ") + strerror(errno) + ".");
 
-	remove(name_rep.c_str());
-	if (mkfifo(name_rep.c_str(), S_IRUSR | S_IWUSR) < 0)
-		throw std::exception((const std::exception &)"Could not create reply pipe");
+	if (os::posix::fifo::make(name_rep) < 0)
+		throw std::runtime_error(std::string("Could not create reply pipe, error ") + strerror(errno) + ".");
 
-	fd_write = -1;
-	fd_read_b = -1;
-	fd_read_nb = -1;
+	open_fifos();
 	created = true;
 }
 
@@ -36,24 +34,29 @@ os::apple::socket_osx::socket_osx(os::open_only_t, const std::string name)
 	this->name_req = name + "-req";
 	this->name_rep = name + "-rep";
 
-	fd_write = -1;
-	fd_read_b = -1;
-	fd_read_nb = -1;
+	open_fifos();
 	connected = true;
 }
 
 os::apple::socket_osx::~socket_osx() {}
 
-void os::apple::socket_osx::clean_file_descriptors()
+void os::apple::socket_osx::open_fifos()
 {
-	if (fd_write > 0)
-		close(fd_write);
+	// Opened once here instead of around every read and write.
+	fifo_req = std::make_unique<os::posix::fifo>(name_req);
+	fifo_rep = std::make_unique<os::posix::fifo>(name_rep);
+}
 
-	if (fd_read_b > 0)
-		close(fd_read_b);
+os::posix::fifo *os::apple::socket_osx::get_fifo(SocketType t)
+{
+	return t == REQUEST ? fifo_req.get() : fifo_rep.get();
+}
 
-	if (fd_read_nb > 0)
-		close(fd_read_nb);
+void os::apple::socket_osx::clean_file_descriptors()
+{
+	// Wakes up anyone still blocked on either direction.
+	fifo_req->close();
+	fifo_rep->close();
 
 	remove(name_req.c_str());
 	remove(name_rep.c_str());
@@ -61,100 +64,12 @@ void os::apple::socket_osx::clean_file_descriptors()
 
 uint32_t os::apple::socket_osx::read(char *buffer, size_t buffer_length, bool is_blocking, SocketType t)
 {
-	os::error err = os::error::Error;
-	int ret = 0;
-	int sizeChunks = 8 * 1024; // 8KB
-	int offset = 0;
-	int file_descriptor = -1;
-	std::string typePipe = t == REQUEST ? "server" : "client";
-
-	if (is_blocking) {
-		fd_read_b = open(t == REQUEST ? name_req.c_str() : name_rep.c_str(), O_RDWR);
-		if (fd_read_b < 0) {
-			goto end;
-		}
-	} else {
-		fd_read_nb = open(t == REQUEST ? name_req.c_str() : name_rep.c_str(), O_RDWR | O_NONBLOCK);
-		if (fd_read_nb < 0) {
-			goto end;
-		}
-	}
-
-	file_descriptor = is_blocking ? fd_read_b : fd_read_nb;
-
-	while (ret <= 0) {
-		ret = ::read(file_descriptor, buffer, buffer_length);
-		if (ret > 0)
-			offset += ret;
-
-		while (ret != 0 && (ret == (sizeChunks - 8) || ret == sizeChunks || ret < 0)) {
-			std::vector<char> new_chunks;
-			new_chunks.resize(sizeChunks);
-			ret = ::read(file_descriptor, new_chunks.data(), new_chunks.size());
-
-			if (ret > 0) {
-				::memcpy(buffer + offset, new_chunks.data(), ret);
-				offset += ret;
-			}
-		}
-	}
-	if (ret < 0) {
-		goto end;
-	}
-	err = os::error::Success;
-
-	if (!is_blocking) {
-		if (fd_read_b > 0)
-			close(fd_read_b);
-		if (fd_read_nb > 0)
-			close(fd_read_nb);
-	}
-
-end:
-	return (uint32_t)err;
+	return (uint32_t)get_fifo(t)->read(buffer, buffer_length, is_blocking);
 }
 
 uint32_t os::apple::socket_osx::write(const char *buffer, size_t buffer_length, SocketType t)
 {
-	os::error err = os::error::Error;
-	int ret = 0;
-	int sizeChunks = 8 * 1024; // 8KB
-	std::string typePipe = t == REQUEST ? "client" : "server";
-
-	if (fd_write > 0)
-		close(fd_write);
-
-	fd_write = open(t == REQUEST ? name_req.c_str() : name_rep.c_str(), O_WRONLY | O_DSYNC);
-	if (fd_write < 0) {
-		goto end;
-	}
-
-	if (buffer_length <= sizeChunks) {
-		ret = ::write(fd_write, buffer, buffer_length);
-	} else {
-		int size_wrote = 0;
-		while (size_wrote < buffer_length) {
-			if (fd_write < 0)
-				fd_write = open(t == REQUEST ? name_req.c_str() : name_rep.c_str(), O_WRONLY | O_DSYNC);
-
-			bool end = (buffer_length - size_wrote) <= sizeChunks;
-			int size_to_write = end ? buffer_length - size_wrote : sizeChunks;
-			ret = ::write(fd_write, buffer + size_wrote, size_to_write);
-			if (ret < 0)
-				break;
-			size_wrote += size_to_write;
-			close(fd_write);
-			fd_write = -1;
-		}
-	}
-
-	if (ret < 0) {
-		goto end;
-	}
-	err = os::error::Success;
-
-end:
-	return (uint32_t)err;
+	return (uint32_t)get_fifo(t)->write(buffer, buffer_length);
 }
 
 bool os::apple::socket_osx::is_created()
@@ -2,6 +2,7 @@
 #define IPC_SOCKET_IPC_H
 
 #include "../include/ipc-socket.hpp"
+#include "../posix/fifo.hpp"
 #include "async_request.hpp"
 
 #include <sys/types.h>
@@ -38,11 +39,12 @@ private:
 	bool connected = true;
 	std::string name_req = "";
 	std::string name_rep = "";
-	int file_req;
-	int file_rep;
-	int fd_write;
-	int fd_read_b;
-	int fd_read_nb;
+	// Both directions stay open for as long as the connection exists.
+	std::unique_ptr<os::posix::fifo> fifo_req;
+	std::unique_ptr<os::posix::fifo> fifo_rep;
+
+	void open_fifos();
+	os::posix::fifo *get_fifo(SocketType t);
 };
 }
 }
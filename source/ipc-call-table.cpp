@@ -0,0 +1,104 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+
+#include "ipc-call-table.hpp"
+
+ipc::call_table::call_table() {}
+
+uint64_t ipc::call_table::insert(call_return_t fn, void *data)
+{
+	if (!fn) {
+		return m_next_uid++;
+	}
+
+	for (size_t probe = 0; probe < probe_limit; probe++) {
+		uint64_t uid = m_next_uid++;
+		slot &entry = m_slots[uid % capacity];
+		uint64_t expected = free_key;
+		if (!entry.key.compare_exchange_strong(expected, claimed_key, std::memory_order_acquire)) {
+			// Still held by a call that is older by a multiple of the capacity, skip its uid.
+			continue;
+		}
+		entry.fn.store(fn, std::memory_order_relaxed);
+		entry.data.store(data, std::memory_order_relaxed);
+		entry.key.store(uid, std::memory_order_release);
+		return uid;
+	}
+
+	std::unique_lock<std::mutex> ul(m_overflow_mtx);
+	uint64_t uid = m_next_uid++;
+	m_overflow.emplace(uid, entry(fn, data));
+	m_overflow_size++;
+	return uid;
+}
+
+bool ipc::call_table::take(uint64_t uid, entry &callback)
+{
+	slot &entry = m_slots[uid % capacity];
+	if (entry.key.load(std::memory_order_acquire) == uid) {
+		// The slot can only be refilled after it was freed, so what is read here belongs to |uid| if freeing it works.
+		call_return_t fn = entry.fn.load(std::memory_order_relaxed);
+		void *data = entry.data.load(std::memory_order_relaxed);
+		uint64_t expected = uid;
+		if (entry.key.compare_exchange_strong(expected, free_key, std::memory_order_acq_rel)) {
+			callback = std::make_pair(fn, data);
+			return true;
+		}
+		return false;
+	}
+
+	if (m_overflow_size.load() == 0) {
+		return false;
+	}
+	std::unique_lock<std::mutex> ul(m_overflow_mtx);
+	auto found = m_overflow.find(uid);
+	if (found == m_overflow.end()) {
+		return false;
+	}
+	callback = found->second;
+	m_overflow.erase(found);
+	m_overflow_size--;
+	return true;
+}
+
+bool ipc::call_table::cancel(uint64_t uid)
+{
+	entry callback;
+	return take(uid, callback);
+}
+
+std::vector<ipc::call_table::entry> ipc::call_table::drain()
+{
+	std::vector<entry> callbacks;
+	for (slot &entry : m_slots) {
+		uint64_t uid = entry.key.load(std::memory_order_acquire);
+		ipc::call_table::entry callback;
+		if (uid != free_key && uid != claimed_key && take(uid, callback)) {
+			callbacks.push_back(callback);
+		}
+	}
+
+	std::unique_lock<std::mutex> ul(m_overflow_mtx);
+	for (auto &call : m_overflow) {
+		callbacks.push_back(call.second);
+	}
+	m_overflow.clear();
+	m_overflow_size = 0;
+	return callbacks;
+}
@@ -38,11 +38,15 @@ bool ipc::collection::register_function(std::shared_ptr<ipc::function> func)
 	return true;
 }
 
-std::shared_ptr<ipc::function> ipc::collection::get_function(const std::string &name)
+std::shared_ptr<ipc::function> ipc::collection::get_function(std::string_view name)
 {
-	for (auto fct : m_functions) {
-		if (fct.first.compare(name.c_str()) == 0)
-			return fct.second;
-	}
+	auto fct = m_functions.find(name);
+	if (fct != m_functions.end())
+		return fct->second;
 	return nullptr;
-}
\ No newline at end of file
+}
+
+const std::map<std::string, std::shared_ptr<ipc::function>, std::less<>> &ipc::collection::get_functions()
+{
+	return m_functions;
+}
@@ -0,0 +1,272 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#include "ipc-client.hpp"
+#include <condition_variable>
+#include <mutex>
+
+// How long to wait for the server to confirm a subscription.
+static const auto subscribe_timeout = std::chrono::seconds(15);
+
+struct ipc::call_future::state {
+	std::mutex mtx;
+	std::condition_variable cv;
+	bool done = false;
+	std::vector<ipc::value> values;
+	std::chrono::high_resolution_clock::duration duration = {};
+
+	// Set for callback calls, which never hand out a future.
+	ipc::client::async_return_t callback;
+	ipc::client::completion_executor_t executor;
+	// Set by a coroutine awaiting the future, runs once the reply is in.
+	std::function<void()> continuation;
+
+	// The call's own reference, dropped once its reply is in.
+	std::shared_ptr<state> self;
+
+	static void complete(void *data, const std::vector<ipc::value> &rval, std::chrono::high_resolution_clock::duration obs_call_duration);
+	void fail(const char *error);
+};
+
+void ipc::call_future::state::complete(void *data, const std::vector<ipc::value> &rval, std::chrono::high_resolution_clock::duration obs_call_duration)
+{
+	std::shared_ptr<state> call = std::move(static_cast<state *>(data)->self);
+
+	if (call->callback) {
+		if (call->executor) {
+			call->executor([call, rval, obs_call_duration]() { call->callback(rval, obs_call_duration); });
+		} else {
+			call->callback(rval, obs_call_duration);
+		}
+		return;
+	}
+
+	std::function<void()> continuation;
+	{
+		std::unique_lock<std::mutex> ul(call->mtx);
+		call->values = rval;
+		call->duration = obs_call_duration;
+		call->done = true;
+		continuation = std::move(call->continuation);
+		call->cv.notify_all();
+	}
+
+	// Outside the lock, the coroutine may well await its next call right away.
+	if (continuation && call->executor) {
+		call->executor(std::move(continuation));
+	} else if (continuation) {
+		continuation();
+	}
+}
+
+void ipc::call_future::state::fail(const char *error)
+{
+	std::unique_lock<std::mutex> ul(mtx);
+	values.resize(1);
+	values[0].value_str = error;
+	done = true;
+	self = nullptr;
+	cv.notify_all();
+}
+
+bool ipc::call_future::valid() const
+{
+	return m_state != nullptr;
+}
+
+bool ipc::call_future::ready() const
+{
+	std::unique_lock<std::mutex> ul(m_state->mtx);
+	return m_state->done;
+}
+
+void ipc::call_future::wait() const
+{
+	std::unique_lock<std::mutex> ul(m_state->mtx);
+	m_state->cv.wait(ul, [this]() { return m_state->done; });
+}
+
+bool ipc::call_future::wait_for(std::chrono::nanoseconds timeout) const
+{
+	std::unique_lock<std::mutex> ul(m_state->mtx);
+	return m_state->cv.wait_for(ul, timeout, [this]() { return m_state->done; });
+}
+
+std::vector<ipc::value> ipc::call_future::get()
+{
+	std::unique_lock<std::mutex> ul(m_state->mtx);
+	m_state->cv.wait(ul, [this]() { return m_state->done; });
+	return std::move(m_state->values);
+}
+
+std::chrono::high_resolution_clock::duration ipc::call_future::duration() const
+{
+	std::unique_lock<std::mutex> ul(m_state->mtx);
+	return m_state->duration;
+}
+
+#ifdef IPC_COROUTINES
+bool ipc::call_future::await_ready() const
+{
+	return ready();
+}
+
+bool ipc::call_future::await_suspend(std::coroutine_handle<> caller)
+{
+	std::unique_lock<std::mutex> ul(m_state->mtx);
+	if (m_state->done) {
+		return false;
+	}
+	m_state->continuation = [caller]() { caller.resume(); };
+	return true;
+}
+
+std::vector<ipc::value> ipc::call_future::await_resume()
+{
+	return get();
+}
+#endif
+
+ipc::call_future ipc::client::call_async(const std::string &cname, const std::string &fname, std::vector<ipc::value> args)
+{
+	ipc::call_future future;
+	future.m_state = std::make_shared<ipc::call_future::state>();
+	future.m_state->executor = m_completion_executor;
+	future.m_state->self = future.m_state;
+	// A local call ID, the shared default would be written by every thread calling at the same time.
+	int64_t cbid = 0;
+	if (!call(cname, fname, std::move(args), &ipc::call_future::state::complete, future.m_state.get(), cbid)) {
+		future.m_state->fail("Call could not be sent.");
+	}
+	return future;
+}
+
+bool ipc::client::call_async(const std::string &cname, const std::string &fname, std::vector<ipc::value> args, async_return_t callback)
+{
+	auto call_state = std::make_shared<ipc::call_future::state>();
+	call_state->callback = std::move(callback);
+	call_state->executor = m_completion_executor;
+	call_state->self = call_state;
+	int64_t cbid = 0;
+	if (!call(cname, fname, std::move(args), &ipc::call_future::state::complete, call_state.get(), cbid)) {
+		call_state->self = nullptr;
+		return false;
+	}
+	return true;
+}
+
+bool ipc::client::call_batch(std::vector<call_spec> calls)
+{
+	for (call_spec &spec : calls) {
+		int64_t cbid = 0;
+		bool sent = spec.fn ? call(spec.class_name, spec.function_name, std::move(spec.arguments), spec.fn, spec.data, cbid)
+				    : call_one_way(spec.class_name, spec.function_name, std::move(spec.arguments));
+		if (!sent) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool ipc::client::call_one_way(const std::string &cname, const std::string &fname, std::vector<ipc::value> args)
+{
+	int64_t cbid = 0;
+	return call(cname, fname, std::move(args), nullptr, nullptr, cbid);
+}
+
+bool ipc::client::send_message(const std::vector<char> &message)
+{
+	return call_one_way(ipc::message_class, ipc::message_function, {ipc::value(message)});
+}
+
+bool ipc::client::subscribe(const std::string &cname, const std::string &event, event_handler_t handler)
+{
+	// In place before the server knows, so nothing published right after it confirmed is missed.
+	{
+		std::unique_lock<std::mutex> ul(m_events_mtx);
+		m_events[cname][event] = std::move(handler);
+	}
+
+	// Called from a reply or event handler the answer can never arrive, like a server that hangs.
+	ipc::call_future reply = call_async(ipc::event_class, ipc::event_subscribe, {ipc::value(cname), ipc::value(event)});
+	if (!reply.wait_for(subscribe_timeout)) {
+		ipc::log("Subscribing to %s::%s timed out.", cname.c_str(), event.c_str());
+		{
+			std::unique_lock<std::mutex> ul(m_events_mtx);
+			m_events[cname].erase(event);
+		}
+		// In case the server gets to it after all.
+		call_one_way(ipc::event_class, ipc::event_unsubscribe, {ipc::value(cname), ipc::value(event)});
+		return false;
+	}
+	auto rval = reply.get();
+	if (!rval.empty()) {
+		ipc::log("Subscribing to %s::%s failed: %s", cname.c_str(), event.c_str(),
+			 rval[0].type == ipc::type::Null ? std::string(rval[0].value_str).c_str() : "unexpected reply");
+		std::unique_lock<std::mutex> ul(m_events_mtx);
+		m_events[cname].erase(event);
+		return false;
+	}
+	return true;
+}
+
+bool ipc::client::unsubscribe(const std::string &cname, const std::string &event)
+{
+	{
+		std::unique_lock<std::mutex> ul(m_events_mtx);
+		auto cls = m_events.find(cname);
+		if (cls == m_events.end() || cls->second.erase(event) == 0) {
+			return false;
+		}
+	}
+	return call_one_way(ipc::event_class, ipc::event_unsubscribe, {ipc::value(cname), ipc::value(event)});
+}
+
+std::shared_ptr<ipc::live_value> ipc::client::open_live_value(const std::string &, event_handler_t)
+{
+	return nullptr;
+}
+
+std::shared_ptr<ipc::bulk_reader> ipc::client::open_bulk_channel(const std::string &, bulk_handler_t)
+{
+	return nullptr;
+}
+
+void ipc::client::dispatch_event(std::string_view cname, std::string_view event, const std::vector<ipc::value> &values)
+{
+	event_handler_t handler;
+	{
+		std::unique_lock<std::mutex> ul(m_events_mtx);
+		auto cls = m_events.find(cname);
+		if (cls == m_events.end()) {
+			return;
+		}
+		auto entry = cls->second.find(event);
+		if (entry == cls->second.end()) {
+			return;
+		}
+		handler = entry->second;
+	}
+	// Unlocked, so the handler may unsubscribe.
+	handler(values);
+}
+
+void ipc::client::set_completion_executor(completion_executor_t executor)
+{
+	m_completion_executor = std::move(executor);
+}
@@ -0,0 +1,133 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+
+#include "ipc-completion.hpp"
+#include <memory>
+#include <vector>
+#ifdef __linux__
+#include "linux/utility.hpp"
+#endif
+
+namespace {
+struct completion_pool {
+	std::mutex mtx;
+	std::vector<ipc::completion *> slots;
+};
+
+// Never destroyed, and neither are the slots: a reply thread may still be waking a
+// caller that has already moved on, which has to find a slot there and not freed memory.
+completion_pool &pool()
+{
+	static completion_pool *instance = new completion_pool();
+	return *instance;
+}
+}
+
+ipc::completion::lease::lease() : m_slot(ipc::completion::acquire()) {}
+
+ipc::completion::lease::~lease()
+{
+	ipc::completion::release(m_slot);
+}
+
+ipc::completion *ipc::completion::acquire()
+{
+	{
+		std::unique_lock<std::mutex> ul(pool().mtx);
+		if (!pool().slots.empty()) {
+			completion *slot = pool().slots.back();
+			pool().slots.pop_back();
+			return slot;
+		}
+	}
+	return new completion();
+}
+
+void ipc::completion::release(completion *slot)
+{
+	// Only released after its wait returned, so nobody else touches the state any more.
+#ifdef __linux__
+	slot->m_state.store(0, std::memory_order_relaxed);
+#else
+	slot->m_done = false;
+#endif
+	std::unique_lock<std::mutex> ul(pool().mtx);
+	pool().slots.push_back(slot);
+}
+
+#ifdef __linux__
+void ipc::completion::signal()
+{
+	if (m_state.exchange(2) == 1) {
+		os::linux::utility::futex_wake(&m_state, 1, false);
+	}
+}
+
+bool ipc::completion::wait_for(std::chrono::nanoseconds timeout)
+{
+	const auto deadline = std::chrono::steady_clock::now() + timeout;
+	uint32_t state = m_state.load(std::memory_order_acquire);
+	while (state != 2) {
+		// Announce the sleep, signal() only makes the syscall for a caller that did.
+		if (state == 0 && !m_state.compare_exchange_strong(state, 1)) {
+			continue;
+		}
+
+		auto remaining = deadline - std::chrono::steady_clock::now();
+		if (remaining <= std::chrono::nanoseconds::zero() ||
+		    os::linux::utility::futex_wait(&m_state, 1, std::chrono::duration_cast<std::chrono::nanoseconds>(remaining), false) ==
+			    os::error::TimedOut) {
+			return m_state.load(std::memory_order_acquire) == 2;
+		}
+		state = m_state.load(std::memory_order_acquire);
+	}
+	return true;
+}
+
+void ipc::completion::wait()
+{
+	uint32_t state = m_state.load(std::memory_order_acquire);
+	while (state != 2) {
+		if (state == 0 && !m_state.compare_exchange_strong(state, 1)) {
+			continue;
+		}
+		os::linux::utility::futex_wait(&m_state, 1, std::chrono::nanoseconds(-1), false);
+		state = m_state.load(std::memory_order_acquire);
+	}
+}
+#else
+void ipc::completion::signal()
+{
+	std::unique_lock<std::mutex> ul(m_mtx);
+	m_done = true;
+	m_cv.notify_one();
+}
+
+bool ipc::completion::wait_for(std::chrono::nanoseconds timeout)
+{
+	std::unique_lock<std::mutex> ul(m_mtx);
+	return m_cv.wait_for(ul, timeout, [this]() { return m_done; });
+}
+
+void ipc::completion::wait()
+{
+	std::unique_lock<std::mutex> ul(m_mtx);
+	m_cv.wait(ul, [this]() { return m_done; });
+}
+#endif
@@ -0,0 +1,81 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#include "ipc-executor.hpp"
+
+ipc::executor::executor(size_t threads)
+{
+	for (size_t idx = 0; idx < threads; idx++) {
+		m_workers.emplace_back(&ipc::executor::worker, std::ref(m_pool));
+	}
+	m_pinned_worker = std::thread(&ipc::executor::worker, std::ref(m_pinned));
+}
+
+ipc::executor::~executor()
+{
+	for (queue *tasks : {&m_pool, &m_pinned}) {
+		std::unique_lock<std::mutex> ul(tasks->mtx);
+		tasks->stop = true;
+		tasks->cv.notify_all();
+	}
+	for (std::thread &thread : m_workers) {
+		thread.join();
+	}
+	m_pinned_worker.join();
+}
+
+void ipc::executor::post(std::function<void()> task)
+{
+	std::unique_lock<std::mutex> ul(m_pool.mtx);
+	m_pool.tasks.push_back(std::move(task));
+	m_pool.cv.notify_one();
+}
+
+void ipc::executor::post_pinned(std::function<void()> task)
+{
+	std::unique_lock<std::mutex> ul(m_pinned.mtx);
+	m_pinned.tasks.push_back(std::move(task));
+	m_pinned.cv.notify_one();
+}
+
+void ipc::executor::worker(queue &tasks)
+{
+	std::unique_lock<std::mutex> ul(tasks.mtx);
+	while (true) {
+		tasks.cv.wait(ul, [&tasks]() { return tasks.stop || tasks.head < tasks.tasks.size(); });
+		if (tasks.head == tasks.tasks.size()) {
+			// Only once stopped, whatever was queued before has run.
+			break;
+		}
+
+		std::function<void()> task = std::move(tasks.tasks[tasks.head++]);
+		if (tasks.head == tasks.tasks.size()) {
+			tasks.tasks.clear();
+			tasks.head = 0;
+		} else if (tasks.head >= 64 && tasks.head * 2 >= tasks.tasks.size()) {
+			// Under steady load it never drains, drop what already ran every now and then.
+			tasks.tasks.erase(tasks.tasks.begin(), tasks.tasks.begin() + tasks.head);
+			tasks.head = 0;
+		}
+		ul.unlock();
+		task();
+		// The task's captures go before the lock is taken again, they may own a connection.
+		task = nullptr;
+		ul.lock();
+	}
+}
@@ -19,6 +19,7 @@
 #include "ipc-function.hpp"
 #include "ipc.hpp"
 #include <iostream>
+#include <stdexcept>
 
 ipc::function::function(const std::string &name, const std::vector<ipc::type> &params, call_handler_t ptr, void *data)
 {
@@ -31,17 +32,42 @@ ipc::function::function(const std::string &name, const std::vector<ipc::type> &p
 
 ipc::function::function(const std::string &name, const std::vector<ipc::type> &params, call_handler_t ptr) : function(name, params, ptr, nullptr) {}
 
-ipc::function::function(const std::string &name, const std::vector<ipc::type> &params, void *data) : function(name, params, nullptr, data) {}
+ipc::function::function(const std::string &name, const std::vector<ipc::type> &params, void *data) : function(name, params, call_handler_t(nullptr), data) {}
 
-ipc::function::function(const std::string &name, const std::vector<ipc::type> &params) : function(name, params, nullptr, nullptr) {}
+ipc::function::function(const std::string &name, const std::vector<ipc::type> &params) : function(name, params, call_handler_t(nullptr), nullptr) {}
 
 ipc::function::function(const std::string &name, call_handler_t ptr, void *data) : function(name, std::vector<ipc::type>(), ptr, data) {}
 
 ipc::function::function(const std::string &name, call_handler_t ptr) : function(name, std::vector<ipc::type>(), ptr, nullptr) {}
 
-ipc::function::function(const std::string &name, void *data) : function(name, std::vector<ipc::type>(), nullptr, data) {}
+ipc::function::function(const std::string &name, void *data) : function(name, std::vector<ipc::type>(), call_handler_t(nullptr), data) {}
 
-ipc::function::function(const std::string &name) : function(name, std::vector<ipc::type>(), nullptr, nullptr) {}
+ipc::function::function(const std::string &name) : function(name, std::vector<ipc::type>(), call_handler_t(nullptr), nullptr) {}
+
+ipc::function::function(const std::string &name, const std::vector<ipc::type> &params, view_call_handler_t ptr, void *data)
+	: function(name, params, call_handler_t(nullptr), data)
+{
+	this->m_viewHandler = ptr;
+}
+
+ipc::function::function(const std::string &name, view_call_handler_t ptr, void *data) : function(name, std::vector<ipc::type>(), ptr, data) {}
+
+ipc::function::function(const std::string &name, view_call_handler_t ptr) : function(name, std::vector<ipc::type>(), ptr, nullptr) {}
+
+ipc::function::function(const std::string &name, const std::vector<ipc::type> &params, async_call_handler_t ptr, void *data)
+	: function(name, params, call_handler_t(nullptr), data)
+{
+	this->m_asyncHandler = ptr;
+}
+
+ipc::function::function(const std::string &name, async_call_handler_t ptr, void *data) : function(name, std::vector<ipc::type>(), ptr, data) {}
+
+ipc::function::function(const std::string &name, const std::vector<ipc::type> &params, std::nullptr_t, void *data)
+	: function(name, params, call_handler_t(nullptr), data)
+{
+}
+
+ipc::function::function(const std::string &name, std::nullptr_t, void *data) : function(name, std::vector<ipc::type>(), call_handler_t(nullptr), data) {}
 
 ipc::function::~function() {}
 
@@ -55,9 +81,61 @@ std::string ipc::function::get_name()
 	return m_name;
 }
 
+void ipc::function::set_execution(ipc::execution policy)
+{
+	m_execution = policy;
+}
+
+ipc::execution ipc::function::get_execution()
+{
+	return m_execution;
+}
+
 void ipc::function::call(const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval)
 {
 	if (m_callHandler.first) {
 		return m_callHandler.first(m_callHandler.second, id, args, rval);
+	} else if (m_viewHandler) {
+		std::vector<ipc::value_view> views(args.begin(), args.end());
+		return m_viewHandler(m_callHandler.second, id, views, rval);
+	} else if (m_asyncHandler) {
+		throw std::runtime_error("Asynchronous function can not be called synchronously.");
+	}
+}
+
+void ipc::function::call(const int64_t id, ipc::span<const ipc::value_view> args, std::vector<ipc::value> &rval)
+{
+	if (m_viewHandler) {
+		return m_viewHandler(m_callHandler.second, id, args, rval);
+	} else if (m_callHandler.first) {
+		std::vector<ipc::value> values;
+		values.reserve(args.size());
+		for (const ipc::value_view &arg : args) {
+			values.push_back(arg.to_value());
+		}
+		return m_callHandler.first(m_callHandler.second, id, values, rval);
+	} else if (m_asyncHandler) {
+		throw std::runtime_error("Asynchronous function can not be called synchronously.");
+	}
+}
+
+bool ipc::function::is_asynchronous()
+{
+	return m_asyncHandler != nullptr;
+}
+
+void ipc::function::call_async(const int64_t id, ipc::span<const ipc::value_view> args, ipc::call_completion_t done)
+{
+	if (m_asyncHandler) {
+		return m_asyncHandler(m_callHandler.second, id, args, std::move(done));
+	}
+
+	std::vector<ipc::value> rval;
+	std::string error;
+	try {
+		call(id, args, rval);
+	} catch (const std::exception &e) {
+		error = e.what();
 	}
+	done(rval, error);
 }
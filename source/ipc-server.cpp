@@ -17,15 +17,150 @@
 ******************************************************************************/
 
 #include "ipc-server.hpp"
+#include <algorithm>
 #include <chrono>
 #include "../include/error.hpp"
 #include "../include/tags.hpp"
 
 #ifdef WIN32
 #include "windows/ipc-socket-win.hpp"
+#include "windows/semaphore.hpp"
 #elif __APPLE__
 #include "apple/ipc-socket-osx.hpp"
+#elif __linux__
+#include "linux/ipc-server-instance-linux.hpp"
+#include "linux/ipc-socket-linux.hpp"
+#include "linux/live-region.hpp"
+#include "linux/bulk-region.hpp"
 #endif
+
+// Frames encoded once for many clients can't carry descriptors, shared binaries go in as copies.
+static void copy_shared_binaries(std::vector<ipc::value> &values)
+{
+	for (ipc::value &v : values) {
+		if (v.type == ipc::type::Binary && v.get_shared_binary()) {
+			v = ipc::value(std::vector<char>(v.binary_data(), v.binary_data() + v.binary_size()));
+		}
+	}
+}
+
+struct ipc::server::live_value {
+#ifdef __linux__
+	std::unique_ptr<os::linux::live_region> region;
+#endif
+	// Serializes stores and changes to |readers|, whose index is the reader slot.
+	std::mutex mtx;
+	std::vector<std::weak_ptr<ipc::server_instance>> readers;
+};
+
+struct ipc::server::bulk_channel : public ipc::bulk_writer {
+	std::string key;
+#ifdef __linux__
+	std::unique_ptr<os::linux::bulk_region> region;
+#endif
+	// Guards |reader| and handing buffers over, the writer's own calls aren't synchronized with each other.
+	std::mutex mtx;
+	std::weak_ptr<ipc::server_instance> reader;
+
+	std::shared_ptr<ipc::server_instance> get_reader()
+	{
+		std::unique_lock<std::mutex> ul(mtx);
+		return reader.lock();
+	}
+
+	virtual bool has_reader() override { return get_reader() != nullptr; }
+
+	virtual bool acquire(ipc::bulk_buffer &buffer) override
+	{
+#ifdef __linux__
+		if (!has_reader() || !region->acquire(buffer.slot, buffer.data)) {
+			return false;
+		}
+		buffer.sequence = 0;
+		buffer.size = region->slot_size();
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	virtual bool publish(const ipc::bulk_buffer &buffer, size_t size) override
+	{
+#ifdef __linux__
+		// Published under the lock, so a buffer goes to exactly the reader that is responsible for releasing it.
+		std::shared_ptr<ipc::server_instance> instance;
+		uint64_t sequence;
+		{
+			std::unique_lock<std::mutex> ul(mtx);
+			instance = reader.lock();
+			sequence = instance ? region->publish(buffer.slot, size) : 0;
+		}
+		if (sequence == 0) {
+			return false;
+		}
+
+		ipc::message::event msg;
+		msg.class_name = ipc::value(ipc::bulk_class);
+		msg.event_name = ipc::value(key);
+		msg.values.push_back(ipc::value(buffer.slot));
+		msg.values.push_back(ipc::value(sequence));
+
+		static thread_local ipc::frame_builder frame;
+		frame.reset();
+		msg.serialize(frame);
+		frame.finish(ipc::protocol::v2);
+		return instance->send_event(frame);
+#else
+		return false;
+#endif
+	}
+};
+
+#ifdef __linux__
+void ipc::server::watcher()
+{
+	while (true) {
+		std::shared_ptr<os::linux::socket_linux> listener;
+		{
+			std::unique_lock<std::mutex> ul(m_sockets_mtx);
+			m_watcher.cv.wait(ul, [this]() { return m_watcher.stop || m_sockets.size() > 0; });
+			if (m_watcher.stop) {
+				break;
+			}
+			listener = std::static_pointer_cast<os::linux::socket_linux>(m_sockets.front());
+		}
+
+		// Accepts and the traffic of every client are dispatched from here, this
+		// only returns once there was an event or someone woke the reactor.
+		listener->get_reactor()->run_once(std::chrono::milliseconds(-1));
+
+		// Reap the clients that reported their connection went away.
+		std::vector<std::shared_ptr<ipc::socket>> dead;
+		{
+			std::unique_lock<std::mutex> ul(m_watcher.dead_mtx);
+			std::swap(dead, m_watcher.dead);
+		}
+		if (!dead.empty()) {
+			std::unique_lock<std::mutex> ul(m_clients_mtx);
+			for (auto &socket : dead) {
+				// finalize() may have been first.
+				if (m_clients.count(socket) != 0) {
+					kill_client(socket);
+				}
+			}
+		}
+	}
+}
+
+void ipc::server::client_disconnected(std::shared_ptr<ipc::socket> socket)
+{
+	{
+		std::unique_lock<std::mutex> ul(m_watcher.dead_mtx);
+		m_watcher.dead.push_back(socket);
+	}
+	std::static_pointer_cast<os::linux::socket_linux>(socket)->get_reactor()->wake();
+}
+#else
 void ipc::server::watcher()
 {
 	os::error ec;
@@ -53,13 +188,20 @@ void ipc::server::watcher()
 		}
 	};
 
+	// The callback of an accept points at its entry, so entries must not move.
 #ifdef WIN32
-	std::map<std::shared_ptr<ipc::socket>, pending_accept> pa_map;
+	std::map<std::shared_ptr<ipc::socket>, std::shared_ptr<pending_accept>> pa_map;
 #elif __APPLE__
-	std::map<std::shared_ptr<ipc::socket>, pending_accept> pa_map;
+	std::map<std::shared_ptr<ipc::socket>, std::shared_ptr<pending_accept>> pa_map;
 #endif
 
 	while (!m_watcher.stop) {
+		// Before looking, so a disconnect reported from here on still ends the wait below.
+		{
+			std::unique_lock<std::mutex> ul(m_watcher.wake_mtx);
+			m_watcher.woken = false;
+		}
+
 		// Verify the state of sockets.
 		{
 			// std::cout << "Checking sockets" << std::endl;
@@ -75,20 +217,20 @@ void ipc::server::watcher()
 						kill_client(socket);
 					}
 				} else if (pending == pa_map.end()) {
-					pending_accept pa;
-					pa.parent = this;
-					pa.start = std::chrono::high_resolution_clock::now();
-					pa.socket = socket;
+					auto pa = std::make_shared<pending_accept>();
+					pa->parent = this;
+					pa->start = std::chrono::high_resolution_clock::now();
+					pa->socket = socket;
 #ifdef WIN32
-					ec = socket->accept(pa.op,
-							    std::bind(&pending_accept::accept_client_cb, &pa, std::placeholders::_1, std::placeholders::_2));
+					ec = socket->accept(pa->op, std::bind(&pending_accept::accept_client_cb, pa.get(), std::placeholders::_1,
+									      std::placeholders::_2));
 					if (ec == os::error::Success) {
 						// There was no client waiting to connect, but there might be one in the future.
 						pa_map.insert_or_assign(socket, pa);
 					}
 #elif __APPLE__
-					ec = socket->accept(pa.op,
-							    std::bind(&pending_accept::accept_client_cb, &pa, std::placeholders::_1, std::placeholders::_2));
+					ec = socket->accept(pa->op, std::bind(&pending_accept::accept_client_cb, pa.get(), std::placeholders::_1,
+									      std::placeholders::_2));
 					if (ec == os::error::Success) {
 						// There was no client waiting to connect, but there might be one in the future.
 						pa_map.insert_or_assign(socket, pa);
@@ -105,16 +247,49 @@ void ipc::server::watcher()
 		std::vector<std::shared_ptr<ipc::socket>> idx_to_socket;
 #endif
 		for (auto kv : pa_map) {
-			waits.push_back(kv.second.op.get());
+			waits.push_back(kv.second->op.get());
 			idx_to_socket.push_back(kv.first);
 		}
 
+		// Block until a client connects or an instance reports its disconnect
+		// through client_disconnected(). The bound is only a safety net for
+		// disconnects nobody reported.
 		if (waits.size() == 0) {
-			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			std::unique_lock<std::mutex> ul(m_watcher.wake_mtx);
+			m_watcher.cv.wait_for(ul, std::chrono::seconds(5), [this]() { return m_watcher.stop || m_watcher.woken; });
 			continue;
 		}
+#ifdef WIN32
+		waits.push_back(m_watcher.wake.get());
+#endif
+
+		size_t index = 0;
+		ec = os::waitable::wait_any(waits.data(), waits.size(), index, std::chrono::seconds(5));
+		if (ec == os::error::Success && index < idx_to_socket.size()) {
+			// The callback has spawned the client, its socket is now watched as a client.
+			pa_map.erase(idx_to_socket[index]);
+		}
+	}
+}
+
+void ipc::server::wake_watcher()
+{
+	{
+		std::unique_lock<std::mutex> ul(m_watcher.wake_mtx);
+		m_watcher.woken = true;
 	}
+	m_watcher.cv.notify_all();
+#ifdef WIN32
+	m_watcher.wake->signal();
+#endif
+}
+
+void ipc::server::client_disconnected(std::shared_ptr<ipc::socket>)
+{
+	// The watcher finds which one through is_connected().
+	wake_watcher();
 }
+#endif
 
 #ifdef WIN32
 void ipc::server::spawn_client(std::shared_ptr<ipc::socket> socket)
@@ -163,10 +338,39 @@ void ipc::server::kill_client(std::shared_ptr<ipc::socket> socket)
 }
 #endif
 
+#ifdef __linux__
+void ipc::server::spawn_client(std::shared_ptr<ipc::socket> socket)
+{
+	std::unique_lock<std::mutex> ul(m_clients_mtx);
+	std::shared_ptr<ipc::server_instance> client = ipc::server_instance::create(this, socket, m_callTimeout);
+	if (m_handlerConnect.first) {
+		m_handlerConnect.first(m_handlerConnect.second, 0);
+	}
+	m_clients.insert_or_assign(socket, client);
+}
+
+void ipc::server::kill_client(std::shared_ptr<ipc::socket> socket)
+{
+	// Calls still queued may keep the instance around for a while, it must not read anything else meanwhile.
+	auto client = m_clients.find(socket);
+	if (client != m_clients.end()) {
+		std::static_pointer_cast<ipc::server_instance_linux>(client->second)->stop();
+	}
+
+	m_clients.erase(socket);
+	if (m_handlerDisconnect.first) {
+		m_handlerDisconnect.first(m_handlerDisconnect.second, 0);
+	}
+}
+#endif
+
 ipc::server::server()
 {
 	// Start Watcher
 	m_watcher.stop = false;
+#ifdef WIN32
+	m_watcher.wake = std::make_unique<os::windows::semaphore>();
+#endif
 	m_watcher.worker = std::thread(std::bind(&ipc::server::watcher, this));
 }
 
@@ -174,7 +378,15 @@ ipc::server::~server()
 {
 	finalize();
 
-	m_watcher.stop = true;
+	{
+		std::unique_lock<std::mutex> ul(m_sockets_mtx);
+		m_watcher.stop = true;
+	}
+#ifdef __linux__
+	m_watcher.cv.notify_all();
+#else
+	wake_watcher();
+#endif
 	if (m_watcher.worker.joinable()) {
 		m_watcher.worker.join();
 	}
@@ -182,6 +394,16 @@ ipc::server::~server()
 
 void ipc::server::initialize(std::string socketPath)
 {
+	// Before any client can ask for them.
+	build_method_table();
+	{
+		std::unique_lock<std::mutex> ul(m_executor_mtx);
+		if (!m_executor) {
+			size_t threads = m_executorThreads ? m_executorThreads : std::max(2u, std::thread::hardware_concurrency());
+			m_executor = std::make_unique<ipc::executor>(threads);
+		}
+	}
+
 	// Start a few sockets.
 
 	try {
@@ -192,6 +414,23 @@ void ipc::server::initialize(std::string socketPath)
 #elif __APPLE__
 		std::unique_lock<std::mutex> ul(m_sockets_mtx);
 		m_sockets.insert(m_sockets.end(), std::make_shared<os::apple::socket_osx>(os::create_only, socketPath));
+#elif __linux__
+		std::unique_lock<std::mutex> ul(m_sockets_mtx);
+		auto listener = std::make_shared<os::linux::socket_linux>(os::create_only, socketPath);
+		os::linux::socket_linux *raw_listener = listener.get();
+		listener->get_reactor()->add(listener->get_handle(), EPOLLIN, [this, raw_listener](uint32_t) {
+			std::shared_ptr<os::linux::socket_linux> connection;
+			while ((connection = raw_listener->accept_connection()) != nullptr) {
+				spawn_client(connection);
+			}
+		});
+		m_sockets.insert(m_sockets.end(), listener);
+#endif
+#ifdef __linux__
+		m_watcher.cv.notify_all();
+#else
+		ul.unlock();
+		wake_watcher();
 #endif
 	} catch (std::exception e) {
 		throw e;
@@ -217,7 +456,22 @@ void ipc::server::finalize()
 		}
 	}
 
+	// Lets calls still in flight finish, they hold on to their connection until then. Nothing new is
+	// taken on meanwhile, see post(), the workers are joined without the lock as tasks may still post.
+	std::unique_ptr<ipc::executor> executor;
+	{
+		std::unique_lock<std::mutex> ul(m_executor_mtx);
+		executor = std::move(m_executor);
+	}
+	executor = nullptr;
+
 	// Kill any remaining sockets
+#ifdef __linux__
+	// Let the watcher drop its reference to the listening socket.
+	for (auto socket : m_sockets) {
+		std::static_pointer_cast<os::linux::socket_linux>(socket)->get_reactor()->wake();
+	}
+#endif
 	m_sockets.clear();
 }
 
@@ -226,6 +480,21 @@ void ipc::server::set_call_timeout(int callTimeout)
 	m_callTimeout = callTimeout;
 }
 
+void ipc::server::set_shared_binary_threshold(size_t bytes)
+{
+	m_sharedBinaryThreshold = bytes;
+}
+
+size_t ipc::server::get_shared_binary_threshold()
+{
+	return m_sharedBinaryThreshold;
+}
+
+void ipc::server::set_executor_threads(size_t threads)
+{
+	m_executorThreads = threads;
+}
+
 void ipc::server::set_connect_handler(server_connect_handler_t handler, void *data)
 {
 	m_handlerConnect = std::make_pair(handler, data);
@@ -253,25 +522,22 @@ void ipc::server::set_post_callback(server_post_callback_t handler, void *data)
 
 bool ipc::server::register_collection(std::shared_ptr<ipc::collection> cls)
 {
-	if (m_classes.count(cls->get_name()) > 0)
-		return false;
-
-	m_classes.insert(std::make_pair(cls->get_name(), cls));
-	return true;
+	return m_classes.emplace(cls->get_name(), cls).second;
 }
 
 bool ipc::server::client_call_function(int64_t cid, const std::string &cname, const std::string &fname, std::vector<ipc::value> &args,
 				       std::vector<ipc::value> &rval, std::string &errormsg, std::chrono::high_resolution_clock::duration &call_duration)
 {
-	if (m_classes.count(cname) == 0) {
-		errormsg = "Class '" + cname + "' is not registered.";
-		return false;
+	if (cname == ipc::message_class) {
+		if (args.size() != 1 || args[0].type != ipc::type::Binary) {
+			errormsg = "Malformed message.";
+			return false;
+		}
+		return deliver_message(cid, args[0].binary_data(), args[0].binary_size(), errormsg);
 	}
-	auto cls = m_classes.at(cname);
 
-	auto fnc = cls->get_function(fname);
+	ipc::function *fnc = find_function(cname, fname, errormsg);
 	if (!fnc) {
-		errormsg = "Function '" + fname + "' not found in class '" + cname + "'.";
 		return false;
 	}
 
@@ -280,7 +546,12 @@ bool ipc::server::client_call_function(int64_t cid, const std::string &cname, co
 	}
 
 	const auto start = std::chrono::high_resolution_clock::now();
-	fnc->call(cid, args, rval);
+	try {
+		fnc->call(cid, args, rval);
+	} catch (std::exception &e) {
+		errormsg = "Function '" + fname + "' in class '" + cname + "' failed: " + e.what();
+		return false;
+	}
 	call_duration = std::chrono::high_resolution_clock::now() - start;
 
 	if (m_postCallback.first) {
@@ -289,3 +560,497 @@ bool ipc::server::client_call_function(int64_t cid, const std::string &cname, co
 
 	return true;
 }
+
+bool ipc::server::client_call_function(int64_t cid, std::string_view cname, std::string_view fname, ipc::span<const ipc::value_view> args,
+				       std::vector<ipc::value> &rval, std::string &errormsg, std::chrono::high_resolution_clock::duration &call_duration)
+{
+	if (cname == ipc::message_class) {
+		if (args.size() != 1 || args[0].type != ipc::type::Binary) {
+			errormsg = "Malformed message.";
+			return false;
+		}
+		return deliver_message(cid, args[0].value_bin.data(), args[0].value_bin.size(), errormsg);
+	}
+
+	ipc::function *fnc = find_function(cname, fname, errormsg);
+	if (!fnc) {
+		return false;
+	}
+
+	return call_function(cid, cname, fname, *fnc, args, rval, errormsg, call_duration);
+}
+
+bool ipc::server::client_call_function(int64_t cid, uint32_t method_id, ipc::span<const ipc::value_view> args, std::vector<ipc::value> &rval,
+				       std::string &errormsg, std::chrono::high_resolution_clock::duration &call_duration)
+{
+	if (method_id == 0 || method_id > m_methods.size()) {
+		errormsg = "Method " + std::to_string(method_id) + " is not registered.";
+		return false;
+	}
+
+	const method &entry = m_methods[method_id - 1];
+	return call_function(cid, entry.class_name, entry.function_name, *entry.function, args, rval, errormsg, call_duration);
+}
+
+ipc::function *ipc::server::resolve_function(uint32_t method_id, std::string_view cname, std::string_view fname, std::string &errormsg)
+{
+	if (method_id == 0) {
+		return find_function(cname, fname, errormsg);
+	} else if (method_id > m_methods.size()) {
+		errormsg = "Method " + std::to_string(method_id) + " is not registered.";
+		return nullptr;
+	}
+	return m_methods[method_id - 1].function.get();
+}
+
+void ipc::server::client_call_function_async(int64_t cid, uint32_t method_id, std::string_view cname, std::string_view fname,
+					     ipc::span<const ipc::value_view> args, ipc::server_call_done_t done)
+{
+	std::string errormsg;
+	ipc::function *fnc = resolve_function(method_id, cname, fname, errormsg);
+	if (!fnc) {
+		std::vector<ipc::value> rval;
+		done(false, rval, errormsg, {});
+		return;
+	}
+	if (method_id != 0) {
+		cname = m_methods[method_id - 1].class_name;
+		fname = m_methods[method_id - 1].function_name;
+	}
+
+	if (m_preCallback.first) {
+		std::vector<ipc::value> values;
+		for (const ipc::value_view &arg : args) {
+			values.push_back(arg.to_value());
+		}
+		m_preCallback.first(std::string(cname), std::string(fname), values, m_preCallback.second);
+	}
+
+	// The names are copied, the completion may run after the frame they point into is gone.
+	const auto start = std::chrono::high_resolution_clock::now();
+	auto finish = [this, cls = std::string(cname), fn = std::string(fname), start, done](std::vector<ipc::value> &rval, const std::string &error) {
+		auto call_duration = std::chrono::high_resolution_clock::now() - start;
+		if (!error.empty()) {
+			done(false, rval, "Function '" + fn + "' in class '" + cls + "' failed: " + error, call_duration);
+			return;
+		}
+		if (m_postCallback.first) {
+			m_postCallback.first(cls, fn, rval, m_postCallback.second);
+		}
+		done(true, rval, std::string(), call_duration);
+	};
+
+	// Handlers that throw before they started anything fail the call, same as synchronous ones.
+	try {
+		fnc->call_async(cid, args, finish);
+	} catch (std::exception &e) {
+		std::vector<ipc::value> rval;
+		finish(rval, e.what());
+	}
+}
+
+bool ipc::server::post(ipc::execution policy, std::function<void()> task)
+{
+	std::unique_lock<std::mutex> ul(m_executor_mtx);
+	if (!m_executor) {
+		return false;
+	}
+	if (policy == ipc::execution::pinned) {
+		m_executor->post_pinned(std::move(task));
+	} else {
+		m_executor->post(std::move(task));
+	}
+	return true;
+}
+
+const std::vector<ipc::server::method> &ipc::server::get_methods()
+{
+	return m_methods;
+}
+
+uint32_t ipc::server::find_method(std::string_view cname, std::string_view fname)
+{
+	if (m_method_slots.empty()) {
+		return 0;
+	}
+
+	// At most half the slots are taken, so every probe ends at an empty one.
+	const size_t hash = method_hash(cname, fname);
+	const size_t mask = m_method_slots.size() - 1;
+	for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+		uint32_t method_id = m_method_slots[slot];
+		if (method_id == 0) {
+			return 0;
+		}
+		const method &entry = m_methods[method_id - 1];
+		if (entry.hash == hash && entry.function_name == fname && entry.class_name == cname) {
+			return method_id;
+		}
+	}
+}
+
+size_t ipc::server::method_hash(std::string_view cname, std::string_view fname)
+{
+	// FNV-1a, the separator keeps "ab"+"c" apart from "a"+"bc".
+	uint64_t hash = 14695981039346656037ull;
+	for (char ch : cname) {
+		hash = (hash ^ uint8_t(ch)) * 1099511628211ull;
+	}
+	hash = (hash ^ 0xFF) * 1099511628211ull;
+	for (char ch : fname) {
+		hash = (hash ^ uint8_t(ch)) * 1099511628211ull;
+	}
+	return size_t(hash ^ (hash >> 32));
+}
+
+void ipc::server::build_method_table()
+{
+	// Both maps are ordered, so the same registrations always get the same IDs.
+	m_methods.clear();
+	for (auto &cls : m_classes) {
+		for (auto &fnc : cls.second->get_functions()) {
+			m_methods.push_back({cls.first, fnc.first, fnc.second, method_hash(cls.first, fnc.first)});
+		}
+	}
+
+	// Frozen open addressing index over the table, slots hold method IDs and 0 marks an empty one.
+	size_t slots = 16;
+	while (slots < 2 * m_methods.size()) {
+		slots <<= 1;
+	}
+	m_method_slots.assign(slots, 0);
+	for (size_t idx = 0; idx < m_methods.size(); idx++) {
+		size_t slot = m_methods[idx].hash & (slots - 1);
+		while (m_method_slots[slot] != 0) {
+			slot = (slot + 1) & (slots - 1);
+		}
+		m_method_slots[slot] = uint32_t(idx + 1);
+	}
+}
+
+size_t ipc::server::publish(const std::string &cname, const std::string &event, std::vector<ipc::value> values)
+{
+	std::vector<std::shared_ptr<ipc::server_instance>> targets;
+	{
+		std::unique_lock<std::mutex> ul(m_events_mtx);
+		auto cls = m_subscribers.find(cname);
+		if (cls == m_subscribers.end()) {
+			return 0;
+		}
+		auto subscribers = cls->second.find(event);
+		if (subscribers == cls->second.end()) {
+			return 0;
+		}
+
+		// Clients that went away are dropped here, disconnecting doesn't have to look.
+		std::vector<std::weak_ptr<ipc::server_instance>> &list = subscribers->second;
+		for (auto entry = list.begin(); entry != list.end();) {
+			if (auto instance = entry->lock()) {
+				targets.push_back(std::move(instance));
+				++entry;
+			} else {
+				entry = list.erase(entry);
+			}
+		}
+	}
+	if (targets.empty()) {
+		return 0;
+	}
+
+	ipc::message::event msg;
+	msg.class_name = ipc::value(cname);
+	msg.event_name = ipc::value(event);
+	msg.values = std::move(values);
+	copy_shared_binaries(msg.values);
+
+	static thread_local ipc::frame_builder frame;
+	frame.reset();
+	msg.serialize(frame);
+	frame.finish(ipc::protocol::v2);
+
+	size_t sent = 0;
+	for (auto &instance : targets) {
+		sent += instance->send_event(frame) ? 1 : 0;
+	}
+	return sent;
+}
+
+void ipc::server::client_subscribe(std::shared_ptr<server_instance> instance, std::string_view cname, std::string_view event, bool subscribe)
+{
+	std::unique_lock<std::mutex> ul(m_events_mtx);
+	std::vector<std::weak_ptr<ipc::server_instance>> &list = m_subscribers[std::string(cname)][std::string(event)];
+	// Compared by owner, locking could make this the last reference to some other instance.
+	for (auto entry = list.begin(); entry != list.end();) {
+		if (entry->expired() || (!entry->owner_before(instance) && !instance.owner_before(*entry))) {
+			entry = list.erase(entry);
+		} else {
+			++entry;
+		}
+	}
+	if (subscribe) {
+		list.push_back(instance);
+	}
+}
+
+bool ipc::server::create_live_value(const std::string &key, size_t capacity)
+{
+#ifdef __linux__
+	std::unique_lock<std::mutex> ul(m_live_mtx);
+	if (m_live_values.count(key) != 0) {
+		return false;
+	}
+
+	auto entry = std::make_shared<live_value>();
+	try {
+		entry->region = os::linux::live_region::create(capacity);
+	} catch (std::exception &e) {
+		ipc::log("Creating live value %s failed: %s", key.c_str(), e.what());
+		return false;
+	}
+	m_live_values.emplace(key, std::move(entry));
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool ipc::server::set_live_value(const std::string &key, std::vector<ipc::value> values)
+{
+#ifdef __linux__
+	std::shared_ptr<live_value> entry;
+	{
+		std::unique_lock<std::mutex> ul(m_live_mtx);
+		auto found = m_live_values.find(key);
+		if (found == m_live_values.end()) {
+			return false;
+		}
+		entry = found->second;
+	}
+
+	// Stored as an event frame, which is what clients already know how to decode.
+	ipc::message::event msg;
+	msg.class_name = ipc::value(ipc::live_class);
+	msg.event_name = ipc::value(key);
+	msg.values = std::move(values);
+	copy_shared_binaries(msg.values);
+
+	static thread_local ipc::frame_builder frame;
+	frame.reset();
+	msg.serialize(frame);
+	frame.finish(ipc::protocol::v2);
+
+	std::vector<std::shared_ptr<ipc::server_instance>> targets;
+	uint64_t sequence;
+	{
+		std::unique_lock<std::mutex> ul(entry->mtx);
+		if (!entry->region->store(frame.data(), frame.size())) {
+			return false;
+		}
+		sequence = entry->region->sequence();
+
+		// Readers that asked for a notification get one and have to ask again, whatever happens meanwhile is conflated.
+		for (size_t idx = 0; idx < entry->readers.size(); idx++) {
+			auto instance = entry->readers[idx].lock();
+			if (instance && entry->region->disarm(idx)) {
+				targets.push_back(std::move(instance));
+			}
+		}
+	}
+	if (targets.empty()) {
+		return true;
+	}
+
+	msg.values.clear();
+	msg.values.push_back(ipc::value(sequence / 2));
+	frame.reset();
+	msg.serialize(frame);
+	frame.finish(ipc::protocol::v2);
+	for (auto &instance : targets) {
+		instance->send_event(frame);
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+void ipc::server::remove_live_value(const std::string &key)
+{
+	// Unlinked once stores still running let go of it, mappings clients hold stay valid.
+	std::unique_lock<std::mutex> ul(m_live_mtx);
+	auto found = m_live_values.find(key);
+	if (found != m_live_values.end()) {
+		m_live_values.erase(found);
+	}
+}
+
+bool ipc::server::client_open_live_value(std::shared_ptr<server_instance> instance, std::string_view key, std::vector<ipc::value> &rval,
+					 std::string &errormsg)
+{
+#ifdef __linux__
+	std::shared_ptr<live_value> entry;
+	{
+		std::unique_lock<std::mutex> ul(m_live_mtx);
+		auto found = m_live_values.find(key);
+		if (found == m_live_values.end()) {
+			errormsg = "Unknown live value.";
+			return false;
+		}
+		entry = found->second;
+	}
+
+	std::unique_lock<std::mutex> ul(entry->mtx);
+	std::vector<std::weak_ptr<ipc::server_instance>> &readers = entry->readers;
+	size_t slot = readers.size();
+	for (size_t idx = 0; idx < readers.size(); idx++) {
+		// Compared by owner like in client_subscribe().
+		if (!readers[idx].owner_before(instance) && !instance.owner_before(readers[idx])) {
+			slot = idx;
+			break;
+		} else if (slot == readers.size() && readers[idx].expired()) {
+			slot = idx;
+		}
+	}
+
+	if (slot == readers.size()) {
+		if (readers.size() >= os::linux::live_region::max_readers) {
+			errormsg = "Live value has too many readers.";
+			return false;
+		}
+		readers.emplace_back();
+	}
+	if (readers[slot].owner_before(instance) || instance.owner_before(readers[slot])) {
+		// A slot left behind by a client that is gone, whatever it asked for doesn't apply.
+		entry->region->arm(slot, false);
+		readers[slot] = instance;
+	}
+
+	rval.push_back(ipc::value(entry->region->name()));
+	rval.push_back(ipc::value(uint32_t(slot)));
+	return true;
+#else
+	errormsg = "Live values are not supported on this platform.";
+	return false;
+#endif
+}
+
+std::shared_ptr<ipc::bulk_writer> ipc::server::create_bulk_channel(const std::string &key, size_t slot_count, size_t slot_size)
+{
+#ifdef __linux__
+	std::unique_lock<std::mutex> ul(m_bulk_mtx);
+	if (m_bulk_channels.count(key) != 0) {
+		return nullptr;
+	}
+
+	auto channel = std::make_shared<bulk_channel>();
+	channel->key = key;
+	try {
+		channel->region = os::linux::bulk_region::create(slot_count, slot_size);
+	} catch (std::exception &e) {
+		ipc::log("Creating bulk channel %s failed: %s", key.c_str(), e.what());
+		return nullptr;
+	}
+	m_bulk_channels.emplace(key, channel);
+	return channel;
+#else
+	return nullptr;
+#endif
+}
+
+void ipc::server::remove_bulk_channel(const std::string &key)
+{
+	std::unique_lock<std::mutex> ul(m_bulk_mtx);
+	auto found = m_bulk_channels.find(key);
+	if (found != m_bulk_channels.end()) {
+		m_bulk_channels.erase(found);
+	}
+}
+
+bool ipc::server::client_open_bulk_channel(std::shared_ptr<server_instance> instance, std::string_view key, std::vector<ipc::value> &rval,
+					   std::string &errormsg)
+{
+#ifdef __linux__
+	std::shared_ptr<bulk_channel> channel;
+	{
+		std::unique_lock<std::mutex> ul(m_bulk_mtx);
+		auto found = m_bulk_channels.find(key);
+		if (found == m_bulk_channels.end()) {
+			errormsg = "Unknown bulk channel.";
+			return false;
+		}
+		channel = found->second;
+	}
+
+	// Buffers the previous reader didn't release are taken back, it can't release them anymore.
+	{
+		std::unique_lock<std::mutex> ul(channel->mtx);
+		channel->reader = instance;
+		channel->region->reset();
+	}
+
+	rval.push_back(ipc::value(channel->region->name()));
+	return true;
+#else
+	errormsg = "Bulk channels are not supported on this platform.";
+	return false;
+#endif
+}
+
+bool ipc::server::deliver_message(int64_t cid, const char *data, size_t size, std::string &errormsg)
+{
+	if (!m_handlerMessage.first) {
+		errormsg = "No message handler is set.";
+		return false;
+	}
+	m_handlerMessage.first(m_handlerMessage.second, cid, std::vector<char>(data, data + size));
+	return true;
+}
+
+ipc::function *ipc::server::find_function(std::string_view cname, std::string_view fname, std::string &errormsg)
+{
+	uint32_t method_id = find_method(cname, fname);
+	if (method_id != 0) {
+		return m_methods[method_id - 1].function.get();
+	}
+
+	// Registered after initialize(), or not at all.
+	auto cls = m_classes.find(cname);
+	if (cls == m_classes.end()) {
+		errormsg = "Class '" + std::string(cname) + "' is not registered.";
+		return nullptr;
+	}
+
+	ipc::function *fnc = cls->second->get_function(fname).get();
+	if (!fnc) {
+		errormsg = "Function '" + std::string(fname) + "' not found in class '" + std::string(cname) + "'.";
+	}
+	return fnc;
+}
+
+bool ipc::server::call_function(int64_t cid, std::string_view cname, std::string_view fname, ipc::function &fnc, ipc::span<const ipc::value_view> args,
+				std::vector<ipc::value> &rval, std::string &errormsg, std::chrono::high_resolution_clock::duration &call_duration)
+{
+	// The callbacks predate borrowed arguments and only get to see owning copies.
+	if (m_preCallback.first) {
+		std::vector<ipc::value> values;
+		for (const ipc::value_view &arg : args) {
+			values.push_back(arg.to_value());
+		}
+		m_preCallback.first(std::string(cname), std::string(fname), values, m_preCallback.second);
+	}
+
+	// A handler that throws, like a typed function called with the wrong arguments, fails the call instead of the server.
+	const auto start = std::chrono::high_resolution_clock::now();
+	try {
+		fnc.call(cid, args, rval);
+	} catch (std::exception &e) {
+		errormsg = "Function '" + std::string(fname) + "' in class '" + std::string(cname) + "' failed: " + e.what();
+		return false;
+	}
+	call_duration = std::chrono::high_resolution_clock::now() - start;
+
+	if (m_postCallback.first) {
+		m_postCallback.first(std::string(cname), std::string(fname), rval, m_postCallback.second);
+	}
+	return true;
+}
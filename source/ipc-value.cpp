@@ -17,17 +17,181 @@
 ******************************************************************************/
 
 #include "ipc-value.hpp"
+#include "ipc.hpp"
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
+
+// Wire tag of a Binary value that travels as an attachment instead of inline.
+#define SHARED_BINARY_TAG (0x80000000u | uint32_t(ipc::type::Binary))
+// v2 tags are a single byte, shared binaries set the high bit and are followed by the attachment index.
+#define V2_SHARED_FLAG 0x80u
+
+// Signed integers are zigzag encoded in v2 so small negative numbers stay short.
+static inline uint64_t zigzag_encode(int64_t value)
+{
+	return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+}
+
+static inline int64_t zigzag_decode(uint64_t value)
+{
+	return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+ipc::value_bytes::value_bytes(const char *data, size_t size)
+{
+	assign(data, size);
+}
+
+ipc::value_bytes &ipc::value_bytes::operator=(const value_bytes &other)
+{
+	if (this != &other) {
+		clear();
+		copy_from(other);
+	}
+	return *this;
+}
+
+ipc::value_bytes &ipc::value_bytes::operator=(value_bytes &&other) noexcept
+{
+	if (this != &other) {
+		clear();
+		memcpy(m_storage, other.m_storage, sizeof(m_storage));
+		other.m_storage[0] = other.m_storage[sizeof(m_storage) - 1] = 0;
+	}
+	return *this;
+}
+
+ipc::value_bytes &ipc::value_bytes::operator=(const std::string &p_value)
+{
+	assign(p_value.data(), p_value.size());
+	return *this;
+}
+
+ipc::value_bytes &ipc::value_bytes::operator=(const char *p_value)
+{
+	assign(p_value, strlen(p_value));
+	return *this;
+}
+
+void ipc::value_bytes::assign(const char *data, size_t size)
+{
+	if (size > UINT32_MAX) {
+		throw std::length_error("Value contents are limited to 4 GiB");
+	}
+
+	// Copy first, |data| may point into the current contents.
+	if (size <= inline_capacity) {
+		char contents[inline_capacity];
+		if (size > 0) {
+			memcpy(contents, data, size);
+		}
+		clear();
+		if (size > 0) {
+			memcpy(m_storage, contents, size);
+		}
+		m_storage[size] = 0;
+		m_storage[sizeof(m_storage) - 1] = char(size);
+		return;
+	}
+
+	char *block = new char[size + 1];
+	memcpy(block, data, size);
+	block[size] = 0;
+	clear();
+	set_external(block, size, heap_tag);
+}
+
+void ipc::value_bytes::assign(std::shared_ptr<ipc::shared_binary> shared)
+{
+	if (!shared) {
+		clear();
+		return;
+	}
+	size_t size = shared->size();
+	if (size > UINT32_MAX) {
+		throw std::length_error("Value contents are limited to 4 GiB");
+	}
+
+	auto *holder = new std::shared_ptr<ipc::shared_binary>(std::move(shared));
+	clear();
+	set_external(holder, size, shared_tag);
+}
+
+void ipc::value_bytes::clear()
+{
+	if (tag() > inline_capacity) {
+		release();
+	}
+	m_storage[0] = m_storage[sizeof(m_storage) - 1] = 0;
+}
+
+std::shared_ptr<ipc::shared_binary> ipc::value_bytes::get_shared() const
+{
+	if (tag() != shared_tag) {
+		return nullptr;
+	}
+	return *static_cast<std::shared_ptr<ipc::shared_binary> *>(pointer());
+}
+
+void ipc::value_bytes::set_external(void *ptr, size_t size, uint8_t tag)
+{
+	uint32_t size32 = uint32_t(size);
+	memcpy(m_storage, &ptr, sizeof(ptr));
+	memcpy(m_storage + sizeof(void *), &size32, sizeof(size32));
+	m_storage[sizeof(m_storage) - 1] = char(tag);
+}
+
+void ipc::value_bytes::copy_from(const value_bytes &other)
+{
+	if (other.tag() <= inline_capacity) {
+		memcpy(m_storage, other.m_storage, sizeof(m_storage));
+	} else if (other.tag() == shared_tag) {
+		assign(other.get_shared());
+	} else {
+		assign(other.data(), other.size());
+	}
+}
+
+void ipc::value_bytes::release()
+{
+	if (tag() == heap_tag) {
+		delete[] static_cast<char *>(pointer());
+	} else {
+		delete static_cast<std::shared_ptr<ipc::shared_binary> *>(pointer());
+	}
+	m_storage[0] = m_storage[sizeof(m_storage) - 1] = 0;
+}
 
 ipc::value::value()
 {
 	this->type = type::Null;
 }
 
-ipc::value::value(const std::vector<char> &p_value) : type(type::Binary), value_bin(p_value) {}
+ipc::value::value(const std::vector<char> &p_value) : type(type::Binary), value_str(p_value.data(), p_value.size()) {}
 
 ipc::value::value(const std::string &p_value) : type(type::String), value_str(p_value) {}
 
+ipc::value::value(std::shared_ptr<ipc::shared_binary> p_value) : type(type::Binary)
+{
+	this->value_str.assign(std::move(p_value));
+}
+
+const char *ipc::value::binary_data() const
+{
+	return this->value_str.data();
+}
+
+size_t ipc::value::binary_size() const
+{
+	return this->value_str.size();
+}
+
+std::shared_ptr<ipc::shared_binary> ipc::value::get_shared_binary() const
+{
+	return this->value_str.get_shared();
+}
+
 ipc::value::value(uint64_t p_value)
 {
 	this->type = type::UInt64;
@@ -92,20 +256,97 @@ size_t ipc::value::size()
 		break;
 	case type::Binary:
 		size += sizeof(uint32_t);
-		size += this->value_bin.size();
+		if (!this->value_str.get_shared()) {
+			size += this->value_str.size();
+		}
 		break;
 	}
 	return size;
 }
 
-size_t ipc::value::serialize(std::vector<char> &buf, size_t offset)
+size_t ipc::value::serialize(std::vector<char> &buf, size_t offset, ipc::shared_binary_list *attachments)
 {
 	size_t buf_size = buf.size() - offset;
 	size_t full_size = size();
 	if (buf_size < full_size) {
 		throw std::exception((const std::exception &)"Value serialization failed, buffer too small");
 	}
-	size_t noffset = offset;
+	return write(&buf[offset], attachments);
+}
+
+void ipc::value::serialize(ipc::frame_builder &builder, ipc::shared_binary_list *attachments, ipc::protocol version)
+{
+	if (version == ipc::protocol::v2) {
+		write_v2(builder, attachments);
+	} else {
+		write(builder.append(size()), attachments);
+	}
+}
+
+void ipc::value::write_v2(ipc::frame_builder &builder, ipc::shared_binary_list *attachments)
+{
+	std::shared_ptr<ipc::shared_binary> shared = this->type == type::Binary ? this->value_str.get_shared() : nullptr;
+	if (shared) {
+		if (!attachments) {
+			throw std::runtime_error("Value serialization failed, shared binary values need a transport that passes descriptors");
+		}
+		builder.append_value<uint8_t>(uint8_t(type::Binary) | V2_SHARED_FLAG);
+		builder.append_varint(attachments->size());
+		attachments->push_back(std::move(shared));
+		return;
+	}
+
+	builder.append_value<uint8_t>(uint8_t(this->type));
+	switch (this->type) {
+	case type::Int32:
+		builder.append_varint(zigzag_encode(this->value_union.i32));
+		break;
+	case type::UInt32:
+		builder.append_varint(this->value_union.ui32);
+		break;
+	case type::Float:
+		builder.append_value<float_t>(this->value_union.fp32);
+		break;
+	case type::Int64:
+		builder.append_varint(zigzag_encode(this->value_union.i64));
+		break;
+	case type::UInt64:
+		builder.append_varint(this->value_union.ui64);
+		break;
+	case type::Double:
+		builder.append_value<double_t>(this->value_union.fp64);
+		break;
+	case type::String:
+		builder.append_varint(this->value_str.size());
+		if (this->value_str.size() > 0) {
+			memcpy(builder.append(this->value_str.size()), this->value_str.data(), this->value_str.size());
+		}
+		break;
+	case type::Binary:
+		builder.append_varint(this->value_str.size());
+		builder.append_binary(this->value_str.data(), this->value_str.size());
+		break;
+	default:
+		break;
+	}
+}
+
+size_t ipc::value::write(char *buf, ipc::shared_binary_list *attachments)
+{
+	size_t noffset = 0;
+	std::shared_ptr<ipc::shared_binary> shared = this->type == type::Binary ? this->value_str.get_shared() : nullptr;
+	if (shared) {
+		if (!attachments) {
+			throw std::runtime_error("Value serialization failed, shared binary values need a transport that passes descriptors");
+		}
+		reinterpret_cast<uint32_t &>(buf[noffset]) = SHARED_BINARY_TAG;
+		noffset += sizeof(uint32_t);
+		reinterpret_cast<uint32_t &>(buf[noffset]) = static_cast<uint32_t>(attachments->size());
+		noffset += sizeof(uint32_t);
+		attachments->push_back(std::move(shared));
+		return noffset;
+	}
+
 	reinterpret_cast<uint32_t &>(buf[noffset]) = (uint32_t)this->type;
 	noffset += sizeof(uint32_t);
 	switch (this->type) {
@@ -134,40 +375,51 @@ size_t ipc::value::serialize(std::vector<char> &buf, size_t offset)
 		noffset += sizeof(double_t);
 		break;
 	case type::String:
+	case type::Binary:
 		reinterpret_cast<uint32_t &>(buf[noffset]) = static_cast<uint32_t>(this->value_str.size());
 		noffset += sizeof(uint32_t);
 		if (this->value_str.size() > 0) {
-			auto str_begin = this->value_str.begin();
-			auto str_end = this->value_str.end();
-			auto buffer_begin = buf.begin() + noffset;
-			std::copy(str_begin, str_end, buffer_begin);
+			memcpy(buf + noffset, this->value_str.data(), this->value_str.size());
 		}
 		noffset += this->value_str.size();
 		break;
-	case type::Binary:
-		reinterpret_cast<uint32_t &>(buf[noffset]) = static_cast<uint32_t>(this->value_bin.size());
-		noffset += sizeof(uint32_t);
-		if (this->value_bin.size() > 0) {
-			auto bin_begin = this->value_bin.begin();
-			auto bin_end = this->value_bin.end();
-			auto buffer_begin = buf.begin() + noffset;
-			std::copy(bin_begin, bin_end, buffer_begin);
-		}
-		noffset += this->value_bin.size();
-		break;
 	}
-	return noffset - offset;
+	return noffset;
 }
 
-size_t ipc::value::deserialize(const std::vector<char> &buf, size_t offset)
+size_t ipc::value::deserialize(const std::vector<char> &buf, size_t offset, const ipc::shared_binary_list *attachments, ipc::protocol version)
 {
+	if (version != ipc::protocol::v1) {
+		ipc::value_view view;
+		size_t used = view.deserialize(buf.data(), buf.size(), offset, attachments, version);
+		*this = view.to_value();
+		return used;
+	}
+
 	if ((buf.size() - offset) < sizeof(uint32_t)) {
 		abort();
 		// throw std::exception((const std::exception&)"Buffer too small");
 	}
-	this->type = (ipc::type) * (reinterpret_cast<const uint32_t *>(&buf[offset]));
+	uint32_t tag = *(reinterpret_cast<const uint32_t *>(&buf[offset]));
 	size_t noffset = offset + sizeof(uint32_t);
 	uint32_t length;
+
+	this->value_str.clear();
+	if (tag == SHARED_BINARY_TAG) {
+		if ((buf.size() - noffset) < sizeof(uint32_t)) {
+			throw std::runtime_error("Deserialize of shared buffer value failed, index missing");
+		}
+		uint32_t index = reinterpret_cast<const uint32_t &>(buf[noffset]);
+		noffset += sizeof(uint32_t);
+		if (!attachments || index >= attachments->size() || !(*attachments)[index]) {
+			throw std::runtime_error("Deserialize of shared buffer value failed, attachment missing");
+		}
+
+		this->type = type::Binary;
+		this->value_str.assign((*attachments)[index]);
+		return (noffset - offset);
+	}
+	this->type = (ipc::type)tag;
 	switch (this->type) {
 	case type::Int32:
 	case type::UInt32:
@@ -201,13 +453,7 @@ size_t ipc::value::deserialize(const std::vector<char> &buf, size_t offset)
 			// throw std::exception((const std::exception&)"Deserialize of string value failed, string missing");
 		}
 
-		this->value_str.clear();
-		this->value_str.resize(length);
-		if (length > 0) {
-			auto begin = buf.begin() + noffset;
-			auto end = buf.begin() + noffset + static_cast<size_t>(length);
-			this->value_str = std::string(begin, end);
-		}
+		this->value_str.assign(buf.data() + noffset, length);
 		noffset += length;
 		break;
 	case type::Binary:
@@ -221,15 +467,216 @@ size_t ipc::value::deserialize(const std::vector<char> &buf, size_t offset)
 			abort();
 			// throw std::exception((const std::exception&)"Deserialize of buffer value failed, buffer missing");
 		}
-		this->value_bin.clear();
-		this->value_bin.resize(length);
-		if (length > 0) {
-			auto begin = buf.begin() + noffset;
-			auto end = buf.begin() + noffset + static_cast<size_t>(length);
-			this->value_bin = std::vector<char>(begin, end);
-		}
+		this->value_str.assign(buf.data() + noffset, length);
 		noffset += length;
 		break;
 	}
 	return (noffset - offset);
 }
+
+ipc::value_view::value_view(const ipc::value &p_value)
+	: type(p_value.type), value_union(p_value.value_union), value_shared(p_value.get_shared_binary())
+{
+	switch (this->type) {
+	case type::String:
+		this->value_str = p_value.value_str;
+		break;
+	case type::Binary:
+		this->value_bin = ipc::span<const char>(p_value.binary_data(), p_value.binary_size());
+		break;
+	default:
+		break;
+	}
+}
+
+ipc::value ipc::value_view::to_value() const
+{
+	ipc::value result;
+	result.type = this->type;
+	result.value_union = this->value_union;
+	switch (this->type) {
+	case type::String:
+		result.value_str.assign(this->value_str.data(), this->value_str.size());
+		break;
+	case type::Binary:
+		if (this->value_shared) {
+			result.value_str.assign(this->value_shared);
+		} else {
+			result.value_str.assign(this->value_bin.data(), this->value_bin.size());
+		}
+		break;
+	default:
+		break;
+	}
+	return result;
+}
+
+size_t ipc::value_view::deserialize(const char *buf, size_t length, size_t offset, const ipc::shared_binary_list *attachments, ipc::protocol version)
+{
+	if (version == ipc::protocol::v2) {
+		return deserialize_v2(buf, length, offset, attachments);
+	} else if (version != ipc::protocol::v1) {
+		throw std::runtime_error("Deserialize of value failed, unknown protocol");
+	}
+
+	if (offset > length || (length - offset) < sizeof(uint32_t)) {
+		throw std::runtime_error("Deserialize of value failed, buffer too small");
+	}
+	uint32_t tag;
+	memcpy(&tag, buf + offset, sizeof(uint32_t));
+	size_t noffset = offset + sizeof(uint32_t);
+	uint32_t size;
+
+	this->value_shared = nullptr;
+	this->value_str = std::string_view();
+	this->value_bin = ipc::span<const char>();
+	if (tag == SHARED_BINARY_TAG) {
+		if ((length - noffset) < sizeof(uint32_t)) {
+			throw std::runtime_error("Deserialize of shared buffer value failed, index missing");
+		}
+		uint32_t index;
+		memcpy(&index, buf + noffset, sizeof(uint32_t));
+		noffset += sizeof(uint32_t);
+		if (!attachments || index >= attachments->size() || !(*attachments)[index]) {
+			throw std::runtime_error("Deserialize of shared buffer value failed, attachment missing");
+		}
+
+		this->type = type::Binary;
+		this->value_shared = (*attachments)[index];
+		this->value_bin = ipc::span<const char>(this->value_shared->data(), this->value_shared->size());
+		return (noffset - offset);
+	}
+
+	this->type = (ipc::type)tag;
+	switch (this->type) {
+	case type::Null:
+		break;
+	case type::Int32:
+	case type::UInt32:
+	case type::Float:
+		if ((length - noffset) < sizeof(int32_t)) {
+			throw std::runtime_error("Deserialize of 32-bit value failed");
+		}
+		memcpy(&this->value_union.i32, buf + noffset, sizeof(int32_t));
+		noffset += sizeof(int32_t);
+		break;
+	case type::Int64:
+	case type::UInt64:
+	case type::Double:
+		if ((length - noffset) < sizeof(int64_t)) {
+			throw std::runtime_error("Deserialize of 64-bit value failed");
+		}
+		memcpy(&this->value_union.ui64, buf + noffset, sizeof(uint64_t));
+		noffset += sizeof(int64_t);
+		break;
+	case type::String:
+	case type::Binary:
+		if ((length - noffset) < sizeof(uint32_t)) {
+			throw std::runtime_error("Deserialize of string or buffer value failed, length missing");
+		}
+		memcpy(&size, buf + noffset, sizeof(uint32_t));
+		noffset += sizeof(uint32_t);
+		if ((length - noffset) < size) {
+			throw std::runtime_error("Deserialize of string or buffer value failed, contents missing");
+		}
+
+		if (this->type == type::String) {
+			this->value_str = std::string_view(buf + noffset, size);
+		} else {
+			this->value_bin = ipc::span<const char>(buf + noffset, size);
+		}
+		noffset += size;
+		break;
+	default:
+		throw std::runtime_error("Deserialize of value failed, unknown type");
+	}
+	return (noffset - offset);
+}
+
+size_t ipc::value_view::deserialize_v2(const char *buf, size_t length, size_t offset, const ipc::shared_binary_list *attachments)
+{
+	if (offset >= length) {
+		throw std::runtime_error("Deserialize of value failed, buffer too small");
+	}
+	uint8_t tag = uint8_t(buf[offset]);
+	size_t noffset = offset + 1;
+	uint64_t number;
+
+	this->value_shared = nullptr;
+	this->value_str = std::string_view();
+	this->value_bin = ipc::span<const char>();
+	if (tag & V2_SHARED_FLAG) {
+		if (tag != (uint8_t(type::Binary) | V2_SHARED_FLAG)) {
+			throw std::runtime_error("Deserialize of value failed, unknown type");
+		}
+		noffset += ipc::read_varint(buf, length, noffset, number);
+		if (!attachments || number >= attachments->size() || !(*attachments)[size_t(number)]) {
+			throw std::runtime_error("Deserialize of shared buffer value failed, attachment missing");
+		}
+
+		this->type = type::Binary;
+		this->value_shared = (*attachments)[size_t(number)];
+		this->value_bin = ipc::span<const char>(this->value_shared->data(), this->value_shared->size());
+		return (noffset - offset);
+	}
+
+	this->type = (ipc::type)tag;
+	switch (this->type) {
+	case type::Null:
+		break;
+	case type::Int32:
+		noffset += ipc::read_varint(buf, length, noffset, number);
+		this->value_union.i64 = zigzag_decode(number);
+		if (this->value_union.i64 < INT32_MIN || this->value_union.i64 > INT32_MAX) {
+			throw std::runtime_error("Deserialize of 32-bit value failed, out of range");
+		}
+		this->value_union.i32 = int32_t(this->value_union.i64);
+		break;
+	case type::UInt32:
+		noffset += ipc::read_varint(buf, length, noffset, number);
+		if (number > UINT32_MAX) {
+			throw std::runtime_error("Deserialize of 32-bit value failed, out of range");
+		}
+		this->value_union.ui32 = uint32_t(number);
+		break;
+	case type::Int64:
+		noffset += ipc::read_varint(buf, length, noffset, number);
+		this->value_union.i64 = zigzag_decode(number);
+		break;
+	case type::UInt64:
+		noffset += ipc::read_varint(buf, length, noffset, number);
+		this->value_union.ui64 = number;
+		break;
+	case type::Float:
+		if ((length - noffset) < sizeof(float_t)) {
+			throw std::runtime_error("Deserialize of 32-bit value failed");
+		}
+		memcpy(&this->value_union.fp32, buf + noffset, sizeof(float_t));
+		noffset += sizeof(float_t);
+		break;
+	case type::Double:
+		if ((length - noffset) < sizeof(double_t)) {
+			throw std::runtime_error("Deserialize of 64-bit value failed");
+		}
+		memcpy(&this->value_union.fp64, buf + noffset, sizeof(double_t));
+		noffset += sizeof(double_t);
+		break;
+	case type::String:
+	case type::Binary:
+		noffset += ipc::read_varint(buf, length, noffset, number);
+		if ((length - noffset) < number) {
+			throw std::runtime_error("Deserialize of string or buffer value failed, contents missing");
+		}
+
+		if (this->type == type::String) {
+			this->value_str = std::string_view(buf + noffset, size_t(number));
+		} else {
+			this->value_bin = ipc::span<const char>(buf + noffset, size_t(number));
+		}
+		noffset += size_t(number);
+		break;
+	default:
+		throw std::runtime_error("Deserialize of value failed, unknown type");
+	}
+	return (noffset - offset);
+}
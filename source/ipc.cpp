@@ -17,11 +17,19 @@
 ******************************************************************************/
 
 #include "ipc.hpp"
+#include <algorithm>
 #include <sstream>
 #include <iostream>
+#include <stdexcept>
 
 using namespace ipc;
 
+// First byte of a v2 message.
+#define V2_CALL_METHOD_ID 0x01u
+#define V2_CALL_ONE_WAY 0x02u
+#define V2_REPLY_ERROR 0x01u
+#define V2_REPLY_EVENT 0x02u
+
 std::string ipc::ProcessInfo::getDescription(DWORD key)
 {
 	ProcessInfo::ExitCode k = static_cast<ProcessInfo::ExitCode>(key);
@@ -124,6 +132,189 @@ std::string ipc::vectortohex(const std::vector<char> &buf)
 	return tohex.str();
 }
 
+ipc::frame_builder::frame_builder()
+{
+	reset();
+}
+
+void ipc::frame_builder::grow(size_t required)
+{
+	m_buffer.resize(std::max(required, m_buffer.size() * 2));
+}
+
+void ipc::frame_builder::reset()
+{
+	m_length = 0;
+	m_references.clear();
+	m_referenced = 0;
+	append(sizeof(ipc_size_t));
+}
+
+void ipc::frame_builder::append_binary(const char *data, size_t length)
+{
+	if (m_reference_threshold == 0 || length < m_reference_threshold) {
+		memcpy(append(length), data, length);
+		return;
+	}
+	m_references.push_back({m_length, data, length});
+	m_referenced += length;
+}
+
+void ipc::frame_builder::set_reference_threshold(size_t bytes)
+{
+	m_reference_threshold = bytes;
+}
+
+void ipc::frame_builder::finish(ipc::protocol version)
+{
+	patch_value<ipc_size_real_t>(0, ipc_size_real_t(version));
+	patch_value<ipc_size_real_t>(sizeof(ipc_size_real_t), ipc_size_real_t(frame_size() - sizeof(ipc_size_t)));
+}
+
+size_t ipc::read_varint(const char *buf, size_t length, size_t offset, uint64_t &value)
+{
+	value = 0;
+	for (size_t idx = 0; idx < 10; idx++) {
+		if (offset + idx >= length) {
+			throw std::runtime_error("Varint truncated");
+		}
+		uint8_t byte = uint8_t(buf[offset + idx]);
+		if (idx == 9 && byte > 1) {
+			break;
+		}
+		value |= uint64_t(byte & 0x7F) << (7 * idx);
+		if ((byte & 0x80) == 0) {
+			return idx + 1;
+		}
+	}
+	throw std::runtime_error("Varint too long");
+}
+
+static void append_name(ipc::frame_builder &builder, const ipc::value_bytes &name)
+{
+	builder.append_varint(name.size());
+	if (name.size() > 0) {
+		memcpy(builder.append(name.size()), name.data(), name.size());
+	}
+}
+
+static size_t read_name(const char *buf, size_t length, size_t offset, ipc::value_view &name)
+{
+	uint64_t size;
+	size_t noffset = offset + ipc::read_varint(buf, length, offset, size);
+	if ((length - noffset) < size) {
+		throw std::runtime_error("Buffer too small");
+	}
+	name.type = ipc::type::String;
+	name.value_str = std::string_view(buf + noffset, size_t(size));
+	return noffset + size_t(size) - offset;
+}
+
+const char *ipc::frame_builder::data() const
+{
+	return m_buffer.data();
+}
+
+size_t ipc::frame_builder::size() const
+{
+	return m_length;
+}
+
+void ipc::frame_builder::gather(std::vector<ipc::frame_segment> &segments) const
+{
+	segments.clear();
+	size_t offset = 0;
+	for (const reference &ref : m_references) {
+		if (ref.offset > offset) {
+			segments.push_back({m_buffer.data() + offset, ref.offset - offset});
+		}
+		segments.push_back({ref.data, ref.length});
+		offset = ref.offset;
+	}
+	if (m_length > offset) {
+		segments.push_back({m_buffer.data() + offset, m_length - offset});
+	}
+}
+
+size_t ipc::frame_builder::frame_size() const
+{
+	return m_length + m_referenced;
+}
+
+size_t ipc::frame_reader::expected() const
+{
+	if (m_end - m_begin < sizeof(ipc_size_t)) {
+		return 0;
+	}
+	ipc_size_real_t size;
+	memcpy(&size, m_buffer.data() + m_begin + sizeof(ipc_size_real_t), sizeof(size));
+	return sizeof(ipc_size_t) + size_t(size);
+}
+
+size_t ipc::frame_reader::buffered() const
+{
+	return m_end - m_begin;
+}
+
+char *ipc::frame_reader::prepare(size_t length)
+{
+	if (m_buffer.size() - m_end < length) {
+		// Only the start of a frame is left at this point, move it to the front instead of growing behind it.
+		if (m_begin != 0) {
+			memmove(m_buffer.data(), m_buffer.data() + m_begin, m_end - m_begin);
+			m_end -= m_begin;
+			m_begin = 0;
+		}
+		if (m_buffer.size() - m_end < length) {
+			m_buffer.resize(m_end + length);
+		}
+	}
+	return m_buffer.data() + m_end;
+}
+
+void ipc::frame_reader::commit(size_t length)
+{
+	m_end += length;
+}
+
+bool ipc::frame_reader::next(const char *&frame, size_t &length)
+{
+	size_t size = expected();
+	if (size == 0 || m_end - m_begin < size) {
+		return false;
+	}
+
+	frame = m_buffer.data() + m_begin;
+	length = size;
+	m_last = m_begin;
+	m_begin += size;
+	m_position += size;
+	// Nothing left, so the next receive starts at the front again. The frame itself stays where it is.
+	if (m_begin == m_end) {
+		m_begin = m_end = 0;
+	}
+	return true;
+}
+
+uint64_t ipc::frame_reader::position() const
+{
+	return m_position;
+}
+
+uint64_t ipc::frame_reader::received() const
+{
+	return m_position + (m_end - m_begin);
+}
+
+bool ipc::frame_reader::detach(std::vector<char> &buffer)
+{
+	if (m_last != 0 || m_end != 0) {
+		return false;
+	}
+	m_buffer.swap(buffer);
+	return true;
+}
+
 size_t ipc::message::function_call::size()
 {
 	size_t size = sizeof(size_t) + uid.size() /* timestamp */
@@ -135,15 +326,15 @@ size_t ipc::message::function_call::size()
 	return size;
 }
 
-size_t ipc::message::function_call::serialize(std::vector<char> &buf, size_t offset)
+size_t ipc::message::function_call::serialize(std::vector<char> &buf, size_t offset, ipc::shared_binary_list *attachments)
 {
-	if ((buf.size() - offset) < size()) {
+	size_t full_size = size();
+	if ((buf.size() - offset) < full_size) {
 		throw std::exception((const std::exception &)"Buffer too small");
 	}
 	size_t noffset = offset;
 
-	reinterpret_cast<size_t &>(buf[noffset]) = size();
-	// std::cout << "size serialized call: " << size() << std::endl;
+	reinterpret_cast<size_t &>(buf[noffset]) = full_size;
 	noffset += sizeof(size_t);
 
 	noffset += uid.serialize(buf, noffset);
@@ -154,13 +345,48 @@ size_t ipc::message::function_call::serialize(std::vector<char> &buf, size_t off
 	noffset += sizeof(uint32_t);
 
 	for (ipc::value &v : arguments) {
-		noffset += v.serialize(buf, noffset);
+		noffset += v.serialize(buf, noffset, attachments);
 	}
 
 	return noffset - offset;
 }
 
-size_t ipc::message::function_call::deserialize(std::vector<char> &buf, size_t offset)
+void ipc::message::function_call::serialize(ipc::frame_builder &builder, ipc::shared_binary_list *attachments, ipc::protocol version)
+{
+	if (version == ipc::protocol::v2) {
+		// No message length, the frame has one.
+		builder.append_value<uint8_t>((method_id ? V2_CALL_METHOD_ID : 0) | (one_way ? V2_CALL_ONE_WAY : 0));
+		builder.append_varint(uid.value_union.ui64);
+		if (method_id) {
+			builder.append_varint(method_id);
+		} else {
+			append_name(builder, class_name.value_str);
+			append_name(builder, function_name.value_str);
+		}
+
+		builder.append_varint(arguments.size());
+		for (ipc::value &v : arguments) {
+			v.serialize(builder, attachments, version);
+		}
+		return;
+	}
+
+	size_t start = builder.size();
+	builder.append_value<size_t>(0);
+
+	uid.serialize(builder, attachments);
+	class_name.serialize(builder, attachments);
+	function_name.serialize(builder, attachments);
+
+	builder.append_value<uint32_t>((uint32_t)arguments.size());
+	for (ipc::value &v : arguments) {
+		v.serialize(builder, attachments);
+	}
+
+	builder.patch_value<size_t>(start, builder.size() - start);
+}
+
+size_t ipc::message::function_call::deserialize(std::vector<char> &buf, size_t offset, const ipc::shared_binary_list *attachments)
 {
 
 	if ((buf.size() - offset) < sizeof(size_t)) {
@@ -183,12 +409,92 @@ size_t ipc::message::function_call::deserialize(std::vector<char> &buf, size_t o
 	noffset += sizeof(uint32_t);
 	this->arguments.resize(cnt);
 	for (size_t idx = 0; idx < cnt; idx++) {
-		noffset += this->arguments[idx].deserialize(buf, noffset);
+		noffset += this->arguments[idx].deserialize(buf, noffset, attachments);
 	}
 
 	return noffset - offset;
 }
 
+size_t ipc::message::function_call_view::deserialize(const char *buf, size_t length, const ipc::shared_binary_list *attachments, ipc::protocol version)
+{
+	if (version == ipc::protocol::v2) {
+		if (length < 1 || (uint8_t(buf[0]) & ~(V2_CALL_METHOD_ID | V2_CALL_ONE_WAY)) != 0) {
+			throw std::runtime_error("Unknown message header");
+		}
+		uint8_t flags = uint8_t(buf[0]);
+		size_t noffset = 1;
+		one_way = (flags & V2_CALL_ONE_WAY) != 0;
+
+		uint64_t number;
+		noffset += ipc::read_varint(buf, length, noffset, number);
+		uid.type = ipc::type::UInt64;
+		uid.value_union.ui64 = number;
+
+		method_id = 0;
+		class_name.type = function_name.type = ipc::type::String;
+		class_name.value_str = function_name.value_str = std::string_view();
+		if (flags & V2_CALL_METHOD_ID) {
+			noffset += ipc::read_varint(buf, length, noffset, number);
+			if (number == 0 || number > UINT32_MAX) {
+				throw std::runtime_error("Invalid method ID");
+			}
+			method_id = uint32_t(number);
+		} else {
+			noffset += read_name(buf, length, noffset, class_name);
+			noffset += read_name(buf, length, noffset, function_name);
+		}
+
+		// Every argument takes at least its tag, which bounds the count by the buffer.
+		noffset += ipc::read_varint(buf, length, noffset, number);
+		if (number > (length - noffset)) {
+			throw std::runtime_error("Buffer too small");
+		}
+		this->arguments.resize(size_t(number));
+		for (ipc::value_view &argument : this->arguments) {
+			noffset += argument.deserialize(buf, length, noffset, attachments, version);
+		}
+		return noffset;
+	} else if (version != ipc::protocol::v1) {
+		throw std::runtime_error("Unknown protocol");
+	}
+
+	method_id = 0;
+	one_way = false;
+	if (length < sizeof(size_t)) {
+		throw std::runtime_error("Buffer too small");
+	}
+
+	size_t size;
+	memcpy(&size, buf, sizeof(size_t));
+	if (length < size) {
+		throw std::runtime_error("Buffer too small");
+	}
+	length = size;
+
+	size_t noffset = sizeof(size_t);
+	noffset += uid.deserialize(buf, length, noffset);
+	noffset += class_name.deserialize(buf, length, noffset);
+	noffset += function_name.deserialize(buf, length, noffset);
+
+	if ((length - noffset) < sizeof(uint32_t)) {
+		throw std::runtime_error("Buffer too small");
+	}
+	uint32_t cnt;
+	memcpy(&cnt, buf + noffset, sizeof(uint32_t));
+	noffset += sizeof(uint32_t);
+
+	// Every argument takes at least its tag, which bounds the count by the buffer.
+	if (cnt > (length - noffset) / sizeof(uint32_t)) {
+		throw std::runtime_error("Buffer too small");
+	}
+	this->arguments.resize(cnt);
+	for (size_t idx = 0; idx < cnt; idx++) {
+		noffset += this->arguments[idx].deserialize(buf, length, noffset, attachments);
+	}
+
+	return noffset;
+}
+
 size_t ipc::message::function_reply::size()
 {
 	size_t size = sizeof(size_t) + uid.size()   /* timestamp */
@@ -202,14 +508,15 @@ size_t ipc::message::function_reply::size()
 	return size;
 }
 
-size_t ipc::message::function_reply::serialize(std::vector<char> &buf, size_t offset)
+size_t ipc::message::function_reply::serialize(std::vector<char> &buf, size_t offset, ipc::shared_binary_list *attachments)
 {
-	if ((buf.size() - offset) < size()) {
+	size_t full_size = size();
+	if ((buf.size() - offset) < full_size) {
 		throw std::exception((const std::exception &)"Buffer too small");
 	}
 	size_t noffset = offset;
 
-	reinterpret_cast<size_t &>(buf[noffset]) = size();
+	reinterpret_cast<size_t &>(buf[noffset]) = full_size;
 
 	noffset += sizeof(size_t);
 
@@ -220,14 +527,82 @@ size_t ipc::message::function_reply::serialize(std::vector<char> &buf, size_t of
 	reinterpret_cast<uint32_t &>(buf[noffset]) = (uint32_t)this->values.size();
 	noffset += sizeof(uint32_t);
 	for (ipc::value &v : values) {
-		noffset += v.serialize(buf, noffset);
+		noffset += v.serialize(buf, noffset, attachments);
 	}
 
 	return noffset - offset;
 }
 
-size_t ipc::message::function_reply::deserialize(std::vector<char> &buf, size_t offset)
+void ipc::message::function_reply::serialize(ipc::frame_builder &builder, ipc::shared_binary_list *attachments, ipc::protocol version)
+{
+	if (version == ipc::protocol::v2) {
+		bool has_error = error.value_str.size() > 0;
+		builder.append_value<uint8_t>(has_error ? V2_REPLY_ERROR : 0);
+		builder.append_varint(uid.value_union.ui64);
+		builder.append_varint(obs_call_duration_ms.value_union.ui32);
+		if (has_error) {
+			append_name(builder, error.value_str);
+		}
+
+		builder.append_varint(values.size());
+		for (ipc::value &v : values) {
+			v.serialize(builder, attachments, version);
+		}
+		return;
+	}
+
+	size_t start = builder.size();
+	builder.append_value<size_t>(0);
+
+	uid.serialize(builder, attachments);
+	obs_call_duration_ms.serialize(builder, attachments);
+	error.serialize(builder, attachments);
+
+	builder.append_value<uint32_t>((uint32_t)this->values.size());
+	for (ipc::value &v : values) {
+		v.serialize(builder, attachments);
+	}
+
+	builder.patch_value<size_t>(start, builder.size() - start);
+}
+
+size_t ipc::message::function_reply::deserialize(std::vector<char> &buf, size_t offset, const ipc::shared_binary_list *attachments, ipc::protocol version)
 {
+	if (version == ipc::protocol::v2) {
+		const char *data = buf.data();
+		size_t length = buf.size();
+		if (offset >= length || (uint8_t(data[offset]) & ~V2_REPLY_ERROR) != 0) {
+			throw std::runtime_error("Unknown message header");
+		}
+		uint8_t flags = uint8_t(data[offset]);
+		size_t noffset = offset + 1;
+
+		uint64_t number;
+		noffset += ipc::read_varint(data, length, noffset, number);
+		uid = ipc::value(number);
+		noffset += ipc::read_varint(data, length, noffset, number);
+		obs_call_duration_ms = ipc::value(uint32_t(std::min<uint64_t>(number, UINT32_MAX)));
+
+		error = ipc::value(std::string());
+		if (flags & V2_REPLY_ERROR) {
+			ipc::value_view text;
+			noffset += read_name(data, length, noffset, text);
+			error.value_str.assign(text.value_str.data(), text.value_str.size());
+		}
+
+		noffset += ipc::read_varint(data, length, noffset, number);
+		if (number > (length - noffset)) {
+			throw std::runtime_error("Buffer too small");
+		}
+		this->values.resize(size_t(number));
+		for (ipc::value &v : this->values) {
+			noffset += v.deserialize(buf, noffset, attachments, version);
+		}
+		return noffset - offset;
+	} else if (version != ipc::protocol::v1) {
+		throw std::runtime_error("Unknown protocol");
+	}
+
 	if ((buf.size() - offset) < sizeof(size_t)) {
 		throw std::exception((const std::exception &)"Buffer too small");
 	}
@@ -247,8 +622,52 @@ size_t ipc::message::function_reply::deserialize(std::vector<char> &buf, size_t
 	noffset += sizeof(uint32_t);
 	this->values.resize(cnt);
 	for (size_t idx = 0; idx < cnt; idx++) {
-		noffset += this->values[idx].deserialize(buf, noffset);
+		noffset += this->values[idx].deserialize(buf, noffset, attachments);
 	}
 
 	return noffset - offset;
 }
+
+void ipc::message::event::serialize(ipc::frame_builder &builder, ipc::shared_binary_list *attachments)
+{
+	builder.append_value<uint8_t>(V2_REPLY_EVENT);
+	append_name(builder, class_name.value_str);
+	append_name(builder, event_name.value_str);
+
+	builder.append_varint(values.size());
+	for (ipc::value &v : values) {
+		v.serialize(builder, attachments, ipc::protocol::v2);
+	}
+}
+
+size_t ipc::message::event::deserialize(std::vector<char> &buf, size_t offset, const ipc::shared_binary_list *attachments)
+{
+	const char *data = buf.data();
+	size_t length = buf.size();
+	if (!is_event(data, length, offset)) {
+		throw std::runtime_error("Unknown message header");
+	}
+	size_t noffset = offset + 1;
+
+	ipc::value_view name;
+	noffset += read_name(data, length, noffset, name);
+	class_name = ipc::value(std::string(name.value_str));
+	noffset += read_name(data, length, noffset, name);
+	event_name = ipc::value(std::string(name.value_str));
+
+	uint64_t number;
+	noffset += ipc::read_varint(data, length, noffset, number);
+	if (number > (length - noffset)) {
+		throw std::runtime_error("Buffer too small");
+	}
+	this->values.resize(size_t(number));
+	for (ipc::value &v : this->values) {
+		noffset += v.deserialize(buf, noffset, attachments, ipc::protocol::v2);
+	}
+	return noffset - offset;
+}
+
+bool ipc::message::event::is_event(const char *buf, size_t length, size_t offset)
+{
+	return offset < length && uint8_t(buf[offset]) == V2_REPLY_EVENT;
+}
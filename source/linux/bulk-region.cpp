@@ -0,0 +1,193 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#include "bulk-region.hpp"
+
+#include <algorithm>
+#include <errno.h>
+#include <new>
+#include <stdexcept>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BULK_REGION_MAGIC 0x4B4C5542 // 'BULK'
+#define BULK_REGION_VERSION 1
+#define BULK_REGION_PREFIX "/ipc-bulk-"
+
+static const uint64_t page_size = 4096;
+
+inline uint64_t round_up(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+inline uint64_t data_offset(uint64_t slot_count)
+{
+	return round_up(sizeof(os::linux::bulk_region::header) + slot_count * sizeof(os::linux::bulk_region::slot), page_size);
+}
+
+std::unique_ptr<os::linux::bulk_region> os::linux::bulk_region::create(size_t slot_count, size_t slot_size)
+{
+	if (slot_count == 0 || slot_count > max_slots || slot_size == 0) {
+		throw std::runtime_error("Bulk channels need between 1 and 256 slots of at least one byte.");
+	}
+
+	slot_size = size_t(round_up(slot_size, page_size));
+	size_t size = size_t(data_offset(slot_count)) + slot_count * slot_size;
+	std::string name;
+	int fd = os::linux::utility::create_shared_memory(BULK_REGION_PREFIX, size, name);
+	if (fd < 0) {
+		throw std::runtime_error(std::string("Creating shared memory failed with error ") + strerror(errno) + ".");
+	}
+
+	return std::unique_ptr<os::linux::bulk_region>(new os::linux::bulk_region(name, fd, size, true, slot_count, slot_size));
+}
+
+std::unique_ptr<os::linux::bulk_region> os::linux::bulk_region::open(const std::string &name)
+{
+	int fd = os::linux::utility::open_shared_memory(BULK_REGION_PREFIX, name);
+	struct stat st = {};
+	if (fd < 0 || fstat(fd, &st) < 0 || size_t(st.st_size) < sizeof(header)) {
+		if (fd >= 0) {
+			::close(fd);
+		}
+		throw std::runtime_error("Bulk channel handed over by the server is not usable.");
+	}
+
+	return std::unique_ptr<os::linux::bulk_region>(new os::linux::bulk_region(name, fd, size_t(st.st_size), false, 0, 0));
+}
+
+os::linux::bulk_region::bulk_region(const std::string &name, int fd, size_t size, bool owner, size_t slot_count, size_t slot_size)
+	: m_name(name), m_owner(owner), m_size(size)
+{
+	void *memory = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	int error_code = errno;
+	::close(fd);
+	if (memory == MAP_FAILED) {
+		if (m_owner) {
+			shm_unlink(m_name.c_str());
+		}
+		throw std::runtime_error(std::string("Mapping shared memory failed with error ") + strerror(error_code) + ".");
+	}
+	m_memory = static_cast<char *>(memory);
+	m_header = reinterpret_cast<header *>(m_memory);
+	m_slots = reinterpret_cast<slot *>(m_memory + sizeof(header));
+
+	if (m_owner) {
+		new (m_header) header();
+		m_header->magic = BULK_REGION_MAGIC;
+		m_header->version = BULK_REGION_VERSION;
+		m_header->slot_count = slot_count;
+		m_header->slot_size = slot_size;
+		m_header->data_offset = data_offset(slot_count);
+		m_header->head = 0;
+		m_header->tail = 0;
+		for (size_t idx = 0; idx < slot_count; idx++) {
+			new (&m_slots[idx]) slot();
+			m_slots[idx].sequence = 0;
+			m_slots[idx].size = 0;
+		}
+	}
+
+	m_slot_count = m_header->slot_count;
+	m_slot_size = m_header->slot_size;
+	m_data_offset = m_header->data_offset;
+	bool valid = m_header->magic == BULK_REGION_MAGIC && m_header->version == BULK_REGION_VERSION && m_slot_count != 0 &&
+		     m_slot_count <= max_slots && m_data_offset == data_offset(m_slot_count) && m_slot_size % page_size == 0 &&
+		     m_slot_size <= (m_size - m_data_offset) / m_slot_count;
+	if (!valid) {
+		munmap(m_memory, m_size);
+		throw std::runtime_error("Bulk channel handed over by the server has an unknown layout.");
+	}
+}
+
+os::linux::bulk_region::~bulk_region()
+{
+	munmap(m_memory, m_size);
+	if (m_owner) {
+		shm_unlink(m_name.c_str());
+	}
+}
+
+const std::string &os::linux::bulk_region::name() const
+{
+	return m_name;
+}
+
+size_t os::linux::bulk_region::slot_count() const
+{
+	return size_t(m_slot_count);
+}
+
+size_t os::linux::bulk_region::slot_size() const
+{
+	return size_t(m_slot_size);
+}
+
+bool os::linux::bulk_region::acquire(uint32_t &index, char *&data)
+{
+	// Clamped like the positions of shm_ring, a tail the consumer pushed past |head| just means full.
+	uint64_t head = m_header->head.load(std::memory_order_relaxed);
+	uint64_t tail = m_header->tail.load(std::memory_order_acquire);
+	if (tail > head || head - tail >= m_slot_count) {
+		return false;
+	}
+
+	index = uint32_t(head % m_slot_count);
+	data = m_memory + m_data_offset + index * m_slot_size;
+	return true;
+}
+
+uint64_t os::linux::bulk_region::publish(uint32_t index, size_t size)
+{
+	uint64_t head = m_header->head.load(std::memory_order_relaxed);
+	if (index != head % m_slot_count || size > m_slot_size) {
+		return 0;
+	}
+
+	// The release store is what makes the contents visible to whoever sees the sequence.
+	m_slots[index].size.store(size, std::memory_order_relaxed);
+	m_slots[index].sequence.store(head + 1, std::memory_order_release);
+	m_header->head.store(head + 1, std::memory_order_release);
+	return head + 1;
+}
+
+void os::linux::bulk_region::reset()
+{
+	m_header->tail.store(m_header->head.load(std::memory_order_relaxed), std::memory_order_release);
+}
+
+bool os::linux::bulk_region::peek(uint32_t index, uint64_t sequence, const char *&data, size_t &size)
+{
+	if (index >= m_slot_count || m_slots[index].sequence.load(std::memory_order_acquire) != sequence) {
+		return false;
+	}
+
+	data = m_memory + m_data_offset + index * m_slot_size;
+	size = size_t(std::min<uint64_t>(m_slots[index].size.load(std::memory_order_relaxed), m_slot_size));
+	return true;
+}
+
+bool os::linux::bulk_region::release(uint64_t sequence)
+{
+	// Release ordering keeps the reads of the slot ahead of the producer reusing it.
+	uint64_t tail = m_header->tail.load(std::memory_order_relaxed);
+	return sequence == tail + 1 && m_header->tail.compare_exchange_strong(tail, sequence, std::memory_order_release);
+}
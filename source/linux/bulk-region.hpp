@@ -0,0 +1,97 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#ifndef OS_LINUX_BULK_REGION_HPP
+#define OS_LINUX_BULK_REGION_HPP
+
+#include "utility.hpp"
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace os {
+namespace linux {
+/** Shared memory pool of equally sized slots, handed from one producer to one consumer in turn.
+ *
+ * The producer fills the slot at |head| in place and publishes it by
+ * advancing |head|, the consumer reads it in place and hands it back by
+ * advancing |tail|. Nothing is copied on either side, the message telling
+ * the consumer about a slot only carries its index and sequence number.
+ * Slots are page aligned so they can be handed to upload or DMA APIs as is.
+ */
+class bulk_region {
+public:
+	static constexpr size_t max_slots = 256;
+
+	struct header {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t slot_count;
+		uint64_t slot_size;
+		uint64_t data_offset;
+		alignas(64) std::atomic<uint64_t> head;
+		alignas(64) std::atomic<uint64_t> tail;
+	};
+	// Written before the slot is published, the sequence is the value of |head| that published it.
+	struct slot {
+		alignas(64) std::atomic<uint64_t> sequence;
+		std::atomic<uint64_t> size;
+	};
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "bulk channels need address-free atomics");
+
+	// Producer side, |slot_count| slots of at least |slot_size| bytes.
+	static std::unique_ptr<os::linux::bulk_region> create(size_t slot_count, size_t slot_size);
+	// Consumer side, the region the producer named.
+	static std::unique_ptr<os::linux::bulk_region> open(const std::string &name);
+	~bulk_region();
+
+	const std::string &name() const;
+	size_t slot_count() const;
+	size_t slot_size() const;
+
+	// Producer: the next slot to fill, false while every slot is published and not yet released.
+	bool acquire(uint32_t &index, char *&data);
+	// Producer: publish the acquired slot with |size| bytes filled, returns its sequence or zero if it wasn't the acquired slot.
+	uint64_t publish(uint32_t index, size_t size);
+	// Producer: take back every published slot, for a new consumer.
+	void reset();
+
+	// Consumer: where published slot |index| is and how much it holds, false if |sequence| doesn't match its contents.
+	bool peek(uint32_t index, uint64_t sequence, const char *&data, size_t &size);
+	// Consumer: hand back the oldest published slot, false if that isn't the one published as |sequence|.
+	bool release(uint64_t sequence);
+
+private:
+	std::string m_name;
+	bool m_owner = false;
+	char *m_memory = nullptr;
+	size_t m_size = 0;
+	header *m_header = nullptr;
+	slot *m_slots = nullptr;
+	// Copied at setup, the peer can scribble over the header.
+	uint64_t m_slot_count = 0;
+	uint64_t m_slot_size = 0;
+	uint64_t m_data_offset = 0;
+
+	// |slot_count| and |slot_size| lay out a region the owner created, a consumer reads them from the header.
+	bulk_region(const std::string &name, int fd, size_t size, bool owner, size_t slot_count, size_t slot_size);
+};
+}
+}
+
+#endif
@@ -0,0 +1,572 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#include "ipc-client-linux.hpp"
+#include "memfd-binary.hpp"
+#include "live-region.hpp"
+#include "bulk-region.hpp"
+#include "../include/ipc-completion.hpp"
+
+#include <condition_variable>
+#include <iterator>
+
+call_return_t g_fn = NULL;
+void *g_data = NULL;
+int64_t g_cbid = 0;
+
+static const auto freeze_timeout = std::chrono::seconds(15);
+
+std::shared_ptr<ipc::client> ipc::client::create(const std::string &socketPath, call_on_disconnect_t disconnectionCallback)
+{
+	return std::make_unique<ipc::client_linux>(socketPath, disconnectionCallback);
+}
+
+std::shared_ptr<ipc::client> ipc::client::create(std::string socketPath)
+{
+	return std::make_unique<ipc::client_linux>(socketPath);
+}
+
+std::shared_ptr<ipc::client> ipc::client::create(const std::string &socketPath, call_on_disconnect_t disconnectionCallback, transport kind)
+{
+	return std::make_unique<ipc::client_linux>(socketPath, disconnectionCallback, kind);
+}
+
+ipc::client_linux::client_linux(const std::string &socketPath, call_on_disconnect_t disconnectionCallback)
+	: m_socketPath(socketPath), m_disconnectionCallback(disconnectionCallback)
+{
+	start();
+}
+
+ipc::client_linux::client_linux(const std::string &socketPath, call_on_disconnect_t disconnectionCallback, transport kind)
+	: m_socketPath(socketPath), m_disconnectionCallback(disconnectionCallback), m_transport(kind)
+{
+	start();
+}
+
+ipc::client_linux::client_linux(std::string socketPath) : m_socketPath(socketPath)
+{
+	start();
+}
+
+ipc::client_linux::~client_linux()
+{
+	stop();
+}
+
+void ipc::client_linux::start()
+{
+	if (m_watcher.stop.exchange(false)) {
+		m_socket = os::linux::socket_linux::create(os::open_only, m_socketPath);
+		if (m_transport == transport::SharedMemory && m_socket->enable_shared_memory(os::linux::shm_channel::default_ring_size) != os::error::Success) {
+			ipc::log("Shared memory transport could not be set up, using the socket.");
+		}
+		m_watcher.worker = std::thread(std::bind(&ipc::client_linux::worker, this));
+
+		// Calls made before the answer arrives simply go out as v1 by name, every frame names its encoding.
+		// The method table is filled before v2 is published and stays untouched until the next start().
+		m_protocol = ipc::protocol::v1;
+		m_methods.clear();
+		auto negotiated = [](void *data, const std::vector<ipc::value> &rval, std::chrono::high_resolution_clock::duration) {
+			ipc::client_linux *self = static_cast<ipc::client_linux *>(data);
+			if (rval.empty() || rval[0].type != ipc::type::UInt32 || rval[0].value_union.ui32 != uint32_t(ipc::protocol::v2)) {
+				return;
+			}
+			for (size_t idx = 1; idx + 1 < rval.size(); idx += 2) {
+				if (rval[idx].type == ipc::type::String && rval[idx + 1].type == ipc::type::String) {
+					self->m_methods[rval[idx].value_str][rval[idx + 1].value_str] = uint32_t((idx + 1) / 2);
+				}
+			}
+			self->m_protocol = ipc::protocol::v2;
+		};
+		call(ipc::protocol_handshake_class, ipc::protocol_handshake_function, {ipc::value(uint32_t(ipc::protocol::v2))}, negotiated, this);
+	}
+}
+
+void ipc::client_linux::stop()
+{
+	if (!m_watcher.stop.exchange(true)) {
+		// Wakes the worker out of its blocking read.
+		m_socket->shutdown();
+		if (m_watcher.worker.joinable()) {
+			m_watcher.worker.join();
+		}
+		m_socket = nullptr;
+	}
+}
+
+bool ipc::client_linux::call(const std::string &cname, const std::string &fname, std::vector<ipc::value> args, call_return_t fn, void *data, int64_t &cbid)
+{
+	if (!m_socket)
+		return false;
+
+	// Any number of calls may be in flight, replies are matched back to their callback by uid.
+	// The callback is registered under its uid up front, and dropped again if the call doesn't go out.
+	const uint64_t uid = m_calls.insert(fn, data);
+	// The shared default would be written by every thread calling at the same time, only a caller's own is set.
+	if (fn != nullptr && &cbid != &g_cbid) {
+		cbid = int64_t(uid);
+	}
+
+	bool sent = false;
+	try {
+		sent = send_call(cname, fname, std::move(args), uid, false);
+	} catch (std::exception &e) {
+		ipc::log("(write) %8llu: Failed to send, error %s.", (unsigned long long)uid, e.what());
+	}
+	if (!sent) {
+		m_calls.cancel(uid);
+	}
+	return sent;
+}
+
+bool ipc::client_linux::call_one_way(const std::string &cname, const std::string &fname, std::vector<ipc::value> args)
+{
+	if (!m_socket)
+		return false;
+
+	// Uid 0 is never handed out, so should a v1 server answer anyway the reply matches nothing.
+	return send_call(cname, fname, std::move(args), 0, true);
+}
+
+namespace ipc {
+class live_value_linux : public ipc::live_value {
+	std::unique_ptr<os::linux::live_region> m_region;
+	size_t m_reader;
+
+public:
+	live_value_linux(std::unique_ptr<os::linux::live_region> region, size_t reader) : m_region(std::move(region)), m_reader(reader) {}
+
+	~live_value_linux()
+	{
+		// The slot stays the client's until it disconnects, it just stops asking for notifications.
+		m_region->arm(m_reader, false);
+	}
+
+	virtual bool read(std::vector<ipc::value> &values) override
+	{
+		static thread_local std::vector<char> buffer;
+		size_t length = 0;
+		if (m_region->load(buffer, length) == 0) {
+			return false;
+		}
+
+		try {
+			buffer.resize(length);
+			ipc::message::event msg;
+			msg.deserialize(buffer, sizeof(ipc::ipc_size_t));
+			values = std::move(msg.values);
+		} catch (std::exception &e) {
+			ipc::log("Live value could not be read: %s", e.what());
+			return false;
+		}
+		return true;
+	}
+
+	virtual uint64_t version() override { return m_region->sequence() / 2; }
+
+	// Ask for a notification of the next change.
+	void arm() { m_region->arm(m_reader, true); }
+};
+
+class bulk_reader_linux : public ipc::bulk_reader {
+	// Held while buffers are handed to the handler, which keeps them in order.
+	std::mutex m_dispatch_mtx;
+	std::unique_ptr<os::linux::bulk_region> m_region;
+	// Announced before the server's answer to opening arrived.
+	std::vector<std::pair<uint32_t, uint64_t>> m_early;
+	ipc::client::bulk_handler_t m_handler;
+
+	void deliver(uint32_t slot, uint64_t sequence)
+	{
+		ipc::bulk_buffer buffer;
+		const char *data = nullptr;
+		// Left over from before a reset, or not for this reader at all.
+		if (!m_region->peek(slot, sequence, data, buffer.size)) {
+			return;
+		}
+		buffer.slot = slot;
+		buffer.sequence = sequence;
+		buffer.data = const_cast<char *>(data);
+		m_handler(*this, buffer);
+	}
+
+public:
+	bulk_reader_linux(ipc::client::bulk_handler_t handler) : m_handler(std::move(handler)) {}
+
+	void attach(std::unique_ptr<os::linux::bulk_region> region)
+	{
+		std::unique_lock<std::mutex> ul(m_dispatch_mtx);
+		m_region = std::move(region);
+		for (auto &entry : m_early) {
+			deliver(entry.first, entry.second);
+		}
+		m_early.clear();
+	}
+
+	void announce(const std::vector<ipc::value> &values)
+	{
+		if (values.size() != 2 || values[0].type != ipc::type::UInt32 || values[1].type != ipc::type::UInt64) {
+			return;
+		}
+		std::unique_lock<std::mutex> ul(m_dispatch_mtx);
+		if (!m_region) {
+			m_early.emplace_back(values[0].value_union.ui32, values[1].value_union.ui64);
+			return;
+		}
+		deliver(values[0].value_union.ui32, values[1].value_union.ui64);
+	}
+
+	virtual bool release(const ipc::bulk_buffer &buffer) override { return m_region->release(buffer.sequence); }
+};
+}
+
+std::shared_ptr<ipc::live_value> ipc::client_linux::open_live_value(const std::string &key, event_handler_t on_change)
+{
+	if (!m_socket)
+		return nullptr;
+
+	// Called from a reply or event handler the answer can never arrive, like a server that hangs.
+	ipc::call_future reply = call_async(ipc::live_class, ipc::live_open, {ipc::value(key)});
+	if (!reply.wait_for(freeze_timeout)) {
+		ipc::log("Opening live value %s timed out.", key.c_str());
+		return nullptr;
+	}
+	auto rval = reply.get();
+	if (rval.size() != 2 || rval[0].type != ipc::type::String || rval[1].type != ipc::type::UInt32) {
+		ipc::log("Opening live value %s failed: %s", key.c_str(),
+			 rval.size() == 1 && rval[0].type == ipc::type::Null ? std::string(rval[0].value_str).c_str() : "unexpected reply");
+		return nullptr;
+	}
+
+	std::shared_ptr<ipc::live_value_linux> live;
+	try {
+		live = std::make_shared<ipc::live_value_linux>(os::linux::live_region::open(rval[0].value_str), size_t(rval[1].value_union.ui32));
+	} catch (std::exception &e) {
+		ipc::log("Opening live value %s failed: %s", key.c_str(), e.what());
+		return nullptr;
+	}
+
+	if (on_change) {
+		// Re-armed before reading, a change while the handler runs is announced again rather than lost.
+		std::weak_ptr<ipc::live_value_linux> weak = live;
+		auto handler = [weak, on_change](const std::vector<ipc::value> &) {
+			std::vector<ipc::value> values;
+			if (auto live = weak.lock()) {
+				live->arm();
+				if (live->read(values)) {
+					on_change(values);
+				}
+			}
+		};
+		{
+			std::unique_lock<std::mutex> ul(m_events_mtx);
+			m_events[ipc::live_class][key] = std::move(handler);
+		}
+		live->arm();
+	}
+	return live;
+}
+
+std::shared_ptr<ipc::bulk_reader> ipc::client_linux::open_bulk_channel(const std::string &key, bulk_handler_t handler)
+{
+	if (!m_socket)
+		return nullptr;
+
+	// In place before the server knows, it may publish before its answer to opening went out.
+	auto reader = std::make_shared<ipc::bulk_reader_linux>(std::move(handler));
+	std::weak_ptr<ipc::bulk_reader_linux> weak = reader;
+	{
+		std::unique_lock<std::mutex> ul(m_events_mtx);
+		m_events[ipc::bulk_class][key] = [weak](const std::vector<ipc::value> &values) {
+			if (auto reader = weak.lock()) {
+				reader->announce(values);
+			}
+		};
+	}
+
+	ipc::call_future reply = call_async(ipc::bulk_class, ipc::bulk_open, {ipc::value(key)});
+	try {
+		if (!reply.wait_for(freeze_timeout)) {
+			throw std::runtime_error("timed out");
+		}
+		auto rval = reply.get();
+		if (rval.size() != 1 || rval[0].type != ipc::type::String) {
+			throw std::runtime_error(rval.size() == 1 && rval[0].type == ipc::type::Null ? std::string(rval[0].value_str) : "unexpected reply");
+		}
+		reader->attach(os::linux::bulk_region::open(rval[0].value_str));
+	} catch (std::exception &e) {
+		ipc::log("Opening bulk channel %s failed: %s", key.c_str(), e.what());
+		std::unique_lock<std::mutex> ul(m_events_mtx);
+		m_events[ipc::bulk_class].erase(key);
+		return nullptr;
+	}
+	return reader;
+}
+
+bool ipc::client_linux::send_call(const std::string &cname, const std::string &fname, std::vector<ipc::value> args, uint64_t uid, bool one_way)
+{
+	ipc::message::function_call fnc_call_msg;
+	fnc_call_msg.uid = ipc::value(uid);
+
+	// Set, v2 calls to a method the server listed at connect go out by ID.
+	ipc::protocol version = m_protocol;
+	if (version == ipc::protocol::v2) {
+		fnc_call_msg.method_id = find_method(cname, fname);
+		fnc_call_msg.one_way = one_way;
+	}
+	if (fnc_call_msg.method_id == 0) {
+		fnc_call_msg.class_name = ipc::value(cname);
+		fnc_call_msg.function_name = ipc::value(fname);
+	}
+	fnc_call_msg.arguments = std::move(args);
+	os::linux::memfd_binary::prepare(fnc_call_msg.arguments, m_shared_binary_threshold, os::linux::socket_linux::max_descriptors,
+					 !m_socket->is_shared_memory());
+
+	// Serialize, each calling thread reuses its own frame.
+	static thread_local ipc::frame_builder builder;
+	ipc::shared_binary_list attachments;
+	builder.reset();
+	builder.set_reference_threshold(os::linux::socket_linux::reference_threshold);
+	try {
+		fnc_call_msg.serialize(builder, &attachments, version);
+	} catch (std::exception &e) {
+		ipc::log("(write) %8llu: Failed to serialize, error %s.", fnc_call_msg.uid.value_union.ui64, e.what());
+		return false;
+	}
+
+	std::vector<int> descriptors;
+	for (auto &attachment : attachments) {
+		descriptors.push_back(attachment->get_handle());
+	}
+
+	builder.finish(version);
+	return m_socket->write(builder, descriptors) == os::error::Success;
+}
+
+bool ipc::client_linux::call_batch(std::vector<call_spec> calls)
+{
+	// Only v2 frames may hold more than one message.
+	ipc::protocol version = m_protocol;
+	if (version != ipc::protocol::v2 || calls.size() < 2) {
+		return ipc::client::call_batch(std::move(calls));
+	}
+	if (!m_socket)
+		return false;
+
+	// Attachments are numbered across the frame, so the descriptor budget is shared by all entries.
+	static thread_local ipc::frame_builder builder;
+	std::vector<uint64_t> uids;
+	uids.reserve(calls.size());
+	ipc::shared_binary_list attachments;
+	size_t budget = os::linux::socket_linux::max_descriptors;
+	builder.reset();
+	try {
+		ipc::message::function_call fnc_call_msg;
+		for (call_spec &spec : calls) {
+			if (spec.fn) {
+				uids.push_back(m_calls.insert(spec.fn, spec.data));
+			}
+			fnc_call_msg.uid = ipc::value(spec.fn ? uids.back() : 0);
+			fnc_call_msg.one_way = spec.fn == nullptr;
+			fnc_call_msg.method_id = find_method(spec.class_name, spec.function_name);
+			if (fnc_call_msg.method_id == 0) {
+				fnc_call_msg.class_name = ipc::value(spec.class_name);
+				fnc_call_msg.function_name = ipc::value(spec.function_name);
+			}
+			fnc_call_msg.arguments = std::move(spec.arguments);
+			budget -= os::linux::memfd_binary::prepare(fnc_call_msg.arguments, m_shared_binary_threshold, budget, !m_socket->is_shared_memory());
+			fnc_call_msg.serialize(builder, &attachments, version);
+		}
+	} catch (std::exception &e) {
+		ipc::log("(write) Failed to serialize a batch of %llu calls, error %s.", (unsigned long long)calls.size(), e.what());
+		for (uint64_t uid : uids) {
+			m_calls.cancel(uid);
+		}
+		return false;
+	}
+
+	std::vector<int> descriptors;
+	for (auto &attachment : attachments) {
+		descriptors.push_back(attachment->get_handle());
+	}
+
+	builder.finish(version);
+	if (m_socket->write(builder.data(), builder.size(), descriptors) != os::error::Success) {
+		for (uint64_t uid : uids) {
+			m_calls.cancel(uid);
+		}
+		return false;
+	}
+	return true;
+}
+
+uint32_t ipc::client_linux::find_method(std::string_view cname, std::string_view fname)
+{
+	auto cls = m_methods.find(cname);
+	if (cls == m_methods.end()) {
+		return 0;
+	}
+	auto fnc = cls->second.find(fname);
+	return fnc != cls->second.end() ? fnc->second : 0;
+}
+
+std::vector<ipc::value> ipc::client_linux::call_synchronous_helper(const std::string &cname, const std::string &fname, const std::vector<ipc::value> &args)
+{
+	// Set up call reference data.
+	struct CallData {
+		ipc::completion::lease done;
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+		std::vector<ipc::value> values;
+		std::chrono::high_resolution_clock::duration obs_call_duration = std::chrono::milliseconds(-2);
+	} cd;
+
+	auto cb = [](void *data, const std::vector<ipc::value> &rval, std::chrono::high_resolution_clock::duration obs_call_duration) {
+		CallData &cd = *static_cast<CallData *>(data);
+
+		// This copies the data off of the reply thread to the main thread.
+		cd.values.reserve(rval.size());
+		std::copy(rval.begin(), rval.end(), std::back_inserter(cd.values));
+
+		cd.obs_call_duration = obs_call_duration;
+		cd.done->signal();
+	};
+
+	int64_t cbid = 0;
+	bool success = call(cname, fname, std::move(args), cb, &cd, cbid);
+	if (!success) {
+		return {};
+	}
+
+	static const auto long_call_timeout = std::chrono::milliseconds(100);
+	bool long_call_flagged = false;
+	bool freeze_flagged = false;
+	while (!cd.done->wait_for(long_call_timeout)) {
+		long_call_flagged = true;
+
+		// Logging of probable freeze
+		const auto total_time = (std::chrono::high_resolution_clock::now() - cd.start);
+		if (!freeze_flagged && total_time > freeze_timeout) {
+			freeze_flagged = true;
+			if (m_freeze_cb)
+				m_freeze_cb(m_app_state_path, cname + "::" + fname, std::chrono::duration_cast<std::chrono::milliseconds>(total_time).count(), -1);
+		}
+	}
+
+	if (long_call_flagged) {
+		const int total_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - cd.start).count();
+		const int obs_time = std::chrono::duration_cast<std::chrono::milliseconds>(cd.obs_call_duration).count();
+		if (m_freeze_cb)
+			m_freeze_cb(m_app_state_path, cname + "::" + fname, total_time, obs_time);
+	}
+
+	return std::move(cd.values);
+}
+
+void ipc::client::set_freeze_callback(call_on_freeze_t cb, std::string app_state)
+{
+	m_freeze_cb = cb;
+	m_app_state_path = app_state;
+}
+
+void ipc::client::set_shared_binary_threshold(size_t bytes)
+{
+	m_shared_binary_threshold = bytes;
+}
+
+void ipc::client_linux::worker()
+{
+	os::error ec = os::error::Success;
+	std::vector<ipc::value> proc_rval;
+
+	while (m_socket->is_connected() && !m_watcher.stop) {
+		size_t length = 0;
+		ec = m_socket->read(m_watcher.buf, length, true);
+		if (ec != os::error::Success) {
+			break;
+		}
+		read_callback_msg(length);
+	}
+
+	// Call any remaining callbacks.
+	proc_rval.resize(1);
+	proc_rval[0].type = ipc::type::Null;
+	proc_rval[0].value_str = "Lost IPC Connection";
+
+	for (auto &cb : m_calls.drain()) {
+		cb.first(cb.second, proc_rval, std::chrono::milliseconds(0));
+	}
+
+	if (!m_watcher.stop && !m_socket->is_connected()) {
+		if (m_disconnectionCallback) {
+			m_disconnectionCallback();
+		}
+	}
+}
+
+void ipc::client_linux::read_callback_msg(size_t size)
+{
+	std::pair<call_return_t, void *> cb;
+	ipc::message::function_reply fnc_reply_msg;
+
+	// A v2 frame answering a batch holds one reply per call, and events published by the server travel in v2 frames too.
+	ipc::protocol version = ipc::read_protocol(m_watcher.buf.data());
+	ipc::shared_binary_list attachments = os::linux::memfd_binary::adopt(m_socket->take_descriptors());
+	size_t offset = sizeof(ipc_size_t);
+	do {
+		ipc::message::event event_msg;
+		bool is_event = version == ipc::protocol::v2 && ipc::message::event::is_event(m_watcher.buf.data(), size, offset);
+		try {
+			if (is_event) {
+				offset += event_msg.deserialize(m_watcher.buf, offset, &attachments);
+			} else {
+				offset += fnc_reply_msg.deserialize(m_watcher.buf, offset, &attachments, version);
+			}
+		} catch (std::exception &e) {
+			// Nothing after this in the stream can be trusted. Disconnecting fails every call still waiting.
+			ipc::log("Deserialize failed with error %s.", e.what());
+			m_socket->shutdown();
+			return;
+		}
+
+		if (is_event) {
+			dispatch_event(event_msg.class_name.value_str, event_msg.event_name.value_str, event_msg.values);
+			continue;
+		}
+
+		// Find the callback function. Nothing is locked while it runs, so it may take its time or make another call.
+		if (!m_calls.take(fnc_reply_msg.uid.value_union.ui64, cb)) {
+			continue;
+		}
+
+		// Decode return values or errors.
+		if (fnc_reply_msg.error.value_str.size() > 0) {
+			fnc_reply_msg.values.resize(1);
+			fnc_reply_msg.values.at(0).type = ipc::type::Null;
+			fnc_reply_msg.values.at(0).value_str = fnc_reply_msg.error.value_str;
+		}
+
+		// Call Callback
+		cb.first(cb.second, fnc_reply_msg.values, std::chrono::milliseconds(fnc_reply_msg.obs_call_duration_ms.value_union.ui32));
+	} while (version == ipc::protocol::v2 && offset < size);
+}
+
+bool ipc::client_linux::cancel(int64_t const &id)
+{
+	return m_calls.cancel(uint64_t(id));
+}
@@ -0,0 +1,82 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+#include "../include/ipc-client.hpp"
+#include "../include/ipc-call-table.hpp"
+#include "../include/error.hpp"
+#include "ipc-socket-linux.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <string_view>
+#include <thread>
+
+namespace ipc {
+class client_linux : public ipc::client {
+public:
+	client_linux(const std::string &socketPath, call_on_disconnect_t disconnectionCallback);
+	client_linux(std::string socketPath);
+	client_linux(const std::string &socketPath, call_on_disconnect_t disconnectionCallback, transport kind);
+	~client_linux();
+
+public:
+	void start();
+	void stop() override;
+
+	virtual bool call(const std::string &cname, const std::string &fname, std::vector<ipc::value> args, call_return_t fn = g_fn, void *data = g_data,
+			  int64_t &cbid = g_cbid) override;
+
+	virtual std::vector<ipc::value> call_synchronous_helper(const std::string &cname, const std::string &fname,
+								const std::vector<ipc::value> &args) override;
+
+	virtual bool call_batch(std::vector<call_spec> calls) override;
+
+	virtual bool call_one_way(const std::string &cname, const std::string &fname, std::vector<ipc::value> args) override;
+
+	virtual std::shared_ptr<ipc::live_value> open_live_value(const std::string &key, event_handler_t on_change = nullptr) override;
+
+	virtual std::shared_ptr<ipc::bulk_reader> open_bulk_channel(const std::string &key, bulk_handler_t handler) override;
+
+private:
+	std::string m_socketPath;
+	call_on_disconnect_t m_disconnectionCallback;
+	transport m_transport = transport::Default;
+	std::unique_ptr<os::linux::socket_linux> m_socket;
+	// Encoding of outgoing calls, v1 until the server acknowledges v2.
+	std::atomic<ipc::protocol> m_protocol = ipc::protocol::v1;
+	// Method IDs by class and function name, as listed by the server when it acknowledged v2.
+	std::map<std::string, std::map<std::string, uint32_t, std::less<>>, std::less<>> m_methods;
+
+	ipc::call_table m_calls;
+
+	// Threading
+	struct {
+		std::thread worker;
+		std::atomic_bool stop = true;
+		std::vector<char> buf;
+	} m_watcher;
+
+	void worker();
+	void read_callback_msg(size_t size);
+	bool send_call(const std::string &cname, const std::string &fname, std::vector<ipc::value> args, uint64_t uid, bool one_way);
+	uint32_t find_method(std::string_view cname, std::string_view fname);
+	bool cancel(int64_t const &id);
+};
+}
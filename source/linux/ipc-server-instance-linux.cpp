@@ -0,0 +1,599 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#include "ipc-server-instance-linux.hpp"
+#include "memfd-binary.hpp"
+#include "../include/ipc-server.hpp"
+
+// Finished serial calls kept for reuse, see run_serial().
+static const size_t serial_spares = 4;
+// Events queued for a client that isn't reading before it is dropped.
+static const size_t event_backlog_limit = 8 * 1024 * 1024;
+
+std::shared_ptr<ipc::server_instance> ipc::server_instance::create(server *owner, std::shared_ptr<ipc::socket> socket, int call_timeout)
+{
+	auto instance = std::make_shared<ipc::server_instance_linux>(owner, socket, call_timeout);
+	instance->start();
+	return instance;
+}
+
+ipc::server_instance_linux::server_instance_linux(server *owner, std::shared_ptr<ipc::socket> socket, int call_timeout)
+{
+	m_parent = owner;
+	m_clientId = 0;
+	m_socket = std::dynamic_pointer_cast<os::linux::socket_linux>(socket);
+	if (call_timeout > 0) {
+		m_socket->set_send_timeout(std::chrono::seconds(call_timeout));
+	}
+}
+
+ipc::server_instance_linux::~server_instance_linux()
+{
+	m_socket->get_reactor()->remove(m_socket->get_handle());
+	if (m_shm_worker.joinable()) {
+		m_socket->shutdown();
+		m_shm_worker.join();
+	}
+}
+
+void ipc::server_instance_linux::stop()
+{
+	m_socket->shutdown();
+	m_socket->get_reactor()->remove(m_socket->get_handle());
+	if (m_shm_worker.joinable()) {
+		m_shm_worker.join();
+	}
+}
+
+void ipc::server_instance_linux::start()
+{
+	// The reactor only keeps a weak reference, the server owns the instance.
+	std::weak_ptr<ipc::server_instance_linux> self = shared_from_this();
+	os::error ec = m_socket->get_reactor()->add(m_socket->get_handle(), EPOLLIN | EPOLLRDHUP, [self](uint32_t events) {
+		if (auto instance = self.lock()) {
+			instance->handle_events(events);
+		}
+	});
+	if (ec != os::error::Success) {
+		m_socket->set_connected(false);
+		m_parent->client_disconnected(m_socket);
+	}
+}
+
+void ipc::server_instance_linux::handle_events(uint32_t events)
+{
+	if ((events & EPOLLIN) && !m_shm_worker.joinable()) {
+		// Drain everything that is queued, each packet carries one frame.
+		while (m_socket->is_connected()) {
+			size_t length = 0;
+			os::error ec = m_socket->read(m_rbuf, length, false);
+			if (ec == os::error::Success) {
+				read_callback_msg(length, false);
+			} else if (ec != os::error::Pending) {
+				disconnect();
+				return;
+			}
+
+			if (m_socket->is_shared_memory()) {
+				// The client switched to shared memory rings, which are served from their own thread.
+				m_shm_worker = std::thread(std::bind(&ipc::server_instance_linux::shm_worker, this));
+				break;
+			} else if (ec == os::error::Pending) {
+				break;
+			}
+		}
+	}
+
+	if (events & (EPOLLHUP | EPOLLRDHUP | EPOLLERR)) {
+		disconnect();
+	}
+}
+
+void ipc::server_instance_linux::shm_worker()
+{
+	while (m_socket->is_connected()) {
+		size_t length = 0;
+		if (m_socket->read(m_rbuf, length, true) != os::error::Success) {
+			disconnect();
+			break;
+		}
+		read_callback_msg(length, true);
+	}
+}
+
+void ipc::server_instance_linux::read_callback_msg(size_t size, bool own_thread)
+{
+	// Arguments are decoded as views into m_rbuf, and both messages keep their
+	// storage between calls, so a handler that only reads costs no allocations.
+	// Replies go out in the revision of the request, so v1 clients never see v2.
+	ipc::protocol version = ipc::read_protocol(m_rbuf.data());
+	ipc::shared_binary_list attachments = os::linux::memfd_binary::adopt(m_socket->take_descriptors());
+	size_t used = 0;
+	try {
+		used = m_call.deserialize(m_rbuf.data() + sizeof(ipc_size_t), size - sizeof(ipc_size_t), &attachments, version);
+	} catch (std::exception &e) {
+		ipc::log("????????: Deserialization of Function Call message failed with error %s.", e.what());
+		disconnect();
+		return;
+	}
+
+	// A v2 frame with more than one call is a batch, answered by a single frame.
+	if (version == ipc::protocol::v2 && used < size - sizeof(ipc_size_t)) {
+		read_batch(size, attachments);
+		return;
+	}
+
+	// The reserved classes are handled without a function, serially.
+	ipc::function *fnc = nullptr;
+	if (m_call.method_id != 0 || !ipc::is_reserved_class(m_call.class_name.value_str)) {
+		std::string errormsg;
+		fnc = m_parent->resolve_function(m_call.method_id, m_call.class_name.value_str, m_call.function_name.value_str, errormsg);
+	}
+
+	// Calls that don't resolve fail right away and count as serial.
+	ipc::execution policy = fnc ? fnc->get_execution() : ipc::execution::serial;
+	bool asynchronous = fnc && fnc->is_asynchronous();
+	if (policy == ipc::execution::serial) {
+		queue_call(version, asynchronous, own_thread);
+		return;
+	}
+
+	// The call takes the frame its views point into along, the next frame is read into fresh storage.
+	auto pending = std::make_shared<pending_call>();
+	pending->frame.swap(m_rbuf);
+	std::swap(pending->call, m_call);
+	pending->version = version;
+
+	// Only the task holds on to the instance, so this thread never ends up destroying it.
+	m_parent->post(policy, [self = shared_from_this(), pending, asynchronous]() {
+		if (asynchronous) {
+			self->start_async(pending);
+			return;
+		}
+		static thread_local ipc::frame_builder frame;
+		ipc::message::function_reply reply;
+		self->execute(pending->call, pending->version, reply, frame);
+	});
+}
+
+void ipc::server_instance_linux::queue_call(ipc::protocol version, bool asynchronous, bool own_thread)
+{
+	std::shared_ptr<pending_call> pending;
+	{
+		std::unique_lock<std::mutex> ul(m_serial_mtx);
+		if (own_thread && !asynchronous && !m_serial_running) {
+			// Nothing is ahead of it and the connection has a thread of its own, no need to hand it over.
+			ul.unlock();
+			execute(m_call, version, m_reply, m_wframe);
+			return;
+		}
+		if (!m_serial_spare.empty()) {
+			pending = std::move(m_serial_spare.back());
+			m_serial_spare.pop_back();
+		}
+	}
+	if (!pending) {
+		pending = std::make_shared<pending_call>();
+	}
+
+	// Like any call handed elsewhere it takes its frame along, m_rbuf gets the storage of an earlier one back.
+	pending->frame.swap(m_rbuf);
+	std::swap(pending->call, m_call);
+	pending->version = version;
+	queue_serial({pending, nullptr, 0, asynchronous});
+}
+
+void ipc::server_instance_linux::queue_serial(serial_call task)
+{
+	std::unique_lock<std::mutex> ul(m_serial_mtx);
+	m_serial_queue.push_back(std::move(task));
+	if (m_serial_running) {
+		return;
+	}
+
+	// Capturing only the pointer lets the task be stored without an allocation. The lock keeps
+	// run_serial() from starting before |m_serial_self| is set.
+	if (!m_parent->post(ipc::execution::concurrent, [this]() { run_serial(); })) {
+		// The server is shutting down, the calls go unanswered along with their connection.
+		m_serial_queue.clear();
+		m_serial_head = 0;
+		return;
+	}
+	m_serial_running = true;
+	m_serial_self = shared_from_this();
+}
+
+void ipc::server_instance_linux::run_serial()
+{
+	std::unique_lock<std::mutex> ul(m_serial_mtx);
+	std::shared_ptr<server_instance_linux> self = std::move(m_serial_self);
+	while (m_serial_head < m_serial_queue.size()) {
+		serial_call task = std::move(m_serial_queue[m_serial_head++]);
+		ul.unlock();
+		if (task.batch) {
+			run_batch_call(task.batch, task.index, task.asynchronous);
+		} else if (task.asynchronous) {
+			start_async(task.single);
+		} else {
+			execute(task.single->call, task.single->version, m_reply, m_wframe);
+		}
+		task.batch = nullptr;
+		ul.lock();
+
+		// A few are enough to cover a client that keeps calls in flight, without pinning every frame it ever sent.
+		if (task.single && !task.asynchronous && m_serial_spare.size() < serial_spares) {
+			m_serial_spare.push_back(std::move(task.single));
+		}
+	}
+	m_serial_queue.clear();
+	m_serial_head = 0;
+	m_serial_running = false;
+
+	// Dropping |self| may destroy the instance, the lock has to go first.
+	ul.unlock();
+}
+
+void ipc::server_instance_linux::read_batch(size_t size, const ipc::shared_binary_list &attachments)
+{
+	// The batch takes the frame its views point into along, like a single call handed elsewhere.
+	auto batch = std::make_shared<pending_batch>();
+	batch->frame.swap(m_rbuf);
+	batch->version = ipc::protocol::v2;
+	const char *body = batch->frame.data() + sizeof(ipc_size_t);
+	size_t length = size - sizeof(ipc_size_t);
+	try {
+		for (size_t offset = 0; offset < length;) {
+			batch->calls.emplace_back();
+			offset += batch->calls.back().deserialize(body + offset, length - offset, &attachments, batch->version);
+		}
+	} catch (std::exception &e) {
+		ipc::log("????????: Deserialization of a batch of Function Call messages failed with error %s.", e.what());
+		disconnect();
+		return;
+	}
+
+	// Each call runs as it would on its own: serial ones in order behind the connection's earlier serial calls, the others on the executor.
+	// The extra count keeps the reply from going out while calls are still being started.
+	batch->replies.resize(batch->calls.size());
+	batch->remaining = batch->calls.size() + 1;
+	for (size_t index = 0; index < batch->calls.size(); index++) {
+		ipc::message::function_call_view &call = batch->calls[index];
+		ipc::function *fnc = nullptr;
+		if (call.method_id != 0 || !ipc::is_reserved_class(call.class_name.value_str)) {
+			std::string errormsg;
+			fnc = m_parent->resolve_function(call.method_id, call.class_name.value_str, call.function_name.value_str, errormsg);
+		}
+
+		ipc::execution policy = fnc ? fnc->get_execution() : ipc::execution::serial;
+		bool asynchronous = fnc && fnc->is_asynchronous();
+		if (policy == ipc::execution::serial) {
+			queue_serial({nullptr, batch, index, asynchronous});
+		} else {
+			m_parent->post(policy, [self = shared_from_this(), batch, index, asynchronous]() { self->run_batch_call(batch, index, asynchronous); });
+		}
+	}
+	release_batch(batch);
+}
+
+void ipc::server_instance_linux::run_batch_call(const std::shared_ptr<pending_batch> &batch, size_t index, bool asynchronous)
+{
+	ipc::message::function_call_view &call = batch->calls[index];
+	if (asynchronous) {
+		auto done = [self = shared_from_this(), batch, index](bool success, std::vector<ipc::value> &rval, const std::string &errormsg,
+								      std::chrono::high_resolution_clock::duration call_duration) {
+			batch->replies[index].values = std::move(rval);
+			self->finish_batch_call(batch, index, success, errormsg, call_duration);
+		};
+		m_parent->client_call_function_async(m_clientId, call.method_id, call.class_name.value_str, call.function_name.value_str, call.arguments,
+						     done);
+		return;
+	}
+	std::string errormsg;
+	std::chrono::high_resolution_clock::duration call_duration = {};
+	bool success = invoke(call, batch->replies[index].values, errormsg, call_duration);
+	finish_batch_call(batch, index, success, errormsg, call_duration);
+}
+
+void ipc::server_instance_linux::finish_batch_call(const std::shared_ptr<pending_batch> &batch, size_t index, bool success,
+						   const std::string &errormsg, std::chrono::high_resolution_clock::duration call_duration)
+{
+	fill_reply(batch->calls[index], success, errormsg, call_duration, batch->replies[index]);
+	release_batch(batch);
+}
+
+void ipc::server_instance_linux::release_batch(const std::shared_ptr<pending_batch> &batch)
+{
+	if (--batch->remaining != 0) {
+		return;
+	}
+
+	// Attachments are numbered across the frame, so the descriptor budget is shared by all replies.
+	static thread_local ipc::frame_builder frame;
+	ipc::shared_binary_list attachments;
+	size_t budget = os::linux::socket_linux::max_descriptors;
+	size_t count = 0;
+	frame.reset();
+	frame.set_reference_threshold(os::linux::socket_linux::reference_threshold);
+	try {
+		for (size_t index = 0; index < batch->replies.size(); index++) {
+			ipc::message::function_reply &reply = batch->replies[index];
+			if (batch->calls[index].one_way) {
+				continue;
+			}
+			count++;
+			budget -= os::linux::memfd_binary::prepare(reply.values, m_parent->get_shared_binary_threshold(), budget,
+								   !m_socket->is_shared_memory());
+			reply.serialize(frame, &attachments, batch->version);
+		}
+	} catch (std::exception &e) {
+		ipc::log("????????: Serialization of a batch of Function Reply messages failed with error %s.", e.what());
+		return;
+	}
+	if (count == 0) {
+		return;
+	}
+
+	std::vector<int> descriptors;
+	for (auto &attachment : attachments) {
+		descriptors.push_back(attachment->get_handle());
+	}
+
+	frame.finish(batch->version);
+	if (m_socket->write(frame, descriptors) != os::error::Success) {
+		disconnect();
+	}
+}
+
+void ipc::server_instance_linux::start_async(std::shared_ptr<pending_call> pending)
+{
+	// The reply goes out from whichever thread completes the call.
+	auto done = [self = shared_from_this(), pending](bool success, std::vector<ipc::value> &rval, const std::string &errormsg,
+							  std::chrono::high_resolution_clock::duration call_duration) {
+		static thread_local ipc::frame_builder frame;
+		ipc::message::function_reply reply;
+		reply.values = std::move(rval);
+		self->send_reply(pending->call, pending->version, success, errormsg, call_duration, reply, frame);
+	};
+
+	ipc::message::function_call_view &call = pending->call;
+	m_parent->client_call_function_async(m_clientId, call.method_id, call.class_name.value_str, call.function_name.value_str, call.arguments, done);
+}
+
+bool ipc::server_instance_linux::invoke(ipc::message::function_call_view &call, std::vector<ipc::value> &rval, std::string &errormsg,
+					std::chrono::high_resolution_clock::duration &call_duration)
+{
+	rval.clear();
+	if (call.method_id != 0) {
+		return m_parent->client_call_function(m_clientId, call.method_id, call.arguments, rval, errormsg, call_duration);
+	} else if (call.class_name.value_str == ipc::protocol_handshake_class) {
+		return negotiate_protocol(call, rval, errormsg);
+	} else if (call.class_name.value_str == ipc::event_class) {
+		return change_subscription(call, errormsg);
+	} else if (call.class_name.value_str == ipc::live_class || call.class_name.value_str == ipc::bulk_class) {
+		return open_shared_memory(call, rval, errormsg);
+	}
+	return m_parent->client_call_function(m_clientId, call.class_name.value_str, call.function_name.value_str, call.arguments, rval, errormsg,
+					      call_duration);
+}
+
+void ipc::server_instance_linux::execute(ipc::message::function_call_view &call, ipc::protocol version, ipc::message::function_reply &reply,
+					 ipc::frame_builder &frame)
+{
+	std::string proc_error;
+	std::chrono::high_resolution_clock::duration call_duration = {};
+	bool success = invoke(call, reply.values, proc_error, call_duration);
+	send_reply(call, version, success, proc_error, call_duration, reply, frame);
+}
+
+void ipc::server_instance_linux::fill_reply(ipc::message::function_call_view &call, bool success, const std::string &errormsg,
+					    std::chrono::high_resolution_clock::duration call_duration, ipc::message::function_reply &reply)
+{
+	// Set, the uid lets the client match replies that overtook each other.
+	reply.uid = call.uid.to_value();
+	reply.obs_call_duration_ms = uint32_t(std::chrono::duration_cast<std::chrono::milliseconds>(call_duration).count());
+	reply.error.value_str.clear();
+	if (!success) {
+		reply.error = ipc::value(errormsg);
+	}
+}
+
+void ipc::server_instance_linux::send_reply(ipc::message::function_call_view &call, ipc::protocol version, bool success, const std::string &errormsg,
+					    std::chrono::high_resolution_clock::duration call_duration, ipc::message::function_reply &reply,
+					    ipc::frame_builder &frame)
+{
+	if (call.one_way) {
+		// Nobody waits for it, not even for an error.
+		reply.values.clear();
+		for (ipc::value_view &arg : call.arguments) {
+			arg.value_shared = nullptr;
+		}
+		return;
+	}
+	fill_reply(call, success, errormsg, call_duration, reply);
+
+	os::linux::memfd_binary::prepare(reply.values, m_parent->get_shared_binary_threshold(), os::linux::socket_linux::max_descriptors,
+					 !m_socket->is_shared_memory());
+
+	// Serialize
+	ipc::shared_binary_list attachments;
+	frame.reset();
+	frame.set_reference_threshold(os::linux::socket_linux::reference_threshold);
+	try {
+		reply.serialize(frame, &attachments, version);
+	} catch (std::exception &e) {
+		ipc::log("%8llu: Serialization of Function Reply message failed with error %s.", reply.uid.value_union.ui64, e.what());
+		return;
+	}
+
+	std::vector<int> descriptors;
+	for (auto &attachment : attachments) {
+		descriptors.push_back(attachment->get_handle());
+	}
+
+	frame.finish(version);
+	if (m_socket->write(frame, descriptors) != os::error::Success) {
+		disconnect();
+	}
+
+	// Don't pin payloads or shared mappings while the connection idles, only the storage is kept.
+	reply.values.clear();
+	for (ipc::value_view &arg : call.arguments) {
+		arg.value_shared = nullptr;
+	}
+}
+
+bool ipc::server_instance_linux::negotiate_protocol(const ipc::message::function_call_view &call, std::vector<ipc::value> &rval, std::string &errormsg)
+{
+	if (call.function_name.value_str != ipc::protocol_handshake_function || call.arguments.size() != 1 || call.arguments[0].type != ipc::type::UInt32) {
+		errormsg = "Malformed protocol handshake.";
+		return false;
+	}
+
+	// The client offers the highest revision it speaks, v2 is the highest here.
+	uint32_t offered = call.arguments[0].value_union.ui32;
+	if (offered < uint32_t(ipc::protocol::v2)) {
+		rval.push_back(ipc::value(uint32_t(ipc::protocol::v1)));
+		return true;
+	}
+
+	// v2 calls may name their target by ID, so the method table follows as class and function name pairs.
+	m_protocol = ipc::protocol::v2;
+	const std::vector<ipc::server::method> &methods = m_parent->get_methods();
+	rval.reserve(1 + 2 * methods.size());
+	rval.push_back(ipc::value(uint32_t(ipc::protocol::v2)));
+	for (const ipc::server::method &entry : methods) {
+		rval.push_back(ipc::value(entry.class_name));
+		rval.push_back(ipc::value(entry.function_name));
+	}
+	return true;
+}
+
+bool ipc::server_instance_linux::change_subscription(const ipc::message::function_call_view &call, std::string &errormsg)
+{
+	bool subscribe = call.function_name.value_str == ipc::event_subscribe;
+	if ((!subscribe && call.function_name.value_str != ipc::event_unsubscribe) || call.arguments.size() != 2 ||
+	    call.arguments[0].type != ipc::type::String || call.arguments[1].type != ipc::type::String) {
+		errormsg = "Malformed event subscription.";
+		return false;
+	} else if (subscribe && m_protocol != ipc::protocol::v2) {
+		errormsg = "Events need protocol v2.";
+		return false;
+	}
+
+	m_parent->client_subscribe(shared_from_this(), call.arguments[0].value_str, call.arguments[1].value_str, subscribe);
+	return true;
+}
+
+bool ipc::server_instance_linux::open_shared_memory(const ipc::message::function_call_view &call, std::vector<ipc::value> &rval,
+						     std::string &errormsg)
+{
+	bool live = call.class_name.value_str == ipc::live_class;
+	if (call.function_name.value_str != (live ? ipc::live_open : ipc::bulk_open) || call.arguments.size() != 1 ||
+	    call.arguments[0].type != ipc::type::String) {
+		errormsg = "Malformed shared memory request.";
+		return false;
+	} else if (m_protocol != ipc::protocol::v2) {
+		// Changes and buffers are announced as events.
+		errormsg = "Live values and bulk channels need protocol v2.";
+		return false;
+	}
+
+	if (live) {
+		return m_parent->client_open_live_value(shared_from_this(), call.arguments[0].value_str, rval, errormsg);
+	}
+	return m_parent->client_open_bulk_channel(shared_from_this(), call.arguments[0].value_str, rval, errormsg);
+}
+
+bool ipc::server_instance_linux::send_event(const ipc::frame_builder &frame)
+{
+	if (!m_socket->is_connected()) {
+		return false;
+	}
+	std::unique_lock<std::mutex> ul(m_event_mtx);
+	if (!m_event_flushing) {
+		os::error ec = m_socket->try_write(frame);
+		if (ec == os::error::Success) {
+			return true;
+		} else if (ec != os::error::Pending) {
+			ul.unlock();
+			disconnect();
+			return false;
+		}
+	}
+
+	size_t length = frame.frame_size();
+	if (m_event_backlog_bytes + length > event_backlog_limit) {
+		m_event_backlog.clear();
+		m_event_backlog_bytes = 0;
+		ul.unlock();
+		disconnect();
+		return false;
+	}
+
+	static thread_local std::vector<ipc::frame_segment> segments;
+	frame.gather(segments);
+	std::vector<char> &copy = m_event_backlog.emplace_back();
+	copy.reserve(length);
+	for (const ipc::frame_segment &segment : segments) {
+		copy.insert(copy.end(), segment.data, segment.data + segment.length);
+	}
+	m_event_backlog_bytes += length;
+
+	if (!m_event_flushing) {
+		if (!m_parent->post(ipc::execution::concurrent, [self = shared_from_this()]() { self->flush_events(); })) {
+			m_event_backlog.clear();
+			m_event_backlog_bytes = 0;
+			return false;
+		}
+		m_event_flushing = true;
+	}
+	return true;
+}
+
+void ipc::server_instance_linux::flush_events()
+{
+	std::unique_lock<std::mutex> ul(m_event_mtx);
+	while (!m_event_backlog.empty()) {
+		std::vector<char> data = std::move(m_event_backlog.front());
+		m_event_backlog.pop_front();
+		m_event_backlog_bytes -= data.size();
+		ul.unlock();
+
+		// Waits for the client, at most the call timeout before the connection is given up.
+		os::error ec = m_socket->write(data.data(), data.size());
+
+		ul.lock();
+		if (ec != os::error::Success) {
+			m_event_backlog.clear();
+			m_event_backlog_bytes = 0;
+			m_event_flushing = false;
+			ul.unlock();
+			disconnect();
+			return;
+		}
+	}
+	m_event_flushing = false;
+}
+
+void ipc::server_instance_linux::disconnect()
+{
+	// The server watcher reaps the instance once this handler returns, or right away when called from the shared memory worker.
+	m_socket->shutdown();
+	m_socket->get_reactor()->remove(m_socket->get_handle());
+	m_parent->client_disconnected(m_socket);
+}
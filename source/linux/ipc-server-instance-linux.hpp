@@ -0,0 +1,133 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+#include "../include/ipc-server-instance.hpp"
+#include "../include/error.hpp"
+#include "ipc-socket-linux.hpp"
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace ipc {
+class server;
+
+/** Server side of one connection.
+ *
+ * There is no thread per client: the instance registers its socket with the
+ * server's reactor and reads every frame from the reactor thread. Calls run on
+ * the executor, serial ones in order and one at a time, so a slow handler only
+ * holds up its own client. Clients that move onto shared memory rings get a
+ * thread of their own instead, since a ring can't be watched by epoll. The
+ * reactor then only watches for hangups.
+ */
+class server_instance_linux : public server_instance, public std::enable_shared_from_this<server_instance_linux> {
+public:
+	server_instance_linux(server *owner, std::shared_ptr<ipc::socket> socket, int call_timeout);
+	~server_instance_linux();
+
+	void start();
+	// Stop reading, calls already handed to the executor still run. Not from its own handlers or the shared memory worker.
+	void stop();
+
+	virtual bool send_event(const ipc::frame_builder &frame) override;
+
+private:
+	server *m_parent = nullptr;
+	int64_t m_clientId;
+	std::shared_ptr<os::linux::socket_linux> m_socket;
+	std::vector<char> m_rbuf;
+	ipc::frame_builder m_wframe;
+	ipc::message::function_call_view m_call;
+	ipc::message::function_reply m_reply;
+	std::thread m_shm_worker;
+	// What the handshake settled on, events are only sent to v2 clients.
+	std::atomic<ipc::protocol> m_protocol = ipc::protocol::v1;
+
+	// A call handed to the executor or an asynchronous function, with the frame its arguments point into.
+	struct pending_call {
+		std::vector<char> frame;
+		ipc::message::function_call_view call;
+		ipc::protocol version;
+	};
+
+	// The calls of a batch frame, answered together once the last one finished.
+	struct pending_batch {
+		std::vector<char> frame;
+		ipc::protocol version;
+		std::vector<ipc::message::function_call_view> calls;
+		std::vector<ipc::message::function_reply> replies;
+		std::atomic<size_t> remaining;
+	};
+
+	// A serial call waiting for its turn, on its own or as part of a batch.
+	struct serial_call {
+		std::shared_ptr<pending_call> single;
+		std::shared_ptr<pending_batch> batch;
+		size_t index;
+		bool asynchronous;
+	};
+
+	// Serial calls of this connection, oldest from |m_serial_head| on. While
+	// |m_serial_running| one executor task drains them, and |m_serial_self|
+	// keeps the instance alive until it is done.
+	std::mutex m_serial_mtx;
+	std::vector<serial_call> m_serial_queue;
+	size_t m_serial_head = 0;
+	bool m_serial_running = false;
+	std::shared_ptr<server_instance_linux> m_serial_self;
+	// Finished single calls, the next ones reuse their frame and views.
+	std::vector<std::shared_ptr<pending_call>> m_serial_spare;
+
+	// Events the socket couldn't take right away, sent in order by one
+	// executor task while |m_event_flushing|. A client that lets too much
+	// pile up is dropped, so publish() never waits for it.
+	std::mutex m_event_mtx;
+	std::deque<std::vector<char>> m_event_backlog;
+	size_t m_event_backlog_bytes = 0;
+	bool m_event_flushing = false;
+
+	void handle_events(uint32_t events);
+	void shm_worker();
+	void read_callback_msg(size_t size, bool own_thread);
+	void queue_call(ipc::protocol version, bool asynchronous, bool own_thread);
+	void queue_serial(serial_call task);
+	void run_serial();
+	void start_async(std::shared_ptr<pending_call> pending);
+	void read_batch(size_t size, const ipc::shared_binary_list &attachments);
+	void run_batch_call(const std::shared_ptr<pending_batch> &batch, size_t index, bool asynchronous);
+	void finish_batch_call(const std::shared_ptr<pending_batch> &batch, size_t index, bool success, const std::string &errormsg,
+			       std::chrono::high_resolution_clock::duration call_duration);
+	void release_batch(const std::shared_ptr<pending_batch> &batch);
+	bool invoke(ipc::message::function_call_view &call, std::vector<ipc::value> &rval, std::string &errormsg,
+		    std::chrono::high_resolution_clock::duration &call_duration);
+	void execute(ipc::message::function_call_view &call, ipc::protocol version, ipc::message::function_reply &reply, ipc::frame_builder &frame);
+	void fill_reply(ipc::message::function_call_view &call, bool success, const std::string &errormsg,
+			std::chrono::high_resolution_clock::duration call_duration, ipc::message::function_reply &reply);
+	void send_reply(ipc::message::function_call_view &call, ipc::protocol version, bool success, const std::string &errormsg,
+			std::chrono::high_resolution_clock::duration call_duration, ipc::message::function_reply &reply, ipc::frame_builder &frame);
+	bool negotiate_protocol(const ipc::message::function_call_view &call, std::vector<ipc::value> &rval, std::string &errormsg);
+	bool change_subscription(const ipc::message::function_call_view &call, std::string &errormsg);
+	// Live values and bulk channels.
+	bool open_shared_memory(const ipc::message::function_call_view &call, std::vector<ipc::value> &rval, std::string &errormsg);
+	void flush_events();
+	void disconnect();
+};
+}
@@ -0,0 +1,637 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#include "ipc-socket-linux.hpp"
+#include "../include/ipc.hpp"
+
+#include <algorithm>
+#include <errno.h>
+#include <poll.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Most packets handed to one sendmmsg(), larger batches take several calls.
+static const size_t send_batch = 64;
+
+inline sockaddr_un make_address(const std::string &name)
+{
+	sockaddr_un addr = {};
+	if (name.length() == 0) {
+		throw std::invalid_argument("'name' can't be empty.");
+	} else if (name.length() >= sizeof(addr.sun_path)) {
+		throw std::invalid_argument("'name' can't be longer than " + std::to_string(sizeof(addr.sun_path) - 1) + " characters.");
+	}
+
+	addr.sun_family = AF_UNIX;
+	memcpy(addr.sun_path, name.c_str(), name.length());
+	return addr;
+}
+
+inline std::runtime_error make_error(const char *what, int error_code)
+{
+	return std::runtime_error(std::string(what) + " failed with error " + strerror(error_code) + ".");
+}
+
+std::unique_ptr<os::linux::socket_linux> os::linux::socket_linux::create(os::create_only_t, const std::string &name)
+{
+	return std::make_unique<os::linux::socket_linux>(os::create_only, name);
+}
+
+std::unique_ptr<os::linux::socket_linux> os::linux::socket_linux::create(os::open_only_t, const std::string &name)
+{
+	return std::make_unique<os::linux::socket_linux>(os::open_only, name);
+}
+
+os::linux::socket_linux::socket_linux(os::create_only_t, const std::string &name)
+{
+	sockaddr_un addr = make_address(name);
+
+	m_fd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (m_fd < 0) {
+		throw make_error("Creating socket", errno);
+	}
+
+	unlink(name.c_str());
+	if (bind(m_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || listen(m_fd, SOMAXCONN) < 0) {
+		int error_code = errno;
+		close(m_fd);
+		throw make_error("Binding socket", error_code);
+	}
+
+	m_path = name;
+	m_reactor = std::make_shared<os::linux::reactor>();
+	created = true;
+}
+
+os::linux::socket_linux::socket_linux(os::open_only_t, const std::string &name)
+{
+	sockaddr_un addr = make_address(name);
+
+	m_fd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (m_fd < 0) {
+		throw make_error("Creating socket", errno);
+	}
+
+	if (connect(m_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+		int error_code = errno;
+		close(m_fd);
+		throw make_error("Connecting socket", error_code);
+	}
+
+	set_connected(true);
+}
+
+os::linux::socket_linux::socket_linux(int fd, std::shared_ptr<os::linux::reactor> reactor) : m_fd(fd), m_reactor(reactor)
+{
+	set_connected(true);
+}
+
+os::linux::socket_linux::~socket_linux()
+{
+	close_descriptors();
+	close_queued_descriptors();
+	if (m_reactor) {
+		m_reactor->remove(m_fd);
+	}
+	close(m_fd);
+
+	if (created) {
+		unlink(m_path.c_str());
+	}
+}
+
+os::error os::linux::socket_linux::read(std::vector<char> &buffer, size_t &length, bool is_blocking)
+{
+	// Descriptors of the previous frame that nobody claimed.
+	close_descriptors();
+
+	while (true) {
+		const char *frame = nullptr;
+		if (m_reader.next(frame, length)) {
+			// Descriptors ride along with the first packet of their frame.
+			while (!m_queued_fds.empty() && m_queued_fds.front().first <= m_reader.position() - length) {
+				if (m_queued_fds.front().first == m_reader.position() - length) {
+					m_read_fds = std::move(m_queued_fds.front().second);
+				} else {
+					for (int fd : m_queued_fds.front().second) {
+						close(fd);
+					}
+				}
+				m_queued_fds.pop_front();
+			}
+
+			// Only an empty frame with a single descriptor announces a shm_channel.
+			if (length == sizeof(ipc::ipc_size_t) && m_read_fds.size() == 1) {
+				int fd = m_read_fds.back();
+				m_read_fds.pop_back();
+				if (!attach_shared_memory(fd)) {
+					set_connected(false);
+					return os::error::Error;
+				}
+				continue;
+			}
+
+			// A large frame was received in place and is handed over as it is, unless that leaves the reader
+			// to grow its storage all over again for less than the frame would cost to copy.
+			size_t read_ahead_size = read_ahead_packets * max_packet_size;
+			bool hand_over = length > max_packet_size && (length >= read_ahead_size || buffer.size() >= read_ahead_size);
+			if (!hand_over || !m_reader.detach(buffer)) {
+				if (buffer.size() < length) {
+					buffer.resize(length);
+				}
+				memcpy(buffer.data(), frame, length);
+			}
+			return os::error::Success;
+		}
+
+		if (m_rx) {
+			os::error ec = m_rx->read(buffer, length, is_blocking);
+			if (ec == os::error::Disconnected) {
+				set_connected(false);
+			}
+			return ec;
+		}
+
+		os::error ec = receive(is_blocking);
+		if (ec != os::error::Success) {
+			if (ec != os::error::Pending) {
+				set_connected(false);
+			}
+			return ec;
+		}
+	}
+}
+
+os::error os::linux::socket_linux::receive(bool is_blocking)
+{
+	// The rest of a frame larger than a packet goes straight to its place, one packet at a time.
+	// Otherwise every packet that is already queued is taken in with a single call, each into a
+	// slot of its own so the kernel never truncates one, and moved up behind the previous one.
+	size_t remaining = m_reader.expected() ? m_reader.expected() - m_reader.buffered() : 0;
+	size_t packets = remaining > max_packet_size ? 1 : m_read_ahead;
+	size_t slot = remaining > max_packet_size ? remaining : max_packet_size;
+	char *space = m_reader.prepare(packets * slot);
+
+	mmsghdr msgs[read_ahead_packets] = {};
+	iovec iovs[read_ahead_packets];
+	char control[read_ahead_packets][CMSG_SPACE(sizeof(int) * max_descriptors)];
+	for (size_t idx = 0; idx < packets; idx++) {
+		iovs[idx] = {space + idx * slot, slot};
+		msgs[idx].msg_hdr.msg_iov = &iovs[idx];
+		msgs[idx].msg_hdr.msg_iovlen = 1;
+		msgs[idx].msg_hdr.msg_control = control[idx];
+		msgs[idx].msg_hdr.msg_controllen = sizeof(control[idx]);
+	}
+
+	int ret;
+	do {
+		// Waits for the first packet only, when blocking.
+		ret = ::recvmmsg(m_fd, msgs, unsigned(packets), MSG_CMSG_CLOEXEC | (is_blocking ? MSG_WAITFORONE : MSG_DONTWAIT), nullptr);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0) {
+		return os::linux::utility::translate_error(errno);
+	}
+
+	size_t length = 0;
+	for (int idx = 0; idx < ret; idx++) {
+		msghdr &msg = msgs[idx].msg_hdr;
+		std::vector<int> fds;
+		for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+				size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+				for (size_t fd_idx = 0; fd_idx < count; fd_idx++) {
+					int fd = -1;
+					memcpy(&fd, CMSG_DATA(cmsg) + fd_idx * sizeof(int), sizeof(fd));
+					fds.push_back(fd);
+				}
+			}
+		}
+		if (!fds.empty()) {
+			m_queued_fds.emplace_back(m_reader.received() + length, std::move(fds));
+		}
+
+		// End of stream. Whatever came before it is still delivered.
+		if (msgs[idx].msg_len == 0) {
+			if (idx == 0) {
+				return os::error::Disconnected;
+			}
+			break;
+		}
+
+		if (idx * slot != length) {
+			memmove(space + length, space + idx * slot, msgs[idx].msg_len);
+		}
+		length += msgs[idx].msg_len;
+	}
+	m_reader.commit(length);
+
+	// Asking for more packets than are queued costs a failed attempt each time, so the
+	// count follows the traffic: it doubles while it comes back full and drops otherwise.
+	if (remaining <= max_packet_size) {
+		m_read_ahead = size_t(ret) == packets ? std::min(packets * 2, read_ahead_packets) : std::max(size_t(ret), size_t(1));
+	}
+	return os::error::Success;
+}
+
+os::error os::linux::socket_linux::write(const char *buffer, size_t buffer_length, const std::vector<int> &descriptors)
+{
+	ipc::frame_segment segment = {buffer, buffer_length};
+	return write_segments(&segment, 1, descriptors);
+}
+
+os::error os::linux::socket_linux::write(const ipc::frame_builder &frame, const std::vector<int> &descriptors)
+{
+	static thread_local std::vector<ipc::frame_segment> segments;
+	frame.gather(segments);
+	return write_segments(segments.data(), segments.size(), descriptors);
+}
+
+os::error os::linux::socket_linux::write_segments(const ipc::frame_segment *segments, size_t count, const std::vector<int> &descriptors)
+{
+	if (descriptors.size() > max_descriptors) {
+		return os::error::BufferTooLarge;
+	}
+
+	pending_write self = {segments, count, 0, &descriptors};
+	for (size_t idx = 0; idx < count; idx++) {
+		self.length += segments[idx].length;
+	}
+
+	std::unique_lock<std::mutex> ul(m_write_mtx);
+
+	if (m_tx) {
+		if (!descriptors.empty()) {
+			return os::error::Error;
+		}
+		return write_ring(segments, count);
+	}
+
+	// Either another writer sends this frame along with its own, or this one takes over.
+	(m_write_tail ? m_write_tail->next : m_write_head) = &self;
+	m_write_tail = &self;
+	m_write_cv.wait(ul, [this, &self]() { return self.done || !m_writing; });
+	if (self.done) {
+		return self.result;
+	}
+
+	m_writing = true;
+	static thread_local std::vector<pending_write *> frames;
+	while (!self.done) {
+		size_t bytes = 0;
+		frames.clear();
+		while (m_write_head && (frames.empty() || bytes + m_write_head->length <= write_budget)) {
+			bytes += m_write_head->length;
+			frames.push_back(m_write_head);
+			m_write_head = m_write_head->next;
+		}
+		if (!m_write_head) {
+			m_write_tail = nullptr;
+		}
+
+		ul.unlock();
+		os::error ec = send_frames(frames);
+		ul.lock();
+
+		for (pending_write *frame : frames) {
+			frame->result = ec;
+			frame->done = true;
+		}
+		m_write_cv.notify_all();
+	}
+
+	// Frames queued in the meantime are sent by one of their writers.
+	m_writing = false;
+	m_write_cv.notify_all();
+	return self.result;
+}
+
+os::error os::linux::socket_linux::try_write(const ipc::frame_builder &frame)
+{
+	static const std::vector<int> no_descriptors;
+	static thread_local std::vector<ipc::frame_segment> segments;
+	static thread_local std::vector<pending_write *> frames;
+	frame.gather(segments);
+	pending_write self = {segments.data(), segments.size(), frame.frame_size(), &no_descriptors};
+
+	std::unique_lock<std::mutex> ul(m_write_mtx);
+	if (m_tx) {
+		// Only this side writes and it holds the lock, so the space can only grow.
+		if (m_tx->available() < self.length) {
+			return os::error::Pending;
+		}
+		return write_ring(segments.data(), segments.size());
+	}
+
+	// A packet goes out whole or not at all, later packets of a larger frame would have to wait.
+	if (self.length > max_packet_size || m_writing || m_write_head) {
+		return os::error::Pending;
+	}
+	m_writing = true;
+	ul.unlock();
+
+	frames.assign(1, &self);
+	os::error ec = send_frames(frames, false);
+
+	ul.lock();
+	m_writing = false;
+	m_write_cv.notify_all();
+	return ec;
+}
+
+os::error os::linux::socket_linux::write_ring(const ipc::frame_segment *segments, size_t count)
+{
+	for (size_t idx = 0; idx < count; idx++) {
+		os::error ec = m_tx->write(segments[idx].data, segments[idx].length);
+		if (ec != os::error::Success) {
+			if (ec == os::error::Disconnected) {
+				set_connected(false);
+			}
+			return ec;
+		}
+	}
+	return os::error::Success;
+}
+
+os::error os::linux::socket_linux::send_frames(const std::vector<pending_write *> &frames, bool wait)
+{
+	static thread_local std::vector<iovec> iovs;
+	static thread_local std::vector<mmsghdr> msgs;
+	static thread_local std::vector<size_t> firsts;
+	static thread_local std::vector<pending_write *> owners;
+	static thread_local std::vector<char> control;
+	iovs.clear();
+	msgs.clear();
+	firsts.clear();
+	owners.clear();
+	control.clear();
+
+	// Cut every frame into packets, each an iovec list over the frame's segments.
+	for (pending_write *frame : frames) {
+		size_t segment = 0, offset = 0;
+		for (size_t remaining = frame->length; remaining > 0;) {
+			size_t packet = std::min(remaining, max_packet_size);
+			bool first = remaining == frame->length;
+			remaining -= packet;
+
+			mmsghdr msg = {};
+			firsts.push_back(iovs.size());
+			for (size_t need = packet; need > 0;) {
+				const ipc::frame_segment &piece = frame->segments[segment];
+				size_t chunk = std::min(piece.length - offset, need);
+				if (chunk > 0) {
+					iovs.push_back({const_cast<char *>(piece.data + offset), chunk});
+				}
+				offset += chunk;
+				need -= chunk;
+				if (offset == piece.length) {
+					segment++;
+					offset = 0;
+				}
+			}
+			msg.msg_hdr.msg_iovlen = iovs.size() - firsts.back();
+
+			// Descriptors ride along with the first packet of the frame.
+			if (first && !frame->descriptors->empty()) {
+				msg.msg_hdr.msg_controllen = CMSG_SPACE(sizeof(int) * frame->descriptors->size());
+				owners.push_back(frame);
+				control.resize(control.size() + msg.msg_hdr.msg_controllen);
+			} else {
+				owners.push_back(nullptr);
+			}
+			msgs.push_back(msg);
+		}
+	}
+
+	// The vectors are complete, so pointers into them hold from here on.
+	size_t control_offset = 0;
+	for (size_t idx = 0; idx < msgs.size(); idx++) {
+		msghdr &msg = msgs[idx].msg_hdr;
+		msg.msg_iov = iovs.data() + firsts[idx];
+		if (owners[idx] == nullptr) {
+			continue;
+		}
+
+		const std::vector<int> &descriptors = *owners[idx]->descriptors;
+		msg.msg_control = control.data() + control_offset;
+		control_offset += msg.msg_controllen;
+		memset(msg.msg_control, 0, msg.msg_controllen);
+		cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int) * descriptors.size());
+		memcpy(CMSG_DATA(cmsg), descriptors.data(), sizeof(int) * descriptors.size());
+	}
+
+	for (size_t sent = 0; sent < msgs.size();) {
+		int ret = ::sendmmsg(m_fd, msgs.data() + sent, unsigned(std::min(msgs.size() - sent, send_batch)), MSG_NOSIGNAL);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				if (!wait && sent == 0) {
+					return os::error::Pending;
+				}
+
+				// The peer isn't reading. Half a frame may be out already, so it either drains or the connection ends.
+				pollfd pfd = {m_fd, POLLOUT, 0};
+				int ready;
+				do {
+					ready = ::poll(&pfd, 1, int(m_send_timeout.count()));
+				} while (ready < 0 && errno == EINTR);
+				if (ready > 0) {
+					continue;
+				}
+				shutdown();
+				return ready == 0 ? os::error::TimedOut : os::linux::utility::translate_error(errno);
+			}
+
+			os::error ec = os::linux::utility::translate_error(errno);
+			if (ec == os::error::Disconnected) {
+				set_connected(false);
+			}
+			return ec;
+		}
+		sent += size_t(ret);
+	}
+	return os::error::Success;
+}
+
+std::shared_ptr<os::linux::socket_linux> os::linux::socket_linux::accept_connection()
+{
+	if (!is_created()) {
+		return nullptr;
+	}
+
+	// Non-blocking like the listener, so a client that stops reading can't hold a writer forever.
+	int fd = ::accept4(m_fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+	if (fd < 0) {
+		return nullptr;
+	}
+	return std::make_shared<os::linux::socket_linux>(fd, m_reactor);
+}
+
+void os::linux::socket_linux::set_send_timeout(std::chrono::milliseconds timeout)
+{
+	m_send_timeout = timeout;
+}
+
+void os::linux::socket_linux::shutdown()
+{
+	set_connected(false);
+	if (m_shm) {
+		m_shm->close();
+	}
+	::shutdown(m_fd, SHUT_RDWR);
+}
+
+os::error os::linux::socket_linux::enable_shared_memory(size_t ring_size)
+{
+	std::unique_ptr<os::linux::shm_channel> channel;
+	try {
+		channel = os::linux::shm_channel::create(ring_size, [this]() { return is_peer_alive(); });
+	} catch (std::exception &e) {
+		ipc::log("Shared memory transport unavailable: %s", e.what());
+		return os::error::Error;
+	}
+
+	char frame[sizeof(ipc::ipc_size_t)] = {};
+	iovec iov = {frame, sizeof(frame)};
+	char control[CMSG_SPACE(sizeof(int))] = {};
+	msghdr msg = {};
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	int fd = channel->get_handle();
+	cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(fd));
+
+	// Frames already queued for the socket have to go out before the switch.
+	std::unique_lock<std::mutex> ul(m_write_mtx);
+	m_write_cv.wait(ul, [this]() { return !m_writing && !m_write_head; });
+	while (::sendmsg(m_fd, &msg, MSG_NOSIGNAL) < 0) {
+		if (errno != EINTR) {
+			return os::linux::utility::translate_error(errno);
+		}
+	}
+
+	m_shm = std::move(channel);
+	m_tx = &m_shm->requests();
+	m_rx = &m_shm->replies();
+	return os::error::Success;
+}
+
+std::vector<int> os::linux::socket_linux::take_descriptors()
+{
+	std::vector<int> fds;
+	std::swap(fds, m_read_fds);
+	return fds;
+}
+
+void os::linux::socket_linux::close_descriptors()
+{
+	for (int fd : m_read_fds) {
+		close(fd);
+	}
+	m_read_fds.clear();
+}
+
+void os::linux::socket_linux::close_queued_descriptors()
+{
+	for (auto &queued : m_queued_fds) {
+		for (int fd : queued.second) {
+			close(fd);
+		}
+	}
+	m_queued_fds.clear();
+}
+
+bool os::linux::socket_linux::is_shared_memory()
+{
+	return m_shm != nullptr;
+}
+
+bool os::linux::socket_linux::attach_shared_memory(int fd)
+{
+	try {
+		m_shm = os::linux::shm_channel::open(fd, [this]() { return is_peer_alive(); });
+	} catch (std::exception &e) {
+		ipc::log("Rejected shared memory from client: %s", e.what());
+		return false;
+	}
+
+	m_rx = &m_shm->requests();
+	m_tx = &m_shm->replies();
+	return true;
+}
+
+bool os::linux::socket_linux::is_peer_alive()
+{
+	// The socket stays open alongside the rings, a closed peer shows up as end of stream.
+	char probe;
+	ssize_t ret = ::recv(m_fd, &probe, sizeof(probe), MSG_PEEK | MSG_DONTWAIT);
+	return ret > 0 || (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR));
+}
+
+int os::linux::socket_linux::get_handle()
+{
+	return m_fd;
+}
+
+std::shared_ptr<os::linux::reactor> os::linux::socket_linux::get_reactor()
+{
+	return m_reactor;
+}
+
+void os::linux::socket_linux::handle_accept_callback(os::error code, size_t)
+{
+	if (code == os::error::Connected || code == os::error::Success) {
+		set_connected(true);
+	} else {
+		set_connected(false);
+	}
+}
+
+bool os::linux::socket_linux::is_created()
+{
+	return created;
+}
+
+bool os::linux::socket_linux::is_connected()
+{
+	return connected;
+}
+
+void os::linux::socket_linux::set_connected(bool is_connected)
+{
+	connected = is_connected;
+}
+
+os::error os::linux::socket_linux::accept(std::shared_ptr<os::async_op> &, os::async_op_cb_t)
+{
+	// Connections are handed out by accept_connection() whenever the reactor reports
+	// the listening socket as readable, so there is no operation to wait on.
+	return os::error::Error;
+}
@@ -0,0 +1,164 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#ifndef OS_LINUX_SOCKET_LINUX_HPP
+#define OS_LINUX_SOCKET_LINUX_HPP
+
+#include "../include/ipc-socket.hpp"
+#include "../include/ipc.hpp"
+#include "utility.hpp"
+#include "reactor.hpp"
+#include "shm-ring.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace os {
+namespace linux {
+/** AF_UNIX SOCK_SEQPACKET connection.
+ *
+ * Message boundaries are preserved by the kernel, so a frame that fits into a
+ * single packet arrives as one packet. Larger frames are split into packets of
+ * at most max_packet_size bytes and reassembled by read(). Reads go through a
+ * frame_reader: one recvmmsg() takes in every packet that is already queued,
+ * up to a count that adapts to the traffic, and the frames in them are
+ * returned one by one.
+ *
+ * A connection can be moved onto a pair of shared memory rings: the client
+ * sends an empty frame carrying the memfd of a shm_channel, from then on
+ * read() and write() use the rings and the socket only reports a dead peer.
+ */
+class socket_linux : public ipc::socket {
+	int m_fd = -1;
+	bool created = false;
+	std::atomic_bool connected = false;
+	std::string m_path;
+	std::shared_ptr<os::linux::reactor> m_reactor;
+
+	// Frames handed to write() that wait for the writer currently sending.
+	struct pending_write {
+		const ipc::frame_segment *segments;
+		size_t count;
+		size_t length;
+		const std::vector<int> *descriptors;
+		os::error result = os::error::Success;
+		bool done = false;
+		pending_write *next = nullptr;
+	};
+	std::mutex m_write_mtx;
+	std::condition_variable m_write_cv;
+	// Writers queue the frames they wait on, linked through the frames so queueing never allocates.
+	pending_write *m_write_head = nullptr, *m_write_tail = nullptr;
+	bool m_writing = false;
+	// How long a non-blocking socket may stay full before a write gives up.
+	std::chrono::milliseconds m_send_timeout = std::chrono::seconds(30);
+
+	ipc::frame_reader m_reader;
+	size_t m_read_ahead = 1;
+	std::vector<int> m_read_fds;
+	// Descriptors read ahead, by the stream offset of the frame they arrived with.
+	std::deque<std::pair<uint64_t, std::vector<int>>> m_queued_fds;
+
+	std::unique_ptr<os::linux::shm_channel> m_shm;
+	os::linux::shm_ring *m_rx = nullptr, *m_tx = nullptr;
+
+	os::error receive(bool is_blocking);
+	os::error write_segments(const ipc::frame_segment *segments, size_t count, const std::vector<int> &descriptors);
+	os::error write_ring(const ipc::frame_segment *segments, size_t count);
+	os::error send_frames(const std::vector<pending_write *> &frames, bool wait = true);
+	bool attach_shared_memory(int fd);
+	void close_descriptors();
+	void close_queued_descriptors();
+	bool is_peer_alive();
+
+public:
+	static constexpr size_t max_packet_size = 64 * 1024;
+	// Most packets taken in by one receive, each needs a slot of max_packet_size.
+	static constexpr size_t read_ahead_packets = 8;
+	// Most bytes of queued frames sent together, a single larger frame still goes out on its own.
+	static constexpr size_t write_budget = 256 * 1024;
+	// Binary values from this size on are sent from their own storage instead of being copied into the frame.
+	static constexpr size_t reference_threshold = 16 * 1024;
+	// Kernel limit for descriptors in one message is SCM_MAX_FD (253).
+	static constexpr size_t max_descriptors = 64;
+
+	static std::unique_ptr<os::linux::socket_linux> create(os::create_only_t, const std::string &name);
+	static std::unique_ptr<os::linux::socket_linux> create(os::open_only_t, const std::string &name);
+
+	socket_linux(os::create_only_t, const std::string &name);
+	socket_linux(os::open_only_t, const std::string &name);
+	socket_linux(int fd, std::shared_ptr<os::linux::reactor> reactor);
+	~socket_linux();
+
+	/** Receive the next complete frame into |buffer|.
+	 *
+	 * |buffer| may be larger than the frame, |length| holds the frame size
+	 * including the ipc_size_t prefix. Frames are copied into |buffer|, except
+	 * large ones that can swap their storage with it instead.
+	 *
+	 * @return Success, Pending if non-blocking and no full frame is available,
+	 *         or Disconnected.
+	 */
+	os::error read(std::vector<char> &buffer, size_t &length, bool is_blocking);
+
+	/** Send one frame, |descriptors| go along with its first packet.
+	 *
+	 * Writers don't each make their own call. Whoever finds no write in
+	 * progress sends every frame queued by then, up to write_budget bytes, with
+	 * a single sendmmsg(), while the others wait for theirs to go out. Nobody
+	 * waits for frames that are not there yet, so a lone writer sends at once.
+	 */
+	os::error write(const char *buffer, size_t buffer_length, const std::vector<int> &descriptors = {});
+	// Same for a frame that references binary values, which are sent straight from their storage.
+	os::error write(const ipc::frame_builder &frame, const std::vector<int> &descriptors = {});
+	// Send |frame| only if that takes no waiting, otherwise Pending and nothing went out. Frames larger than a packet always wait.
+	os::error try_write(const ipc::frame_builder &frame);
+
+	// Descriptors that arrived with the frame last returned by read(), the caller owns them.
+	std::vector<int> take_descriptors();
+
+	// Accept one pending connection on a listening socket, or nullptr if none is waiting. The connection doesn't block.
+	std::shared_ptr<os::linux::socket_linux> accept_connection();
+	// Most time write() waits for a peer that doesn't read, it fails with TimedOut after that. 30 seconds unless set.
+	void set_send_timeout(std::chrono::milliseconds timeout);
+
+	// Unblock any reader and stop further traffic.
+	void shutdown();
+
+	// Client side: hand a new shm_channel to the server and move all further traffic onto it.
+	os::error enable_shared_memory(size_t ring_size);
+	bool is_shared_memory();
+
+	int get_handle();
+	std::shared_ptr<os::linux::reactor> get_reactor();
+
+	virtual void handle_accept_callback(os::error code, size_t length) override;
+	virtual bool is_created() override;
+	virtual bool is_connected() override;
+	virtual void set_connected(bool is_connected) override;
+	virtual os::error accept(std::shared_ptr<os::async_op> &op, os::async_op_cb_t cb) override;
+};
+}
+}
+
+#endif
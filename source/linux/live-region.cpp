@@ -0,0 +1,193 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#include "live-region.hpp"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <new>
+#include <stdexcept>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#define LIVE_REGION_MAGIC 0x4556494C // 'LIVE'
+#define LIVE_REGION_VERSION 1
+#define LIVE_REGION_PREFIX "/ipc-live-"
+
+// Readers retry this often before they start yielding to a writer that was preempted mid-store.
+static const int spin_limit = 64;
+
+inline size_t word_count(size_t bytes)
+{
+	return (bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+}
+
+std::unique_ptr<os::linux::live_region> os::linux::live_region::create(size_t capacity)
+{
+	size_t size = sizeof(header) + word_count(capacity) * sizeof(uint64_t);
+	std::string name;
+	int fd = os::linux::utility::create_shared_memory(LIVE_REGION_PREFIX, size, name);
+	if (fd < 0) {
+		throw std::runtime_error(std::string("Creating shared memory failed with error ") + strerror(errno) + ".");
+	}
+
+	return std::unique_ptr<os::linux::live_region>(new os::linux::live_region(name, fd, size, true));
+}
+
+std::unique_ptr<os::linux::live_region> os::linux::live_region::open(const std::string &name)
+{
+	int fd = os::linux::utility::open_shared_memory(LIVE_REGION_PREFIX, name);
+	struct stat st = {};
+	if (fd < 0 || fstat(fd, &st) < 0 || size_t(st.st_size) < sizeof(header)) {
+		if (fd >= 0) {
+			::close(fd);
+		}
+		throw std::runtime_error("Live value handed over by the server is not usable.");
+	}
+
+	return std::unique_ptr<os::linux::live_region>(new os::linux::live_region(name, fd, size_t(st.st_size), false));
+}
+
+os::linux::live_region::live_region(const std::string &name, int fd, size_t size, bool owner) : m_name(name), m_owner(owner), m_size(size)
+{
+	// The mapping keeps the object alive, the descriptor isn't needed past this.
+	m_memory = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	int error_code = errno;
+	::close(fd);
+	if (m_memory == MAP_FAILED) {
+		if (m_owner) {
+			shm_unlink(m_name.c_str());
+		}
+		throw std::runtime_error(std::string("Mapping shared memory failed with error ") + strerror(error_code) + ".");
+	}
+
+	m_header = static_cast<header *>(m_memory);
+	m_words = reinterpret_cast<std::atomic<uint64_t> *>(static_cast<char *>(m_memory) + sizeof(header));
+	if (m_owner) {
+		new (m_header) header();
+		m_header->magic = LIVE_REGION_MAGIC;
+		m_header->version = LIVE_REGION_VERSION;
+		m_header->capacity = (m_size - sizeof(header)) & ~uint64_t(sizeof(uint64_t) - 1);
+		m_header->sequence = 0;
+		m_header->size = 0;
+		for (std::atomic<uint32_t> &word : m_header->armed) {
+			word = 0;
+		}
+	}
+
+	m_capacity = m_header->capacity;
+	if (m_header->magic != LIVE_REGION_MAGIC || m_header->version != LIVE_REGION_VERSION || m_capacity % sizeof(uint64_t) != 0 ||
+	    m_capacity > m_size - sizeof(header)) {
+		munmap(m_memory, m_size);
+		throw std::runtime_error("Live value handed over by the server has an unknown layout.");
+	}
+}
+
+os::linux::live_region::~live_region()
+{
+	munmap(m_memory, m_size);
+	if (m_owner) {
+		shm_unlink(m_name.c_str());
+	}
+}
+
+const std::string &os::linux::live_region::name() const
+{
+	return m_name;
+}
+
+bool os::linux::live_region::store(const char *data, size_t size)
+{
+	if (size > m_capacity) {
+		return false;
+	}
+
+	// Every access to the contents is atomic, which keeps the copies of a torn read defined. Release stores
+	// of the contents can't pass the odd sequence, the acquire loads of a reader can't pass its second check.
+	uint64_t sequence = m_header->sequence.load(std::memory_order_relaxed) | 1;
+	m_header->sequence.store(sequence, std::memory_order_relaxed);
+
+	size_t full = size / sizeof(uint64_t);
+	for (size_t idx = 0; idx < full; idx++) {
+		uint64_t word;
+		memcpy(&word, data + idx * sizeof(uint64_t), sizeof(word));
+		m_words[idx].store(word, std::memory_order_release);
+	}
+	if (size_t rest = size - full * sizeof(uint64_t)) {
+		uint64_t word = 0;
+		memcpy(&word, data + full * sizeof(uint64_t), rest);
+		m_words[full].store(word, std::memory_order_release);
+	}
+	m_header->size.store(size, std::memory_order_release);
+
+	m_header->sequence.store(sequence + 1, std::memory_order_release);
+	return true;
+}
+
+uint64_t os::linux::live_region::load(std::vector<char> &buffer, size_t &length)
+{
+	for (int attempt = 0;; attempt++) {
+		if (attempt >= spin_limit) {
+			std::this_thread::yield();
+		}
+
+		uint64_t sequence = m_header->sequence.load(std::memory_order_acquire);
+		if (sequence == 0) {
+			length = 0;
+			return 0;
+		} else if (sequence & 1) {
+			continue;
+		}
+
+		size_t size = size_t(std::min<uint64_t>(m_header->size.load(std::memory_order_acquire), m_capacity));
+		size_t words = word_count(size);
+		if (buffer.size() < words * sizeof(uint64_t)) {
+			buffer.resize(words * sizeof(uint64_t));
+		}
+		for (size_t idx = 0; idx < words; idx++) {
+			uint64_t word = m_words[idx].load(std::memory_order_acquire);
+			memcpy(buffer.data() + idx * sizeof(uint64_t), &word, sizeof(word));
+		}
+
+		if (m_header->sequence.load(std::memory_order_relaxed) == sequence) {
+			length = size;
+			return sequence;
+		}
+	}
+}
+
+uint64_t os::linux::live_region::sequence() const
+{
+	return m_header->sequence.load(std::memory_order_acquire) & ~uint64_t(1);
+}
+
+void os::linux::live_region::arm(size_t reader, bool armed)
+{
+	if (reader < max_readers) {
+		m_header->armed[reader].store(armed ? 1 : 0);
+	}
+}
+
+bool os::linux::live_region::disarm(size_t reader)
+{
+	return reader < max_readers && m_header->armed[reader].exchange(0) != 0;
+}
@@ -0,0 +1,98 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#ifndef OS_LINUX_LIVE_REGION_HPP
+#define OS_LINUX_LIVE_REGION_HPP
+
+#include "utility.hpp"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace os {
+namespace linux {
+/** Shared memory slot holding the latest encoding of one live value.
+ *
+ * A seqlock: the server bumps |sequence| to an odd number, rewrites the
+ * contents and bumps it back to even, readers copy the contents out and retry
+ * if the sequence moved meanwhile. Readers never block the writer and there
+ * is never more than the one value to read, however far behind they are.
+ *
+ * Each reader owns one |armed| word. Setting it asks for a single change
+ * notification, the server clears it when it sends that notification, so a
+ * reader has at most one in flight no matter how often the value changes.
+ *
+ * The region is a named shared memory object, see
+ * utility::create_shared_memory(), unlinked when the server removes the value.
+ */
+class live_region {
+public:
+	static constexpr size_t max_readers = 64;
+
+	struct header {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t capacity;
+		alignas(64) std::atomic<uint64_t> sequence;
+		std::atomic<uint64_t> size;
+		alignas(64) std::atomic<uint32_t> armed[max_readers];
+	};
+	static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+		      "live values need address-free atomics");
+
+	// Server side, contents of up to |capacity| bytes.
+	static std::unique_ptr<os::linux::live_region> create(size_t capacity);
+	// Client side, the region the server named.
+	static std::unique_ptr<os::linux::live_region> open(const std::string &name);
+	~live_region();
+
+	const std::string &name() const;
+
+	// Replace the contents, false if they don't fit. Only one thread may store at a time.
+	bool store(const char *data, size_t size);
+
+	/** Copy the latest contents into |buffer|, which only grows, and their size to |length|.
+	 *
+	 * Returns the sequence the copy belongs to, zero if nothing was stored yet.
+	 */
+	uint64_t load(std::vector<char> &buffer, size_t &length);
+
+	// Stores so far, times two.
+	uint64_t sequence() const;
+
+	void arm(size_t reader, bool armed);
+	// Server side: clear the reader's word, true if it was set.
+	bool disarm(size_t reader);
+
+private:
+	std::string m_name;
+	bool m_owner = false;
+	void *m_memory = nullptr;
+	size_t m_size = 0;
+	header *m_header = nullptr;
+	std::atomic<uint64_t> *m_words = nullptr;
+	// Copied at setup, the peer can scribble over the header.
+	uint64_t m_capacity = 0;
+
+	live_region(const std::string &name, int fd, size_t size, bool owner);
+};
+}
+}
+
+#endif
@@ -0,0 +1,157 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#include "memfd-binary.hpp"
+#include "../include/ipc.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define REQUIRED_SEALS (F_SEAL_WRITE | F_SEAL_SHRINK)
+
+inline std::runtime_error make_error(const char *what, int error_code)
+{
+	return std::runtime_error(std::string(what) + " failed with error " + strerror(error_code) + ".");
+}
+
+std::shared_ptr<os::linux::memfd_binary> os::linux::memfd_binary::create(const char *data, size_t size)
+{
+	int fd = memfd_create("ipc-binary", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0) {
+		throw make_error("Creating memfd", errno);
+	}
+
+	// Written through the descriptor, a writable mapping would prevent F_SEAL_WRITE.
+	size_t offset = 0;
+	while (offset < size) {
+		ssize_t ret = pwrite(fd, data + offset, size - offset, off_t(offset));
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		} else if (ret <= 0) {
+			int error_code = ret < 0 ? errno : ENOSPC;
+			close(fd);
+			throw make_error("Filling memfd", error_code);
+		}
+		offset += size_t(ret);
+	}
+
+	if (fcntl(fd, F_ADD_SEALS, REQUIRED_SEALS | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+		int error_code = errno;
+		close(fd);
+		throw make_error("Sealing memfd", error_code);
+	}
+
+	return std::shared_ptr<os::linux::memfd_binary>(new os::linux::memfd_binary(fd, size));
+}
+
+std::shared_ptr<os::linux::memfd_binary> os::linux::memfd_binary::open(int fd)
+{
+	struct stat st = {};
+	int seals = fcntl(fd, F_GET_SEALS);
+	if (seals < 0 || (seals & REQUIRED_SEALS) != REQUIRED_SEALS || fstat(fd, &st) < 0) {
+		close(fd);
+		throw std::runtime_error("Descriptor is not a sealed memfd.");
+	}
+
+	return std::shared_ptr<os::linux::memfd_binary>(new os::linux::memfd_binary(fd, size_t(st.st_size)));
+}
+
+os::linux::memfd_binary::memfd_binary(int fd, size_t size) : m_fd(fd), m_size(size)
+{
+	if (m_size == 0) {
+		return;
+	}
+
+	void *memory = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_fd, 0);
+	if (memory == MAP_FAILED) {
+		int error_code = errno;
+		close(m_fd);
+		throw make_error("Mapping memfd", error_code);
+	}
+	m_data = static_cast<const char *>(memory);
+}
+
+os::linux::memfd_binary::~memfd_binary()
+{
+	if (m_data) {
+		munmap(const_cast<char *>(m_data), m_size);
+	}
+	close(m_fd);
+}
+
+const char *os::linux::memfd_binary::data() const
+{
+	return m_data;
+}
+
+size_t os::linux::memfd_binary::size() const
+{
+	return m_size;
+}
+
+int os::linux::memfd_binary::get_handle() const
+{
+	return m_fd;
+}
+
+size_t os::linux::memfd_binary::prepare(std::vector<ipc::value> &values, size_t threshold, size_t max_count, bool can_attach)
+{
+	size_t count = 0;
+	for (ipc::value &v : values) {
+		if (v.type != ipc::type::Binary) {
+			continue;
+		}
+
+		if (v.get_shared_binary()) {
+			if (!can_attach || count >= max_count) {
+				v = ipc::value(std::vector<char>(v.binary_data(), v.binary_data() + v.binary_size()));
+			} else {
+				count++;
+			}
+		} else if (can_attach && threshold > 0 && v.binary_size() >= threshold && count < max_count) {
+			try {
+				v = ipc::value(std::static_pointer_cast<ipc::shared_binary>(create(v.binary_data(), v.binary_size())));
+				count++;
+			} catch (std::exception &e) {
+				// The value simply stays inline.
+				ipc::log("Sharing binary value failed: %s", e.what());
+			}
+		}
+	}
+	return count;
+}
+
+ipc::shared_binary_list os::linux::memfd_binary::adopt(const std::vector<int> &fds)
+{
+	ipc::shared_binary_list list;
+	list.reserve(fds.size());
+	for (int fd : fds) {
+		try {
+			list.push_back(open(fd));
+		} catch (std::exception &e) {
+			ipc::log("Rejected binary value from peer: %s", e.what());
+			list.push_back(nullptr);
+		}
+	}
+	return list;
+}
@@ -0,0 +1,67 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#ifndef OS_LINUX_MEMFD_BINARY_HPP
+#define OS_LINUX_MEMFD_BINARY_HPP
+
+#include "../include/ipc-value.hpp"
+#include "utility.hpp"
+#include <memory>
+#include <vector>
+
+namespace os {
+namespace linux {
+/** Binary value held in a sealed memfd.
+ *
+ * The sender fills the file once and seals it against writes and resizing,
+ * so the receiver can map it read-only without having to trust the sender
+ * not to change or truncate it underneath.
+ */
+class memfd_binary : public ipc::shared_binary {
+	int m_fd = -1;
+	const char *m_data = nullptr;
+	size_t m_size = 0;
+
+	memfd_binary(int fd, size_t size);
+
+public:
+	static std::shared_ptr<os::linux::memfd_binary> create(const char *data, size_t size);
+	// Takes ownership of |fd|, which is closed if it is not a sealed memfd.
+	static std::shared_ptr<os::linux::memfd_binary> open(int fd);
+	~memfd_binary();
+
+	virtual const char *data() const override;
+	virtual size_t size() const override;
+	virtual int get_handle() const override;
+
+	/** Prepare |values| for a frame.
+	 *
+	 * Binary values of at least |threshold| bytes are moved into memfds, up to
+	 * |max_count| per frame. A threshold of zero disables this. Without
+	 * |can_attach| shared values are copied back inline instead. Returns the
+	 * number of values that will be attached.
+	 */
+	static size_t prepare(std::vector<ipc::value> &values, size_t threshold, size_t max_count, bool can_attach);
+
+	// Wrap descriptors received with a frame, unusable ones become nullptr.
+	static ipc::shared_binary_list adopt(const std::vector<int> &fds);
+};
+}
+}
+
+#endif
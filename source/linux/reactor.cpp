@@ -0,0 +1,143 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#include "reactor.hpp"
+#include <errno.h>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#define MAX_EVENTS_PER_WAIT 64
+
+inline uint64_t make_token(int fd, uint32_t generation)
+{
+	return (uint64_t(generation) << 32) | uint32_t(fd);
+}
+
+os::linux::reactor::reactor()
+{
+	m_epoll = epoll_create1(EPOLL_CLOEXEC);
+	if (m_epoll < 0) {
+		throw std::runtime_error("Creating epoll instance failed.");
+	}
+
+	m_wakeup = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (m_wakeup < 0) {
+		close(m_epoll);
+		throw std::runtime_error("Creating reactor wakeup event failed.");
+	}
+
+	epoll_event ev = {};
+	ev.events = EPOLLIN;
+	ev.data.u64 = make_token(m_wakeup, 0);
+	epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup, &ev);
+}
+
+os::linux::reactor::~reactor()
+{
+	close(m_wakeup);
+	close(m_epoll);
+}
+
+os::error os::linux::reactor::add(int fd, uint32_t events, reactor_handler_t handler)
+{
+	std::unique_lock<std::mutex> ul(m_handlers_mtx);
+	registration reg;
+	reg.generation = ++m_generation;
+	reg.handler = std::make_shared<reactor_handler_t>(std::move(handler));
+
+	epoll_event ev = {};
+	ev.events = events;
+	ev.data.u64 = make_token(fd, reg.generation);
+	if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		return os::linux::utility::translate_error(errno);
+	}
+
+	m_handlers.insert_or_assign(fd, std::move(reg));
+	return os::error::Success;
+}
+
+os::error os::linux::reactor::modify(int fd, uint32_t events)
+{
+	std::unique_lock<std::mutex> ul(m_handlers_mtx);
+	auto reg = m_handlers.find(fd);
+	if (reg == m_handlers.end()) {
+		return os::error::Error;
+	}
+
+	epoll_event ev = {};
+	ev.events = events;
+	ev.data.u64 = make_token(fd, reg->second.generation);
+	if (epoll_ctl(m_epoll, EPOLL_CTL_MOD, fd, &ev) < 0) {
+		return os::linux::utility::translate_error(errno);
+	}
+	return os::error::Success;
+}
+
+void os::linux::reactor::remove(int fd)
+{
+	std::unique_lock<std::mutex> ul(m_handlers_mtx);
+	if (m_handlers.erase(fd) != 0) {
+		epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+	}
+}
+
+void os::linux::reactor::wake()
+{
+	uint64_t one = 1;
+	if (::write(m_wakeup, &one, sizeof(one)) < 0) {
+		// Counter is saturated, so a wakeup is already pending.
+	}
+}
+
+os::error os::linux::reactor::run_once(std::chrono::milliseconds timeout)
+{
+	epoll_event events[MAX_EVENTS_PER_WAIT];
+	int count = epoll_wait(m_epoll, events, MAX_EVENTS_PER_WAIT, timeout.count() < 0 ? -1 : int(timeout.count()));
+	if (count < 0) {
+		return errno == EINTR ? os::error::Success : os::linux::utility::translate_error(errno);
+	} else if (count == 0) {
+		return os::error::TimedOut;
+	}
+
+	for (int idx = 0; idx < count; idx++) {
+		int fd = int(uint32_t(events[idx].data.u64));
+		uint32_t generation = uint32_t(events[idx].data.u64 >> 32);
+
+		if (fd == m_wakeup && generation == 0) {
+			uint64_t value;
+			while (::read(m_wakeup, &value, sizeof(value)) > 0) {
+			}
+			continue;
+		}
+
+		// Hold a reference so that the handler may remove itself, and skip events
+		// for descriptors that were removed or reused earlier in this batch.
+		std::shared_ptr<reactor_handler_t> handler;
+		{
+			std::unique_lock<std::mutex> ul(m_handlers_mtx);
+			auto reg = m_handlers.find(fd);
+			if (reg == m_handlers.end() || reg->second.generation != generation) {
+				continue;
+			}
+			handler = reg->second.handler;
+		}
+		(*handler)(events[idx].events);
+	}
+	return os::error::Success;
+}
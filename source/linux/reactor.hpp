@@ -0,0 +1,68 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#ifndef OS_LINUX_REACTOR_HPP
+#define OS_LINUX_REACTOR_HPP
+
+#include "utility.hpp"
+#include <sys/epoll.h>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace os {
+namespace linux {
+typedef std::function<void(uint32_t events)> reactor_handler_t;
+
+/** Single epoll loop that multiplexes every descriptor of a server.
+ *
+ * Handlers run on the thread calling run_once(). A handler may add or remove
+ * descriptors, including its own, while it is being dispatched.
+ */
+class reactor {
+	struct registration {
+		uint32_t generation;
+		std::shared_ptr<reactor_handler_t> handler;
+	};
+
+	int m_epoll = -1;
+	int m_wakeup = -1;
+	uint32_t m_generation = 0;
+	std::mutex m_handlers_mtx;
+	std::map<int, registration> m_handlers;
+
+public:
+	reactor();
+	~reactor();
+
+	os::error add(int fd, uint32_t events, reactor_handler_t handler);
+	os::error modify(int fd, uint32_t events);
+	void remove(int fd);
+
+	// Interrupt a blocking run_once() from another thread.
+	void wake();
+
+	// Wait for events and dispatch them. A negative timeout waits forever.
+	os::error run_once(std::chrono::milliseconds timeout);
+};
+}
+}
+
+#endif
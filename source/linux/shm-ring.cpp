@@ -0,0 +1,338 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#include "shm-ring.hpp"
+#include "../include/ipc.hpp"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <new>
+#include <stdexcept>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#define SHM_CHANNEL_MAGIC 0x52495043 // 'CPIR'
+#define SHM_CHANNEL_VERSION 1
+
+// A sleeping peer is checked for liveness this often.
+static const auto peer_check_interval = std::chrono::milliseconds(100);
+
+// Spinning only pays off when the peer runs on another core at the same time.
+static const int spin_limit = std::thread::hardware_concurrency() > 1 ? 4000 : 0;
+
+struct alignas(64) region_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t ring_size;
+};
+
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	asm volatile("yield");
+#endif
+}
+
+size_t os::linux::shm_ring::required_size(size_t capacity)
+{
+	return sizeof(header) + capacity;
+}
+
+void os::linux::shm_ring::initialize(void *memory, size_t capacity)
+{
+	header *hdr = new (memory) header();
+	hdr->head = 0;
+	hdr->tail = 0;
+	hdr->data_doorbell = 0;
+	hdr->consumer_waiting = 0;
+	hdr->space_doorbell = 0;
+	hdr->producer_waiting = 0;
+	hdr->closed = 0;
+	hdr->capacity = capacity;
+}
+
+os::linux::shm_ring::shm_ring(void *memory, peer_check_t peer_check)
+	: m_header(static_cast<header *>(memory)), m_data(static_cast<char *>(memory) + sizeof(header)), m_capacity(m_header->capacity),
+	  m_mask(m_capacity - 1), m_peer_check(peer_check)
+{
+}
+
+os::error os::linux::shm_ring::write(const char *buffer, size_t length)
+{
+	// The peer can scribble over the header, so positions are clamped to the capacity seen at setup.
+	const uint64_t capacity = m_capacity;
+	uint64_t head = m_header->head.load(std::memory_order_relaxed);
+
+	size_t offset = 0;
+	while (offset < length) {
+		if (m_header->closed) {
+			return os::error::Disconnected;
+		}
+
+		size_t space = size_t(capacity - std::min(head - m_header->tail.load(std::memory_order_acquire), capacity));
+		if (space == 0) {
+			os::error ec = wait(m_header->space_doorbell, m_header->producer_waiting,
+					    [this, head, capacity]() { return (head - m_header->tail.load()) < capacity; });
+			if (ec != os::error::Success) {
+				return ec;
+			}
+			continue;
+		}
+
+		size_t chunk = std::min(space, length - offset);
+		size_t start = size_t(head & m_mask);
+		size_t first = std::min(chunk, size_t(capacity) - start);
+		memcpy(m_data + start, buffer + offset, first);
+		memcpy(m_data, buffer + offset + first, chunk - first);
+
+		head += chunk;
+		offset += chunk;
+		m_header->head.store(head);
+		notify(m_header->data_doorbell, m_header->consumer_waiting);
+	}
+	return os::error::Success;
+}
+
+size_t os::linux::shm_ring::available()
+{
+	const uint64_t capacity = m_capacity;
+	uint64_t head = m_header->head.load(std::memory_order_relaxed);
+	return size_t(capacity - std::min(head - m_header->tail.load(std::memory_order_acquire), capacity));
+}
+
+os::error os::linux::shm_ring::read(std::vector<char> &buffer, size_t &length, bool is_blocking)
+{
+	if (m_header->closed) {
+		return os::error::Disconnected;
+	}
+	if (!is_blocking && m_header->head.load(std::memory_order_acquire) == m_header->tail.load(std::memory_order_relaxed)) {
+		return os::error::Pending;
+	}
+
+	if (buffer.size() < sizeof(ipc::ipc_size_t)) {
+		buffer.resize(sizeof(ipc::ipc_size_t));
+	}
+	os::error ec = receive(buffer.data(), sizeof(ipc::ipc_size_t));
+	if (ec != os::error::Success) {
+		return ec;
+	}
+
+	size_t expected = sizeof(ipc::ipc_size_t) + size_t(ipc::read_size(buffer));
+	if (buffer.size() < expected) {
+		buffer.resize(expected);
+	}
+	ec = receive(buffer.data() + sizeof(ipc::ipc_size_t), expected - sizeof(ipc::ipc_size_t));
+	if (ec != os::error::Success) {
+		return ec;
+	}
+
+	length = expected;
+	return os::error::Success;
+}
+
+void os::linux::shm_ring::close()
+{
+	m_header->closed = 1;
+	m_header->data_doorbell++;
+	m_header->space_doorbell++;
+	os::linux::utility::futex_wake(&m_header->data_doorbell, INT32_MAX, true);
+	os::linux::utility::futex_wake(&m_header->space_doorbell, INT32_MAX, true);
+}
+
+bool os::linux::shm_ring::is_closed()
+{
+	return m_header->closed != 0;
+}
+
+os::error os::linux::shm_ring::receive(char *buffer, size_t length)
+{
+	const uint64_t capacity = m_capacity;
+	uint64_t tail = m_header->tail.load(std::memory_order_relaxed);
+
+	size_t offset = 0;
+	while (offset < length) {
+		if (m_header->closed) {
+			return os::error::Disconnected;
+		}
+
+		size_t available = size_t(std::min(m_header->head.load(std::memory_order_acquire) - tail, capacity));
+		if (available == 0) {
+			os::error ec = wait(m_header->data_doorbell, m_header->consumer_waiting, [this, tail]() { return m_header->head.load() != tail; });
+			if (ec != os::error::Success) {
+				return ec;
+			}
+			continue;
+		}
+
+		size_t chunk = std::min(available, length - offset);
+		size_t start = size_t(tail & m_mask);
+		size_t first = std::min(chunk, size_t(capacity) - start);
+		memcpy(buffer + offset, m_data + start, first);
+		memcpy(buffer + offset + first, m_data, chunk - first);
+
+		tail += chunk;
+		offset += chunk;
+		m_header->tail.store(tail);
+		notify(m_header->space_doorbell, m_header->producer_waiting);
+	}
+	return os::error::Success;
+}
+
+os::error os::linux::shm_ring::wait(std::atomic<uint32_t> &doorbell, std::atomic<uint32_t> &waiting, const std::function<bool()> &ready)
+{
+	for (int spin = 0; spin < spin_limit; spin++) {
+		if (ready()) {
+			return os::error::Success;
+		}
+		cpu_relax();
+	}
+
+	while (!m_header->closed) {
+		// Announce the sleep before the final check, a producer that misses the
+		// announcement is guaranteed to have been seen by that check. Reading the
+		// doorbell first makes a wake between check and sleep fall through.
+		waiting.store(1);
+		uint32_t sequence = doorbell.load();
+		if (ready()) {
+			waiting.store(0, std::memory_order_relaxed);
+			return os::error::Success;
+		}
+
+		os::error ec = os::linux::utility::futex_wait(&doorbell, sequence, peer_check_interval, true);
+		waiting.store(0, std::memory_order_relaxed);
+		if (ec == os::error::TimedOut && m_peer_check && !m_peer_check()) {
+			close();
+		} else if (ec == os::error::Error) {
+			return ec;
+		}
+	}
+	return os::error::Disconnected;
+}
+
+void os::linux::shm_ring::notify(std::atomic<uint32_t> &doorbell, std::atomic<uint32_t> &waiting)
+{
+	if (waiting.load()) {
+		doorbell++;
+		os::linux::utility::futex_wake(&doorbell, 1, true);
+	}
+}
+
+std::unique_ptr<os::linux::shm_channel> os::linux::shm_channel::create(size_t ring_size, shm_ring::peer_check_t peer_check)
+{
+	// Positions are masked, so the capacity has to be a power of two.
+	size_t capacity = 4096;
+	while (capacity < ring_size) {
+		capacity <<= 1;
+	}
+
+	int fd = memfd_create("ipc-shm-channel", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0) {
+		throw std::runtime_error(std::string("Creating shared memory failed with error ") + strerror(errno) + ".");
+	}
+
+	size_t size = sizeof(region_header) + 2 * shm_ring::required_size(capacity);
+	if (ftruncate(fd, off_t(size)) < 0 || fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+		int error_code = errno;
+		::close(fd);
+		throw std::runtime_error(std::string("Sizing shared memory failed with error ") + strerror(error_code) + ".");
+	}
+
+	return std::unique_ptr<os::linux::shm_channel>(new os::linux::shm_channel(fd, size, true, peer_check));
+}
+
+std::unique_ptr<os::linux::shm_channel> os::linux::shm_channel::open(int fd, shm_ring::peer_check_t peer_check)
+{
+	// The peer may only hand over a region that can't shrink underneath us.
+	struct stat st = {};
+	int seals = fcntl(fd, F_GET_SEALS);
+	if (fstat(fd, &st) < 0 || seals < 0 || (seals & F_SEAL_SHRINK) == 0 || size_t(st.st_size) < sizeof(region_header)) {
+		::close(fd);
+		throw std::runtime_error("Shared memory handed over by the peer is not usable.");
+	}
+
+	return std::unique_ptr<os::linux::shm_channel>(new os::linux::shm_channel(fd, size_t(st.st_size), false, peer_check));
+}
+
+os::linux::shm_channel::shm_channel(int fd, size_t size, bool initialize, shm_ring::peer_check_t peer_check) : m_fd(fd), m_size(size)
+{
+	m_memory = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+	if (m_memory == MAP_FAILED) {
+		int error_code = errno;
+		::close(m_fd);
+		throw std::runtime_error(std::string("Mapping shared memory failed with error ") + strerror(error_code) + ".");
+	}
+
+	region_header *region = static_cast<region_header *>(m_memory);
+	char *rings = static_cast<char *>(m_memory) + sizeof(region_header);
+	if (initialize) {
+		region->magic = SHM_CHANNEL_MAGIC;
+		region->version = SHM_CHANNEL_VERSION;
+		region->ring_size = (m_size - sizeof(region_header)) / 2 - sizeof(shm_ring::header);
+		shm_ring::initialize(rings, size_t(region->ring_size));
+		shm_ring::initialize(rings + shm_ring::required_size(size_t(region->ring_size)), size_t(region->ring_size));
+	}
+
+	size_t ring_size = size_t(region->ring_size);
+	bool valid = region->magic == SHM_CHANNEL_MAGIC && region->version == SHM_CHANNEL_VERSION && ring_size != 0 &&
+		     (ring_size & (ring_size - 1)) == 0 && sizeof(region_header) + 2 * shm_ring::required_size(ring_size) <= m_size;
+	shm_ring::header *first = reinterpret_cast<shm_ring::header *>(rings);
+	shm_ring::header *second = reinterpret_cast<shm_ring::header *>(rings + (valid ? shm_ring::required_size(ring_size) : 0));
+	if (!valid || first->capacity != ring_size || second->capacity != ring_size) {
+		munmap(m_memory, m_size);
+		::close(m_fd);
+		throw std::runtime_error("Shared memory handed over by the peer has an unknown layout.");
+	}
+
+	m_requests = std::make_unique<os::linux::shm_ring>(first, peer_check);
+	m_replies = std::make_unique<os::linux::shm_ring>(second, peer_check);
+}
+
+os::linux::shm_channel::~shm_channel()
+{
+	m_requests = nullptr;
+	m_replies = nullptr;
+	munmap(m_memory, m_size);
+	::close(m_fd);
+}
+
+int os::linux::shm_channel::get_handle()
+{
+	return m_fd;
+}
+
+os::linux::shm_ring &os::linux::shm_channel::requests()
+{
+	return *m_requests;
+}
+
+os::linux::shm_ring &os::linux::shm_channel::replies()
+{
+	return *m_replies;
+}
+
+void os::linux::shm_channel::close()
+{
+	m_requests->close();
+	m_replies->close();
+}
@@ -0,0 +1,116 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#ifndef OS_LINUX_SHM_RING_HPP
+#define OS_LINUX_SHM_RING_HPP
+
+#include "utility.hpp"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace os {
+namespace linux {
+/** Single-producer single-consumer byte ring living in shared memory.
+ *
+ * Frames are copied straight into the mapping and published by advancing
+ * |head|, the consumer releases them by advancing |tail|. Either side only
+ * enters the kernel when it has to sleep, or to wake a peer that announced it
+ * is sleeping through its *_waiting word. Frames larger than the ring are
+ * streamed through it in pieces.
+ */
+class shm_ring {
+public:
+	struct header {
+		alignas(64) std::atomic<uint64_t> head;
+		std::atomic<uint32_t> data_doorbell;
+		std::atomic<uint32_t> consumer_waiting;
+		alignas(64) std::atomic<uint64_t> tail;
+		std::atomic<uint32_t> space_doorbell;
+		std::atomic<uint32_t> producer_waiting;
+		alignas(64) std::atomic<uint32_t> closed;
+		uint64_t capacity;
+	};
+	static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+		      "shared memory rings need address-free atomics");
+
+	// Called after a sleep timed out, returning false closes the ring.
+	typedef std::function<bool()> peer_check_t;
+
+	static size_t required_size(size_t capacity);
+	static void initialize(void *memory, size_t capacity);
+
+	shm_ring(void *memory, peer_check_t peer_check);
+
+	os::error write(const char *buffer, size_t length);
+	// Bytes write() takes right now without waiting for the reader.
+	size_t available();
+
+	/** Receive the next frame into |buffer|, same contract as socket_linux::read().
+	 *
+	 * Without |is_blocking| this only returns Pending while the ring is empty,
+	 * a frame that has started to arrive is always received completely.
+	 */
+	os::error read(std::vector<char> &buffer, size_t &length, bool is_blocking);
+
+	// Fail current and future reads and writes on both sides.
+	void close();
+	bool is_closed();
+
+private:
+	header *m_header;
+	char *m_data;
+	uint64_t m_capacity;
+	uint64_t m_mask;
+	peer_check_t m_peer_check;
+
+	os::error receive(char *buffer, size_t length);
+	os::error wait(std::atomic<uint32_t> &doorbell, std::atomic<uint32_t> &waiting, const std::function<bool()> &ready);
+	void notify(std::atomic<uint32_t> &doorbell, std::atomic<uint32_t> &waiting);
+};
+
+/** memfd region holding the request and the reply ring of one connection.
+ *
+ * The client creates it and hands the descriptor to the server over the
+ * socket, after which the socket only serves to detect a dead peer.
+ */
+class shm_channel {
+	int m_fd = -1;
+	void *m_memory = nullptr;
+	size_t m_size = 0;
+	std::unique_ptr<shm_ring> m_requests, m_replies;
+
+	shm_channel(int fd, size_t size, bool initialize, shm_ring::peer_check_t peer_check);
+
+public:
+	static constexpr size_t default_ring_size = 1024 * 1024;
+
+	static std::unique_ptr<os::linux::shm_channel> create(size_t ring_size, shm_ring::peer_check_t peer_check);
+	static std::unique_ptr<os::linux::shm_channel> open(int fd, shm_ring::peer_check_t peer_check);
+	~shm_channel();
+
+	int get_handle();
+	os::linux::shm_ring &requests();
+	os::linux::shm_ring &replies();
+	void close();
+};
+}
+}
+
+#endif
@@ -0,0 +1,123 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#include "utility.hpp"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex words must be plain 32-bit integers");
+
+os::error os::linux::utility::translate_error(int error_code)
+{
+	switch (error_code) {
+	case 0:
+		return os::error::Success;
+	case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+	case EWOULDBLOCK:
+#endif
+	case EINPROGRESS:
+		return os::error::Pending;
+	case EPIPE:
+	case ECONNRESET:
+	case ECONNREFUSED:
+	case ENOTCONN:
+	case ENOENT:
+	case EBADF:
+		return os::error::Disconnected;
+	case EISCONN:
+		return os::error::Connected;
+	case EMSGSIZE:
+		return os::error::BufferTooLarge;
+	case ETIMEDOUT:
+		return os::error::TimedOut;
+	case ENOBUFS:
+	case ENOMEM:
+		return os::error::BufferOverflow;
+	}
+	return os::error::Error;
+}
+
+os::error os::linux::utility::futex_wait(std::atomic<uint32_t> *word, uint32_t expected, std::chrono::nanoseconds timeout, bool shared)
+{
+	timespec ts;
+	timespec *pts = nullptr;
+	if (timeout.count() >= 0) {
+		ts.tv_sec = time_t(timeout.count() / 1000000000);
+		ts.tv_nsec = long(timeout.count() % 1000000000);
+		pts = &ts;
+	}
+
+	if (syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE, expected, pts, nullptr, 0) < 0) {
+		switch (errno) {
+		case EAGAIN:
+		case EINTR:
+			return os::error::Success;
+		case ETIMEDOUT:
+			return os::error::TimedOut;
+		}
+		return os::error::Error;
+	}
+	return os::error::Success;
+}
+
+void os::linux::utility::futex_wake(std::atomic<uint32_t> *word, int count, bool shared)
+{
+	syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+int os::linux::utility::create_shared_memory(const char *prefix, size_t size, std::string &name)
+{
+	static std::atomic<uint64_t> counter(0);
+
+	int fd = -1;
+	while (fd < 0) {
+		name = prefix + std::to_string(getpid()) + "-" + std::to_string(counter++);
+		fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+		// Left behind by an earlier process with the same pid, try the next one.
+		if (fd < 0 && errno != EEXIST) {
+			return -1;
+		}
+	}
+
+	if (ftruncate(fd, off_t(size)) < 0) {
+		int error_code = errno;
+		close(fd);
+		shm_unlink(name.c_str());
+		errno = error_code;
+		return -1;
+	}
+	return fd;
+}
+
+int os::linux::utility::open_shared_memory(const char *prefix, const std::string &name)
+{
+	// Only ever an object the library created, a peer doesn't get to pick arbitrary ones.
+	if (name.compare(0, strlen(prefix), prefix) != 0 || name.find('/', 1) != std::string::npos) {
+		errno = EINVAL;
+		return -1;
+	}
+	return shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+}
@@ -0,0 +1,50 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#ifndef OS_LINUX_UTILITY_HPP
+#define OS_LINUX_UTILITY_HPP
+
+// GNU dialects predefine 'linux' as 1, which would clash with the namespace name.
+#ifdef linux
+#undef linux
+#endif
+
+#include "error.hpp"
+#include <atomic>
+#include <chrono>
+#include <inttypes.h>
+#include <string>
+
+namespace os {
+namespace linux {
+namespace utility {
+os::error translate_error(int error_code);
+
+// Sleep while |*word| equals |expected|. |shared| must be set for words that live in memory shared with another process.
+os::error futex_wait(std::atomic<uint32_t> *word, uint32_t expected, std::chrono::nanoseconds timeout, bool shared);
+void futex_wake(std::atomic<uint32_t> *word, int count, bool shared);
+
+// POSIX shared memory objects for regions that peers on the shared memory transport, which can't receive descriptors, have to open.
+// Creating names the object |prefix| plus a unique suffix. Both return -1 with errno set on failure, opening a name without |prefix| included.
+int create_shared_memory(const char *prefix, size_t size, std::string &name);
+int open_shared_memory(const char *prefix, const std::string &name);
+};
+}
+}
+
+#endif
@@ -0,0 +1,205 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+
+#include "fifo.hpp"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static os::error translate_error(int error_code)
+{
+	switch (error_code) {
+	case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+	case EWOULDBLOCK:
+#endif
+		return os::error::Pending;
+	case EPIPE:
+	case ENOENT:
+	case EBADF:
+		return os::error::Disconnected;
+	}
+	return os::error::Error;
+}
+
+static bool set_flags(int fd)
+{
+	// pipe2() is not available everywhere.
+	return fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) >= 0 && fcntl(fd, F_SETFD, FD_CLOEXEC) >= 0;
+}
+
+int os::posix::fifo::make(const std::string &path)
+{
+	if (unlink(path.c_str()) < 0 && errno != ENOENT) {
+		return -1;
+	}
+	return mkfifo(path.c_str(), S_IRUSR | S_IWUSR);
+}
+
+os::posix::fifo::fifo(const std::string &path, size_t buffer_size) : m_closed(false), m_buffer(std::max(buffer_size, size_t(4096)))
+{
+	// Read-write, so neither side waits in open() for the other and reads never see end of file.
+	m_fd = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (m_fd < 0) {
+		throw std::runtime_error(std::string("Opening ") + path + " failed with error " + strerror(errno) + ".");
+	}
+
+	if (pipe(m_wake) < 0 || !set_flags(m_wake[0]) || !set_flags(m_wake[1])) {
+		int error_code = errno;
+		::close(m_fd);
+		if (m_wake[0] >= 0) {
+			::close(m_wake[0]);
+			::close(m_wake[1]);
+		}
+		throw std::runtime_error(std::string("Creating a wake pipe failed with error ") + strerror(error_code) + ".");
+	}
+}
+
+os::posix::fifo::~fifo()
+{
+	close();
+	::close(m_fd);
+	::close(m_wake[0]);
+	::close(m_wake[1]);
+}
+
+os::error os::posix::fifo::read(char *buffer, size_t length, bool is_blocking)
+{
+	std::unique_lock<std::mutex> ul(m_read_mtx);
+
+	size_t offset = 0;
+	while (offset < length) {
+		if (m_closed) {
+			return os::error::Disconnected;
+		}
+
+		if (m_begin != m_end) {
+			size_t chunk = std::min(m_end - m_begin, length - offset);
+			memcpy(buffer + offset, m_buffer.data() + m_begin, chunk);
+			m_begin += chunk;
+			offset += chunk;
+			continue;
+		}
+
+		// Whatever is left either fits the buffer, which then takes in everything available, or goes straight to the caller.
+		m_begin = m_end = 0;
+		bool direct = length - offset >= m_buffer.size();
+		ssize_t ret = direct ? ::read(m_fd, buffer + offset, length - offset) : ::read(m_fd, m_buffer.data(), m_buffer.size());
+		if (ret > 0) {
+			if (direct) {
+				offset += size_t(ret);
+			} else {
+				m_end = size_t(ret);
+			}
+			continue;
+		} else if (ret == 0) {
+			return os::error::Disconnected;
+		} else if (errno == EINTR) {
+			continue;
+		} else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+			return translate_error(errno);
+		}
+
+		if (offset == 0 && !is_blocking) {
+			return os::error::Pending;
+		}
+		os::error ec = wait(POLLIN);
+		if (ec != os::error::Success) {
+			return ec;
+		}
+	}
+	return os::error::Success;
+}
+
+os::error os::posix::fifo::write(const char *buffer, size_t length)
+{
+	std::unique_lock<std::mutex> ul(m_write_mtx);
+
+	size_t offset = 0;
+	while (offset < length) {
+		if (m_closed) {
+			return os::error::Disconnected;
+		}
+
+		ssize_t ret = ::write(m_fd, buffer + offset, length - offset);
+		if (ret > 0) {
+			offset += size_t(ret);
+			continue;
+		} else if (ret < 0 && errno == EINTR) {
+			continue;
+		} else if (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+			return translate_error(errno);
+		}
+
+		// The FIFO is full until the reader catches up.
+		os::error ec = wait(POLLOUT);
+		if (ec != os::error::Success) {
+			return ec;
+		}
+	}
+	return os::error::Success;
+}
+
+void os::posix::fifo::close()
+{
+	if (!m_closed.exchange(true)) {
+		char byte = 0;
+		while (::write(m_wake[1], &byte, 1) < 0 && errno == EINTR) {
+		}
+	}
+}
+
+bool os::posix::fifo::is_closed()
+{
+	return m_closed;
+}
+
+int os::posix::fifo::get_handle()
+{
+	return m_fd;
+}
+
+os::error os::posix::fifo::wait(short events)
+{
+	struct pollfd fds[2] = {{m_fd, events, 0}, {m_wake[0], POLLIN, 0}};
+	while (!m_closed) {
+		int ret = poll(fds, 2, -1);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return os::error::Error;
+		}
+
+		if (fds[1].revents != 0) {
+			break;
+		} else if ((fds[0].revents & (POLLERR | POLLNVAL)) != 0) {
+			return os::error::Disconnected;
+		} else if (fds[0].revents != 0) {
+			return os::error::Success;
+		}
+	}
+	return os::error::Disconnected;
+}
@@ -0,0 +1,80 @@
+/******************************************************************************
+    Copyright (C) 2016-2019 by Streamlabs (General Workings Inc)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+
+#ifndef OS_POSIX_FIFO_HPP
+#define OS_POSIX_FIFO_HPP
+
+#include "error.hpp"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace os {
+namespace posix {
+/** One direction of a FIFO connection, opened once and kept for its lifetime.
+ *
+ * The descriptor is opened read-write and non-blocking, so opening never waits
+ * for the peer and a write end always exists. Waiting is done with poll(), and
+ * reads are served from a reusable buffer that takes in everything available
+ * with a single read() instead of one call per field. Reads larger than that
+ * buffer go straight into the caller's memory.
+ */
+class fifo {
+public:
+	static constexpr size_t default_buffer_size = 64 * 1024;
+
+	// Replace whatever is left at |path| with a fresh FIFO, -1 and errno on failure.
+	static int make(const std::string &path);
+
+	fifo(const std::string &path, size_t buffer_size = default_buffer_size);
+	~fifo();
+
+	/** Read exactly |length| bytes into |buffer|.
+	 *
+	 * Without |is_blocking| this only returns Pending while nothing has arrived,
+	 * once some data is there the read is always completed.
+	 */
+	os::error read(char *buffer, size_t length, bool is_blocking);
+
+	// Write all of |buffer|, concurrent writers never interleave.
+	os::error write(const char *buffer, size_t length);
+
+	// Fail current and future reads and writes, waking anyone blocked in them.
+	void close();
+	bool is_closed();
+
+	int get_handle();
+
+private:
+	int m_fd = -1;
+	int m_wake[2] = {-1, -1};
+	std::atomic<bool> m_closed;
+
+	std::mutex m_read_mtx, m_write_mtx;
+	std::vector<char> m_buffer;
+	size_t m_begin = 0, m_end = 0;
+
+	// Wait until the descriptor is ready for |events| or the fifo is closed.
+	os::error wait(short events);
+};
+}
+}
+
+#endif
@@ -3,6 +3,7 @@
 #include <set>
 
 #include "ipc-client-win.hpp"
+#include "../include/ipc-completion.hpp"
 #include "semaphore.hpp"
 
 call_return_t g_fn = NULL;
@@ -23,6 +24,12 @@ std::shared_ptr<ipc::client> ipc::client::create(std::string socketPath)
 	return std::make_unique<ipc::client_win>(socketPath);
 }
 
+std::shared_ptr<ipc::client> ipc::client::create(const std::string &socketPath, call_on_disconnect_t disconnectionCallback, transport)
+{
+	// Only the named pipe transport exists on Windows.
+	return std::make_unique<ipc::client_win>(socketPath, disconnectionCallback);
+}
+
 ipc::client_win::client_win(const std::string &socketPath, call_on_disconnect_t disconnectionCallback)
 	: m_socketPath(socketPath), m_disconnectionCallback(disconnectionCallback)
 {
@@ -59,8 +66,6 @@ void ipc::client_win::stop()
 
 bool ipc::client_win::call(const std::string &cname, const std::string &fname, std::vector<ipc::value> args, call_return_t fn, void *data, int64_t &cbid)
 {
-	static std::mutex mtx;
-	static uint64_t timestamp = 0;
 	os::error ec;
 	std::shared_ptr<os::async_op> write_op;
 	ipc::message::function_call fnc_call_msg;
@@ -69,10 +74,11 @@ bool ipc::client_win::call(const std::string &cname, const std::string &fname, s
 	if (!m_socket)
 		return false;
 
-	{
-		std::unique_lock<std::mutex> ulock(mtx);
-		timestamp++;
-		fnc_call_msg.uid = ipc::value(timestamp);
+	// Replies are matched back to their callback by uid, the callback is dropped again if the call doesn't go out.
+	fnc_call_msg.uid = ipc::value(m_calls.insert(fn, data));
+	// The shared default would be written by every thread calling at the same time, only a caller's own is set.
+	if (fn != nullptr && &cbid != &g_cbid) {
+		cbid = int64_t(fnc_call_msg.uid.value_union.ui64);
 	}
 
 	// Set
@@ -86,19 +92,14 @@ bool ipc::client_win::call(const std::string &cname, const std::string &fname, s
 		fnc_call_msg.serialize(buf, sizeof(ipc_size_t));
 	} catch (std::exception &e) {
 		ipc::log("(write) %8llu: Failed to serialize, error %s.", fnc_call_msg.uid.value_union.ui64, e.what());
+		m_calls.cancel(fnc_call_msg.uid.value_union.ui64);
 		throw e;
 	}
 
-	if (fn != nullptr) {
-		std::unique_lock<std::mutex> ulock(m_lock);
-		m_cb.insert(std::make_pair(fnc_call_msg.uid.value_union.ui64, std::make_pair(fn, data)));
-		cbid = fnc_call_msg.uid.value_union.ui64;
-	}
-
 	ipc::make_sendable(buf);
 	ec = m_socket->write(buf.data(), buf.size(), write_op, nullptr);
 	if (ec != os::error::Success && ec != os::error::Pending) {
-		cancel(cbid);
+		m_calls.cancel(fnc_call_msg.uid.value_union.ui64);
 		//write_op->cancel();
 		return false;
 	}
@@ -109,7 +110,7 @@ bool ipc::client_win::call(const std::string &cname, const std::string &fname, s
 	}
 
 	if (ec != os::error::Success) {
-		cancel(cbid);
+		m_calls.cancel(fnc_call_msg.uid.value_union.ui64);
 		write_op->cancel();
 		return false;
 	}
@@ -121,7 +122,7 @@ std::vector<ipc::value> ipc::client_win::call_synchronous_helper(const std::stri
 {
 	// Set up call reference data.
 	struct CallData {
-		std::shared_ptr<os::windows::semaphore> sgn = std::make_shared<os::windows::semaphore>();
+		ipc::completion::lease done;
 		bool called = false;
 		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
 
@@ -138,7 +139,7 @@ std::vector<ipc::value> ipc::client_win::call_synchronous_helper(const std::stri
 
 		cd.obs_call_duration = obs_call_duration;
 		cd.called = true;
-		cd.sgn->signal();
+		cd.done->signal();
 	};
 
 	int64_t cbid = 0;
@@ -150,7 +151,7 @@ std::vector<ipc::value> ipc::client_win::call_synchronous_helper(const std::stri
 	static const auto long_call_timeout = std::chrono::milliseconds(100);
 	bool long_call_flagged = false;
 	bool freeze_flagged = false;
-	while (cd.sgn->wait(long_call_timeout) == os::error::TimedOut) {
+	while (!cd.done->wait_for(long_call_timeout)) {
 		long_call_flagged = true;
 
 		// Logging of probable freeze
@@ -181,6 +182,11 @@ void ipc::client::set_freeze_callback(call_on_freeze_t cb, std::string app_state
 	m_app_state_path = app_state;
 }
 
+void ipc::client::set_shared_binary_threshold(size_t bytes)
+{
+	m_shared_binary_threshold = bytes;
+}
+
 void ipc::client_win::worker()
 {
 	os::error ec = os::error::Success;
@@ -219,13 +225,8 @@ void ipc::client_win::worker()
 	proc_rval[0].type = ipc::type::Null;
 	proc_rval[0].value_str = "Lost IPC Connection";
 
-	{
-		std::unique_lock<std::mutex> ulock(m_lock);
-		for (auto &cb : m_cb) {
-			cb.second.first(cb.second.second, proc_rval, std::chrono::milliseconds(0));
-		}
-
-		m_cb.clear();
+	for (auto &cb : m_calls.drain()) {
+		cb.first(cb.second, proc_rval, std::chrono::milliseconds(0));
 	}
 
 	if (!m_socket->is_connected()) {
@@ -271,13 +272,10 @@ void ipc::client_win::read_callback_msg(os::error ec, size_t size)
 		throw e;
 	}
 
-	// Find the callback function.
-	std::unique_lock<std::mutex> ulock(m_lock);
-	auto cb2 = m_cb.find(fnc_reply_msg.uid.value_union.ui64);
-	if (cb2 == m_cb.end()) {
+	// Find the callback function. Nothing is locked while it runs, so it may take its time or make another call.
+	if (!m_calls.take(fnc_reply_msg.uid.value_union.ui64, cb)) {
 		return;
 	}
-	cb = cb2->second;
 
 	// Decode return values or errors.
 	if (fnc_reply_msg.error.value_str.size() > 0) {
@@ -288,13 +286,9 @@ void ipc::client_win::read_callback_msg(os::error ec, size_t size)
 
 	// Call Callback
 	cb.first(cb.second, fnc_reply_msg.values, std::chrono::milliseconds(fnc_reply_msg.obs_call_duration_ms.value_union.ui32));
-
-	// Remove cb entry
-	m_cb.erase(fnc_reply_msg.uid.value_union.ui64);
 }
 
 bool ipc::client_win::cancel(int64_t const &id)
 {
-	std::unique_lock<std::mutex> ulock(m_lock);
-	return m_cb.erase(id) != 0;
+	return m_calls.cancel(uint64_t(id));
 }
\ No newline at end of file
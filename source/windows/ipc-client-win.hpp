@@ -1,4 +1,5 @@
 #include "../include/ipc-client.hpp"
+#include "../include/ipc-call-table.hpp"
 #include "../include/error.hpp"
 #include "ipc-socket-win.hpp"
 
@@ -30,8 +31,7 @@ private:
 	std::shared_ptr<os::async_op> m_rop;
 
 	bool m_authenticated = false;
-	std::mutex m_lock;
-	std::map<int64_t, std::pair<call_return_t, void *>> m_cb;
+	ipc::call_table m_calls;
 
 	// Threading
 	struct {
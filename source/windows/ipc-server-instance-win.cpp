@@ -66,15 +66,18 @@ void ipc::server_instance_win::worker()
 		}
 		if (!m_wop || !m_wop->is_valid()) {
 			if (m_write_queue.size() > 0) {
-				std::vector<char> &fbuf = m_write_queue.front();
-				ipc::make_sendable(fbuf);
-				ec = m_socket->write(fbuf.data(), fbuf.size(), m_wop, std::bind(&ipc::server_instance_win::write_callback, this, _1, _2));
+				// Moved to m_wbuf, which outlives the WriteFileEx, so the queue entry can go right away.
+				m_wbuf = std::move(m_write_queue.front());
+				m_write_queue.pop();
+				ipc::make_sendable(m_wbuf);
+
+				ec = m_socket->write(m_wbuf.data(), m_wbuf.size(), m_wop, std::bind(&ipc::server_instance_win::write_callback, this, _1, _2));
 				if (ec != os::error::Pending && ec != os::error::Success) {
 					if (ec == os::error::Disconnected) {
 						break;
 					} else {
 						const DWORD parent_proc_exit_code = os::windows::utility::get_parent_process_exit_code();
-						ipc::log("Write buffer operation failed with error %d %p, pp_exit_code=%d", static_cast<int>(ec), &fbuf,
+						ipc::log("Write buffer operation failed with error %d %p, pp_exit_code=%d", static_cast<int>(ec), &m_wbuf,
 							 parent_proc_exit_code);
 						throw std::exception("Write buffer operation failed");
 					}
@@ -83,7 +86,6 @@ void ipc::server_instance_win::worker()
 				std::unique_lock<std::mutex> lock(m_watchdog_mutex);
 				m_write_waiting = false;
 				lock.unlock();
-				m_write_queue.pop();
 			}
 		}
 
@@ -108,6 +110,11 @@ void ipc::server_instance_win::worker()
 			}
 		}
 	}
+
+	// Unless the server is the one tearing this down, have it reaped now.
+	if (!m_stopWorkers) {
+		m_parent->client_disconnected(m_socket);
+	}
 }
 
 void ipc::server_instance_win::read_callback_init(os::error ec, size_t size)
@@ -0,0 +1,169 @@
+#include "ipc-call-table.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+// The client's table of calls in flight: uids that collide with a call still
+// holding their slot, more calls than slots, cancelling and draining, and
+// many threads registering and completing calls at once. Then the cost of
+// a register and lookup pair against the mutex and std::map it replaces.
+
+#define OPERATIONS 1000000
+
+static void callback(void *data, const std::vector<ipc::value> &rval, std::chrono::high_resolution_clock::duration) {}
+
+static void *tag(uint64_t value)
+{
+	return reinterpret_cast<void *>(uintptr_t(value));
+}
+
+static bool check_single()
+{
+	ipc::call_table table;
+	ipc::call_table::entry entry;
+
+	// A call that stays in flight makes the uid that would share its slot get skipped.
+	uint64_t held = table.insert(callback, tag(1));
+	std::set<uint64_t> uids;
+	for (size_t idx = 0; idx < ipc::call_table::capacity; idx++) {
+		uint64_t uid = table.insert(callback, tag(idx + 2));
+		if (!uids.insert(uid).second || uid % ipc::call_table::capacity == held % ipc::call_table::capacity) {
+			fprintf(stdout, "Uid %llu was handed out twice or shares a slot with a call in flight.\n", (unsigned long long)uid);
+			return false;
+		}
+		if (!table.take(uid, entry) || entry.first != callback || entry.second != tag(idx + 2) || table.take(uid, entry)) {
+			fprintf(stdout, "Call %llu did not come back exactly once.\n", (unsigned long long)uid);
+			return false;
+		}
+	}
+
+	// Calls without a callback only take a uid.
+	uint64_t bare = table.insert(nullptr, nullptr);
+	if (table.take(bare, entry) || !table.cancel(held) || table.take(held, entry)) {
+		fprintf(stdout, "Cancelling, or a call without a callback, went wrong.\n");
+		return false;
+	}
+
+	// Four times as many calls as slots, the rest end up in the overflow map.
+	std::vector<uint64_t> flight;
+	for (size_t idx = 0; idx < 4 * ipc::call_table::capacity; idx++) {
+		flight.push_back(table.insert(callback, tag(idx)));
+	}
+	for (size_t idx = 0; idx < flight.size(); idx += 2) {
+		if (!table.take(flight[idx], entry) || entry.second != tag(idx)) {
+			fprintf(stdout, "Call %zu of a full table came back wrong.\n", idx);
+			return false;
+		}
+	}
+	std::vector<ipc::call_table::entry> rest = table.drain();
+	std::set<void *> tags;
+	for (auto &call : rest) {
+		tags.insert(call.second);
+	}
+	bool odd_only = tags.size() == flight.size() / 2;
+	for (size_t idx = 1; idx < flight.size(); idx += 2) {
+		odd_only = odd_only && tags.count(tag(idx)) == 1;
+	}
+	if (rest.size() != flight.size() / 2 || !odd_only || !table.drain().empty()) {
+		fprintf(stdout, "Drain returned %zu calls instead of the %zu left.\n", rest.size(), flight.size() / 2);
+		return false;
+	}
+	fprintf(stdout, "Single thread: collisions skipped, %zu calls in flight in %zu slots, drain complete.\n", flight.size(),
+		ipc::call_table::capacity);
+	return true;
+}
+
+// Every thread keeps |depth| calls of its own in flight and completes them out of order.
+template<typename Table> static bool run_threads(Table &table, size_t threads, size_t depth, uint64_t &ns)
+{
+	std::atomic<size_t> wrong(0);
+	std::vector<std::thread> workers;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t thread = 0; thread < threads; thread++) {
+		workers.emplace_back([&table, &wrong, thread, threads, depth]() {
+			std::vector<std::pair<uint64_t, void *>> flight;
+			ipc::call_table::entry entry;
+			for (size_t idx = 0; idx < OPERATIONS / threads; idx++) {
+				void *data = tag((uint64_t(thread) << 32) | idx);
+				flight.emplace_back(table.insert(callback, data), data);
+				if (flight.size() == depth) {
+					for (size_t done = depth; done-- > 0;) {
+						if (!table.take(flight[done].first, entry) || entry.second != flight[done].second) {
+							wrong++;
+						}
+					}
+					flight.clear();
+				}
+			}
+			for (auto &call : flight) {
+				if (!table.take(call.first, entry) || entry.second != call.second) {
+					wrong++;
+				}
+			}
+		});
+	}
+	for (auto &worker : workers) {
+		worker.join();
+	}
+	ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count() / OPERATIONS);
+	return wrong == 0;
+}
+
+// What the clients used before: a process-wide counter behind a mutex and a std::map behind another.
+struct locked_map {
+	std::mutex counter_mtx, mtx;
+	uint64_t counter = 0;
+	std::map<int64_t, ipc::call_table::entry> calls;
+
+	uint64_t insert(call_return_t fn, void *data)
+	{
+		uint64_t uid;
+		{
+			std::unique_lock<std::mutex> ul(counter_mtx);
+			uid = ++counter;
+		}
+		std::unique_lock<std::mutex> ul(mtx);
+		calls.insert(std::make_pair(uid, std::make_pair(fn, data)));
+		return uid;
+	}
+	bool take(uint64_t uid, ipc::call_table::entry &entry)
+	{
+		std::unique_lock<std::mutex> ul(mtx);
+		auto found = calls.find(int64_t(uid));
+		if (found == calls.end()) {
+			return false;
+		}
+		entry = found->second;
+		calls.erase(found);
+		return true;
+	}
+};
+
+int main(int argc, char *argv[])
+{
+	bool passed = check_single();
+
+	for (size_t threads : {1, 4, 16}) {
+		for (size_t depth : {1, 64}) {
+			ipc::call_table table;
+			locked_map map;
+			uint64_t table_ns = 0, map_ns = 0;
+			bool table_ok = run_threads(table, threads, depth, table_ns);
+			bool map_ok = run_threads(map, threads, depth, map_ns);
+			if (!table_ok || !map_ok || !table.drain().empty()) {
+				fprintf(stdout, "%zu threads, %zu deep: calls came back wrong.\n", threads, depth);
+				passed = false;
+			}
+			fprintf(stdout, "%2zu threads, %2zu in flight each: table %3llu ns, mutex and map %3llu ns per call (%.2fx).\n", threads, depth,
+				(unsigned long long)table_ns, (unsigned long long)map_ns, double(map_ns) / double(table_ns ? table_ns : 1));
+		}
+	}
+
+	fprintf(stdout, "Call table checks %s.\n", passed ? "passed" : "failed");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+#include "ipc.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Serializing a function call into a fresh, pre-measured std::vector against
+// appending it to a reused ipc::frame_builder. Both must produce the same
+// bytes, also when large binaries are referenced instead of copied.
+
+#define TOTAL_ARGUMENTS 4000000
+
+static ipc::message::function_call make_call(size_t arguments)
+{
+	ipc::message::function_call call;
+	call.uid = ipc::value(uint64_t(12345));
+	call.class_name = ipc::value(std::string("Benchmark"));
+	call.function_name = ipc::value(std::string("Function1"));
+	for (size_t idx = 0; idx < arguments; idx++) {
+		switch (idx % 3) {
+		case 0:
+			call.arguments.push_back(ipc::value(uint64_t(idx)));
+			break;
+		case 1:
+			call.arguments.push_back(ipc::value(double(idx) * 0.5));
+			break;
+		case 2:
+			call.arguments.push_back(ipc::value("argument-" + std::to_string(idx)));
+			break;
+		}
+	}
+	return call;
+}
+
+int main(int argc, char *argv[])
+{
+	int failures = 0;
+	ipc::frame_builder builder;
+
+	for (size_t arguments : {1, 16, 256}) {
+		ipc::message::function_call call = make_call(arguments);
+		size_t iterations = TOTAL_ARGUMENTS / arguments;
+
+		// Same output from both paths.
+		std::vector<char> buf(call.size() + sizeof(ipc::ipc_size_t));
+		call.serialize(buf, sizeof(ipc::ipc_size_t));
+		ipc::make_sendable(buf);
+		builder.reset();
+		call.serialize(builder);
+		builder.finish();
+		if (buf.size() != builder.size() || memcmp(buf.data() + sizeof(ipc::ipc_size_real_t), builder.data() + sizeof(ipc::ipc_size_real_t),
+							   buf.size() - sizeof(ipc::ipc_size_real_t)) != 0) {
+			fprintf(stdout, "%3zu arguments: frame builder output differs.\n", arguments);
+			failures++;
+			continue;
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t idx = 0; idx < iterations; idx++) {
+			std::vector<char> frame(call.size() + sizeof(ipc::ipc_size_t));
+			call.serialize(frame, sizeof(ipc::ipc_size_t));
+			ipc::make_sendable(frame);
+		}
+		auto vector_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+		start = std::chrono::high_resolution_clock::now();
+		for (size_t idx = 0; idx < iterations; idx++) {
+			builder.reset();
+			call.serialize(builder);
+			builder.finish();
+		}
+		auto builder_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+		fprintf(stdout, "%3zu arguments, %6zu byte frame: vector %6llu ns, frame builder %6llu ns per call (%.2fx).\n", arguments, buf.size(),
+			(unsigned long long)(vector_ns / iterations), (unsigned long long)(builder_ns / iterations), double(vector_ns) / double(builder_ns));
+	}
+
+	// Referenced binaries gathered back in order give the copied frame.
+	ipc::message::function_call call = make_call(3);
+	call.arguments.push_back(ipc::value(std::vector<char>(100000, 'r')));
+	call.arguments.push_back(ipc::value(std::vector<char>(100, 'c')));
+	call.arguments.push_back(ipc::value(std::vector<char>(20000, 'R')));
+	builder.reset();
+	builder.set_reference_threshold(0);
+	call.serialize(builder, nullptr, ipc::protocol::v2);
+	builder.finish(ipc::protocol::v2);
+	std::vector<char> copied(builder.data(), builder.data() + builder.size());
+
+	ipc::frame_builder referencing;
+	referencing.set_reference_threshold(16 * 1024);
+	referencing.reset();
+	call.serialize(referencing, nullptr, ipc::protocol::v2);
+	referencing.finish(ipc::protocol::v2);
+	std::vector<ipc::frame_segment> segments;
+	referencing.gather(segments);
+	std::vector<char> gathered;
+	for (const ipc::frame_segment &segment : segments) {
+		gathered.insert(gathered.end(), segment.data, segment.data + segment.length);
+	}
+	if (gathered != copied || referencing.frame_size() != copied.size() || referencing.size() + 120000 != copied.size()) {
+		fprintf(stdout, "Referenced binaries: gathered frame differs from the copied one.\n");
+		failures++;
+	} else {
+		fprintf(stdout, "Referenced binaries: %zu byte frame from %zu segments, %zu bytes buffered.\n", gathered.size(), segments.size(),
+			referencing.size());
+	}
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+#include "ipc.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Several frames taken in at once, a prefix and a body split over receives, and
+// a frame far larger than the buffer, which must be received in place and
+// handed over without being copied.
+
+#define ITERATIONS 1000000
+
+static std::vector<char> make_frame(size_t body, char fill)
+{
+	std::vector<char> frame(sizeof(ipc::ipc_size_t) + body, fill);
+	ipc::make_sendable(frame);
+	return frame;
+}
+
+static void receive(ipc::frame_reader &reader, const char *data, size_t length)
+{
+	memcpy(reader.prepare(length), data, length);
+	reader.commit(length);
+}
+
+static bool check(const char *frame, size_t length, const std::vector<char> &expected)
+{
+	return length == expected.size() && memcmp(frame, expected.data(), length) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int failures = 0;
+	const char *frame = nullptr;
+	size_t length = 0;
+
+	// Three frames in one receive.
+	{
+		ipc::frame_reader reader;
+		std::vector<char> frames[] = {make_frame(0, 'a'), make_frame(100, 'b'), make_frame(3, 'c')};
+		std::vector<char> stream;
+		for (auto &one : frames) {
+			stream.insert(stream.end(), one.begin(), one.end());
+		}
+		receive(reader, stream.data(), stream.size());
+		for (auto &one : frames) {
+			if (!reader.next(frame, length) || !check(frame, length, one)) {
+				fprintf(stdout, "Frames received together were not all returned.\n");
+				failures++;
+			}
+		}
+		if (reader.next(frame, length) || reader.buffered() != 0 || reader.position() != stream.size()) {
+			fprintf(stdout, "Reader returned more than it was given.\n");
+			failures++;
+		}
+	}
+
+	// A prefix, then a body, arriving a few bytes at a time.
+	{
+		ipc::frame_reader reader;
+		std::vector<char> one = make_frame(37, 'd');
+		bool early = false;
+		for (size_t offset = 0; offset < one.size(); offset += 3) {
+			early |= reader.next(frame, length);
+			receive(reader, one.data() + offset, std::min(size_t(3), one.size() - offset));
+		}
+		if (early || !reader.next(frame, length) || !check(frame, length, one)) {
+			fprintf(stdout, "A frame split over receives was not reassembled.\n");
+			failures++;
+		}
+	}
+
+	// 16 MB behind a small frame: only the start of it is ever moved.
+	{
+		ipc::frame_reader reader;
+		std::vector<char> small = make_frame(10, 'e'), large = make_frame(16 * 1024 * 1024, 'f');
+		for (size_t idx = 0; idx < large.size(); idx++) {
+			large[idx] = char(idx * 7);
+		}
+		ipc::make_sendable(large);
+		std::vector<char> start(small);
+		start.insert(start.end(), large.begin(), large.begin() + 1000);
+		receive(reader, start.data(), start.size());
+
+		bool moved = false;
+		const char *place = nullptr;
+		for (size_t offset = 1000; offset < large.size();) {
+			if (offset == 1000 && (!reader.next(frame, length) || !check(frame, length, small))) {
+				fprintf(stdout, "The small frame in front was not returned.\n");
+				failures++;
+			}
+			size_t chunk = std::min(large.size() - offset, size_t(64 * 1024));
+			char *space = reader.prepare(reader.expected() - reader.buffered());
+			moved |= place != nullptr && place != space - reader.buffered();
+			place = space - reader.buffered();
+			memcpy(space, large.data() + offset, chunk);
+			reader.commit(chunk);
+			offset += chunk;
+		}
+
+		std::vector<char> buffer;
+		if (moved || !reader.next(frame, length) || frame != place || !check(frame, length, large) || !reader.detach(buffer) ||
+		    buffer.data() != place) {
+			fprintf(stdout, "The large frame was moved or copied.\n");
+			failures++;
+		}
+	}
+
+	// Bursts of eight small frames per receive.
+	{
+		ipc::frame_reader reader;
+		std::vector<char> one = make_frame(56, 'g'), burst;
+		for (size_t idx = 0; idx < 8; idx++) {
+			burst.insert(burst.end(), one.begin(), one.end());
+		}
+		size_t frames = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t idx = 0; idx < ITERATIONS / 8; idx++) {
+			receive(reader, burst.data(), burst.size());
+			while (reader.next(frame, length)) {
+				frames++;
+			}
+		}
+		auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+		if (frames != ITERATIONS) {
+			fprintf(stdout, "Returned %zu of %d frames.\n", frames, ITERATIONS);
+			failures++;
+		}
+		fprintf(stdout, "%d frames of %zu bytes, 8 per receive: %.1f ns per frame.\n", ITERATIONS, one.size(), double(ns) / ITERATIONS);
+	}
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,254 @@
+#include "ipc-server.hpp"
+#include "ipc-client.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// ipc::server::create_bulk_channel() and ipc::client::open_bulk_channel():
+// the server renders 1080p RGBA frames straight into the channel's slots and
+// a client in another process checks them in place, over the socket and then
+// the shared memory rings. Frames have to arrive complete and in order at
+// well above 60 per second.
+
+#pragma region Logging
+std::chrono::high_resolution_clock::time_point tp = std::chrono::high_resolution_clock::now();
+
+static void blog(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::vector<char> text(vsnprintf(nullptr, 0, format, args) + 1);
+	va_end(args);
+	va_start(args, format);
+	vsnprintf(text.data(), text.size(), format, args);
+	va_end(args);
+
+	auto timeSinceStart = (std::chrono::high_resolution_clock::now() - tp);
+	auto hours = std::chrono::duration_cast<std::chrono::hours>(timeSinceStart);
+	timeSinceStart -= hours;
+	auto minutes = std::chrono::duration_cast<std::chrono::minutes>(timeSinceStart);
+	timeSinceStart -= minutes;
+	auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeSinceStart);
+	timeSinceStart -= seconds;
+	auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(timeSinceStart);
+	timeSinceStart -= milliseconds;
+	auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(timeSinceStart);
+	timeSinceStart -= microseconds;
+	auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeSinceStart);
+
+	fprintf(stdout, "%.2d:%.2d:%.2d.%.3d.%.3d.%.3d: [%d] %s\n", int(hours.count()), int(minutes.count()), int(seconds.count()),
+		int(milliseconds.count()), int(microseconds.count()), int(nanoseconds.count()), int(getpid()), text.data());
+	fflush(stdout);
+}
+#pragma endregion Logging
+
+#define CONN "/tmp/HelloWorldIPC-bulk"
+#define WIDTH 1920
+#define HEIGHT 1080
+#define FRAME_SIZE (WIDTH * HEIGHT * 4)
+#define SLOTS 4
+#define FRAMES 300
+#define TARGET_FPS 60
+
+static int server(int argc, char *argv[]);
+static int client(int argc, char *argv[]);
+
+int main(int argc, char *argv[])
+{
+	if ((argc >= 4) && (strcmp(argv[1], "client") == 0)) {
+		return client(argc, argv);
+	} else {
+		return server(argc, argv);
+	}
+}
+
+static int64_t now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Each frame starts with its number and the time it was published, every byte after that is the frame number.
+struct frame_stamp {
+	uint64_t number;
+	int64_t published_ns;
+};
+
+static bool wait_for_reader(ipc::bulk_writer &writer, bool present)
+{
+	for (size_t idx = 0; idx < 5000 && writer.has_reader() != present; idx++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return writer.has_reader() == present;
+}
+
+static bool produce(ipc::bulk_writer &writer, const char *name)
+{
+	if (!wait_for_reader(writer, true)) {
+		blog("Critical Failure: %s: Client never opened the channel.", name);
+		return false;
+	}
+
+	size_t full = 0;
+	int64_t start = now_ns();
+	for (uint64_t number = 0; number < FRAMES; number++) {
+		ipc::bulk_buffer buffer;
+		while (!writer.acquire(buffer)) {
+			if (!writer.has_reader()) {
+				blog("Critical Failure: %s: Reader went away at frame %llu.", name, (unsigned long long)number);
+				return false;
+			}
+			full++;
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+		if (buffer.size < FRAME_SIZE) {
+			blog("Critical Failure: %s: Slot of %zu bytes is too small.", name, buffer.size);
+			return false;
+		}
+
+		// Rendered in place, the library never touches the pixels.
+		memset(buffer.data, int(number & 0xFF), FRAME_SIZE);
+		frame_stamp stamp = {number, now_ns()};
+		memcpy(buffer.data, &stamp, sizeof(stamp));
+		if (!writer.publish(buffer, FRAME_SIZE)) {
+			blog("Critical Failure: %s: Publishing frame %llu failed.", name, (unsigned long long)number);
+			return false;
+		}
+	}
+	double seconds = double(now_ns() - start) / 1e9;
+	blog("%s: %d frames of %d bytes in %.3f s, %.0f frames per second, %.0f MB/s, waited for a free slot %zu times.", name, FRAMES, FRAME_SIZE,
+	     seconds, FRAMES / seconds, double(FRAMES) * FRAME_SIZE / seconds / 1e6, full);
+	blog("%s: Sustained rate is %s the %d frames per second target.", name, FRAMES / seconds >= TARGET_FPS ? "within" : "below", TARGET_FPS);
+	return true;
+}
+
+int server(int argc, char *argv[])
+{
+	std::string conn = CONN "-" + std::to_string(getpid());
+	ipc::server socket;
+
+	try {
+		socket.initialize(conn);
+	} catch (std::exception &e) {
+		blog("Unable to start server: %s", e.what());
+		return -1;
+	}
+
+	std::shared_ptr<ipc::bulk_writer> writer = socket.create_bulk_channel("preview", SLOTS, FRAME_SIZE);
+	if (!writer || socket.create_bulk_channel("preview", 1, 1) || socket.create_bulk_channel("empty", 0, FRAME_SIZE)) {
+		blog("Critical Failure: Creating bulk channels misbehaved.");
+		return 1;
+	}
+	ipc::bulk_buffer buffer;
+	if (writer->has_reader() || writer->acquire(buffer)) {
+		blog("Critical Failure: Buffers were handed out without a reader.");
+		return 1;
+	}
+
+	bool failed = false;
+	const char *kinds[] = {"socket", "shm"};
+	for (const char *kind : kinds) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			execl("/proc/self/exe", argv[0], "client", conn.c_str(), kind, nullptr);
+			_exit(127);
+		}
+
+		failed = !produce(*writer, kind) || failed;
+		int status = 0;
+		waitpid(pid, &status, 0);
+		failed = failed || !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+		if (failed) {
+			break;
+		}
+		// The next client takes over once this one is gone.
+		if (!wait_for_reader(*writer, false)) {
+			blog("Critical Failure: Reader stayed attached after its client exited.");
+			failed = true;
+			break;
+		}
+	}
+
+	blog("Shutting down server, bulk channel checks %s.", failed ? "failed" : "passed");
+	writer = nullptr;
+	socket.finalize();
+	return failed ? 1 : 0;
+}
+
+int client(int argc, char *argv[])
+{
+	bool shm = strcmp(argv[3], "shm") == 0;
+	std::shared_ptr<ipc::client> socket;
+	try {
+		socket = ipc::client::create(argv[2], nullptr, shm ? ipc::client::transport::SharedMemory : ipc::client::transport::Default);
+	} catch (std::exception &e) {
+		blog("Unable to start client: %s", e.what());
+		return -1;
+	}
+	if (socket->open_bulk_channel("missing", [](ipc::bulk_reader &, const ipc::bulk_buffer &) {})) {
+		blog("Critical Failure: Unknown bulk channel was opened.");
+		return 1;
+	}
+
+	std::mutex mtx;
+	std::deque<ipc::bulk_buffer> held;
+	std::vector<int64_t> latencies;
+	std::atomic<uint64_t> received(0);
+	std::atomic<bool> broken(false);
+	std::shared_ptr<ipc::bulk_reader> channel = socket->open_bulk_channel("preview", [&](ipc::bulk_reader &reader, const ipc::bulk_buffer &buffer) {
+		int64_t arrived = now_ns();
+		frame_stamp stamp;
+		memcpy(&stamp, buffer.data, sizeof(stamp));
+		bool intact = buffer.size == FRAME_SIZE && stamp.number == received;
+		for (size_t offset = sizeof(stamp); intact && offset < buffer.size; offset += 4093) {
+			intact = uint8_t(buffer.data[offset]) == uint8_t(stamp.number & 0xFF);
+		}
+		if (!intact) {
+			blog("Critical Failure: Frame %llu arrived as frame %llu or was damaged.", (unsigned long long)received.load(),
+			     (unsigned long long)stamp.number);
+			broken = true;
+		}
+		latencies.push_back(arrived - stamp.published_ns);
+
+		// Hold on to the previous frame until the next arrived, like a renderer that is presenting it.
+		std::unique_lock<std::mutex> ul(mtx);
+		held.push_back(buffer);
+		if (held.size() == 2 && received == 1 && reader.release(held.back())) {
+			blog("Critical Failure: A buffer was released out of order.");
+			broken = true;
+		}
+		while (held.size() > 1) {
+			if (!reader.release(held.front())) {
+				blog("Critical Failure: Releasing frame %llu failed.", (unsigned long long)held.front().sequence);
+				broken = true;
+			}
+			held.pop_front();
+		}
+		received++;
+	});
+	if (!channel) {
+		blog("Critical Failure: Opening the bulk channel failed.");
+		return 1;
+	}
+
+	for (size_t idx = 0; idx < 10000 && received < FRAMES && !broken; idx++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	if (received != FRAMES || broken) {
+		blog("Critical Failure: %llu of %d frames arrived intact.", (unsigned long long)received.load(), FRAMES);
+		return 1;
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+	blog("Client (%s): %d frames arrived in order and intact, median %lld ns from publish to handler.", argv[3], FRAMES,
+	     (long long)latencies[latencies.size() / 2]);
+	socket = nullptr;
+	return 0;
+}
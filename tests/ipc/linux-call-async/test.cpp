@@ -0,0 +1,191 @@
+#include "ipc-server.hpp"
+#include "ipc-client.hpp"
+#include "ipc-executor.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+// ipc::client::call_async(): futures for replies and errors, callbacks that
+// call again from inside, a slow callback that must not stop other threads
+// from making calls, and callbacks delivered through an executor.
+
+#pragma region Logging
+std::chrono::high_resolution_clock::time_point tp = std::chrono::high_resolution_clock::now();
+
+static void blog(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::vector<char> text(vsnprintf(nullptr, 0, format, args) + 1);
+	va_end(args);
+	va_start(args, format);
+	vsnprintf(text.data(), text.size(), format, args);
+	va_end(args);
+
+	auto timeSinceStart = (std::chrono::high_resolution_clock::now() - tp);
+	auto hours = std::chrono::duration_cast<std::chrono::hours>(timeSinceStart);
+	timeSinceStart -= hours;
+	auto minutes = std::chrono::duration_cast<std::chrono::minutes>(timeSinceStart);
+	timeSinceStart -= minutes;
+	auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeSinceStart);
+	timeSinceStart -= seconds;
+	auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(timeSinceStart);
+	timeSinceStart -= milliseconds;
+	auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(timeSinceStart);
+	timeSinceStart -= microseconds;
+	auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeSinceStart);
+
+	fprintf(stdout, "%.2d:%.2d:%.2d.%.3d.%.3d.%.3d: [%d] %s\n", int(hours.count()), int(minutes.count()), int(seconds.count()),
+		int(milliseconds.count()), int(microseconds.count()), int(nanoseconds.count()), int(getpid()), text.data());
+	fflush(stdout);
+}
+#pragma endregion Logging
+
+#define CONN "/tmp/HelloWorldIPC-async"
+#define SLOW_MS 200
+
+typedef std::chrono::high_resolution_clock::duration duration_t;
+
+static void echo(void *data, const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval)
+{
+	rval = args;
+}
+
+static void slow(void *data, const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(SLOW_MS));
+	rval = args;
+}
+
+static bool is(const std::vector<ipc::value> &rval, uint64_t expected)
+{
+	return rval.size() == 1 && rval[0].type == ipc::type::UInt64 && rval[0].value_union.ui64 == expected;
+}
+
+static bool eventually(const std::atomic<bool> &flag)
+{
+	for (size_t idx = 0; idx < 5000 && !flag; idx++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return flag;
+}
+
+static bool check_futures(std::shared_ptr<ipc::client> client)
+{
+	std::vector<ipc::call_future> futures;
+	for (uint64_t idx = 0; idx < 32; idx++) {
+		futures.push_back(client->call_async("Default", "Echo", {ipc::value(idx)}));
+	}
+	for (uint64_t idx = 0; idx < futures.size(); idx++) {
+		if (!futures[idx].valid() || !is(futures[idx].get(), idx)) {
+			blog("Critical Failure: Future %llu got the wrong reply.", (unsigned long long)idx);
+			return false;
+		}
+	}
+
+	ipc::call_future pending = client->call_async("Default", "Slow", {ipc::value(uint64_t(5))});
+	if (pending.wait_for(std::chrono::milliseconds(SLOW_MS / 4)) || pending.ready() || !is(pending.get(), 5)) {
+		blog("Critical Failure: Future of a slow call was ready too early or got the wrong reply.");
+		return false;
+	}
+
+	auto rval = client->call_async("Default", "Missing", {}).get();
+	if (rval.size() != 1 || rval[0].type != ipc::type::Null || rval[0].value_str.empty()) {
+		blog("Critical Failure: Future of a failed call holds no error.");
+		return false;
+	}
+	blog("Futures: 32 in flight, a slow one and an error came back right.");
+	return true;
+}
+
+static bool check_callbacks(std::shared_ptr<ipc::client> client)
+{
+	// A callback making another call used to deadlock on the client's table lock.
+	std::atomic<bool> inner_done(false);
+	auto inner = [&inner_done](const std::vector<ipc::value> &rval, duration_t) { inner_done = is(rval, 2); };
+	bool nested_ok = client->call_async("Default", "Echo", {ipc::value(uint64_t(1))}, [client, inner](const std::vector<ipc::value> &, duration_t) {
+		client->call_async("Default", "Echo", {ipc::value(uint64_t(2))}, inner);
+	});
+	if (!nested_ok || !eventually(inner_done)) {
+		blog("Critical Failure: A call made from a callback did not complete.");
+		return false;
+	}
+
+	// While a callback takes its time on the reply thread, other threads can still send.
+	std::atomic<bool> slow_entered(false), slow_done(false);
+	client->call_async("Default", "Echo", {ipc::value(uint64_t(3))},
+			   [&slow_entered, &slow_done](const std::vector<ipc::value> &, duration_t) {
+				   slow_entered = true;
+				   std::this_thread::sleep_for(std::chrono::milliseconds(SLOW_MS));
+				   slow_done = true;
+			   });
+	eventually(slow_entered);
+	auto start = std::chrono::high_resolution_clock::now();
+	ipc::call_future sent = client->call_async("Default", "Echo", {ipc::value(uint64_t(4))});
+	auto send_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
+	if (send_ms >= SLOW_MS / 2 || !eventually(slow_done) || !is(sent.get(), 4)) {
+		blog("Critical Failure: Sending took %lld ms behind a slow callback.", (long long)send_ms);
+		return false;
+	}
+	blog("Callbacks: nested call completed, sending took %lld ms next to a %d ms callback.", (long long)send_ms, SLOW_MS);
+	return true;
+}
+
+static bool check_executor(const std::string &conn)
+{
+	ipc::executor pool(2);
+	std::shared_ptr<ipc::client> client = ipc::client::create(conn);
+	client->set_completion_executor([&pool](std::function<void()> task) { pool.post(std::move(task)); });
+
+	// Slow callbacks on the pool leave the reply thread free for the future.
+	std::atomic<int> done(0);
+	std::atomic<bool> all_done(false);
+	for (uint64_t idx = 0; idx < 2; idx++) {
+		client->call_async("Default", "Echo", {ipc::value(idx)}, [&done, &all_done](const std::vector<ipc::value> &, duration_t) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(SLOW_MS));
+			all_done = ++done == 2;
+		});
+	}
+	auto start = std::chrono::high_resolution_clock::now();
+	auto rval = client->call_async("Default", "Echo", {ipc::value(uint64_t(9))}).get();
+	auto reply_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
+	if (!is(rval, 9) || reply_ms >= SLOW_MS / 2 || !eventually(all_done)) {
+		blog("Critical Failure: Reply took %lld ms while callbacks ran on the executor.", (long long)reply_ms);
+		return false;
+	}
+	blog("Executor: a future completed after %lld ms while two %d ms callbacks ran on the pool.", (long long)reply_ms, SLOW_MS);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	std::string conn = CONN "-" + std::to_string(getpid());
+	ipc::server server;
+	std::shared_ptr<ipc::collection> collection = std::make_shared<ipc::collection>("Default");
+	collection->register_function(std::make_shared<ipc::function>("Echo", echo));
+	auto slow_function = std::make_shared<ipc::function>("Slow", slow);
+	slow_function->set_execution(ipc::execution::concurrent);
+	collection->register_function(slow_function);
+	server.register_collection(collection);
+
+	try {
+		server.initialize(conn);
+	} catch (std::exception &e) {
+		blog("Unable to start server: %s", e.what());
+		return 1;
+	}
+
+	bool passed = false;
+	{
+		std::shared_ptr<ipc::client> client = ipc::client::create(conn);
+		passed = check_futures(client) && check_callbacks(client) && check_executor(conn);
+	}
+	server.finalize();
+
+	blog("Asynchronous call checks %s.", passed ? "passed" : "failed");
+	return passed ? 0 : 1;
+}
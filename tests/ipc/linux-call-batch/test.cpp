@@ -0,0 +1,255 @@
+#include "ipc-server.hpp"
+#include "ipc-client.hpp"
+#include "ipc-executor.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+// ipc::client::call_batch(): every entry's callback gets its own reply, also
+// when serial, concurrent, asynchronous and failing calls share a batch, and
+// a burst of small calls costs less as one batch than as separate calls.
+
+#pragma region Logging
+std::chrono::high_resolution_clock::time_point tp = std::chrono::high_resolution_clock::now();
+
+static void blog(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::vector<char> text(vsnprintf(nullptr, 0, format, args) + 1);
+	va_end(args);
+	va_start(args, format);
+	vsnprintf(text.data(), text.size(), format, args);
+	va_end(args);
+
+	auto timeSinceStart = (std::chrono::high_resolution_clock::now() - tp);
+	auto hours = std::chrono::duration_cast<std::chrono::hours>(timeSinceStart);
+	timeSinceStart -= hours;
+	auto minutes = std::chrono::duration_cast<std::chrono::minutes>(timeSinceStart);
+	timeSinceStart -= minutes;
+	auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeSinceStart);
+	timeSinceStart -= seconds;
+	auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(timeSinceStart);
+	timeSinceStart -= milliseconds;
+	auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(timeSinceStart);
+	timeSinceStart -= microseconds;
+	auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeSinceStart);
+
+	fprintf(stdout, "%.2d:%.2d:%.2d.%.3d.%.3d.%.3d: [%d] %s\n", int(hours.count()), int(minutes.count()), int(seconds.count()),
+		int(milliseconds.count()), int(microseconds.count()), int(nanoseconds.count()), int(getpid()), text.data());
+	fflush(stdout);
+}
+#pragma endregion Logging
+
+#define CONN "/tmp/HelloWorldIPC-batch"
+#define BURST 200
+#define ROUNDS 200
+
+typedef std::chrono::high_resolution_clock::duration duration_t;
+
+static void echo(void *data, const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval)
+{
+	rval = args;
+}
+
+static void later(void *data, const int64_t id, ipc::span<const ipc::value_view> args, ipc::call_completion_t done)
+{
+	std::vector<ipc::value> rval;
+	for (const ipc::value_view &arg : args) {
+		rval.push_back(arg.to_value());
+	}
+	std::thread([rval, done]() mutable { done(rval, ""); }).detach();
+}
+
+// Counts replies into a slot per entry, so a reply delivered twice or to the wrong entry shows.
+struct inbox {
+	std::vector<std::vector<ipc::value>> replies;
+	std::vector<std::atomic<int>> counts;
+	std::atomic<size_t> total;
+
+	inbox(size_t size) : replies(size), counts(size), total(0) {}
+
+	struct slot {
+		inbox *parent;
+		size_t index;
+	};
+	std::vector<slot> slots;
+
+	void prepare()
+	{
+		slots.clear();
+		for (size_t idx = 0; idx < replies.size(); idx++) {
+			slots.push_back({this, idx});
+			counts[idx] = 0;
+		}
+		total = 0;
+	}
+
+	static void callback(void *data, const std::vector<ipc::value> &rval, duration_t)
+	{
+		slot *s = static_cast<slot *>(data);
+		s->parent->replies[s->index] = rval;
+		s->parent->counts[s->index]++;
+		s->parent->total++;
+	}
+
+	bool wait(size_t expected)
+	{
+		for (size_t idx = 0; idx < 5000000 && total < expected; idx++) {
+			std::this_thread::yield();
+		}
+		return total == expected;
+	}
+};
+
+static bool is(const std::vector<ipc::value> &rval, uint64_t expected)
+{
+	return rval.size() == 1 && rval[0].type == ipc::type::UInt64 && rval[0].value_union.ui64 == expected;
+}
+
+static bool check_mixed(std::shared_ptr<ipc::client> client)
+{
+	const char *functions[] = {"Echo", "Concurrent", "Later", "Missing"};
+	inbox box(64);
+	box.prepare();
+
+	std::vector<ipc::call_spec> calls;
+	for (size_t idx = 0; idx < box.replies.size(); idx++) {
+		calls.push_back({"Default", functions[idx % 4], {ipc::value(uint64_t(idx))}, &inbox::callback, &box.slots[idx]});
+	}
+	// Entries without a callback go out one way.
+	calls.push_back({"Default", "Echo", {ipc::value(uint64_t(0))}});
+
+	if (!client->call_batch(std::move(calls)) || !box.wait(box.replies.size())) {
+		blog("Critical Failure: Batch was not sent or not all replies arrived.");
+		return false;
+	}
+	for (size_t idx = 0; idx < box.replies.size(); idx++) {
+		const std::vector<ipc::value> &rval = box.replies[idx];
+		bool ok = idx % 4 == 3 ? (rval.size() == 1 && rval[0].type == ipc::type::Null && !rval[0].value_str.empty()) : is(rval, idx);
+		if (!ok || box.counts[idx] != 1) {
+			blog("Critical Failure: Entry %llu (%s) got the wrong reply or %d replies.", (unsigned long long)idx, functions[idx % 4],
+			     int(box.counts[idx]));
+			return false;
+		}
+	}
+
+	// Shared binaries of several entries are numbered across the frame.
+	client->set_shared_binary_threshold(4096);
+	std::vector<char> first(64 * 1024, 'a'), second(96 * 1024, 'b');
+	std::atomic<int> matched(0);
+	auto check = [](void *data, const std::vector<ipc::value> &rval, duration_t) {
+		std::pair<std::vector<char> *, std::atomic<int> *> &expected = *static_cast<std::pair<std::vector<char> *, std::atomic<int> *> *>(data);
+		if (rval.size() == 1 && rval[0].type == ipc::type::Binary && rval[0].binary_size() == expected.first->size() &&
+		    memcmp(rval[0].binary_data(), expected.first->data(), expected.first->size()) == 0) {
+			(*expected.second)++;
+		} else {
+			(*expected.second) -= 100;
+		}
+	};
+	std::pair<std::vector<char> *, std::atomic<int> *> one(&first, &matched), two(&second, &matched);
+	calls.clear();
+	calls.push_back({"Default", "Echo", {ipc::value(first)}, check, &one});
+	calls.push_back({"Default", "Echo", {ipc::value(second)}, check, &two});
+	bool sent = client->call_batch(std::move(calls));
+	for (size_t idx = 0; idx < 5000 && matched < 2 && matched >= 0; idx++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	client->set_shared_binary_threshold(0);
+	if (!sent || matched != 2) {
+		blog("Critical Failure: Shared binaries in a batch did not come back intact.");
+		return false;
+	}
+
+	blog("Mixed batch: %llu entries answered once each, shared binaries intact.", (unsigned long long)box.replies.size());
+	return true;
+}
+
+static bool measure(std::shared_ptr<ipc::client> client)
+{
+	inbox box(BURST);
+	box.prepare();
+
+	std::vector<std::chrono::nanoseconds> single, batched;
+	for (size_t round = 0; round < ROUNDS; round++) {
+		box.total = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t idx = 0; idx < BURST; idx++) {
+			client->call("Default", "Echo", {ipc::value(uint64_t(idx))}, &inbox::callback, &box.slots[idx]);
+		}
+		if (!box.wait(BURST)) {
+			blog("Critical Failure: Separate calls did not all complete.");
+			return false;
+		}
+		single.push_back(std::chrono::high_resolution_clock::now() - start);
+
+		box.total = 0;
+		start = std::chrono::high_resolution_clock::now();
+		std::vector<ipc::call_spec> calls;
+		calls.reserve(BURST);
+		for (size_t idx = 0; idx < BURST; idx++) {
+			calls.push_back({"Default", "Echo", {ipc::value(uint64_t(idx))}, &inbox::callback, &box.slots[idx]});
+		}
+		if (!client->call_batch(std::move(calls)) || !box.wait(BURST)) {
+			blog("Critical Failure: Batched calls did not all complete.");
+			return false;
+		}
+		batched.push_back(std::chrono::high_resolution_clock::now() - start);
+
+		for (size_t idx = 0; idx < BURST; idx++) {
+			if (!is(box.replies[idx], idx)) {
+				blog("Critical Failure: Burst entry %llu got the wrong reply.", (unsigned long long)idx);
+				return false;
+			}
+		}
+	}
+
+	std::sort(single.begin(), single.end());
+	std::sort(batched.begin(), batched.end());
+	auto single_us = std::chrono::duration_cast<std::chrono::microseconds>(single[ROUNDS / 2]).count();
+	auto batched_us = std::chrono::duration_cast<std::chrono::microseconds>(batched[ROUNDS / 2]).count();
+	blog("Burst of %d calls: median %lld us as separate calls, %lld us as one batch.", BURST, (long long)single_us, (long long)batched_us);
+	if (batched_us >= single_us) {
+		blog("Critical Failure: Batching did not make the burst cheaper.");
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	std::string conn = CONN "-" + std::to_string(getpid());
+	ipc::server server;
+	std::shared_ptr<ipc::collection> collection = std::make_shared<ipc::collection>("Default");
+	collection->register_function(std::make_shared<ipc::function>("Echo", echo));
+	auto concurrent = std::make_shared<ipc::function>("Concurrent", echo);
+	concurrent->set_execution(ipc::execution::concurrent);
+	collection->register_function(concurrent);
+	collection->register_function(std::make_shared<ipc::function>("Later", later, nullptr));
+	server.register_collection(collection);
+	server.set_shared_binary_threshold(4096);
+
+	try {
+		server.initialize(conn);
+	} catch (std::exception &e) {
+		blog("Unable to start server: %s", e.what());
+		return 1;
+	}
+
+	bool passed = false;
+	{
+		std::shared_ptr<ipc::client> client = ipc::client::create(conn);
+		// Replies arrive in order, so the handshake is through once this returns and batches go out as v2.
+		client->call_synchronous_helper("Default", "Echo", {});
+		passed = check_mixed(client) && measure(client);
+	}
+	server.finalize();
+
+	blog("Batch call checks %s.", passed ? "passed" : "failed");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+#include "ipc-server.hpp"
+#include "ipc-client.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+// How long a new connection takes until its first call is answered, and how
+// long the server takes to notice a client that went away. Neither may wait
+// for a polling interval of the watcher.
+
+#pragma region Logging
+std::chrono::high_resolution_clock::time_point tp = std::chrono::high_resolution_clock::now();
+
+static void blog(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::vector<char> text(vsnprintf(nullptr, 0, format, args) + 1);
+	va_end(args);
+	va_start(args, format);
+	vsnprintf(text.data(), text.size(), format, args);
+	va_end(args);
+
+	auto timeSinceStart = (std::chrono::high_resolution_clock::now() - tp);
+	auto hours = std::chrono::duration_cast<std::chrono::hours>(timeSinceStart);
+	timeSinceStart -= hours;
+	auto minutes = std::chrono::duration_cast<std::chrono::minutes>(timeSinceStart);
+	timeSinceStart -= minutes;
+	auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeSinceStart);
+	timeSinceStart -= seconds;
+	auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(timeSinceStart);
+	timeSinceStart -= milliseconds;
+	auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(timeSinceStart);
+	timeSinceStart -= microseconds;
+	auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeSinceStart);
+
+	fprintf(stdout, "%.2d:%.2d:%.2d.%.3d.%.3d.%.3d: [%d] %s\n", int(hours.count()), int(minutes.count()), int(seconds.count()),
+		int(milliseconds.count()), int(microseconds.count()), int(nanoseconds.count()), int(getpid()), text.data());
+	fflush(stdout);
+}
+#pragma endregion Logging
+
+#define CONN "/tmp/HelloWorldIPC-connect"
+#define CONNECTIONS 200
+// The watcher used to sleep this long when there was nothing to do.
+#define POLL_INTERVAL_MS 20
+
+static std::atomic<size_t> disconnects(0);
+static std::atomic<int64_t> disconnected_at(0);
+
+static int64_t now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void on_disconnect(void *data, int64_t id)
+{
+	disconnected_at = now_ns();
+	disconnects++;
+}
+
+static void echo(void *data, const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval)
+{
+	rval.push_back(args.size() > 0 ? args[0] : ipc::value(0));
+}
+
+static std::chrono::nanoseconds percentile(std::vector<std::chrono::nanoseconds> &samples, size_t pct)
+{
+	std::sort(samples.begin(), samples.end());
+	return samples[std::min(samples.size() - 1, samples.size() * pct / 100)];
+}
+
+int main(int argc, char *argv[])
+{
+	std::string conn = CONN "-" + std::to_string(getpid());
+	ipc::server server;
+	std::shared_ptr<ipc::collection> collection = std::make_shared<ipc::collection>("Default");
+	collection->register_function(std::make_shared<ipc::function>("Echo", echo));
+	server.register_collection(collection);
+	server.set_disconnect_handler(on_disconnect, nullptr);
+	try {
+		server.initialize(conn);
+	} catch (std::exception &e) {
+		blog("Unable to start server: %s", e.what());
+		return 1;
+	}
+
+	std::vector<std::chrono::nanoseconds> connect, reap;
+	connect.reserve(CONNECTIONS);
+	reap.reserve(CONNECTIONS);
+	for (size_t idx = 0; idx < CONNECTIONS; idx++) {
+		auto start = std::chrono::steady_clock::now();
+		std::shared_ptr<ipc::client> client;
+		try {
+			client = ipc::client::create(conn, nullptr);
+		} catch (std::exception &e) {
+			blog("Critical Failure: Connection %llu failed: %s", (unsigned long long)idx, e.what());
+			return 1;
+		}
+		auto rval = client->call_synchronous_helper("Default", "Echo", {ipc::value(uint64_t(idx))});
+		connect.push_back(std::chrono::steady_clock::now() - start);
+		if (rval.size() != 1 || rval[0].type != ipc::type::UInt64 || rval[0].value_union.ui64 != idx) {
+			blog("Critical Failure: First call of connection %llu returned the wrong value.", (unsigned long long)idx);
+			return 1;
+		}
+
+		int64_t gone = now_ns();
+		client = nullptr;
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while (disconnects <= idx) {
+			if (std::chrono::steady_clock::now() > deadline) {
+				blog("Critical Failure: Server did not notice that connection %llu went away.", (unsigned long long)idx);
+				return 1;
+			}
+			std::this_thread::yield();
+		}
+		reap.push_back(std::chrono::nanoseconds(std::max(int64_t(0), disconnected_at - gone)));
+	}
+
+	auto connect_median = percentile(connect, 50), reap_median = percentile(reap, 50);
+	blog("Connect to first reply: median %llu ns, 99th percentile %llu ns.", (unsigned long long)connect_median.count(),
+	     (unsigned long long)percentile(connect, 99).count());
+	blog("Disconnect to reaped: median %llu ns, 99th percentile %llu ns.", (unsigned long long)reap_median.count(),
+	     (unsigned long long)percentile(reap, 99).count());
+
+	server.finalize();
+
+	// A watcher that polls would need half its interval on average.
+	if (connect_median >= std::chrono::milliseconds(POLL_INTERVAL_MS / 2) || reap_median >= std::chrono::milliseconds(POLL_INTERVAL_MS / 2)) {
+		blog("Critical Failure: Connections are handled at the pace of a polling watcher.");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,215 @@
+#include "ipc-server.hpp"
+#include "ipc-client.hpp"
+#include "ipc-coroutine.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+// Coroutines on both ends: a client keeps thousands of calls in flight as
+// coroutines, a front server relays each of them from a coroutine handler to
+// a back server, whose asynchronous handler parks them all before answering.
+// Every call is in flight at once while only the library's own threads run.
+
+#pragma region Logging
+std::chrono::high_resolution_clock::time_point tp = std::chrono::high_resolution_clock::now();
+
+static void blog(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::vector<char> text(vsnprintf(nullptr, 0, format, args) + 1);
+	va_end(args);
+	va_start(args, format);
+	vsnprintf(text.data(), text.size(), format, args);
+	va_end(args);
+
+	auto timeSinceStart = (std::chrono::high_resolution_clock::now() - tp);
+	auto hours = std::chrono::duration_cast<std::chrono::hours>(timeSinceStart);
+	timeSinceStart -= hours;
+	auto minutes = std::chrono::duration_cast<std::chrono::minutes>(timeSinceStart);
+	timeSinceStart -= minutes;
+	auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeSinceStart);
+	timeSinceStart -= seconds;
+	auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(timeSinceStart);
+	timeSinceStart -= milliseconds;
+	auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(timeSinceStart);
+	timeSinceStart -= microseconds;
+	auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeSinceStart);
+
+	fprintf(stdout, "%.2d:%.2d:%.2d.%.3d.%.3d.%.3d: [%d] %s\n", int(hours.count()), int(minutes.count()), int(seconds.count()),
+		int(milliseconds.count()), int(microseconds.count()), int(nanoseconds.count()), int(getpid()), text.data());
+	fflush(stdout);
+}
+#pragma endregion Logging
+
+#define CONN "/tmp/HelloWorldIPC-coroutines"
+#define CALLS 5000
+
+
+// Completions the back server holds until all calls have arrived.
+struct parking {
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::vector<std::pair<ipc::call_completion_t, uint64_t>> calls;
+	size_t peak = 0;
+};
+
+static void park(void *data, const int64_t id, ipc::span<const ipc::value_view> args, ipc::call_completion_t done)
+{
+	parking *lot = static_cast<parking *>(data);
+	std::unique_lock<std::mutex> ul(lot->mtx);
+	lot->calls.emplace_back(std::move(done), args.size() == 1 ? args[0].value_union.ui64 : 0);
+	lot->peak = std::max(lot->peak, lot->calls.size());
+	lot->cv.notify_all();
+}
+
+// Let every parked call finish once |count| are in, or whatever is there after a timeout.
+static size_t release(parking &lot, size_t count)
+{
+	std::vector<std::pair<ipc::call_completion_t, uint64_t>> calls;
+	{
+		std::unique_lock<std::mutex> ul(lot.mtx);
+		lot.cv.wait_for(ul, std::chrono::seconds(20), [&lot, count]() { return lot.calls.size() >= count; });
+		calls.swap(lot.calls);
+	}
+	for (auto &call : calls) {
+		std::vector<ipc::value> rval = {ipc::value(call.second * 2)};
+		call.first(rval, std::string());
+	}
+	return calls.size();
+}
+
+static ipc::task<std::vector<ipc::value>> relay(void *data, const int64_t id, ipc::span<const ipc::value_view> args)
+{
+	ipc::client *back = static_cast<ipc::client *>(data);
+	if (args.size() != 1 || args[0].type != ipc::type::UInt64) {
+		throw std::invalid_argument("Relay takes one UInt64.");
+	}
+
+	// The views stay valid across the co_await, the frame is held until the reply is out.
+	uint64_t value = args[0].value_union.ui64;
+	// Arguments are built up front, GCC 12 can't put an initializer list inside a co_await expression.
+	std::vector<ipc::value> call_args = {ipc::value(value)};
+	std::vector<ipc::value> rval = co_await back->call_async("Back", "Park", std::move(call_args));
+	if (value == 0) {
+		throw std::runtime_error("zero is refused after the fact");
+	}
+	rval.push_back(ipc::value(value + 1));
+	co_return rval;
+}
+
+struct tally {
+	std::atomic<size_t> done = 0, wrong = 0, refused = 0;
+};
+
+static ipc::task<uint64_t> relay_sum(std::shared_ptr<ipc::client> client, uint64_t value)
+{
+	std::vector<ipc::value> call_args = {ipc::value(value)};
+	std::vector<ipc::value> rval = co_await client->call_async("Front", "Relay", std::move(call_args));
+	if (rval.size() != 2 || rval[0].type != ipc::type::UInt64 || rval[1].type != ipc::type::UInt64) {
+		throw std::runtime_error(rval.size() == 1 ? std::string(rval[0].value_str) : "Malformed reply.");
+	}
+	co_return rval[0].value_union.ui64 + rval[1].value_union.ui64;
+}
+
+static bool is_refusal(uint64_t value, const std::exception &e)
+{
+	return value == 0 && strstr(e.what(), "zero is refused") != nullptr;
+}
+
+static ipc::task<void> one_call(std::shared_ptr<ipc::client> client, uint64_t value, tally &counts)
+{
+	try {
+		uint64_t sum = co_await relay_sum(client, value);
+		if (sum != value * 3 + 1) {
+			counts.wrong++;
+		}
+	} catch (std::exception &e) {
+		counts.refused++;
+		if (!is_refusal(value, e)) {
+			counts.wrong++;
+		}
+	}
+	counts.done++;
+}
+
+static size_t thread_count()
+{
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.compare(0, 8, "Threads:") == 0) {
+			return size_t(std::stoul(line.substr(8)));
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	std::string back_conn = CONN "-back-" + std::to_string(getpid());
+	std::string front_conn = CONN "-front-" + std::to_string(getpid());
+
+	parking lot;
+	ipc::server back, front;
+	back.set_executor_threads(1);
+	front.set_executor_threads(1);
+	std::shared_ptr<ipc::collection> back_collection = std::make_shared<ipc::collection>("Back");
+	back_collection->register_function(std::make_shared<ipc::function>("Park", park, &lot));
+	back.register_collection(back_collection);
+
+	std::shared_ptr<ipc::client> back_client, client;
+	try {
+		back.initialize(back_conn);
+		back_client = ipc::client::create(back_conn);
+
+		std::shared_ptr<ipc::collection> front_collection = std::make_shared<ipc::collection>("Front");
+		front_collection->register_function(ipc::make_coroutine_function("Relay", relay, back_client.get()));
+		front.register_collection(front_collection);
+		front.initialize(front_conn);
+		client = ipc::client::create(front_conn);
+	} catch (std::exception &e) {
+		blog("Unable to start: %s", e.what());
+		return 1;
+	}
+
+	tally counts;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (uint64_t idx = 0; idx < CALLS; idx++) {
+		ipc::spawn(one_call(client, idx, counts));
+	}
+	auto sent = std::chrono::high_resolution_clock::now();
+	size_t threads = thread_count();
+	size_t released = release(lot, CALLS);
+	for (size_t idx = 0; idx < 10000 && counts.done < CALLS; idx++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	auto ms = [](std::chrono::high_resolution_clock::duration span) {
+		return (long long)std::chrono::duration_cast<std::chrono::milliseconds>(span).count();
+	};
+	blog("%d coroutine calls sent in %lld ms, %zu in flight at once on %zu threads, all answered after %lld ms.", CALLS, ms(sent - start), lot.peak,
+	     threads, ms(end - start));
+
+	bool passed = released == CALLS && lot.peak == CALLS && counts.done == CALLS && counts.wrong == 0 && counts.refused == 1;
+	if (!passed) {
+		blog("Critical Failure: %zu released, %zu done, %zu wrong, %zu refused.", released, counts.done.load(), counts.wrong.load(),
+		     counts.refused.load());
+	}
+
+	client = nullptr;
+	front.finalize();
+	back_client = nullptr;
+	back.finalize();
+
+	blog("Coroutine checks %s.", passed ? "passed" : "failed");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+#include "ipc-server.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+// Per-call cost of name based dispatch as the number of registered methods
+// grows. The lookup alone is timed through the server's frozen hash index and
+// through the nested ordered maps it used to walk, then complete dispatches by
+// name and by method ID. Calls go straight to ipc::server, no socket traffic
+// is involved.
+
+#pragma region Logging
+std::chrono::high_resolution_clock::time_point tp = std::chrono::high_resolution_clock::now();
+
+static void blog(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::vector<char> text(vsnprintf(nullptr, 0, format, args) + 1);
+	va_end(args);
+	va_start(args, format);
+	vsnprintf(text.data(), text.size(), format, args);
+	va_end(args);
+
+	auto timeSinceStart = (std::chrono::high_resolution_clock::now() - tp);
+	auto hours = std::chrono::duration_cast<std::chrono::hours>(timeSinceStart);
+	timeSinceStart -= hours;
+	auto minutes = std::chrono::duration_cast<std::chrono::minutes>(timeSinceStart);
+	timeSinceStart -= minutes;
+	auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeSinceStart);
+	timeSinceStart -= seconds;
+	auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(timeSinceStart);
+	timeSinceStart -= milliseconds;
+	auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(timeSinceStart);
+	timeSinceStart -= microseconds;
+	auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeSinceStart);
+
+	fprintf(stdout, "%.2d:%.2d:%.2d.%.3d.%.3d.%.3d: [%d] %s\n", int(hours.count()), int(minutes.count()), int(seconds.count()),
+		int(milliseconds.count()), int(microseconds.count()), int(nanoseconds.count()), int(getpid()), text.data());
+	fflush(stdout);
+}
+#pragma endregion Logging
+
+#define CONN "/tmp/HelloWorldIPC-dispatch"
+#define FUNCTIONS_PER_CLASS 100
+#define ITERATIONS 500000
+
+static void *last_called = nullptr;
+
+static void record(void *data, const int64_t id, ipc::span<const ipc::value_view> args, std::vector<ipc::value> &rval)
+{
+	last_called = data;
+}
+
+struct target {
+	std::string class_name, function_name;
+	uint32_t method_id;
+	void *data;
+};
+
+static uint64_t per_call_ns(std::chrono::high_resolution_clock::time_point start)
+{
+	return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count() / ITERATIONS);
+}
+
+static bool measure(size_t methods)
+{
+	std::string conn = CONN "-" + std::to_string(getpid()) + "-" + std::to_string(methods);
+	ipc::server server;
+	std::map<std::string, std::shared_ptr<ipc::collection>, std::less<>> classes;
+	std::vector<target> targets;
+	std::vector<char> tags(methods);
+	for (size_t idx = 0; idx < methods; idx++) {
+		std::string cname = "Class" + std::to_string(idx / FUNCTIONS_PER_CLASS);
+		std::string fname = "Function" + std::to_string(idx % FUNCTIONS_PER_CLASS);
+		auto &collection = classes[cname];
+		if (!collection) {
+			collection = std::make_shared<ipc::collection>(cname);
+			server.register_collection(collection);
+		}
+		collection->register_function(std::make_shared<ipc::function>(fname, record, &tags[idx]));
+		targets.push_back({cname, fname, 0, &tags[idx]});
+	}
+
+	try {
+		server.initialize(conn);
+	} catch (std::exception &e) {
+		blog("Unable to start server: %s", e.what());
+		return false;
+	}
+	for (target &entry : targets) {
+		entry.method_id = server.find_method(entry.class_name, entry.function_name);
+	}
+
+	// Visit the methods in random order so the lookups can't ride on a warm cache line.
+	std::vector<size_t> order(ITERATIONS);
+	std::mt19937 rng(static_cast<uint32_t>(methods));
+	for (size_t &idx : order) {
+		idx = rng() % methods;
+	}
+
+	bool passed = true;
+	std::vector<ipc::value> rval;
+	std::string errormsg;
+	std::chrono::high_resolution_clock::duration duration;
+
+	uint32_t checksum = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t idx : order) {
+		const target &entry = targets[idx];
+		checksum += server.find_method(entry.class_name, entry.function_name);
+	}
+	uint64_t index_lookup = per_call_ns(start);
+
+	// What every call used to pay: a lookup per map level and a reference count on the way out.
+	void *last_found = nullptr;
+	start = std::chrono::high_resolution_clock::now();
+	for (size_t idx : order) {
+		const target &entry = targets[idx];
+		auto cls = classes.find(std::string_view(entry.class_name));
+		std::shared_ptr<ipc::function> fnc = cls->second->get_function(entry.function_name);
+		last_found = fnc.get();
+	}
+	uint64_t map_lookup = per_call_ns(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	for (size_t idx : order) {
+		const target &entry = targets[idx];
+		passed = server.client_call_function(0, std::string_view(entry.class_name), std::string_view(entry.function_name), {}, rval, errormsg,
+						     duration) &&
+			 last_called == entry.data && passed;
+	}
+	uint64_t by_name = per_call_ns(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	for (size_t idx : order) {
+		const target &entry = targets[idx];
+		passed = server.client_call_function(0, entry.method_id, {}, rval, errormsg, duration) && last_called == entry.data && passed;
+	}
+	uint64_t by_id = per_call_ns(start);
+
+	passed = passed && checksum != 0 && last_found != nullptr && server.find_method("Class0", "Missing") == 0 &&
+		 !server.client_call_function(0, std::string_view("Missing"), std::string_view("Function0"), {}, rval, errormsg, duration);
+	server.finalize();
+
+	blog("%5zu methods: lookup %3llu ns in the index, %3llu ns through the nested maps; dispatch %3llu ns by name, %3llu ns by method ID.",
+	     methods, (unsigned long long)index_lookup, (unsigned long long)map_lookup, (unsigned long long)by_name, (unsigned long long)by_id);
+	if (!passed) {
+		blog("Critical Failure: A call was dispatched to the wrong method.");
+	}
+	return passed;
+}
+
+int main(int argc, char *argv[])
+{
+	bool passed = true;
+	for (size_t methods : {10, 100, 1000, 10000}) {
+		passed = measure(methods) && passed;
+	}
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,241 @@
+#include "ipc-server.hpp"
+#include "ipc-client.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+// ipc::server::publish() and ipc::client::subscribe(): events reach only the
+// clients that subscribed, in order and next to replies on the same
+// connection, over the socket and the shared memory rings. Shared binaries
+// arrive as plain copies. Push latency is compared with the round trip of
+// polling a getter.
+
+#pragma region Logging
+std::chrono::high_resolution_clock::time_point tp = std::chrono::high_resolution_clock::now();
+
+static void blog(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::vector<char> text(vsnprintf(nullptr, 0, format, args) + 1);
+	va_end(args);
+	va_start(args, format);
+	vsnprintf(text.data(), text.size(), format, args);
+	va_end(args);
+
+	auto timeSinceStart = (std::chrono::high_resolution_clock::now() - tp);
+	auto hours = std::chrono::duration_cast<std::chrono::hours>(timeSinceStart);
+	timeSinceStart -= hours;
+	auto minutes = std::chrono::duration_cast<std::chrono::minutes>(timeSinceStart);
+	timeSinceStart -= minutes;
+	auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeSinceStart);
+	timeSinceStart -= seconds;
+	auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(timeSinceStart);
+	timeSinceStart -= milliseconds;
+	auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(timeSinceStart);
+	timeSinceStart -= microseconds;
+	auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeSinceStart);
+
+	fprintf(stdout, "%.2d:%.2d:%.2d.%.3d.%.3d.%.3d: [%d] %s\n", int(hours.count()), int(minutes.count()), int(seconds.count()),
+		int(milliseconds.count()), int(microseconds.count()), int(nanoseconds.count()), int(getpid()), text.data());
+	fflush(stdout);
+}
+#pragma endregion Logging
+
+#define CONN "/tmp/HelloWorldIPC-events"
+#define EVENTS 10000
+
+static std::atomic<uint64_t> state(0);
+
+static void get_state(void *data, const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval)
+{
+	rval.push_back(ipc::value(state.load()));
+}
+
+// Stands in for a binary a handler received shared and passes on.
+class test_binary : public ipc::shared_binary {
+	std::vector<char> m_data;
+
+public:
+	test_binary(size_t size, char fill) : m_data(size, fill) {}
+
+	virtual const char *data() const override { return m_data.data(); }
+	virtual size_t size() const override { return m_data.size(); }
+	virtual int get_handle() const override { return -1; }
+};
+
+static std::atomic<size_t> disconnects(0);
+
+static void on_disconnect(void *data, int64_t id)
+{
+	disconnects++;
+}
+
+struct receiver {
+	std::atomic<uint64_t> count = 0;
+	std::atomic<uint64_t> last = 0;
+	std::atomic<bool> ordered = true;
+
+	ipc::client::event_handler_t handler()
+	{
+		return [this](const std::vector<ipc::value> &values) {
+			uint64_t value = values.size() == 1 && values[0].type == ipc::type::UInt64 ? values[0].value_union.ui64 : UINT64_MAX;
+			if (value != count) {
+				ordered = false;
+			}
+			last = value;
+			count++;
+		};
+	}
+
+	bool wait(uint64_t expected)
+	{
+		for (size_t idx = 0; idx < 5000 && count < expected; idx++) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return count == expected;
+	}
+};
+
+static bool check_fan_out(ipc::server &server, const std::string &conn, ipc::client::transport kind, const char *name)
+{
+	std::shared_ptr<ipc::client> first = ipc::client::create(conn, nullptr, kind);
+	std::shared_ptr<ipc::client> second = ipc::client::create(conn, nullptr, kind);
+	receiver changed, renamed, other;
+	if (!first->subscribe("Scene", "changed", changed.handler()) || !second->subscribe("Scene", "renamed", renamed.handler()) ||
+	    !second->subscribe("Source", "changed", other.handler())) {
+		blog("Critical Failure: %s: Subscribing failed.", name);
+		return false;
+	}
+
+	// Only the subscriber of an event gets it, in the order it was published, while replies keep flowing.
+	size_t sent = 0;
+	for (uint64_t idx = 0; idx < EVENTS; idx++) {
+		sent += server.publish("Scene", "changed", {ipc::value(idx)});
+		if (idx % 1000 == 0 && first->call_synchronous_helper("Default", "GetState", {}).size() != 1) {
+			blog("Critical Failure: %s: Call between events failed.", name);
+			return false;
+		}
+	}
+	if (sent != EVENTS || !changed.wait(EVENTS) || !changed.ordered || renamed.count != 0 || other.count != 0) {
+		blog("Critical Failure: %s: %llu of %d events arrived, %s, %llu went to the wrong subscriber.", name, (unsigned long long)changed.count.load(),
+		     EVENTS, changed.ordered ? "in order" : "out of order", (unsigned long long)(renamed.count + other.count));
+		return false;
+	}
+	if (server.publish("Scene", "renamed", {ipc::value(uint64_t(0))}) != 1 || !renamed.wait(1) || server.publish("Scene", "missing", {}) != 0) {
+		blog("Critical Failure: %s: Second subscriber was not reached alone.", name);
+		return false;
+	}
+
+	// Encoded once for every subscriber, so a shared binary is copied in.
+	std::atomic<size_t> binary_size(0);
+	if (!first->subscribe("Scene", "thumbnail", [&binary_size](const std::vector<ipc::value> &values) {
+		    bool intact = values.size() == 1 && values[0].type == ipc::type::Binary && values[0].binary_size() > 0 &&
+				  std::all_of(values[0].binary_data(), values[0].binary_data() + values[0].binary_size(), [](char c) { return c == 't'; });
+		    binary_size = intact ? values[0].binary_size() : 1;
+	    })) {
+		blog("Critical Failure: %s: Subscribing failed.", name);
+		return false;
+	}
+	size_t reached = 0;
+	try {
+		reached = server.publish("Scene", "thumbnail", {ipc::value(std::make_shared<test_binary>(100000, 't'))});
+	} catch (std::exception &e) {
+		blog("Critical Failure: %s: Publishing a shared binary threw: %s", name, e.what());
+		return false;
+	}
+	for (size_t idx = 0; idx < 5000 && binary_size == 0; idx++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	if (reached != 1 || binary_size != 100000) {
+		blog("Critical Failure: %s: Shared binary event did not arrive intact.", name);
+		return false;
+	}
+
+	// Unsubscribing is one way, the next call is answered after it took effect.
+	if (!first->unsubscribe("Scene", "changed") || first->unsubscribe("Scene", "changed")) {
+		blog("Critical Failure: %s: Unsubscribing failed.", name);
+		return false;
+	}
+	first->call_synchronous_helper("Default", "GetState", {});
+	if (server.publish("Scene", "changed", {ipc::value(uint64_t(0))}) != 0) {
+		blog("Critical Failure: %s: Event still went out after unsubscribing.", name);
+		return false;
+	}
+
+	// Clients that went away drop out of the subscriber lists.
+	size_t gone = disconnects + 1;
+	second = nullptr;
+	for (size_t idx = 0; idx < 5000 && disconnects < gone; idx++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	if (server.publish("Scene", "renamed", {ipc::value(uint64_t(1))}) != 0) {
+		blog("Critical Failure: %s: Event went to a client that is gone.", name);
+		return false;
+	}
+
+	blog("%s: %d events arrived in order at their only subscriber, unsubscribed and departed clients got none.", name, EVENTS);
+	return true;
+}
+
+static bool measure(ipc::server &server, const std::string &conn)
+{
+	std::shared_ptr<ipc::client> client = ipc::client::create(conn);
+	std::atomic<int64_t> received_at(0);
+	auto now_ns = []() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	};
+	if (!client->subscribe("Default", "state", [&received_at, now_ns](const std::vector<ipc::value> &) { received_at = now_ns(); })) {
+		blog("Critical Failure: Subscribing failed.");
+		return false;
+	}
+
+	std::vector<int64_t> push, poll;
+	for (size_t idx = 0; idx < 2000; idx++) {
+		received_at = 0;
+		int64_t start = now_ns();
+		server.publish("Default", "state", {ipc::value(uint64_t(idx))});
+		while (received_at == 0) {
+			std::this_thread::yield();
+		}
+		push.push_back(received_at - start);
+
+		start = now_ns();
+		client->call_synchronous_helper("Default", "GetState", {});
+		poll.push_back(now_ns() - start);
+	}
+	std::sort(push.begin(), push.end());
+	std::sort(poll.begin(), poll.end());
+	blog("Median change to client: %lld ns pushed as event, %lld ns for one poll of a getter.", (long long)push[push.size() / 2],
+	     (long long)poll[poll.size() / 2]);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	std::string conn = CONN "-" + std::to_string(getpid());
+	ipc::server server;
+	std::shared_ptr<ipc::collection> collection = std::make_shared<ipc::collection>("Default");
+	collection->register_function(std::make_shared<ipc::function>("GetState", get_state));
+	server.register_collection(collection);
+	server.set_disconnect_handler(on_disconnect, nullptr);
+
+	try {
+		server.initialize(conn);
+	} catch (std::exception &e) {
+		blog("Unable to start server: %s", e.what());
+		return 1;
+	}
+
+	bool passed = check_fan_out(server, conn, ipc::client::transport::Default, "Socket") &&
+		      check_fan_out(server, conn, ipc::client::transport::SharedMemory, "Shared memory") && measure(server, conn);
+	server.finalize();
+
+	blog("Event checks %s.", passed ? "passed" : "failed");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,262 @@
+#include "ipc-server.hpp"
+#include "ipc-client.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+// Calls to concurrent, pinned and serial functions on one server. A slow
+// concurrent call must not hold up a serial call from the same client, its
+// reply has to find its caller after overtaking, several slow calls have to
+// overlap, and pinned calls from any client have to share one thread.
+// Asynchronous functions answer from the thread that completes them, without
+// holding up the connection's thread in between. A slow serial call holds up
+// the later serial calls of its own client, but no other client.
+
+#pragma region Logging
+std::chrono::high_resolution_clock::time_point tp = std::chrono::high_resolution_clock::now();
+
+static void blog(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::vector<char> text(vsnprintf(nullptr, 0, format, args) + 1);
+	va_end(args);
+	va_start(args, format);
+	vsnprintf(text.data(), text.size(), format, args);
+	va_end(args);
+
+	auto timeSinceStart = (std::chrono::high_resolution_clock::now() - tp);
+	auto hours = std::chrono::duration_cast<std::chrono::hours>(timeSinceStart);
+	timeSinceStart -= hours;
+	auto minutes = std::chrono::duration_cast<std::chrono::minutes>(timeSinceStart);
+	timeSinceStart -= minutes;
+	auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeSinceStart);
+	timeSinceStart -= seconds;
+	auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(timeSinceStart);
+	timeSinceStart -= milliseconds;
+	auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(timeSinceStart);
+	timeSinceStart -= microseconds;
+	auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeSinceStart);
+
+	fprintf(stdout, "%.2d:%.2d:%.2d.%.3d.%.3d.%.3d: [%d] %s\n", int(hours.count()), int(minutes.count()), int(seconds.count()),
+		int(milliseconds.count()), int(microseconds.count()), int(nanoseconds.count()), int(getpid()), text.data());
+	fflush(stdout);
+}
+#pragma endregion Logging
+
+#define CONN "/tmp/HelloWorldIPC-executor"
+#define SLOW_MS 200
+
+static uint64_t thread_tag()
+{
+	return uint64_t(std::hash<std::thread::id>()(std::this_thread::get_id()));
+}
+
+static void slow(void *data, const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(SLOW_MS));
+	rval = args;
+}
+
+static void echo(void *data, const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval)
+{
+	rval = args;
+}
+
+static void where(void *data, const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval)
+{
+	rval.push_back(ipc::value(thread_tag()));
+}
+
+// Completes from a thread of its own, a zero fails the call.
+static void later(void *data, const int64_t id, ipc::span<const ipc::value_view> args, ipc::call_completion_t done)
+{
+	uint64_t value = args.size() == 1 ? args[0].value_union.ui64 : 0;
+	std::thread([value, done]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(SLOW_MS));
+		std::vector<ipc::value> rval = {ipc::value(value)};
+		done(rval, value == 0 ? "zero" : "");
+	}).detach();
+}
+
+struct inbox {
+	std::mutex mtx;
+	std::vector<uint64_t> values;
+	std::chrono::high_resolution_clock::time_point last;
+};
+
+static void collect(void *data, const std::vector<ipc::value> &rval, std::chrono::high_resolution_clock::duration)
+{
+	inbox *box = static_cast<inbox *>(data);
+	std::unique_lock<std::mutex> ul(box->mtx);
+	box->values.push_back(rval.size() == 1 && rval[0].type == ipc::type::UInt64 ? rval[0].value_union.ui64 : UINT64_MAX);
+	box->last = std::chrono::high_resolution_clock::now();
+}
+
+static size_t received(inbox &box)
+{
+	std::unique_lock<std::mutex> ul(box.mtx);
+	return box.values.size();
+}
+
+static bool wait_for(inbox &box, size_t count)
+{
+	auto deadline = std::chrono::high_resolution_clock::now() + std::chrono::seconds(10);
+	while (received(box) < count) {
+		if (std::chrono::high_resolution_clock::now() > deadline) {
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+static uint64_t since_ms(std::chrono::high_resolution_clock::time_point start, std::chrono::high_resolution_clock::time_point end)
+{
+	return uint64_t(std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+}
+
+static bool check(const char *name, std::shared_ptr<ipc::client> client)
+{
+	// A serial call while a slow concurrent one is in flight.
+	inbox slow_box;
+	auto start = std::chrono::high_resolution_clock::now();
+	client->call("Default", "Slow", {ipc::value(uint64_t(7))}, collect, &slow_box);
+	auto rval = client->call_synchronous_helper("Default", "Where", {});
+	uint64_t serial_ms = since_ms(start, std::chrono::high_resolution_clock::now());
+	bool overtaken = received(slow_box) == 0;
+	if (!wait_for(slow_box, 1) || slow_box.values[0] != 7 || rval.size() != 1 || !overtaken || serial_ms >= SLOW_MS) {
+		blog("Critical Failure: %s: serial call took %llu ms behind a slow one, or a reply went astray.", name, (unsigned long long)serial_ms);
+		return false;
+	}
+	uint64_t serial_thread = rval[0].value_union.ui64;
+
+	// Four slow calls on four executor threads overlap.
+	inbox burst;
+	start = std::chrono::high_resolution_clock::now();
+	for (uint64_t idx = 0; idx < 4; idx++) {
+		client->call("Default", "Slow", {ipc::value(idx)}, collect, &burst);
+	}
+	if (!wait_for(burst, 4)) {
+		blog("Critical Failure: %s: concurrent calls did not complete.", name);
+		return false;
+	}
+	uint64_t burst_ms = since_ms(start, burst.last);
+	std::set<uint64_t> values(burst.values.begin(), burst.values.end());
+	if (values != std::set<uint64_t>{0, 1, 2, 3} || burst_ms >= 3 * SLOW_MS) {
+		blog("Critical Failure: %s: four slow calls took %llu ms or came back wrong.", name, (unsigned long long)burst_ms);
+		return false;
+	}
+
+	// Pinned calls all run on the same thread, which isn't the one serving serial calls.
+	inbox pinned;
+	for (size_t idx = 0; idx < 16; idx++) {
+		client->call("Default", "Pinned", {}, collect, &pinned);
+	}
+	if (!wait_for(pinned, 16) || std::set<uint64_t>(pinned.values.begin(), pinned.values.end()).size() != 1 || pinned.values[0] == serial_thread) {
+		blog("Critical Failure: %s: pinned calls ran on more than one thread.", name);
+		return false;
+	}
+
+	// An asynchronous call leaves the connection's thread free until it completes, and may fail.
+	inbox async_box;
+	start = std::chrono::high_resolution_clock::now();
+	client->call("Default", "Later", {ipc::value(uint64_t(5))}, collect, &async_box);
+	rval = client->call_synchronous_helper("Default", "Where", {});
+	uint64_t async_ms = since_ms(start, std::chrono::high_resolution_clock::now());
+	overtaken = received(async_box) == 0;
+	auto failed = client->call_synchronous_helper("Default", "Later", {ipc::value(uint64_t(0))});
+	if (!wait_for(async_box, 1) || async_box.values[0] != 5 || !overtaken || async_ms >= SLOW_MS || failed.size() != 1 ||
+	    failed[0].type != ipc::type::Null || std::string(failed[0].value_str).find("zero") == std::string::npos) {
+		blog("Critical Failure: %s: serial call took %llu ms behind an asynchronous one, or its result went astray.", name,
+		     (unsigned long long)async_ms);
+		return false;
+	}
+
+	blog("%s: serial call answered after %llu ms next to a %d ms call, four of those took %llu ms together.", name, (unsigned long long)serial_ms,
+	     SLOW_MS, (unsigned long long)burst_ms);
+	blog("%s: serial call answered after %llu ms next to a %d ms asynchronous call.", name, (unsigned long long)async_ms, SLOW_MS);
+	return true;
+}
+
+static bool check_isolation(const std::string &conn)
+{
+	std::shared_ptr<ipc::client> first = ipc::client::create(conn);
+	std::shared_ptr<ipc::client> second = ipc::client::create(conn);
+
+	inbox ordered;
+	first->call("Default", "SlowSerial", {ipc::value(uint64_t(1))}, collect, &ordered);
+	first->call("Default", "Echo", {ipc::value(uint64_t(2))}, collect, &ordered);
+	auto start = std::chrono::high_resolution_clock::now();
+	auto rval = second->call_synchronous_helper("Default", "Where", {});
+	uint64_t other_ms = since_ms(start, std::chrono::high_resolution_clock::now());
+	bool waiting = received(ordered) == 0;
+	if (!wait_for(ordered, 2) || ordered.values != std::vector<uint64_t>{1, 2} || rval.size() != 1 || !waiting || other_ms >= SLOW_MS) {
+		blog("Critical Failure: another client's serial call took %llu ms behind a slow one, or serial calls overtook each other.",
+		     (unsigned long long)other_ms);
+		return false;
+	}
+
+	blog("Serial call answered after %llu ms next to another client's %d ms serial call.", (unsigned long long)other_ms, SLOW_MS);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	std::string conn = CONN "-" + std::to_string(getpid());
+	ipc::server server;
+	server.set_executor_threads(4);
+
+	std::shared_ptr<ipc::collection> collection = std::make_shared<ipc::collection>("Default");
+	auto slow_function = std::make_shared<ipc::function>("Slow", slow);
+	slow_function->set_execution(ipc::execution::concurrent);
+	auto pinned_function = std::make_shared<ipc::function>("Pinned", where);
+	pinned_function->set_execution(ipc::execution::pinned);
+	collection->register_function(slow_function);
+	collection->register_function(std::make_shared<ipc::function>("SlowSerial", slow));
+	collection->register_function(std::make_shared<ipc::function>("Echo", echo));
+	collection->register_function(pinned_function);
+	collection->register_function(std::make_shared<ipc::function>("Where", where));
+	collection->register_function(std::make_shared<ipc::function>("Later", later, nullptr));
+	server.register_collection(collection);
+
+	try {
+		server.initialize(conn);
+	} catch (std::exception &e) {
+		blog("Unable to start server: %s", e.what());
+		return 1;
+	}
+
+	bool passed = check("Socket", ipc::client::create(conn)) &&
+		      check("Shared memory", ipc::client::create(conn, nullptr, ipc::client::transport::SharedMemory)) && check_isolation(conn);
+
+	// A connection that goes away with a call in flight.
+	{
+		std::shared_ptr<ipc::client> client = ipc::client::create(conn);
+		client->call("Default", "Slow", {ipc::value(uint64_t(1))});
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(SLOW_MS / 2));
+
+	// Finalizing while a call holds on to a connection that keeps sending calls for the executor.
+	std::shared_ptr<ipc::client> busy = ipc::client::create(conn, nullptr, ipc::client::transport::SharedMemory);
+	busy->call("Default", "Slow", {ipc::value(uint64_t(1))});
+	std::thread sender([busy]() {
+		auto deadline = std::chrono::high_resolution_clock::now() + std::chrono::seconds(2);
+		while (std::chrono::high_resolution_clock::now() < deadline && busy->call("Default", "Pinned", {})) {
+		}
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(SLOW_MS / 2));
+	server.finalize();
+	sender.join();
+	busy = nullptr;
+
+	blog("Executor checks %s.", passed ? "passed" : "failed");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,203 @@
+#include "posix/fifo.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// The FIFO engine behind the macOS transport, which behaves the same on Linux.
+// A child process echoes every frame it gets on one FIFO back on the other.
+// The parent measures small round trips, streams frames larger than the FIFO
+// and its read buffer, and checks that non-blocking reads and close() behave.
+
+#pragma region Logging
+std::chrono::high_resolution_clock::time_point tp = std::chrono::high_resolution_clock::now();
+
+static void blog(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::vector<char> text(vsnprintf(nullptr, 0, format, args) + 1);
+	va_end(args);
+	va_start(args, format);
+	vsnprintf(text.data(), text.size(), format, args);
+	va_end(args);
+
+	auto timeSinceStart = (std::chrono::high_resolution_clock::now() - tp);
+	auto hours = std::chrono::duration_cast<std::chrono::hours>(timeSinceStart);
+	timeSinceStart -= hours;
+	auto minutes = std::chrono::duration_cast<std::chrono::minutes>(timeSinceStart);
+	timeSinceStart -= minutes;
+	auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeSinceStart);
+	timeSinceStart -= seconds;
+	auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(timeSinceStart);
+	timeSinceStart -= milliseconds;
+	auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(timeSinceStart);
+	timeSinceStart -= microseconds;
+	auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeSinceStart);
+
+	fprintf(stdout, "%.2d:%.2d:%.2d.%.3d.%.3d.%.3d: [%d] %s\n", int(hours.count()), int(minutes.count()), int(seconds.count()),
+		int(milliseconds.count()), int(microseconds.count()), int(nanoseconds.count()), int(getpid()), text.data());
+	fflush(stdout);
+}
+#pragma endregion Logging
+
+#define CONN "/tmp/HelloWorldIPC-fifo"
+#define ROUNDTRIPS 20000
+
+static int parent(int argc, char *argv[]);
+static int child(int argc, char *argv[]);
+
+int main(int argc, char *argv[])
+{
+	if ((argc >= 3) && (strcmp(argv[1], "child") == 0)) {
+		return child(argc, argv);
+	} else {
+		return parent(argc, argv);
+	}
+}
+
+static bool send_frame(os::posix::fifo &out, const std::vector<char> &body)
+{
+	std::vector<char> frame(sizeof(uint64_t) + body.size());
+	uint64_t size = body.size();
+	memcpy(frame.data(), &size, sizeof(size));
+	std::copy(body.begin(), body.end(), frame.begin() + sizeof(size));
+	return out.write(frame.data(), frame.size()) == os::error::Success;
+}
+
+static bool receive_frame(os::posix::fifo &in, std::vector<char> &body)
+{
+	uint64_t size = 0;
+	if (in.read(reinterpret_cast<char *>(&size), sizeof(size), true) != os::error::Success) {
+		return false;
+	}
+	body.resize(size_t(size));
+	return in.read(body.data(), body.size(), true) == os::error::Success;
+}
+
+int child(int argc, char *argv[])
+{
+	os::posix::fifo in(std::string(argv[2]) + "-req");
+	os::posix::fifo out(std::string(argv[2]) + "-rep");
+
+	// An empty frame ends the test.
+	std::vector<char> body;
+	while (receive_frame(in, body) && !body.empty()) {
+		if (!send_frame(out, body)) {
+			blog("Critical Failure: Could not echo a frame.");
+			return 1;
+		}
+	}
+	return body.empty() ? 0 : 1;
+}
+
+static bool run(os::posix::fifo &out, os::posix::fifo &in)
+{
+	std::vector<char> body;
+	char byte;
+	if (in.read(&byte, 1, false) != os::error::Pending) {
+		blog("Critical Failure: Non-blocking read of an empty FIFO did not return Pending.");
+		return false;
+	}
+
+	std::vector<std::chrono::nanoseconds> latencies;
+	latencies.reserve(ROUNDTRIPS);
+	std::vector<char> small(64);
+	for (size_t idx = 0; idx < 1000 + ROUNDTRIPS; idx++) {
+		memcpy(small.data(), &idx, sizeof(idx));
+		auto start = std::chrono::high_resolution_clock::now();
+		if (!send_frame(out, small) || !receive_frame(in, body)) {
+			blog("Critical Failure: Round trip %llu failed.", (unsigned long long)idx);
+			return false;
+		}
+		if (idx >= 1000) {
+			latencies.push_back(std::chrono::high_resolution_clock::now() - start);
+		}
+		if (body != small) {
+			blog("Critical Failure: Round trip %llu returned the wrong frame.", (unsigned long long)idx);
+			return false;
+		}
+	}
+	std::sort(latencies.begin(), latencies.end());
+	blog("Small frames: median %llu ns, 99th percentile %llu ns per round trip.", (unsigned long long)latencies[ROUNDTRIPS / 2].count(),
+	     (unsigned long long)latencies[ROUNDTRIPS * 99 / 100].count());
+
+	// Far larger than the FIFO, so both sides have to wait for each other in the middle of a frame.
+	std::vector<char> large(4 * 1024 * 1024 + 17);
+	for (size_t idx = 0; idx < large.size(); idx++) {
+		large[idx] = char(idx * 31);
+	}
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t idx = 0; idx < 16; idx++) {
+		// The child can only echo once it has read the whole frame, so it is sent from another thread.
+		bool sent = false;
+		std::thread sender([&]() { sent = send_frame(out, large); });
+		bool received = receive_frame(in, body);
+		sender.join();
+		if (!sent || !received || body != large) {
+			blog("Critical Failure: Large frame %llu was not echoed back.", (unsigned long long)idx);
+			return false;
+		}
+	}
+	auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	blog("Large frames: 16 x %llu bytes echoed in %llu us, %.1f MB/s each way.", (unsigned long long)large.size(), (unsigned long long)duration.count(),
+	     double(16 * large.size()) / double(duration.count()));
+	return true;
+}
+
+int parent(int argc, char *argv[])
+{
+	std::string conn = CONN "-" + std::to_string(getpid());
+	if (os::posix::fifo::make(conn + "-req") < 0 || os::posix::fifo::make(conn + "-rep") < 0) {
+		blog("Critical Failure: Could not create the FIFOs.");
+		return 1;
+	}
+
+	bool passed = false;
+	pid_t pid = -1;
+	try {
+		os::posix::fifo out(conn + "-req");
+		os::posix::fifo in(conn + "-rep");
+
+		pid = fork();
+		if (pid == 0) {
+			execl("/proc/self/exe", argv[0], "child", conn.c_str(), nullptr);
+			_exit(127);
+		}
+
+		passed = run(out, in);
+		send_frame(out, {});
+
+		// A reader blocked on a silent FIFO has to be woken by close().
+		os::error ec = os::error::Success;
+		std::thread reader([&]() {
+			char byte;
+			ec = in.read(&byte, 1, true);
+		});
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		in.close();
+		reader.join();
+		if (ec != os::error::Disconnected) {
+			blog("Critical Failure: close() did not wake a blocked reader.");
+			passed = false;
+		}
+	} catch (std::exception &e) {
+		blog("Critical Failure: %s", e.what());
+	}
+
+	int status = 0;
+	if (pid > 0) {
+		waitpid(pid, &status, 0);
+	}
+	bool child_passed = pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	unlink((conn + "-req").c_str());
+	unlink((conn + "-rep").c_str());
+
+	blog("Child %s, parent %s.", child_passed ? "passed" : "failed", passed ? "passed" : "failed");
+	return passed && child_passed ? 0 : 1;
+}
@@ -0,0 +1,271 @@
+#include "ipc-server.hpp"
+#include "ipc-client.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+// ipc::server::set_live_value() and ipc::client::open_live_value(): a writer
+// far faster than a deliberately slow subscriber, over the socket and the
+// shared memory rings. The subscriber has to end up with the latest values
+// after a handful of notifications, and readers must never see values torn
+// between two stores. Shared binaries are stored as copies. Reading a live
+// value is compared with polling a getter.
+
+#pragma region Logging
+std::chrono::high_resolution_clock::time_point tp = std::chrono::high_resolution_clock::now();
+
+static void blog(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::vector<char> text(vsnprintf(nullptr, 0, format, args) + 1);
+	va_end(args);
+	va_start(args, format);
+	vsnprintf(text.data(), text.size(), format, args);
+	va_end(args);
+
+	auto timeSinceStart = (std::chrono::high_resolution_clock::now() - tp);
+	auto hours = std::chrono::duration_cast<std::chrono::hours>(timeSinceStart);
+	timeSinceStart -= hours;
+	auto minutes = std::chrono::duration_cast<std::chrono::minutes>(timeSinceStart);
+	timeSinceStart -= minutes;
+	auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeSinceStart);
+	timeSinceStart -= seconds;
+	auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(timeSinceStart);
+	timeSinceStart -= milliseconds;
+	auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(timeSinceStart);
+	timeSinceStart -= microseconds;
+	auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeSinceStart);
+
+	fprintf(stdout, "%.2d:%.2d:%.2d.%.3d.%.3d.%.3d: [%d] %s\n", int(hours.count()), int(minutes.count()), int(seconds.count()),
+		int(milliseconds.count()), int(microseconds.count()), int(nanoseconds.count()), int(getpid()), text.data());
+	fflush(stdout);
+}
+#pragma endregion Logging
+
+#define CONN "/tmp/HelloWorldIPC-live"
+#define STORES 20000
+
+static std::atomic<uint64_t> state(0);
+
+// Stands in for a binary a handler received shared and passes on.
+class test_binary : public ipc::shared_binary {
+	std::vector<char> m_data;
+
+public:
+	test_binary(size_t size, char fill) : m_data(size, fill) {}
+
+	virtual const char *data() const override { return m_data.data(); }
+	virtual size_t size() const override { return m_data.size(); }
+	virtual int get_handle() const override { return -1; }
+};
+
+static void get_state(void *data, const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval)
+{
+	rval.push_back(ipc::value(state.load()));
+}
+
+static std::vector<ipc::value> make_values(uint64_t idx)
+{
+	return {ipc::value(idx), ipc::value(double(idx) * 0.5), ipc::value(std::string(idx % 64, 'x'))};
+}
+
+// Whether |values| are all from the same store, and which one.
+static bool consistent(const std::vector<ipc::value> &values, uint64_t &idx)
+{
+	if (values.size() != 3 || values[0].type != ipc::type::UInt64 || values[1].type != ipc::type::Double || values[2].type != ipc::type::String) {
+		return false;
+	}
+	idx = values[0].value_union.ui64;
+	return values[1].value_union.fp64 == double(idx) * 0.5 && values[2].value_str.size() == idx % 64;
+}
+
+static bool check_conflation(ipc::server &server, const std::string &conn, ipc::client::transport kind, const char *name)
+{
+	std::shared_ptr<ipc::client> watcher = ipc::client::create(conn, nullptr, kind);
+	std::shared_ptr<ipc::client> poller = ipc::client::create(conn, nullptr, kind);
+
+	// A subscriber that takes far longer per change than the writer.
+	std::atomic<uint64_t> notified(0), latest(UINT64_MAX);
+	std::atomic<bool> torn(false);
+	std::shared_ptr<ipc::live_value> watched = watcher->open_live_value("meter", [&](const std::vector<ipc::value> &values) {
+		uint64_t idx = 0;
+		if (!consistent(values, idx)) {
+			torn = true;
+		}
+		latest = idx;
+		notified++;
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+	});
+	std::shared_ptr<ipc::live_value> polled = poller->open_live_value("meter");
+	if (!watched || !polled) {
+		blog("Critical Failure: %s: Opening the live value failed.", name);
+		return false;
+	}
+
+	// A reader copying values out while they are being replaced.
+	std::atomic<bool> writing(true);
+	std::atomic<uint64_t> reads(0);
+	std::thread reader([&]() {
+		std::vector<ipc::value> values;
+		uint64_t idx = 0, previous = 0;
+		while (writing) {
+			if (polled->read(values)) {
+				if (!consistent(values, idx) || idx < previous) {
+					torn = true;
+				}
+				previous = idx;
+				reads++;
+			}
+		}
+	});
+
+	// Values keep counting up across transports, so they only ever grow.
+	uint64_t base = polled->version(), final = base + STORES;
+	for (uint64_t idx = base + 1; idx <= final; idx++) {
+		if (!server.set_live_value("meter", make_values(idx))) {
+			blog("Critical Failure: %s: Storing failed.", name);
+			writing = false;
+			reader.join();
+			return false;
+		}
+	}
+	writing = false;
+	reader.join();
+	uint64_t pending = notified;
+
+	for (size_t idx = 0; idx < 5000 && latest != final; idx++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	std::vector<ipc::value> values;
+	uint64_t last = 0;
+	if (torn || latest != final || !polled->read(values) || !consistent(values, last) || last != final || polled->version() != final) {
+		blog("Critical Failure: %s: Subscriber ended at %llu, reader at %llu of %llu, %s.", name, (unsigned long long)latest.load(),
+		     (unsigned long long)last, (unsigned long long)final, torn ? "torn values were seen" : "no torn values");
+		return false;
+	}
+	// At most one in flight: once the writer stopped there is no backlog to work through, however slow the subscriber.
+	if (notified - pending > 2) {
+		blog("Critical Failure: %s: %llu notifications were still queued after the last store.", name, (unsigned long long)(notified - pending));
+		return false;
+	}
+
+	blog("%s: %d stores, the slow subscriber was notified %llu times and ended on the latest, %llu consistent reads meanwhile.", name, STORES,
+	     (unsigned long long)notified.load(), (unsigned long long)reads.load());
+	return true;
+}
+
+static bool check_lifetime(ipc::server &server, const std::string &conn)
+{
+	std::shared_ptr<ipc::client> client = ipc::client::create(conn);
+	if (server.create_live_value("meter", 4096) || server.set_live_value("missing", {}) || client->open_live_value("missing")) {
+		blog("Critical Failure: Duplicate or unknown live values were accepted.");
+		return false;
+	}
+
+	// Nothing to read until the first store.
+	if (!server.create_live_value("stats", 256)) {
+		blog("Critical Failure: Creating a second live value failed.");
+		return false;
+	}
+	std::shared_ptr<ipc::live_value> stats = client->open_live_value("stats");
+	std::vector<ipc::value> values;
+	if (!stats || stats->read(values) || stats->version() != 0) {
+		blog("Critical Failure: Live value could be read before it was stored.");
+		return false;
+	}
+
+	// Values that don't fit leave the previous ones in place.
+	uint64_t idx = 0;
+	if (!server.set_live_value("stats", make_values(7)) || server.set_live_value("stats", {ipc::value(std::vector<char>(512, 'b'))}) ||
+	    !stats->read(values) || !consistent(values, idx) || idx != 7 || stats->version() != 1) {
+		blog("Critical Failure: Oversized values were not rejected.");
+		return false;
+	}
+
+	// Removed, it can't be opened anymore but stays readable where it is open.
+	server.remove_live_value("stats");
+	if (client->open_live_value("stats") || !stats->read(values) || !consistent(values, idx) || idx != 7) {
+		blog("Critical Failure: Removed live value behaved unexpectedly.");
+		return false;
+	}
+
+	// Shared binaries are copied into the region.
+	std::shared_ptr<ipc::live_value> thumbnail;
+	try {
+		if (server.create_live_value("thumbnail", 4096) && server.set_live_value("thumbnail", {ipc::value(std::make_shared<test_binary>(1000, 't'))})) {
+			thumbnail = client->open_live_value("thumbnail");
+		}
+	} catch (std::exception &e) {
+		blog("Critical Failure: Storing a shared binary threw: %s", e.what());
+		return false;
+	}
+	if (!thumbnail || !thumbnail->read(values) || values.size() != 1 || values[0].type != ipc::type::Binary || values[0].binary_size() != 1000 ||
+	    !std::all_of(values[0].binary_data(), values[0].binary_data() + 1000, [](char c) { return c == 't'; })) {
+		blog("Critical Failure: Shared binary was not stored intact.");
+		return false;
+	}
+	server.remove_live_value("thumbnail");
+
+	blog("Unknown, duplicate, oversized and removed live values and shared binaries behave.");
+	return true;
+}
+
+static bool measure(ipc::server &server, const std::string &conn)
+{
+	std::shared_ptr<ipc::client> client = ipc::client::create(conn);
+	std::shared_ptr<ipc::live_value> meter = client->open_live_value("meter");
+	if (!meter) {
+		blog("Critical Failure: Opening the live value failed.");
+		return false;
+	}
+
+	std::vector<int64_t> read, poll;
+	std::vector<ipc::value> values;
+	for (size_t idx = 0; idx < 2000; idx++) {
+		server.set_live_value("meter", make_values(idx));
+		state = idx;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		meter->read(values);
+		read.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count());
+
+		start = std::chrono::high_resolution_clock::now();
+		client->call_synchronous_helper("Default", "GetState", {});
+		poll.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count());
+	}
+	std::sort(read.begin(), read.end());
+	std::sort(poll.begin(), poll.end());
+	blog("Median latest value: %lld ns reading the live value, %lld ns for one poll of a getter.", (long long)read[read.size() / 2],
+	     (long long)poll[poll.size() / 2]);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	std::string conn = CONN "-" + std::to_string(getpid());
+	ipc::server server;
+	std::shared_ptr<ipc::collection> collection = std::make_shared<ipc::collection>("Default");
+	collection->register_function(std::make_shared<ipc::function>("GetState", get_state));
+	server.register_collection(collection);
+
+	try {
+		server.initialize(conn);
+	} catch (std::exception &e) {
+		blog("Unable to start server: %s", e.what());
+		return 1;
+	}
+
+	bool passed = server.create_live_value("meter", 4096) && check_conflation(server, conn, ipc::client::transport::Default, "Socket") &&
+		      check_conflation(server, conn, ipc::client::transport::SharedMemory, "Shared memory") && check_lifetime(server, conn) &&
+		      measure(server, conn);
+	server.finalize();
+
+	blog("Live value checks %s.", passed ? "passed" : "failed");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,191 @@
+#include "ipc-server.hpp"
+#include "ipc-client.hpp"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <cstdarg>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Large Binary values passed as sealed memfds. One client shares everything
+// above a threshold, a second one copies everything into the frame, and both
+// echo the same payloads so the timings compare directly.
+
+#pragma region Logging
+std::chrono::high_resolution_clock::time_point tp = std::chrono::high_resolution_clock::now();
+
+static void blog(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::vector<char> text(vsnprintf(nullptr, 0, format, args) + 1);
+	va_end(args);
+	va_start(args, format);
+	vsnprintf(text.data(), text.size(), format, args);
+	va_end(args);
+
+	auto timeSinceStart = (std::chrono::high_resolution_clock::now() - tp);
+	auto hours = std::chrono::duration_cast<std::chrono::hours>(timeSinceStart);
+	timeSinceStart -= hours;
+	auto minutes = std::chrono::duration_cast<std::chrono::minutes>(timeSinceStart);
+	timeSinceStart -= minutes;
+	auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeSinceStart);
+	timeSinceStart -= seconds;
+	auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(timeSinceStart);
+	timeSinceStart -= milliseconds;
+	auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(timeSinceStart);
+	timeSinceStart -= microseconds;
+	auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeSinceStart);
+
+	fprintf(stdout, "%.2d:%.2d:%.2d.%.3d.%.3d.%.3d: [%d] %s\n", int(hours.count()), int(minutes.count()), int(seconds.count()),
+		int(milliseconds.count()), int(microseconds.count()), int(nanoseconds.count()), int(getpid()), text.data());
+	fflush(stdout);
+}
+#pragma endregion Logging
+
+#define CONN "/tmp/HelloWorldIPC-memfd"
+#define THRESHOLD (64 * 1024)
+#define LARGE_SIZE (16 * 1024 * 1024)
+#define ROUNDTRIPS 20
+
+static int server(int argc, char *argv[]);
+static int client(int argc, char *argv[]);
+
+int main(int argc, char *argv[])
+{
+	if ((argc >= 3) && (strcmp(argv[1], "client") == 0)) {
+		return client(argc, argv);
+	} else {
+		return server(argc, argv);
+	}
+}
+
+// Echoes the arguments and appends whether the first one arrived out of band.
+static void echo(void *data, const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval)
+{
+	rval = args;
+	rval.push_back(ipc::value(uint32_t((args.size() > 0 && args[0].get_shared_binary()) ? 1 : 0)));
+}
+
+int server(int argc, char *argv[])
+{
+	blog("Starting server...");
+
+	std::string conn = CONN "-" + std::to_string(getpid());
+	ipc::server socket;
+
+	std::shared_ptr<ipc::collection> collection = std::make_shared<ipc::collection>("Default");
+	collection->register_function(std::make_shared<ipc::function>("Echo", echo));
+	socket.register_collection(collection);
+
+	try {
+		socket.initialize(conn);
+	} catch (std::exception &e) {
+		blog("Unable to start server: %s", e.what());
+		return -1;
+	}
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		execl("/proc/self/exe", argv[0], "client", conn.c_str(), nullptr);
+		_exit(127);
+	}
+
+	int status = 0;
+	waitpid(pid, &status, 0);
+	bool failed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+
+	blog("Shutting down server, client %s.", failed ? "failed" : "passed");
+	socket.finalize();
+
+	return failed ? 1 : 0;
+}
+
+static bool check(const char *name, std::shared_ptr<ipc::client> socket, const std::vector<char> &payload, bool expect_shared)
+{
+	auto rval = socket->call_synchronous_helper("Default", "Echo", {ipc::value(payload)});
+	if (rval.size() != 2 || rval[0].type != ipc::type::Binary || rval[1].type != ipc::type::UInt32) {
+		blog("Critical Failure: %s echo failed%s%s.", name, rval.size() ? ", error " : "", rval.size() ? rval[0].value_str.c_str() : "");
+		return false;
+	}
+	if (rval[0].binary_size() != payload.size() || memcmp(rval[0].binary_data(), payload.data(), payload.size()) != 0) {
+		blog("Critical Failure: %s echo returned different contents.", name);
+		return false;
+	}
+
+	bool arrived_shared = rval[1].value_union.ui32 != 0;
+	bool returned_shared = rval[0].get_shared_binary() != nullptr;
+	if (arrived_shared != expect_shared || returned_shared != expect_shared) {
+		blog("Critical Failure: %s was %s shared to the server and %s shared back.", name, arrived_shared ? "" : "not", returned_shared ? "" : "not");
+		return false;
+	}
+
+	// Whatever the receiver maps has to be immutable.
+	if (returned_shared && (fcntl(rval[0].get_shared_binary()->get_handle(), F_GET_SEALS) & F_SEAL_WRITE) == 0) {
+		blog("Critical Failure: %s arrived in a memfd that is not sealed.", name);
+		return false;
+	}
+	return true;
+}
+
+static bool measure(const char *name, std::shared_ptr<ipc::client> socket, const std::vector<char> &payload)
+{
+	std::vector<std::chrono::nanoseconds> latencies;
+	for (size_t idx = 0; idx < ROUNDTRIPS; idx++) {
+		auto callstart = std::chrono::high_resolution_clock::now();
+		auto rval = socket->call_synchronous_helper("Default", "Echo", {ipc::value(payload)});
+		latencies.push_back(std::chrono::high_resolution_clock::now() - callstart);
+		if (rval.size() != 2 || rval[0].binary_size() != payload.size()) {
+			blog("Critical Failure: %s echo failed.", name);
+			return false;
+		}
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+	blog("%s: %llu MiB echo, median %llu us, best %llu us per round trip.", name, (unsigned long long)(payload.size() >> 20),
+	     (unsigned long long)std::chrono::duration_cast<std::chrono::microseconds>(latencies[ROUNDTRIPS / 2]).count(),
+	     (unsigned long long)std::chrono::duration_cast<std::chrono::microseconds>(latencies[0]).count());
+	return true;
+}
+
+int client(int argc, char *argv[])
+{
+	blog("Starting client...");
+
+	std::shared_ptr<ipc::client> shared, copied;
+	try {
+		shared = ipc::client::create(argv[2]);
+		copied = ipc::client::create(argv[2]);
+	} catch (std::exception &e) {
+		blog("Unable to start client: %s", e.what());
+		return -1;
+	}
+	shared->set_shared_binary_threshold(THRESHOLD);
+
+	std::vector<char> small(THRESHOLD - 1), large(LARGE_SIZE);
+	for (size_t idx = 0; idx < large.size(); idx++) {
+		large[idx] = char(idx * 31 + (idx >> 12));
+	}
+	std::copy(large.begin(), large.begin() + small.size(), small.begin());
+
+	if (!check("Below threshold", shared, small, false) || !check("Above threshold", shared, large, true) ||
+	    !check("Sharing disabled", copied, large, false)) {
+		return 1;
+	}
+
+	if (!measure("Copied", copied, large) || !measure("Shared", shared, large)) {
+		return 1;
+	}
+
+	blog("Shutting down client...");
+	shared = nullptr;
+	copied = nullptr;
+
+	return 0;
+}
@@ -0,0 +1,192 @@
+#include "ipc-server.hpp"
+#include "ipc-client.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+// ipc::client::call_one_way() and send_message(): the server runs the call
+// or passes the message on, in order with ordinary calls, and sends nothing
+// back, not even for calls that fail. Sending one way is compared against
+// calls whose replies are awaited.
+
+#pragma region Logging
+std::chrono::high_resolution_clock::time_point tp = std::chrono::high_resolution_clock::now();
+
+static void blog(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::vector<char> text(vsnprintf(nullptr, 0, format, args) + 1);
+	va_end(args);
+	va_start(args, format);
+	vsnprintf(text.data(), text.size(), format, args);
+	va_end(args);
+
+	auto timeSinceStart = (std::chrono::high_resolution_clock::now() - tp);
+	auto hours = std::chrono::duration_cast<std::chrono::hours>(timeSinceStart);
+	timeSinceStart -= hours;
+	auto minutes = std::chrono::duration_cast<std::chrono::minutes>(timeSinceStart);
+	timeSinceStart -= minutes;
+	auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeSinceStart);
+	timeSinceStart -= seconds;
+	auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(timeSinceStart);
+	timeSinceStart -= milliseconds;
+	auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(timeSinceStart);
+	timeSinceStart -= microseconds;
+	auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeSinceStart);
+
+	fprintf(stdout, "%.2d:%.2d:%.2d.%.3d.%.3d.%.3d: [%d] %s\n", int(hours.count()), int(minutes.count()), int(seconds.count()),
+		int(milliseconds.count()), int(microseconds.count()), int(nanoseconds.count()), int(getpid()), text.data());
+	fflush(stdout);
+}
+#pragma endregion Logging
+
+#define CONN "/tmp/HelloWorldIPC-oneway"
+#define CALLS 20000
+
+struct counters {
+	std::atomic<uint64_t> calls = 0;
+	std::atomic<uint64_t> sum = 0;
+	std::atomic<uint64_t> messages = 0;
+	std::vector<char> last_message;
+	std::atomic<uint64_t> connects = 0;
+} server_side;
+
+static void add(void *data, const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval)
+{
+	server_side.calls++;
+	server_side.sum += args.size() > 0 ? args[0].value_union.ui64 : 0;
+	rval.push_back(ipc::value(server_side.sum.load()));
+}
+
+static void on_message(void *data, int64_t id, const std::vector<char> &message)
+{
+	server_side.last_message = message;
+	server_side.messages++;
+}
+
+// Counts replies that arrive for the one-way calls, none should.
+static std::atomic<uint64_t> replies(0);
+
+static void count_reply(void *data, const std::vector<ipc::value> &rval, std::chrono::high_resolution_clock::duration)
+{
+	replies++;
+}
+
+static bool check_one_way(std::shared_ptr<ipc::client> client)
+{
+	uint64_t expected = 0;
+	for (uint64_t idx = 0; idx < 100; idx++) {
+		if (!client->call_one_way("Default", "Add", {ipc::value(idx)})) {
+			blog("Critical Failure: One way call %llu could not be sent.", (unsigned long long)idx);
+			return false;
+		}
+		expected += idx;
+	}
+	// Failing calls stay silent as well.
+	client->call_one_way("Default", "Missing", {});
+	client->call_one_way("Missing", "Add", {});
+
+	// Serial calls run in order, so the ordinary call sees all of the one way calls before it.
+	auto rval = client->call_synchronous_helper("Default", "Add", {ipc::value(uint64_t(0))});
+	if (rval.size() != 1 || rval[0].value_union.ui64 != expected || server_side.calls != 101) {
+		blog("Critical Failure: One way calls did not all run before the next call, sum %llu instead of %llu.",
+		     rval.empty() ? 0ull : (unsigned long long)rval[0].value_union.ui64, (unsigned long long)expected);
+		return false;
+	}
+
+	std::vector<char> message = {'h', 'e', 'l', 'l', 'o', '\0', 'x'};
+	if (!client->send_message(message) || !client->send_message({})) {
+		blog("Critical Failure: Message could not be sent.");
+		return false;
+	}
+	client->call_synchronous_helper("Default", "Add", {ipc::value(uint64_t(0))});
+	if (server_side.messages != 2 || !server_side.last_message.empty()) {
+		blog("Critical Failure: Message handler got %llu messages.", (unsigned long long)server_side.messages.load());
+		return false;
+	}
+
+	// One way entries of a batch get no reply either, a batch of only those gets no reply frame.
+	std::vector<ipc::call_spec> calls;
+	calls.push_back({"Default", "Add", {ipc::value(uint64_t(1))}});
+	calls.push_back({"Default", "Add", {ipc::value(uint64_t(2))}, count_reply, nullptr});
+	calls.push_back({"Default", "Add", {ipc::value(uint64_t(3))}});
+	client->call_batch(std::move(calls));
+	calls.clear();
+	calls.push_back({"Default", "Add", {ipc::value(uint64_t(4))}});
+	calls.push_back({"Default", "Add", {ipc::value(uint64_t(5))}});
+	client->call_batch(std::move(calls));
+	rval = client->call_synchronous_helper("Default", "Add", {ipc::value(uint64_t(0))});
+	if (rval.size() != 1 || rval[0].value_union.ui64 != expected + 15 || replies != 1) {
+		blog("Critical Failure: Batch with one way entries ran wrong or got %llu replies.", (unsigned long long)replies.load());
+		return false;
+	}
+
+	blog("One way: calls ran in order, failures stayed silent, messages arrived, batches answered only what was asked.");
+	return true;
+}
+
+static bool measure(std::shared_ptr<ipc::client> client)
+{
+	// Ordinary calls with a callback, the reply of each is dropped on arrival.
+	replies = 0;
+	uint64_t before = server_side.calls;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (uint64_t idx = 0; idx < CALLS; idx++) {
+		client->call("Default", "Add", {ipc::value(uint64_t(0))}, count_reply, nullptr);
+	}
+	while (replies < CALLS) {
+		std::this_thread::yield();
+	}
+	auto replied_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+	start = std::chrono::high_resolution_clock::now();
+	for (uint64_t idx = 0; idx < CALLS; idx++) {
+		client->call_one_way("Default", "Add", {ipc::value(uint64_t(0))});
+	}
+	client->call_synchronous_helper("Default", "Add", {ipc::value(uint64_t(0))});
+	auto one_way_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+	if (server_side.calls != before + 2 * CALLS + 1 || replies != CALLS) {
+		blog("Critical Failure: %llu calls ran and %llu replies arrived.", (unsigned long long)(server_side.calls - before),
+		     (unsigned long long)replies.load());
+		return false;
+	}
+	blog("%d calls: %lld ns per call with a reply, %lld ns per one way call.", CALLS, (long long)(replied_ns / CALLS), (long long)(one_way_ns / CALLS));
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	std::string conn = CONN "-" + std::to_string(getpid());
+	ipc::server server;
+	std::shared_ptr<ipc::collection> collection = std::make_shared<ipc::collection>("Default");
+	collection->register_function(std::make_shared<ipc::function>("Add", add));
+	server.register_collection(collection);
+	server.set_message_handler(on_message, nullptr);
+
+	try {
+		server.initialize(conn);
+	} catch (std::exception &e) {
+		blog("Unable to start server: %s", e.what());
+		return 1;
+	}
+
+	bool passed = false;
+	{
+		std::shared_ptr<ipc::client> client = ipc::client::create(conn);
+		// Replies arrive in order, so the handshake is through once this returns and one way calls go out as v2.
+		client->call_synchronous_helper("Default", "Add", {ipc::value(uint64_t(0))});
+		server_side.calls = 0;
+		passed = check_one_way(client) && measure(client);
+	}
+	server.finalize();
+
+	blog("One way call checks %s.", passed ? "passed" : "failed");
+	return passed ? 0 : 1;
+}
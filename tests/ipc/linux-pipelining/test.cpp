@@ -0,0 +1,225 @@
+#include "ipc-server.hpp"
+#include "ipc-client.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Throughput of one connection with 1, 8 and 64 calls in flight, issued by
+// four client threads. Every reply has to reach the callback of its own call,
+// which is checked with a function that lets calls overtake each other.
+
+#pragma region Logging
+std::chrono::high_resolution_clock::time_point tp = std::chrono::high_resolution_clock::now();
+
+static void blog(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::vector<char> text(vsnprintf(nullptr, 0, format, args) + 1);
+	va_end(args);
+	va_start(args, format);
+	vsnprintf(text.data(), text.size(), format, args);
+	va_end(args);
+
+	auto timeSinceStart = (std::chrono::high_resolution_clock::now() - tp);
+	auto hours = std::chrono::duration_cast<std::chrono::hours>(timeSinceStart);
+	timeSinceStart -= hours;
+	auto minutes = std::chrono::duration_cast<std::chrono::minutes>(timeSinceStart);
+	timeSinceStart -= minutes;
+	auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeSinceStart);
+	timeSinceStart -= seconds;
+	auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(timeSinceStart);
+	timeSinceStart -= milliseconds;
+	auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(timeSinceStart);
+	timeSinceStart -= microseconds;
+	auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeSinceStart);
+
+	fprintf(stdout, "%.2d:%.2d:%.2d.%.3d.%.3d.%.3d: [%d] %s\n", int(hours.count()), int(minutes.count()), int(seconds.count()),
+		int(milliseconds.count()), int(microseconds.count()), int(nanoseconds.count()), int(getpid()), text.data());
+	fflush(stdout);
+}
+#pragma endregion Logging
+
+#define CONN "/tmp/HelloWorldIPC-pipelining"
+#define THREADS 4
+#define CALLS 40000
+
+static int server(int argc, char *argv[]);
+static int client(int argc, char *argv[]);
+
+int main(int argc, char *argv[])
+{
+	if ((argc >= 3) && (strcmp(argv[1], "client") == 0)) {
+		return client(argc, argv);
+	} else {
+		return server(argc, argv);
+	}
+}
+
+static void echo(void *data, const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval)
+{
+	rval = args;
+}
+
+// Concurrent, so replies leave in whatever order the calls happen to finish.
+static void jitter(void *data, const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval)
+{
+	static thread_local std::mt19937 rng(uint32_t(std::hash<std::thread::id>()(std::this_thread::get_id())));
+	std::this_thread::sleep_for(std::chrono::microseconds(rng() % 500));
+	rval = args;
+}
+
+int server(int argc, char *argv[])
+{
+	blog("Starting server...");
+
+	std::string conn = CONN "-" + std::to_string(getpid());
+	ipc::server socket;
+	socket.set_executor_threads(8);
+
+	std::shared_ptr<ipc::collection> collection = std::make_shared<ipc::collection>("Default");
+	collection->register_function(std::make_shared<ipc::function>("Echo", echo));
+	auto jitter_function = std::make_shared<ipc::function>("Jitter", jitter);
+	jitter_function->set_execution(ipc::execution::concurrent);
+	collection->register_function(jitter_function);
+	socket.register_collection(collection);
+
+	try {
+		socket.initialize(conn);
+	} catch (std::exception &e) {
+		blog("Unable to start server: %s", e.what());
+		return -1;
+	}
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		execl("/proc/self/exe", argv[0], "client", conn.c_str(), nullptr);
+		_exit(127);
+	}
+
+	int status = 0;
+	waitpid(pid, &status, 0);
+	bool failed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+
+	blog("Shutting down server, client %s.", failed ? "failed" : "passed");
+	socket.finalize();
+
+	return failed ? 1 : 0;
+}
+
+// Bounds the calls in flight on the connection, shared by all sending threads.
+struct window {
+	std::mutex mtx;
+	std::condition_variable cv;
+	size_t in_flight = 0, depth = 1, completed = 0, mismatched = 0, overtaken = 0;
+	uint64_t last_seen = 0;
+
+	void acquire()
+	{
+		std::unique_lock<std::mutex> ul(mtx);
+		cv.wait(ul, [this]() { return in_flight < depth; });
+		in_flight++;
+	}
+};
+
+struct pending {
+	window *owner;
+	uint64_t expected;
+};
+
+static void client_call_handler(void *data, const std::vector<ipc::value> &rval, std::chrono::high_resolution_clock::duration)
+{
+	pending *call = static_cast<pending *>(data);
+	window &win = *call->owner;
+	std::unique_lock<std::mutex> ul(win.mtx);
+	if (rval.size() != 1 || rval[0].type != ipc::type::UInt64 || rval[0].value_union.ui64 != call->expected) {
+		win.mismatched++;
+	}
+	if (call->expected < win.last_seen) {
+		win.overtaken++;
+	}
+	win.last_seen = std::max(win.last_seen, call->expected);
+	win.completed++;
+	win.in_flight--;
+	win.cv.notify_all();
+}
+
+static bool run(std::shared_ptr<ipc::client> socket, const char *function, size_t depth, size_t calls, window &win)
+{
+	std::vector<pending> slots(calls);
+	std::atomic<size_t> next(0);
+	std::atomic<bool> failed(false);
+	win.depth = depth;
+
+	std::vector<std::thread> threads;
+	for (size_t idx = 0; idx < THREADS; idx++) {
+		threads.emplace_back([&]() {
+			for (size_t call = next++; call < calls; call = next++) {
+				win.acquire();
+				slots[call] = {&win, uint64_t(call)};
+				if (!socket->call("Default", function, {ipc::value(uint64_t(call))}, client_call_handler, &slots[call])) {
+					failed = true;
+					return;
+				}
+			}
+		});
+	}
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+
+	std::unique_lock<std::mutex> ul(win.mtx);
+	bool done = win.cv.wait_for(ul, std::chrono::seconds(30), [&win, calls]() { return win.completed == calls; });
+	return done && !failed && win.mismatched == 0;
+}
+
+int client(int argc, char *argv[])
+{
+	blog("Starting client on %u core(s)...", std::thread::hardware_concurrency());
+
+	std::shared_ptr<ipc::client> socket;
+	try {
+		socket = ipc::client::create(argv[2]);
+	} catch (std::exception &e) {
+		blog("Unable to start client: %s", e.what());
+		return -1;
+	}
+
+	// Warm up, this also gets the protocol handshake out of the way.
+	for (size_t idx = 0; idx < 1000; idx++) {
+		socket->call_synchronous_helper("Default", "Echo", {ipc::value(uint64_t(idx))});
+	}
+
+	double depth_one = 0;
+	for (size_t depth : {1, 8, 64}) {
+		window win;
+		auto start = std::chrono::high_resolution_clock::now();
+		if (!run(socket, "Echo", depth, CALLS, win)) {
+			blog("Critical Failure: Depth %zu lost or mismatched replies.", depth);
+			return 1;
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		double rate = CALLS / seconds;
+		depth_one = depth == 1 ? rate : depth_one;
+		blog("Depth %2zu: %8.0f calls per second, %.2fx depth 1.", depth, rate, rate / depth_one);
+	}
+
+	window win;
+	if (!run(socket, "Jitter", 64, 2000, win)) {
+		blog("Critical Failure: Replies that overtook each other reached the wrong callback.");
+		return 1;
+	}
+	blog("Out of order: %zu of 2000 replies overtook an earlier call, all reached their own callback.", win.overtaken);
+
+	blog("Shutting down client...");
+	socket = nullptr;
+	return 0;
+}
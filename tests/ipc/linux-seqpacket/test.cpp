@@ -0,0 +1,202 @@
+#include "ipc-server.hpp"
+#include "ipc-client.hpp"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <sstream>
+#include <chrono>
+#include <ctime>
+#include <mutex>
+#include <vector>
+#include <cstdarg>
+#include <cstring>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Linux counterpart of the synchronous-call and simple-multi-client tests.
+// The server and its clients run the same workloads (1000 synchronous echo
+// calls, 10000 asynchronous calls) so the numbers compare directly.
+
+#pragma region Logging
+std::chrono::high_resolution_clock::time_point tp = std::chrono::high_resolution_clock::now();
+
+static void blog(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::vector<char> text(vsnprintf(nullptr, 0, format, args) + 1);
+	va_end(args);
+	va_start(args, format);
+	vsnprintf(text.data(), text.size(), format, args);
+	va_end(args);
+
+	auto timeSinceStart = (std::chrono::high_resolution_clock::now() - tp);
+	auto hours = std::chrono::duration_cast<std::chrono::hours>(timeSinceStart);
+	timeSinceStart -= hours;
+	auto minutes = std::chrono::duration_cast<std::chrono::minutes>(timeSinceStart);
+	timeSinceStart -= minutes;
+	auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeSinceStart);
+	timeSinceStart -= seconds;
+	auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(timeSinceStart);
+	timeSinceStart -= milliseconds;
+	auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(timeSinceStart);
+	timeSinceStart -= microseconds;
+	auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeSinceStart);
+
+	fprintf(stdout, "%.2d:%.2d:%.2d.%.3d.%.3d.%.3d: [%d] %s\n", int(hours.count()), int(minutes.count()), int(seconds.count()),
+		int(milliseconds.count()), int(microseconds.count()), int(nanoseconds.count()), int(getpid()), text.data());
+	fflush(stdout);
+}
+#pragma endregion Logging
+
+#define CONN "/tmp/HelloWorldIPC2"
+#define CLIENTCOUNT 4ull
+
+static int server(int argc, char *argv[]);
+static int client(int argc, char *argv[]);
+
+int main(int argc, char *argv[])
+{
+	if ((argc >= 3) && (strcmp(argv[1], "client") == 0)) {
+		return client(argc, argv);
+	} else {
+		return server(argc, argv);
+	}
+}
+
+static void function1(void *data, const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval)
+{
+	rval.resize(args.size());
+	for (size_t idx = 0; idx < args.size(); idx++) {
+		rval[idx] = args[idx];
+	}
+	rval.push_back(ipc::value(0));
+}
+
+int server(int argc, char *argv[])
+{
+	blog("Starting server...");
+
+	std::string conn = CONN "-" + std::to_string(getpid());
+	ipc::server socket;
+
+	std::shared_ptr<ipc::collection> collection = std::make_shared<ipc::collection>("Default");
+	collection->register_function(std::make_shared<ipc::function>("Function1", function1));
+	socket.register_collection(collection);
+
+	try {
+		socket.initialize(conn);
+	} catch (std::exception &e) {
+		blog("Unable to start server: %s", e.what());
+		return -1;
+	}
+
+	blog("Spawning %llu clients...", CLIENTCOUNT);
+	std::vector<pid_t> clients;
+	for (size_t idx = 0; idx < CLIENTCOUNT; idx++) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			execl("/proc/self/exe", argv[0], "client", conn.c_str(), nullptr);
+			_exit(127);
+		}
+		clients.push_back(pid);
+	}
+
+	int failures = 0;
+	for (pid_t pid : clients) {
+		int status = 0;
+		waitpid(pid, &status, 0);
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			failures++;
+		}
+	}
+
+	blog("Shutting down server, %d client(s) failed.", failures);
+	socket.finalize();
+
+	return failures == 0 ? 0 : 1;
+}
+
+static void client_call_handler(void *data, const std::vector<ipc::value> &rval, std::chrono::high_resolution_clock::duration)
+{
+	std::atomic<size_t> *inbox = static_cast<std::atomic<size_t> *>(data);
+	(*inbox)++;
+}
+
+int client(int argc, char *argv[])
+{
+	blog("Starting client...");
+
+	std::shared_ptr<ipc::client> socket;
+
+	try {
+		socket = ipc::client::create(argv[2]);
+	} catch (std::exception &e) {
+		blog("Unable to start client: %s", e.what());
+		return -1;
+	}
+
+	// Synchronous round trips, same workload as tests/ipc/synchronous-call.
+	size_t total = 1000;
+	std::vector<std::chrono::nanoseconds> latencies;
+	latencies.reserve(total);
+	blog("Attempting to make %llu synchronous calls...", (unsigned long long)total);
+
+	auto tpstart = std::chrono::high_resolution_clock::now();
+	for (size_t idx = 0; idx < total; idx++) {
+		auto callstart = std::chrono::high_resolution_clock::now();
+		auto rval = socket->call_synchronous_helper("Default", "Function1", {ipc::value(uint64_t(idx))});
+		latencies.push_back(std::chrono::high_resolution_clock::now() - callstart);
+		if (rval.size() != 2 || rval[0].type != ipc::type::UInt64 || rval[0].value_union.ui64 != idx) {
+			blog("Critical Failure: Could not call function%s%s.", rval.size() ? ", error " : "", rval.size() ? rval[0].value_str.c_str() : "");
+			return 1;
+		}
+	}
+	auto tpend = std::chrono::high_resolution_clock::now();
+
+	std::sort(latencies.begin(), latencies.end());
+	auto tpdurns = std::chrono::duration_cast<std::chrono::nanoseconds>(tpend - tpstart);
+	blog("Synchronous: %llu calls in %llu microseconds.", (unsigned long long)total,
+	     (unsigned long long)std::chrono::duration_cast<std::chrono::microseconds>(tpdurns).count());
+	blog("Synchronous: average %llu ns, median %llu ns, 99th percentile %llu ns per call.", (unsigned long long)(tpdurns.count() / total),
+	     (unsigned long long)latencies[total / 2].count(), (unsigned long long)latencies[total * 99 / 100].count());
+
+	// Frames larger than one packet are split and reassembled.
+	std::vector<char> large(4 * 1024 * 1024 + 17, 'x');
+	auto rval = socket->call_synchronous_helper("Default", "Function1", {ipc::value(large)});
+	if (rval.size() != 2 || rval[0].type != ipc::type::Binary || rval[0].binary_size() != large.size() ||
+	    memcmp(rval[0].binary_data(), large.data(), large.size()) != 0) {
+		blog("Critical Failure: Large payload was not echoed back.");
+		return 1;
+	}
+
+	// Asynchronous throughput, same workload as tests/ipc/simple-multi-client.
+	std::atomic<size_t> inbox = 0;
+	size_t outbox = 0;
+	total = 10000;
+	blog("Attempting to make %llu calls...", (unsigned long long)total);
+
+	tpstart = std::chrono::high_resolution_clock::now();
+	while (outbox < total) {
+		if (!socket->call("Default", "Function1", {}, client_call_handler, &inbox)) {
+			blog("Critical Failure: Could not call function.");
+			return 1;
+		}
+		outbox++;
+	}
+	while (inbox < outbox) {
+		std::this_thread::sleep_for(std::chrono::microseconds(50));
+	}
+	tpend = std::chrono::high_resolution_clock::now();
+
+	tpdurns = std::chrono::duration_cast<std::chrono::nanoseconds>(tpend - tpstart);
+	blog("Sent %llu & Received %llu messages in %llu milliseconds.", (unsigned long long)outbox, (unsigned long long)inbox.load(),
+	     (unsigned long long)std::chrono::duration_cast<std::chrono::milliseconds>(tpdurns).count());
+	blog("Average %llu ns per message.", (unsigned long long)(tpdurns.count() / total));
+
+	blog("Shutting down client...");
+	socket = nullptr;
+
+	return 0;
+}
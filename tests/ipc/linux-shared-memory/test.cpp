@@ -0,0 +1,194 @@
+#include "ipc-server.hpp"
+#include "ipc-client.hpp"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <cstdarg>
+#include <cstring>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Round trip latency of the socket transport against the shared memory rings.
+// A single client makes the same synchronous calls over both, then pushes a
+// payload larger than a ring and a burst of asynchronous calls through the
+// rings.
+
+#pragma region Logging
+std::chrono::high_resolution_clock::time_point tp = std::chrono::high_resolution_clock::now();
+
+static void blog(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::vector<char> text(vsnprintf(nullptr, 0, format, args) + 1);
+	va_end(args);
+	va_start(args, format);
+	vsnprintf(text.data(), text.size(), format, args);
+	va_end(args);
+
+	auto timeSinceStart = (std::chrono::high_resolution_clock::now() - tp);
+	auto hours = std::chrono::duration_cast<std::chrono::hours>(timeSinceStart);
+	timeSinceStart -= hours;
+	auto minutes = std::chrono::duration_cast<std::chrono::minutes>(timeSinceStart);
+	timeSinceStart -= minutes;
+	auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeSinceStart);
+	timeSinceStart -= seconds;
+	auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(timeSinceStart);
+	timeSinceStart -= milliseconds;
+	auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(timeSinceStart);
+	timeSinceStart -= microseconds;
+	auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeSinceStart);
+
+	fprintf(stdout, "%.2d:%.2d:%.2d.%.3d.%.3d.%.3d: [%d] %s\n", int(hours.count()), int(minutes.count()), int(seconds.count()),
+		int(milliseconds.count()), int(microseconds.count()), int(nanoseconds.count()), int(getpid()), text.data());
+	fflush(stdout);
+}
+#pragma endregion Logging
+
+#define CONN "/tmp/HelloWorldIPC-shm"
+#define ROUNDTRIPS 20000
+#define TARGET_NS 5000
+
+static int server(int argc, char *argv[]);
+static int client(int argc, char *argv[]);
+
+int main(int argc, char *argv[])
+{
+	if ((argc >= 3) && (strcmp(argv[1], "client") == 0)) {
+		return client(argc, argv);
+	} else {
+		return server(argc, argv);
+	}
+}
+
+static void function1(void *data, const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval)
+{
+	rval.resize(args.size());
+	for (size_t idx = 0; idx < args.size(); idx++) {
+		rval[idx] = args[idx];
+	}
+	rval.push_back(ipc::value(0));
+}
+
+int server(int argc, char *argv[])
+{
+	blog("Starting server...");
+
+	std::string conn = CONN "-" + std::to_string(getpid());
+	ipc::server socket;
+
+	std::shared_ptr<ipc::collection> collection = std::make_shared<ipc::collection>("Default");
+	collection->register_function(std::make_shared<ipc::function>("Function1", function1));
+	socket.register_collection(collection);
+
+	try {
+		socket.initialize(conn);
+	} catch (std::exception &e) {
+		blog("Unable to start server: %s", e.what());
+		return -1;
+	}
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		execl("/proc/self/exe", argv[0], "client", conn.c_str(), nullptr);
+		_exit(127);
+	}
+
+	int status = 0;
+	waitpid(pid, &status, 0);
+	bool failed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+
+	blog("Shutting down server, client %s.", failed ? "failed" : "passed");
+	socket.finalize();
+
+	return failed ? 1 : 0;
+}
+
+static bool measure(const char *name, std::shared_ptr<ipc::client> socket, std::chrono::nanoseconds &median)
+{
+	std::vector<std::chrono::nanoseconds> latencies;
+	latencies.reserve(ROUNDTRIPS);
+
+	// Warm up both processes and the allocator before timing.
+	for (size_t idx = 0; idx < 1000; idx++) {
+		socket->call_synchronous_helper("Default", "Function1", {ipc::value(uint64_t(idx))});
+	}
+
+	for (size_t idx = 0; idx < ROUNDTRIPS; idx++) {
+		auto callstart = std::chrono::high_resolution_clock::now();
+		auto rval = socket->call_synchronous_helper("Default", "Function1", {ipc::value(uint64_t(idx))});
+		latencies.push_back(std::chrono::high_resolution_clock::now() - callstart);
+		if (rval.size() != 2 || rval[0].type != ipc::type::UInt64 || rval[0].value_union.ui64 != idx) {
+			blog("Critical Failure: %s call %llu returned the wrong value.", name, (unsigned long long)idx);
+			return false;
+		}
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+	median = latencies[ROUNDTRIPS / 2];
+	blog("%s: median %llu ns, 99th percentile %llu ns, best %llu ns per round trip.", name, (unsigned long long)median.count(),
+	     (unsigned long long)latencies[ROUNDTRIPS * 99 / 100].count(), (unsigned long long)latencies[0].count());
+	return true;
+}
+
+static void client_call_handler(void *data, const std::vector<ipc::value> &rval, std::chrono::high_resolution_clock::duration)
+{
+	std::atomic<size_t> *inbox = static_cast<std::atomic<size_t> *>(data);
+	(*inbox)++;
+}
+
+int client(int argc, char *argv[])
+{
+	blog("Starting client on %u core(s)...", std::thread::hardware_concurrency());
+
+	std::shared_ptr<ipc::client> pipe, shm;
+	try {
+		pipe = ipc::client::create(argv[2], nullptr, ipc::client::transport::Default);
+		shm = ipc::client::create(argv[2], nullptr, ipc::client::transport::SharedMemory);
+	} catch (std::exception &e) {
+		blog("Unable to start client: %s", e.what());
+		return -1;
+	}
+
+	std::chrono::nanoseconds pipe_median, shm_median;
+	if (!measure("Socket", pipe, pipe_median) || !measure("Shared memory", shm, shm_median)) {
+		return 1;
+	}
+	blog("Shared memory median is %s the %d ns target.", shm_median.count() < TARGET_NS ? "within" : "above", TARGET_NS);
+	pipe = nullptr;
+
+	// Four times the ring size, so the frame has to be streamed through it in both directions.
+	std::vector<char> large(4 * 1024 * 1024 + 17, 'x');
+	auto rval = shm->call_synchronous_helper("Default", "Function1", {ipc::value(large)});
+	if (rval.size() != 2 || rval[0].type != ipc::type::Binary || rval[0].binary_size() != large.size() ||
+	    memcmp(rval[0].binary_data(), large.data(), large.size()) != 0) {
+		blog("Critical Failure: Large payload was not echoed back.");
+		return 1;
+	}
+
+	std::atomic<size_t> inbox = 0;
+	size_t outbox = 0, total = 10000;
+	auto tpstart = std::chrono::high_resolution_clock::now();
+	while (outbox < total) {
+		if (!shm->call("Default", "Function1", {}, client_call_handler, &inbox)) {
+			blog("Critical Failure: Could not call function.");
+			return 1;
+		}
+		outbox++;
+	}
+	while (inbox < outbox) {
+		std::this_thread::sleep_for(std::chrono::microseconds(50));
+	}
+	auto tpdurns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - tpstart);
+	blog("Shared memory: %llu asynchronous calls, average %llu ns per message.", (unsigned long long)total,
+	     (unsigned long long)(tpdurns.count() / total));
+
+	blog("Shutting down client...");
+	shm = nullptr;
+
+	return 0;
+}
@@ -0,0 +1,255 @@
+#include "ipc.hpp"
+#include "ipc-server.hpp"
+#include "ipc-client.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// A client that sends calls with large replies and never reads them. The
+// server has to give up on it once the call timeout passed without the socket
+// draining, instead of holding a thread forever, and other clients have to be
+// served meanwhile. Then a subscriber that stops reading: publish() may not
+// wait for it, the other subscriber gets every event and the stalled one is
+// dropped once its backlog grows too large.
+
+#pragma region Logging
+std::chrono::high_resolution_clock::time_point tp = std::chrono::high_resolution_clock::now();
+
+static void blog(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::vector<char> text(vsnprintf(nullptr, 0, format, args) + 1);
+	va_end(args);
+	va_start(args, format);
+	vsnprintf(text.data(), text.size(), format, args);
+	va_end(args);
+
+	auto timeSinceStart = (std::chrono::high_resolution_clock::now() - tp);
+	auto hours = std::chrono::duration_cast<std::chrono::hours>(timeSinceStart);
+	timeSinceStart -= hours;
+	auto minutes = std::chrono::duration_cast<std::chrono::minutes>(timeSinceStart);
+	timeSinceStart -= minutes;
+	auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeSinceStart);
+	timeSinceStart -= seconds;
+	auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(timeSinceStart);
+	timeSinceStart -= milliseconds;
+	auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(timeSinceStart);
+	timeSinceStart -= microseconds;
+	auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeSinceStart);
+
+	fprintf(stdout, "%.2d:%.2d:%.2d.%.3d.%.3d.%.3d: [%d] %s\n", int(hours.count()), int(minutes.count()), int(seconds.count()),
+		int(milliseconds.count()), int(microseconds.count()), int(nanoseconds.count()), int(getpid()), text.data());
+	fflush(stdout);
+}
+#pragma endregion Logging
+
+#define CONN "/tmp/HelloWorldIPC-stalled"
+#define REPLY_SIZE (256 * 1024)
+#define EVENT_SIZE (4 * 1024)
+#define EVENT_COUNT 4000
+
+static std::atomic<int> disconnects(0);
+
+static void on_disconnect(void *, int64_t)
+{
+	disconnects++;
+}
+
+static void big(void *, const int64_t, const std::vector<ipc::value> &, std::vector<ipc::value> &rval)
+{
+	rval.push_back(ipc::value(std::vector<char>(REPLY_SIZE, 'b')));
+}
+
+static void echo(void *, const int64_t, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval)
+{
+	rval = args;
+}
+
+static int raw_connect(const std::string &path)
+{
+	sockaddr_un addr = {};
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+	int fd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// Sends calls to Big in v1, the replies are never read.
+static bool stall(int fd, size_t calls)
+{
+	for (size_t idx = 0; idx < calls; idx++) {
+		ipc::message::function_call call;
+		call.uid = ipc::value(uint64_t(idx + 1));
+		call.class_name = ipc::value(std::string("Default"));
+		call.function_name = ipc::value(std::string("Big"));
+		ipc::frame_builder builder;
+		call.serialize(builder, nullptr, ipc::protocol::v1);
+		builder.finish(ipc::protocol::v1);
+		if (send(fd, builder.data(), builder.size(), MSG_NOSIGNAL) != ssize_t(builder.size())) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool raw_call(int fd, ipc::message::function_call &call)
+{
+	ipc::frame_builder builder;
+	call.serialize(builder, nullptr, ipc::protocol::v1);
+	builder.finish(ipc::protocol::v1);
+	if (send(fd, builder.data(), builder.size(), MSG_NOSIGNAL) != ssize_t(builder.size())) {
+		return false;
+	}
+
+	std::vector<char> frame(64 * 1024);
+	ssize_t length = recv(fd, frame.data(), frame.size(), 0);
+	if (length < ssize_t(sizeof(ipc::ipc_size_t))) {
+		return false;
+	}
+	frame.resize(size_t(length));
+	ipc::message::function_reply reply;
+	reply.deserialize(frame, sizeof(ipc::ipc_size_t), nullptr, ipc::protocol::v1);
+	return reply.error.value_str.empty();
+}
+
+// Agrees on v2 and subscribes to Scene.changed, events are never read after that.
+static bool stalled_subscriber(int fd)
+{
+	ipc::message::function_call call;
+	call.uid = ipc::value(uint64_t(1));
+	call.class_name = ipc::value(std::string(ipc::protocol_handshake_class));
+	call.function_name = ipc::value(std::string(ipc::protocol_handshake_function));
+	call.arguments = {ipc::value(uint32_t(ipc::protocol::v2))};
+	if (!raw_call(fd, call)) {
+		return false;
+	}
+
+	call.uid = ipc::value(uint64_t(2));
+	call.class_name = ipc::value(std::string(ipc::event_class));
+	call.function_name = ipc::value(std::string(ipc::event_subscribe));
+	call.arguments = {ipc::value(std::string("Scene")), ipc::value(std::string("changed"))};
+	return raw_call(fd, call);
+}
+
+static bool wait_for_disconnects(int count, std::chrono::seconds timeout)
+{
+	auto deadline = std::chrono::high_resolution_clock::now() + timeout;
+	while (disconnects < count) {
+		if (std::chrono::high_resolution_clock::now() > deadline) {
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	std::string conn = CONN "-" + std::to_string(getpid());
+	ipc::server server;
+	server.set_call_timeout(1);
+	server.set_disconnect_handler(on_disconnect, nullptr);
+	std::shared_ptr<ipc::collection> collection = std::make_shared<ipc::collection>("Default");
+	collection->register_function(std::make_shared<ipc::function>("Big", big));
+	collection->register_function(std::make_shared<ipc::function>("Echo", echo));
+	server.register_collection(collection);
+	try {
+		server.initialize(conn);
+	} catch (std::exception &e) {
+		blog("Unable to start server: %s", e.what());
+		return 1;
+	}
+
+	bool passed = true;
+	int fd = raw_connect(conn);
+	auto start = std::chrono::high_resolution_clock::now();
+	if (fd < 0 || !stall(fd, 16)) {
+		blog("Critical Failure: Unable to send calls to the server.");
+		passed = false;
+	}
+
+	// Answered while the server still waits for the stalled client to read.
+	std::shared_ptr<ipc::client> client = ipc::client::create(conn);
+	auto rval = client->call_synchronous_helper("Default", "Echo", {ipc::value(uint64_t(42))});
+	if (passed && (rval.size() != 1 || rval[0].type != ipc::type::UInt64 || rval[0].value_union.ui64 != 42)) {
+		blog("Critical Failure: Another client wasn't served next to the stalled one.");
+		passed = false;
+	}
+
+	if (passed && !wait_for_disconnects(1, std::chrono::seconds(10))) {
+		blog("Critical Failure: The server kept waiting for a client that doesn't read.");
+		passed = false;
+	}
+	uint64_t stalled_ms = uint64_t(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count());
+
+	rval = client->call_synchronous_helper("Default", "Echo", {ipc::value(uint64_t(43))});
+	if (passed && (rval.size() != 1 || rval[0].type != ipc::type::UInt64 || rval[0].value_union.ui64 != 43)) {
+		blog("Critical Failure: The other client lost its connection too.");
+		passed = false;
+	}
+
+	std::atomic<size_t> received(0);
+	int subscriber = raw_connect(conn);
+	if (passed && (subscriber < 0 || !stalled_subscriber(subscriber) ||
+		       !client->subscribe("Scene", "changed", [&received](const std::vector<ipc::value> &) { received++; }))) {
+		blog("Critical Failure: Unable to subscribe.");
+		passed = false;
+	}
+
+	std::chrono::high_resolution_clock::duration slowest = {};
+	if (passed) {
+		std::vector<char> payload(EVENT_SIZE, 'e');
+		for (size_t idx = 0; idx < EVENT_COUNT; idx++) {
+			auto begin = std::chrono::high_resolution_clock::now();
+			server.publish("Scene", "changed", {ipc::value(payload)});
+			slowest = std::max(slowest, std::chrono::high_resolution_clock::now() - begin);
+		}
+	}
+	uint64_t slowest_ms = uint64_t(std::chrono::duration_cast<std::chrono::milliseconds>(slowest).count());
+	if (passed && slowest_ms >= 500) {
+		blog("Critical Failure: publish() waited %llu ms for a subscriber that doesn't read.", (unsigned long long)slowest_ms);
+		passed = false;
+	}
+
+	auto deadline = std::chrono::high_resolution_clock::now() + std::chrono::seconds(10);
+	while (passed && received < EVENT_COUNT && std::chrono::high_resolution_clock::now() < deadline) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	if (passed && received != EVENT_COUNT) {
+		blog("Critical Failure: The reading subscriber got %zu of %d events.", size_t(received), EVENT_COUNT);
+		passed = false;
+	}
+	if (passed && !wait_for_disconnects(2, std::chrono::seconds(10))) {
+		blog("Critical Failure: The subscriber that doesn't read was kept.");
+		passed = false;
+	}
+
+	client = nullptr;
+	if (fd >= 0) {
+		close(fd);
+	}
+	if (subscriber >= 0) {
+		close(subscriber);
+	}
+	server.finalize();
+
+	if (passed) {
+		blog("Stalled client dropped after %llu ms with a call timeout of 1 s.", (unsigned long long)stalled_ms);
+		blog("Slowest publish() took %llu ms next to a subscriber that doesn't read.", (unsigned long long)slowest_ms);
+	}
+	blog("Stalled client checks %s.", passed ? "passed" : "failed");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,235 @@
+#include "ipc-server.hpp"
+#include "ipc-client.hpp"
+#include "ipc-completion.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <semaphore.h>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+// What a synchronous call pays to wait for its reply. The named semaphore
+// the macOS client created per call and the mutex and condition variable
+// the Linux client built per call, against a pooled completion slot: first
+// the bare setup, signal and wait, then whole calls over a socket. Several
+// threads making synchronous calls at once must each get their own reply.
+
+#pragma region Logging
+std::chrono::high_resolution_clock::time_point tp = std::chrono::high_resolution_clock::now();
+
+static void blog(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::vector<char> text(vsnprintf(nullptr, 0, format, args) + 1);
+	va_end(args);
+	va_start(args, format);
+	vsnprintf(text.data(), text.size(), format, args);
+	va_end(args);
+
+	auto timeSinceStart = (std::chrono::high_resolution_clock::now() - tp);
+	auto hours = std::chrono::duration_cast<std::chrono::hours>(timeSinceStart);
+	timeSinceStart -= hours;
+	auto minutes = std::chrono::duration_cast<std::chrono::minutes>(timeSinceStart);
+	timeSinceStart -= minutes;
+	auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeSinceStart);
+	timeSinceStart -= seconds;
+	auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(timeSinceStart);
+	timeSinceStart -= milliseconds;
+	auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(timeSinceStart);
+	timeSinceStart -= microseconds;
+	auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeSinceStart);
+
+	fprintf(stdout, "%.2d:%.2d:%.2d.%.3d.%.3d.%.3d: [%d] %s\n", int(hours.count()), int(minutes.count()), int(seconds.count()),
+		int(milliseconds.count()), int(microseconds.count()), int(nanoseconds.count()), int(getpid()), text.data());
+	fflush(stdout);
+}
+#pragma endregion Logging
+
+#define CONN "/tmp/HelloWorldIPC-sync-completion"
+#define ITERATIONS 20000
+#define CALLS 5000
+
+typedef std::chrono::high_resolution_clock::duration duration_t;
+
+static void echo(void *data, const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval)
+{
+	rval = args;
+}
+
+#pragma region Waits
+// How the macOS client waited: a fresh named semaphore per call.
+struct named_semaphore {
+	sem_t *sem = SEM_FAILED;
+	std::string name;
+	std::vector<ipc::value> values;
+
+	bool open()
+	{
+		name = "/ipc-sem-cb" + std::to_string(rand());
+		sem_unlink(name.c_str());
+		sem = sem_open(name.c_str(), O_CREAT | O_EXCL, 0644, 0);
+		return sem != SEM_FAILED;
+	}
+	void signal() { sem_post(sem); }
+	void wait()
+	{
+		sem_wait(sem);
+		sem_close(sem);
+		sem_unlink(name.c_str());
+	}
+};
+
+// How the Linux client waited: a mutex and condition variable per call.
+struct condition {
+	std::mutex mtx;
+	std::condition_variable cv;
+	bool called = false;
+	std::vector<ipc::value> values;
+
+	bool open() { return true; }
+	void signal()
+	{
+		std::unique_lock<std::mutex> ul(mtx);
+		called = true;
+		cv.notify_one();
+	}
+	void wait()
+	{
+		std::unique_lock<std::mutex> ul(mtx);
+		cv.wait(ul, [this]() { return called; });
+	}
+};
+
+struct pooled {
+	ipc::completion::lease done;
+	std::vector<ipc::value> values;
+
+	bool open() { return true; }
+	void signal() { done->signal(); }
+	void wait() { done->wait(); }
+};
+#pragma endregion Waits
+
+// Setup, signal and wait on one thread, which is the part a call adds on top of the round trip.
+template<typename Wait> static uint64_t bare_ns()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t idx = 0; idx < ITERATIONS; idx++) {
+		Wait slot;
+		if (!slot.open()) {
+			return UINT64_MAX;
+		}
+		slot.signal();
+		slot.wait();
+	}
+	return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count() / ITERATIONS);
+}
+
+template<typename Wait> static void on_reply(void *data, const std::vector<ipc::value> &rval, duration_t)
+{
+	Wait &slot = *static_cast<Wait *>(data);
+	slot.values = rval;
+	slot.signal();
+}
+
+// Whole calls made through call() with each kind of wait, like call_synchronous_helper() does.
+template<typename Wait> static uint64_t call_ns(std::shared_ptr<ipc::client> client, bool &correct)
+{
+	std::vector<uint64_t> samples;
+	samples.reserve(CALLS);
+	for (uint64_t idx = 0; idx < CALLS; idx++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		Wait slot;
+		int64_t cbid = 0;
+		if (!slot.open() || !client->call("Default", "Echo", {ipc::value(idx)}, &on_reply<Wait>, &slot, cbid)) {
+			correct = false;
+			return UINT64_MAX;
+		}
+		slot.wait();
+		samples.push_back(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count()));
+		correct = correct && slot.values.size() == 1 && slot.values[0].value_union.ui64 == idx;
+	}
+	std::sort(samples.begin(), samples.end());
+	return samples[samples.size() / 2];
+}
+
+static uint64_t helper_ns(std::shared_ptr<ipc::client> client, bool &correct)
+{
+	std::vector<uint64_t> samples;
+	samples.reserve(CALLS);
+	for (uint64_t idx = 0; idx < CALLS; idx++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		auto rval = client->call_synchronous_helper("Default", "Echo", {ipc::value(idx)});
+		samples.push_back(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count()));
+		correct = correct && rval.size() == 1 && rval[0].value_union.ui64 == idx;
+	}
+	std::sort(samples.begin(), samples.end());
+	return samples[samples.size() / 2];
+}
+
+static bool check_threads(std::shared_ptr<ipc::client> client)
+{
+	std::atomic<size_t> wrong(0);
+	std::vector<std::thread> threads;
+	for (uint64_t thread = 0; thread < 4; thread++) {
+		threads.emplace_back([client, thread, &wrong]() {
+			for (uint64_t idx = 0; idx < 1000; idx++) {
+				uint64_t value = thread << 32 | idx;
+				auto rval = client->call_synchronous_helper("Default", "Echo", {ipc::value(value)});
+				if (rval.size() != 1 || rval[0].value_union.ui64 != value) {
+					wrong++;
+				}
+			}
+		});
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+	return wrong == 0;
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t sem_bare = bare_ns<named_semaphore>(), cv_bare = bare_ns<condition>(), pooled_bare = bare_ns<pooled>();
+	blog("Setup, signal and wait: named semaphore %llu ns, mutex and condition variable %llu ns, pooled slot %llu ns.",
+	     (unsigned long long)sem_bare, (unsigned long long)cv_bare, (unsigned long long)pooled_bare);
+
+	std::string conn = CONN "-" + std::to_string(getpid());
+	ipc::server server;
+	std::shared_ptr<ipc::collection> collection = std::make_shared<ipc::collection>("Default");
+	collection->register_function(std::make_shared<ipc::function>("Echo", echo));
+	server.register_collection(collection);
+	try {
+		server.initialize(conn);
+	} catch (std::exception &e) {
+		blog("Unable to start server: %s", e.what());
+		return 1;
+	}
+
+	bool correct = true, threads_ok = false;
+	{
+		std::shared_ptr<ipc::client> client = ipc::client::create(conn);
+		helper_ns(client, correct);
+		uint64_t sem_call = call_ns<named_semaphore>(client, correct), cv_call = call_ns<condition>(client, correct);
+		uint64_t pooled_call = call_ns<pooled>(client, correct), helper_call = helper_ns(client, correct);
+		blog("Median synchronous call: named semaphore %llu ns, mutex and condition variable %llu ns, pooled slot %llu ns, "
+		     "call_synchronous_helper %llu ns.",
+		     (unsigned long long)sem_call, (unsigned long long)cv_call, (unsigned long long)pooled_call, (unsigned long long)helper_call);
+		threads_ok = check_threads(client);
+	}
+	server.finalize();
+
+	bool passed = correct && threads_ok && pooled_bare < sem_bare;
+	if (!passed) {
+		blog("Critical Failure: %s.", !correct ? "a reply went astray" : !threads_ok ? "a thread got another's reply" : "pooled slots are no cheaper");
+	}
+	blog("Synchronous completion checks %s.", passed ? "passed" : "failed");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,237 @@
+#include "ipc-server.hpp"
+#include "ipc-client.hpp"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <cstdarg>
+#include <cstring>
+#include <new>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Server side heap allocations per call for a handler that takes borrowed
+// arguments against one that takes owning ipc::values. The server counts
+// every operator new, the client reads the counter around each run.
+
+#pragma region Logging
+std::chrono::high_resolution_clock::time_point tp = std::chrono::high_resolution_clock::now();
+
+static void blog(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::vector<char> text(vsnprintf(nullptr, 0, format, args) + 1);
+	va_end(args);
+	va_start(args, format);
+	vsnprintf(text.data(), text.size(), format, args);
+	va_end(args);
+
+	auto timeSinceStart = (std::chrono::high_resolution_clock::now() - tp);
+	auto hours = std::chrono::duration_cast<std::chrono::hours>(timeSinceStart);
+	timeSinceStart -= hours;
+	auto minutes = std::chrono::duration_cast<std::chrono::minutes>(timeSinceStart);
+	timeSinceStart -= minutes;
+	auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeSinceStart);
+	timeSinceStart -= seconds;
+	auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(timeSinceStart);
+	timeSinceStart -= milliseconds;
+	auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(timeSinceStart);
+	timeSinceStart -= microseconds;
+	auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeSinceStart);
+
+	fprintf(stdout, "%.2d:%.2d:%.2d.%.3d.%.3d.%.3d: [%d] %s\n", int(hours.count()), int(minutes.count()), int(seconds.count()),
+		int(milliseconds.count()), int(microseconds.count()), int(nanoseconds.count()), int(getpid()), text.data());
+	fflush(stdout);
+}
+#pragma endregion Logging
+
+#pragma region Allocation Counting
+static std::atomic<uint64_t> allocations(0);
+
+void *operator new(size_t size)
+{
+	allocations++;
+	if (void *ptr = malloc(size ? size : 1)) {
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+	free(ptr);
+}
+#pragma endregion Allocation Counting
+
+#define CONN "/tmp/HelloWorldIPC-view"
+#define WARMUP 100
+#define CALLS 10000
+
+static int server(int argc, char *argv[]);
+static int client(int argc, char *argv[]);
+
+int main(int argc, char *argv[])
+{
+	if ((argc >= 3) && (strcmp(argv[1], "client") == 0)) {
+		return client(argc, argv);
+	} else {
+		return server(argc, argv);
+	}
+}
+
+static void view_sum(void *data, const int64_t id, ipc::span<const ipc::value_view> args, std::vector<ipc::value> &rval)
+{
+	uint64_t sum = 0;
+	for (const ipc::value_view &arg : args) {
+		if (arg.type == ipc::type::String) {
+			sum += arg.value_str.size();
+		} else if (arg.type == ipc::type::Binary) {
+			for (char ch : arg.value_bin) {
+				sum += uint8_t(ch);
+			}
+		} else if (arg.type == ipc::type::UInt64) {
+			sum += arg.value_union.ui64;
+		}
+	}
+	rval.push_back(ipc::value(sum));
+}
+
+static void owned_sum(void *data, const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval)
+{
+	uint64_t sum = 0;
+	for (const ipc::value &arg : args) {
+		if (arg.type == ipc::type::String) {
+			sum += arg.value_str.size();
+		} else if (arg.type == ipc::type::Binary) {
+			for (size_t idx = 0; idx < arg.binary_size(); idx++) {
+				sum += uint8_t(arg.binary_data()[idx]);
+			}
+		} else if (arg.type == ipc::type::UInt64) {
+			sum += arg.value_union.ui64;
+		}
+	}
+	rval.push_back(ipc::value(sum));
+}
+
+static void count_allocations(void *data, const int64_t id, ipc::span<const ipc::value_view> args, std::vector<ipc::value> &rval)
+{
+	rval.push_back(ipc::value(uint64_t(allocations.load())));
+}
+
+int server(int argc, char *argv[])
+{
+	blog("Starting server...");
+
+	std::string conn = CONN "-" + std::to_string(getpid());
+	ipc::server socket;
+
+	std::shared_ptr<ipc::collection> collection = std::make_shared<ipc::collection>("Default");
+	collection->register_function(std::make_shared<ipc::function>("ViewSum", view_sum));
+	collection->register_function(std::make_shared<ipc::function>("OwnedSum", owned_sum));
+	collection->register_function(std::make_shared<ipc::function>("Allocations", count_allocations));
+	socket.register_collection(collection);
+
+	try {
+		socket.initialize(conn);
+	} catch (std::exception &e) {
+		blog("Unable to start server: %s", e.what());
+		return -1;
+	}
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		execl("/proc/self/exe", argv[0], "client", conn.c_str(), nullptr);
+		_exit(127);
+	}
+
+	int status = 0;
+	waitpid(pid, &status, 0);
+	bool failed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+
+	blog("Shutting down server, client %s.", failed ? "failed" : "passed");
+	socket.finalize();
+
+	return failed ? 1 : 0;
+}
+
+static uint64_t server_allocations(std::shared_ptr<ipc::client> socket)
+{
+	auto rval = socket->call_synchronous_helper("Default", "Allocations", {});
+	return rval.size() == 1 ? rval[0].value_union.ui64 : 0;
+}
+
+static bool measure(const char *name, std::shared_ptr<ipc::client> socket, const std::vector<ipc::value> &args, uint64_t expected, double &per_call)
+{
+	for (size_t idx = 0; idx < WARMUP; idx++) {
+		socket->call_synchronous_helper("Default", name, args);
+	}
+
+	// The counter call itself allocates nothing on the server, see count_allocations.
+	uint64_t before = server_allocations(socket);
+	auto tpstart = std::chrono::high_resolution_clock::now();
+	for (size_t idx = 0; idx < CALLS; idx++) {
+		auto rval = socket->call_synchronous_helper("Default", name, args);
+		if (rval.size() != 1 || rval[0].type != ipc::type::UInt64 || rval[0].value_union.ui64 != expected) {
+			blog("Critical Failure: %s returned the wrong value.", name);
+			return false;
+		}
+	}
+	auto tpdurns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - tpstart);
+	uint64_t after = server_allocations(socket);
+
+	per_call = double(after - before) / CALLS;
+	blog("%s: %.2f server allocations, %llu ns per call.", name, per_call, (unsigned long long)(tpdurns.count() / CALLS));
+	return true;
+}
+
+int client(int argc, char *argv[])
+{
+	blog("Starting client...");
+
+	std::shared_ptr<ipc::client> socket;
+	try {
+		socket = ipc::client::create(argv[2]);
+	} catch (std::exception &e) {
+		blog("Unable to start client: %s", e.what());
+		return -1;
+	}
+
+	// Strings and binaries well past any small buffer optimization.
+	std::vector<ipc::value> args;
+	uint64_t expected = 0;
+	for (size_t idx = 0; idx < 4; idx++) {
+		args.push_back(ipc::value(std::string(100 + idx, 's')));
+		expected += 100 + idx;
+	}
+	for (size_t idx = 0; idx < 2; idx++) {
+		args.push_back(ipc::value(std::vector<char>(1024, char(idx + 1))));
+		expected += 1024 * (idx + 1);
+	}
+	for (size_t idx = 0; idx < 2; idx++) {
+		args.push_back(ipc::value(uint64_t(idx + 7)));
+		expected += idx + 7;
+	}
+
+	double owned = 0, view = 0;
+	if (!measure("OwnedSum", socket, args, expected, owned) || !measure("ViewSum", socket, args, expected, view)) {
+		return 1;
+	}
+	if (view != 0) {
+		blog("Critical Failure: Borrowed arguments still allocate on the server.");
+		return 1;
+	}
+
+	blog("Shutting down client...");
+	socket = nullptr;
+
+	return 0;
+}
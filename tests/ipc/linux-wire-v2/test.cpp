@@ -0,0 +1,413 @@
+#include "ipc.hpp"
+#include "ipc-server.hpp"
+#include "ipc-client.hpp"
+#include <chrono>
+#include <cstdarg>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Wire format v2 and its handshake. Checks the size of a tiny call in both
+// encodings, round trips every type through the v2 codec, then talks to a
+// scripted stand-in server to see what the client puts on the wire with a
+// v2 peer and with one that predates the handshake, and finally drives the
+// real server with raw v1 and v2 frames and with a regular client.
+
+#pragma region Logging
+std::chrono::high_resolution_clock::time_point tp = std::chrono::high_resolution_clock::now();
+
+static void blog(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::vector<char> text(vsnprintf(nullptr, 0, format, args) + 1);
+	va_end(args);
+	va_start(args, format);
+	vsnprintf(text.data(), text.size(), format, args);
+	va_end(args);
+
+	auto timeSinceStart = (std::chrono::high_resolution_clock::now() - tp);
+	auto hours = std::chrono::duration_cast<std::chrono::hours>(timeSinceStart);
+	timeSinceStart -= hours;
+	auto minutes = std::chrono::duration_cast<std::chrono::minutes>(timeSinceStart);
+	timeSinceStart -= minutes;
+	auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeSinceStart);
+	timeSinceStart -= seconds;
+	auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(timeSinceStart);
+	timeSinceStart -= milliseconds;
+	auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(timeSinceStart);
+	timeSinceStart -= microseconds;
+	auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeSinceStart);
+
+	fprintf(stdout, "%.2d:%.2d:%.2d.%.3d.%.3d.%.3d: [%d] %s\n", int(hours.count()), int(minutes.count()), int(seconds.count()),
+		int(milliseconds.count()), int(microseconds.count()), int(nanoseconds.count()), int(getpid()), text.data());
+	fflush(stdout);
+}
+#pragma endregion Logging
+
+#define CONN "/tmp/HelloWorldIPC-wire"
+
+static std::vector<ipc::value> sample_values()
+{
+	return {ipc::value(),
+		ipc::value(1.5f),
+		ipc::value(-2.25),
+		ipc::value(int32_t(-7)),
+		ipc::value(int64_t(INT64_MIN)),
+		ipc::value(uint32_t(300)),
+		ipc::value(uint64_t(UINT64_MAX)),
+		ipc::value(std::string()),
+		ipc::value(std::string("a string longer than the inline capacity")),
+		ipc::value(std::vector<char>(3, 'b'))};
+}
+
+static bool same(const ipc::value &a, const ipc::value &b)
+{
+	if (a.type != b.type) {
+		return false;
+	}
+	switch (a.type) {
+	case ipc::type::Null:
+		return true;
+	case ipc::type::Float:
+	case ipc::type::Int32:
+	case ipc::type::UInt32:
+		return a.value_union.ui32 == b.value_union.ui32;
+	case ipc::type::String:
+		return std::string_view(a.value_str) == std::string_view(b.value_str);
+	case ipc::type::Binary:
+		return a.binary_size() == b.binary_size() && memcmp(a.binary_data(), b.binary_data(), a.binary_size()) == 0;
+	default:
+		return a.value_union.ui64 == b.value_union.ui64;
+	}
+}
+
+static bool same(const std::vector<ipc::value> &a, const std::vector<ipc::value> &b)
+{
+	if (a.size() != b.size()) {
+		return false;
+	}
+	for (size_t idx = 0; idx < a.size(); idx++) {
+		if (!same(a[idx], b[idx])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+#pragma region Raw Sockets
+static int raw_socket(const std::string &path, bool listen)
+{
+	sockaddr_un addr = {};
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+	int fd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (listen) {
+		unlink(path.c_str());
+		if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || ::listen(fd, 4) < 0) {
+			close(fd);
+			return -1;
+		}
+	} else if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// Frames in this test always fit into a single packet.
+static bool raw_send(int fd, const ipc::frame_builder &builder)
+{
+	return send(fd, builder.data(), builder.size(), MSG_NOSIGNAL) == ssize_t(builder.size());
+}
+
+static bool raw_recv(int fd, std::vector<char> &frame)
+{
+	frame.resize(64 * 1024);
+	ssize_t length = recv(fd, frame.data(), frame.size(), 0);
+	if (length < ssize_t(sizeof(ipc::ipc_size_t))) {
+		return false;
+	}
+	frame.resize(size_t(length));
+	return true;
+}
+#pragma endregion Raw Sockets
+
+static size_t frame_size(ipc::message::function_call &call, ipc::protocol version)
+{
+	ipc::frame_builder builder;
+	call.serialize(builder, nullptr, version);
+	builder.finish(version);
+	return builder.size();
+}
+
+static bool check_codec()
+{
+	ipc::message::function_call call;
+	call.uid = ipc::value(uint64_t(42));
+	call.class_name = ipc::value(std::string("Default"));
+	call.function_name = ipc::value(std::string("Function1"));
+	call.arguments = {ipc::value(uint64_t(7))};
+	size_t v1 = frame_size(call, ipc::protocol::v1), v2 = frame_size(call, ipc::protocol::v2);
+	call.method_id = 12;
+	size_t v2_id = frame_size(call, ipc::protocol::v2);
+	blog("Tiny call frame: v1 %zu bytes, v2 %zu bytes, v2 with method ID %zu bytes.", v1, v2, v2_id);
+	if (v2 >= v1 || v2_id >= v2) {
+		blog("Critical Failure: v2 is not smaller.");
+		return false;
+	}
+
+	call.method_id = 0;
+	call.arguments = sample_values();
+	ipc::frame_builder builder;
+	call.serialize(builder, nullptr, ipc::protocol::v2);
+	builder.finish(ipc::protocol::v2);
+
+	ipc::message::function_call_view view;
+	view.deserialize(builder.data() + sizeof(ipc::ipc_size_t), builder.size() - sizeof(ipc::ipc_size_t), nullptr, ipc::protocol::v2);
+	std::vector<ipc::value> decoded;
+	for (const ipc::value_view &argument : view.arguments) {
+		decoded.push_back(argument.to_value());
+	}
+	if (ipc::read_protocol(builder.data()) != ipc::protocol::v2 || view.uid.value_union.ui64 != 42 || view.class_name.value_str != "Default" ||
+	    view.function_name.value_str != "Function1" || !same(decoded, call.arguments)) {
+		blog("Critical Failure: v2 call did not decode to what was encoded.");
+		return false;
+	}
+
+	ipc::message::function_reply reply;
+	reply.uid = ipc::value(uint64_t(1) << 40);
+	reply.obs_call_duration_ms = ipc::value(uint32_t(17));
+	reply.error = ipc::value(std::string("Something failed."));
+	reply.values = sample_values();
+	builder.reset();
+	reply.serialize(builder, nullptr, ipc::protocol::v2);
+	builder.finish(ipc::protocol::v2);
+
+	std::vector<char> frame(builder.data(), builder.data() + builder.size());
+	ipc::message::function_reply decoded_reply;
+	decoded_reply.deserialize(frame, sizeof(ipc::ipc_size_t), nullptr, ipc::protocol::v2);
+	if (decoded_reply.uid.value_union.ui64 != reply.uid.value_union.ui64 || decoded_reply.obs_call_duration_ms.value_union.ui32 != 17 ||
+	    decoded_reply.error.value_str != "Something failed." || !same(decoded_reply.values, reply.values)) {
+		blog("Critical Failure: v2 reply did not decode to what was encoded.");
+		return false;
+	}
+
+	// Truncated input has to be rejected, not read past.
+	for (size_t length = 0; length < builder.size() - sizeof(ipc::ipc_size_t); length++) {
+		try {
+			view.deserialize(builder.data() + sizeof(ipc::ipc_size_t), length, nullptr, ipc::protocol::v2);
+			blog("Critical Failure: Truncated v2 message of %zu bytes was accepted.", length);
+			return false;
+		} catch (std::exception &) {
+		}
+	}
+	return true;
+}
+
+struct seen_call {
+	ipc::protocol version;
+	uint32_t method_id;
+};
+
+// Answers the handshake like a v2 server listing Default.Echo as method 1, or like one that predates it, and echoes every other call in its own encoding.
+static void fake_server(int listener, bool knows_v2, std::vector<seen_call> *seen)
+{
+	int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+	std::vector<char> frame;
+	ipc::frame_builder builder;
+	ipc::message::function_call_view call;
+	try {
+		while (raw_recv(fd, frame)) {
+			ipc::protocol version = ipc::read_protocol(frame.data());
+			call.deserialize(frame.data() + sizeof(ipc::ipc_size_t), frame.size() - sizeof(ipc::ipc_size_t), nullptr, version);
+
+			ipc::message::function_reply reply;
+			reply.uid = call.uid.to_value();
+			if (call.class_name.value_str == ipc::protocol_handshake_class) {
+				if (knows_v2) {
+					reply.values.push_back(ipc::value(uint32_t(ipc::protocol::v2)));
+					reply.values.push_back(ipc::value(std::string("Default")));
+					reply.values.push_back(ipc::value(std::string("Echo")));
+				} else {
+					reply.error = ipc::value(std::string("Class 'ipc:protocol' is not registered."));
+				}
+			} else {
+				seen->push_back({version, call.method_id});
+				for (const ipc::value_view &argument : call.arguments) {
+					reply.values.push_back(argument.to_value());
+				}
+			}
+
+			builder.reset();
+			reply.serialize(builder, nullptr, version);
+			builder.finish(version);
+			raw_send(fd, builder);
+		}
+	} catch (std::exception &e) {
+		blog("Stand-in server failed: %s", e.what());
+	}
+	close(fd);
+}
+
+static bool check_client(bool knows_v2)
+{
+	const char *name = knows_v2 ? "v2 peer" : "v1 peer";
+	std::string conn = CONN "-fake-" + std::to_string(getpid());
+	int listener = raw_socket(conn, true);
+	if (listener < 0) {
+		blog("Critical Failure: Could not listen on %s.", conn.c_str());
+		return false;
+	}
+
+	std::vector<seen_call> seen;
+	std::thread server(fake_server, listener, knows_v2, &seen);
+	bool echoed = true;
+	{
+		std::shared_ptr<ipc::client> client = ipc::client::create(conn);
+		for (size_t idx = 0; idx < 3; idx++) {
+			echoed = echoed && same(client->call_synchronous_helper("Default", "Echo", sample_values()), sample_values());
+		}
+		echoed = echoed && same(client->call_synchronous_helper("Default", "Unlisted", sample_values()), sample_values());
+	}
+	server.join();
+	close(listener);
+	unlink(conn.c_str());
+
+	// The first call may overtake the handshake answer, everything after it may not. Listed methods go by ID, the rest by name.
+	bool expected = seen.size() == 4;
+	for (size_t idx = 1; idx < seen.size(); idx++) {
+		expected = expected && seen[idx].version == (knows_v2 ? ipc::protocol::v2 : ipc::protocol::v1) &&
+			   seen[idx].method_id == (knows_v2 && idx < 3 ? 1 : 0);
+	}
+	if (!echoed || !expected) {
+		blog("Critical Failure: Client against a %s %s.", name, echoed ? "used the wrong encoding" : "got the wrong values back");
+		return false;
+	}
+	blog("Client against a %s: calls went out as %s.", name, knows_v2 ? "v2 by method ID" : "v1");
+	return true;
+}
+
+static void echo(void *data, const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval)
+{
+	rval = args;
+}
+
+static bool raw_call(int fd, ipc::message::function_call &call, ipc::protocol version, ipc::message::function_reply &reply)
+{
+	ipc::frame_builder builder;
+	call.serialize(builder, nullptr, version);
+	builder.finish(version);
+	std::vector<char> frame;
+	if (!raw_send(fd, builder) || !raw_recv(fd, frame) || ipc::read_protocol(frame.data()) != version) {
+		return false;
+	}
+	reply.deserialize(frame, sizeof(ipc::ipc_size_t), nullptr, version);
+	return true;
+}
+
+static bool check_server()
+{
+	std::string conn = CONN "-" + std::to_string(getpid());
+	ipc::server server;
+	std::shared_ptr<ipc::collection> collection = std::make_shared<ipc::collection>("Default");
+	collection->register_function(std::make_shared<ipc::function>("Echo", echo));
+	server.register_collection(collection);
+	try {
+		server.initialize(conn);
+	} catch (std::exception &e) {
+		blog("Unable to start server: %s", e.what());
+		return false;
+	}
+
+	bool passed = true;
+	int fd = raw_socket(conn, false);
+	ipc::message::function_call call;
+	ipc::message::function_reply reply;
+
+	// A client that predates v2 sends plain calls and has to get plain replies.
+	call.uid = ipc::value(uint64_t(1));
+	call.class_name = ipc::value(std::string("Default"));
+	call.function_name = ipc::value(std::string("Echo"));
+	call.arguments = sample_values();
+	if (fd < 0 || !raw_call(fd, call, ipc::protocol::v1, reply) || !same(reply.values, sample_values())) {
+		blog("Critical Failure: Server did not answer a v1 call in v1.");
+		passed = false;
+	}
+
+	call.uid = ipc::value(uint64_t(2));
+	call.class_name = ipc::value(std::string(ipc::protocol_handshake_class));
+	call.function_name = ipc::value(std::string(ipc::protocol_handshake_function));
+	call.arguments = {ipc::value(uint32_t(ipc::protocol::v2))};
+	if (passed && (!raw_call(fd, call, ipc::protocol::v1, reply) || reply.values.size() != 3 ||
+		       reply.values[0].value_union.ui32 != uint32_t(ipc::protocol::v2) || reply.values[1].value_str != "Default" ||
+		       reply.values[2].value_str != "Echo")) {
+		blog("Critical Failure: Server did not accept v2 and list its methods in the handshake.");
+		passed = false;
+	}
+
+	// Method 1 is Default.Echo, the only one registered before initialize().
+	call.uid = ipc::value(uint64_t(4));
+	call.method_id = 1;
+	call.arguments = sample_values();
+	if (passed && (!raw_call(fd, call, ipc::protocol::v2, reply) || !reply.error.value_str.empty() || !same(reply.values, sample_values()))) {
+		blog("Critical Failure: Server did not dispatch a call by method ID.");
+		passed = false;
+	}
+
+	call.uid = ipc::value(uint64_t(5));
+	call.method_id = 2;
+	if (passed && (!raw_call(fd, call, ipc::protocol::v2, reply) || reply.error.value_str.empty())) {
+		blog("Critical Failure: Server accepted an unknown method ID.");
+		passed = false;
+	}
+	call.method_id = 0;
+
+	call.uid = ipc::value(uint64_t(3));
+	call.class_name = ipc::value(std::string("Default"));
+	call.function_name = ipc::value(std::string("Missing"));
+	call.arguments = {};
+	if (passed && (!raw_call(fd, call, ipc::protocol::v2, reply) || reply.uid.value_union.ui64 != 3 || reply.error.value_str.empty())) {
+		blog("Critical Failure: Server did not report an error in v2.");
+		passed = false;
+	}
+	if (fd >= 0) {
+		close(fd);
+	}
+
+	// Registered after the table was built, so only reachable by name.
+	std::shared_ptr<ipc::collection> late = std::make_shared<ipc::collection>("Late");
+	late->register_function(std::make_shared<ipc::function>("Echo", echo));
+	server.register_collection(late);
+
+	if (passed) {
+		std::shared_ptr<ipc::client> client = ipc::client::create(conn);
+		for (size_t idx = 0; idx < 100 && passed; idx++) {
+			passed = same(client->call_synchronous_helper("Default", "Echo", sample_values()), sample_values());
+		}
+		passed = passed && same(client->call_synchronous_helper("Late", "Echo", sample_values()), sample_values());
+		auto rval = client->call_synchronous_helper("Default", "Missing", {});
+		if (!passed || rval.size() != 1 || rval[0].type != ipc::type::Null || rval[0].value_str.empty()) {
+			blog("Critical Failure: Client and server disagree.");
+			passed = false;
+		}
+	}
+
+	server.finalize();
+	if (passed) {
+		blog("Server answers v1 in v1 and v2 in v2, by name and by method ID.");
+	}
+	return passed;
+}
+
+int main(int argc, char *argv[])
+{
+	bool passed = check_codec() && check_client(true) && check_client(false) && check_server();
+	blog("Wire format checks %s.", passed ? "passed" : "failed");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,180 @@
+#include "ipc-server.hpp"
+#include "ipc-client.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+// Several threads pipeline calls over one socket connection while the server
+// answers them from its executor threads, so frames from different writers
+// queue up behind each other on both sides and go out together. The binaries
+// mix small ones with ones large enough to be sent from their own storage and
+// to span several packets, every reply has to come back intact to its caller.
+// A lone synchronous caller must not be held back waiting for company.
+
+#pragma region Logging
+std::chrono::high_resolution_clock::time_point tp = std::chrono::high_resolution_clock::now();
+
+static void blog(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::vector<char> text(vsnprintf(nullptr, 0, format, args) + 1);
+	va_end(args);
+	va_start(args, format);
+	vsnprintf(text.data(), text.size(), format, args);
+	va_end(args);
+
+	auto timeSinceStart = (std::chrono::high_resolution_clock::now() - tp);
+	auto hours = std::chrono::duration_cast<std::chrono::hours>(timeSinceStart);
+	timeSinceStart -= hours;
+	auto minutes = std::chrono::duration_cast<std::chrono::minutes>(timeSinceStart);
+	timeSinceStart -= minutes;
+	auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeSinceStart);
+	timeSinceStart -= seconds;
+	auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(timeSinceStart);
+	timeSinceStart -= milliseconds;
+	auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(timeSinceStart);
+	timeSinceStart -= microseconds;
+	auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeSinceStart);
+
+	fprintf(stdout, "%.2d:%.2d:%.2d.%.3d.%.3d.%.3d: [%d] %s\n", int(hours.count()), int(minutes.count()), int(seconds.count()),
+		int(milliseconds.count()), int(microseconds.count()), int(nanoseconds.count()), int(getpid()), text.data());
+	fflush(stdout);
+}
+#pragma endregion Logging
+
+#define CONN "/tmp/HelloWorldIPC-coalescing"
+#define THREADS 4
+#define CALLS 500
+#define ROUNDTRIPS 5000
+
+static const size_t sizes[] = {64, 20000, 200000};
+
+static void echo(void *data, const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval)
+{
+	rval = args;
+}
+
+struct inbox {
+	std::atomic<size_t> received = 0;
+	std::atomic<size_t> damaged = 0;
+};
+
+static void collect(void *data, const std::vector<ipc::value> &rval, std::chrono::high_resolution_clock::duration)
+{
+	inbox *box = static_cast<inbox *>(data);
+	if (rval.size() != 2 || rval[0].type != ipc::type::UInt64 || rval[1].type != ipc::type::Binary) {
+		box->damaged++;
+	} else {
+		uint64_t tag = rval[0].value_union.ui64;
+		const char *bytes = rval[1].binary_data();
+		size_t size = rval[1].binary_size();
+		if (size != sizes[tag % 3] || std::any_of(bytes, bytes + size, [tag](char c) { return c != char(tag); })) {
+			box->damaged++;
+		}
+	}
+	box->received++;
+}
+
+static bool pipeline(std::shared_ptr<ipc::client> client)
+{
+	inbox box;
+	std::atomic<size_t> failed = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<std::thread> threads;
+	for (size_t thread = 0; thread < THREADS; thread++) {
+		threads.emplace_back([&, thread]() {
+			for (uint64_t idx = 0; idx < CALLS; idx++) {
+				uint64_t tag = thread * CALLS + idx;
+				std::vector<char> payload(sizes[tag % 3], char(tag));
+				if (!client->call("Default", "Echo", {ipc::value(tag), ipc::value(payload)}, collect, &box)) {
+					failed++;
+				}
+			}
+		});
+	}
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+
+	auto deadline = std::chrono::high_resolution_clock::now() + std::chrono::seconds(30);
+	while (box.received < THREADS * CALLS - failed && std::chrono::high_resolution_clock::now() < deadline) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	if (failed != 0 || box.received != THREADS * CALLS || box.damaged != 0) {
+		blog("Critical Failure: %llu calls failed, %llu of %llu replies arrived, %llu damaged.", (unsigned long long)failed.load(),
+		     (unsigned long long)box.received.load(), (unsigned long long)(THREADS * CALLS), (unsigned long long)box.damaged.load());
+		return false;
+	}
+
+	double bytes = 0;
+	for (size_t idx = 0; idx < THREADS * CALLS; idx++) {
+		bytes += double(sizes[idx % 3]);
+	}
+	blog("%d threads, %d calls each: %llu us, %.1f MB/s echoed.", THREADS, CALLS, (unsigned long long)elapsed.count(),
+	     2 * bytes / double(elapsed.count()));
+	return true;
+}
+
+static bool alone(std::shared_ptr<ipc::client> client)
+{
+	std::vector<std::chrono::nanoseconds> latencies;
+	latencies.reserve(ROUNDTRIPS);
+	std::vector<char> payload(sizes[0], char(0));
+	for (size_t idx = 0; idx < ROUNDTRIPS; idx++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		auto rval = client->call_synchronous_helper("Default", "Echo", {ipc::value(uint64_t(0)), ipc::value(payload)});
+		latencies.push_back(std::chrono::high_resolution_clock::now() - start);
+		if (rval.size() != 2 || rval[0].type != ipc::type::UInt64 || rval[1].binary_size() != payload.size()) {
+			blog("Critical Failure: Synchronous call %llu returned the wrong value.", (unsigned long long)idx);
+			return false;
+		}
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+	blog("Lone caller: median %llu ns, 99th percentile %llu ns per round trip.", (unsigned long long)latencies[ROUNDTRIPS / 2].count(),
+	     (unsigned long long)latencies[ROUNDTRIPS * 99 / 100].count());
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	std::string conn = CONN "-" + std::to_string(getpid());
+	ipc::server server;
+	server.set_executor_threads(4);
+
+	std::shared_ptr<ipc::collection> collection = std::make_shared<ipc::collection>("Default");
+	auto echo_function = std::make_shared<ipc::function>("Echo", echo);
+	echo_function->set_execution(ipc::execution::concurrent);
+	collection->register_function(echo_function);
+	server.register_collection(collection);
+
+	try {
+		server.initialize(conn);
+	} catch (std::exception &e) {
+		blog("Unable to start server: %s", e.what());
+		return 1;
+	}
+
+	std::shared_ptr<ipc::client> client;
+	try {
+		client = ipc::client::create(conn);
+	} catch (std::exception &e) {
+		blog("Unable to start client: %s", e.what());
+		return 1;
+	}
+
+	bool passed = pipeline(client) && alone(client);
+	client = nullptr;
+	server.finalize();
+
+	blog("Write coalescing checks %s.", passed ? "passed" : "failed");
+	return passed ? 0 : 1;
+}
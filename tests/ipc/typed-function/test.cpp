@@ -0,0 +1,167 @@
+#include "ipc.hpp"
+#include "ipc-function.hpp"
+#include "ipc-server.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Functions registered through ipc::make_function against the same functions
+// written as hand-unpacking handlers: signatures and unique names, results,
+// rejected arguments, and the heap traffic and time of one call each.
+
+#define ITERATIONS 200000
+
+#pragma region Allocation Counting
+// GCC inlines these into their callers and then takes the free() for a mismatched new/free pair.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+static std::atomic<uint64_t> allocations(0);
+
+void *operator new(size_t size)
+{
+	allocations++;
+	if (void *ptr = malloc(size ? size : 1)) {
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+	free(ptr);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#pragma endregion Allocation Counting
+
+static uint64_t measure(std::string_view source, int32_t channel, double volume)
+{
+	return source.size() + uint64_t(channel) + uint64_t(volume);
+}
+
+static void measure_handler(void *data, const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval)
+{
+	if (args.size() != 3 || args[0].type != ipc::type::String || args[1].type != ipc::type::Int32 || args[2].type != ipc::type::Double) {
+		return;
+	}
+	rval.push_back(ipc::value(measure(args[0].value_str, args[1].value_union.i32, args[2].value_union.fp64)));
+}
+
+static std::tuple<uint32_t, std::string> split(ipc::span<const char> data)
+{
+	return std::make_tuple(uint32_t(data.size()), std::string(data.begin(), data.end()));
+}
+
+static void nothing() {}
+
+struct counter {
+	uint64_t total = 0;
+
+	uint64_t add(uint64_t amount) { return total += amount; }
+	std::vector<ipc::value> get() const { return {ipc::value(total), ipc::value(std::string("total"))}; }
+};
+
+static bool call(ipc::server &server, const char *fname, std::vector<ipc::value> args, std::vector<ipc::value> &rval, std::string &errormsg)
+{
+	std::vector<ipc::value_view> views(args.begin(), args.end());
+	std::chrono::high_resolution_clock::duration duration;
+	rval.clear();
+	errormsg.clear();
+	return server.client_call_function(0, std::string_view("Typed"), std::string_view(fname), views, rval, errormsg, duration);
+}
+
+int main(int argc, char *argv[])
+{
+	int failures = 0;
+	counter instance;
+
+	ipc::server server;
+	std::shared_ptr<ipc::collection> collection = std::make_shared<ipc::collection>("Typed");
+	std::shared_ptr<ipc::function> typed = ipc::make_function<&measure>("Measure");
+	collection->register_function(typed);
+	collection->register_function(ipc::make_function<&split>("Split"));
+	collection->register_function(ipc::make_function<&nothing>("Nothing"));
+	collection->register_function(ipc::make_function<&counter::add>("Add", &instance));
+	collection->register_function(ipc::make_function<&counter::get>("Get", &instance));
+	server.register_collection(collection);
+
+	// Compile time signatures have to name functions like runtime declared ones do.
+	std::string expected = ipc::base::make_unique_id("Measure", {ipc::type::String, ipc::type::Int32, ipc::type::Double});
+	if (typed->get_unique_name() != expected || collection->get_function("Add")->get_unique_name() != "Add_U8") {
+		fprintf(stdout, "Unique name %s does not match %s.\n", typed->get_unique_name().c_str(), expected.c_str());
+		failures++;
+	}
+
+	std::vector<ipc::value> rval;
+	std::string errormsg;
+	if (!call(server, "Measure", {ipc::value(std::string("source")), ipc::value(int32_t(3)), ipc::value(2.5)}, rval, errormsg) || rval.size() != 1 ||
+	    rval[0].type != ipc::type::UInt64 || rval[0].value_union.ui64 != 11) {
+		fprintf(stdout, "Measure returned the wrong value: %s\n", errormsg.c_str());
+		failures++;
+	}
+	if (!call(server, "Split", {ipc::value(std::vector<char>(5, 'x'))}, rval, errormsg) || rval.size() != 2 || rval[0].value_union.ui32 != 5 ||
+	    rval[1].type != ipc::type::String || rval[1].value_str != "xxxxx") {
+		fprintf(stdout, "Split did not return both tuple elements.\n");
+		failures++;
+	}
+	if (!call(server, "Nothing", {}, rval, errormsg) || !rval.empty()) {
+		fprintf(stdout, "Nothing returned something.\n");
+		failures++;
+	}
+	call(server, "Add", {ipc::value(uint64_t(40))}, rval, errormsg);
+	call(server, "Add", {ipc::value(uint64_t(2))}, rval, errormsg);
+	if (!call(server, "Get", {}, rval, errormsg) || rval.size() != 2 || rval[0].value_union.ui64 != 42 || instance.total != 42) {
+		fprintf(stdout, "Member functions did not run on the instance.\n");
+		failures++;
+	}
+
+	// Mismatches are reported to the caller, the function never runs.
+	if (call(server, "Add", {ipc::value(int32_t(1))}, rval, errormsg) || errormsg.empty() ||
+	    call(server, "Add", {}, rval, errormsg) || instance.total != 42) {
+		fprintf(stdout, "Arguments of the wrong type or count were accepted.\n");
+		failures++;
+	} else {
+		fprintf(stdout, "Rejected: %s\n", errormsg.c_str());
+	}
+
+	// One call each through a handler that unpacks owning values, and the typed function.
+	ipc::function handwritten("Measure", {ipc::type::String, ipc::type::Int32, ipc::type::Double}, measure_handler);
+	std::vector<ipc::value> args = {ipc::value(std::string("a source name that does not fit inline")), ipc::value(int32_t(3)), ipc::value(2.5)};
+	std::vector<ipc::value_view> views(args.begin(), args.end());
+	struct {
+		const char *name;
+		ipc::function *fnc;
+		uint64_t allocations = 0, ns = 0, result = 0;
+	} runs[] = {{"Hand-written", &handwritten}, {"Typed", typed.get()}};
+	for (auto &run : runs) {
+		uint64_t count = allocations;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t idx = 0; idx < ITERATIONS; idx++) {
+			rval.clear();
+			run.fnc->call(0, views, rval);
+		}
+		run.ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count() / ITERATIONS);
+		run.allocations = allocations - count;
+		run.result = rval.empty() ? 0 : rval[0].value_union.ui64;
+		fprintf(stdout, "%-12s %.2f allocations, %llu ns per call.\n", run.name, double(run.allocations) / ITERATIONS, (unsigned long long)run.ns);
+	}
+	if (runs[0].result != runs[1].result || runs[1].allocations > runs[0].allocations) {
+		fprintf(stdout, "Typed function disagrees with the hand-written one or allocates more.\n");
+		failures++;
+	}
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,179 @@
+#include "ipc.hpp"
+#include "ipc-class.hpp"
+#include "ipc-function.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Footprint of ipc::value and the cost of one dispatch through the owning
+// path: decode a call, run a handler through its collection and encode the
+// reply. Heap traffic is counted by replacing operator new.
+
+#define ITERATIONS 200000
+
+#pragma region Allocation Counting
+// GCC inlines these into their callers and then takes the free() for a mismatched new/free pair.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+static std::atomic<uint64_t> allocations(0), allocated_bytes(0);
+
+void *operator new(size_t size)
+{
+	allocations++;
+	allocated_bytes += size;
+	if (void *ptr = malloc(size ? size : 1)) {
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+	free(ptr);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#pragma endregion Allocation Counting
+
+// A typical mix: mostly scalars and short names, one longer string and two binaries.
+static std::vector<ipc::value> make_arguments(size_t seed)
+{
+	std::vector<ipc::value> args;
+	args.reserve(9);
+	args.push_back(ipc::value(uint64_t(seed)));
+	args.push_back(ipc::value(double(seed) * 0.5));
+	args.push_back(ipc::value(int32_t(-1)));
+	args.push_back(ipc::value(uint32_t(seed & 0xFF)));
+	args.push_back(ipc::value(std::string("Default")));
+	args.push_back(ipc::value(std::string("source_name")));
+	args.push_back(ipc::value(std::string("a scene item name that will not fit inline")));
+	args.push_back(ipc::value(std::vector<char>(12, 'b')));
+	args.push_back(ipc::value(std::vector<char>(256, 'B')));
+	return args;
+}
+
+// Claims more than a value can hold, without the memory behind it.
+class oversized_binary : public ipc::shared_binary {
+public:
+	const char *data() const override { return nullptr; }
+	size_t size() const override { return size_t(-1); }
+	int get_handle() const override { return -1; }
+};
+
+static void sum(void *data, const int64_t id, const std::vector<ipc::value> &args, std::vector<ipc::value> &rval)
+{
+	uint64_t total = 0;
+	for (const ipc::value &arg : args) {
+		switch (arg.type) {
+		case ipc::type::String:
+			total += arg.value_str.size();
+			break;
+		case ipc::type::Binary:
+			total += arg.binary_size();
+			break;
+		case ipc::type::Int32:
+		case ipc::type::UInt32:
+			total += arg.value_union.ui32;
+			break;
+		case ipc::type::Double:
+			total += uint64_t(arg.value_union.fp64);
+			break;
+		default:
+			total += arg.value_union.ui64;
+			break;
+		}
+	}
+	rval.push_back(ipc::value(total));
+	rval.push_back(ipc::value(std::string("ok")));
+}
+
+int main(int argc, char *argv[])
+{
+	fprintf(stdout, "sizeof(ipc::value) = %zu bytes, 9 arguments = %zu bytes of vector storage.\n", sizeof(ipc::value), 9 * sizeof(ipc::value));
+
+	// Memory: building and copying argument vectors.
+	uint64_t count = allocations, bytes = allocated_bytes;
+	std::vector<std::vector<ipc::value>> calls;
+	calls.reserve(1000);
+	for (size_t idx = 0; idx < 1000; idx++) {
+		calls.push_back(make_arguments(idx));
+	}
+	fprintf(stdout, "Build: %.2f allocations, %.1f bytes per argument vector.\n", double(allocations - count) / 1000,
+		double(allocated_bytes - bytes) / 1000);
+
+	count = allocations;
+	bytes = allocated_bytes;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t idx = 0; idx < ITERATIONS; idx++) {
+		std::vector<ipc::value> copy = calls[idx % calls.size()];
+	}
+	auto copy_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+	fprintf(stdout, "Copy:  %.2f allocations, %.1f bytes, %llu ns per argument vector.\n", double(allocations - count) / ITERATIONS,
+		double(allocated_bytes - bytes) / ITERATIONS, (unsigned long long)(copy_ns / ITERATIONS));
+
+	// Dispatch: decode, look up, call, encode.
+	ipc::collection collection("Default");
+	collection.register_function(std::make_shared<ipc::function>("Sum", sum));
+
+	ipc::message::function_call call;
+	call.uid = ipc::value(uint64_t(1));
+	call.class_name = ipc::value(std::string("Default"));
+	call.function_name = ipc::value(std::string("Sum"));
+	call.arguments = calls[7];
+	std::vector<char> frame(call.size() + sizeof(ipc::ipc_size_t));
+	call.serialize(frame, sizeof(ipc::ipc_size_t));
+
+	uint64_t expected = 0;
+	ipc::frame_builder builder;
+	count = allocations;
+	start = std::chrono::high_resolution_clock::now();
+	for (size_t idx = 0; idx < ITERATIONS; idx++) {
+		ipc::message::function_call fnc_call_msg;
+		ipc::message::function_reply fnc_reply_msg;
+		fnc_call_msg.deserialize(frame, sizeof(ipc::ipc_size_t));
+
+		std::vector<ipc::value> rval;
+		collection.get_function(fnc_call_msg.function_name.value_str)->call(0, fnc_call_msg.arguments, rval);
+		fnc_reply_msg.uid = fnc_call_msg.uid;
+		std::swap(rval, fnc_reply_msg.values);
+
+		builder.reset();
+		fnc_reply_msg.serialize(builder);
+		builder.finish();
+		expected = fnc_reply_msg.values[0].value_union.ui64;
+	}
+	auto dispatch_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+	fprintf(stdout, "Dispatch: %.2f allocations, %llu ns per call.\n", double(allocations - count) / ITERATIONS,
+		(unsigned long long)(dispatch_ns / ITERATIONS));
+
+	// The scalars of call 7, then the string and binary lengths.
+	uint64_t check = 7 + 3 + 0xFFFFFFFFull + 7 + 7 + 11 + 42 + 12 + 256;
+	if (expected != check) {
+		fprintf(stdout, "Dispatch returned %llu instead of %llu.\n", (unsigned long long)expected, (unsigned long long)check);
+		return 1;
+	}
+
+	// Lengths are stored in 32 bits, shared binaries included.
+	if (sizeof(size_t) > sizeof(uint32_t)) {
+		try {
+			ipc::value oversized(std::make_shared<oversized_binary>());
+			fprintf(stdout, "A shared binary over 4 GiB was accepted.\n");
+			return 1;
+		} catch (std::length_error &) {
+		}
+	}
+	return 0;
+}